@@ -0,0 +1,28 @@
+/** @file
+    Bulk decoding of code and RfRaw test data files on a pool of threads.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_BULK_DECODE_H_
+#define INCLUDE_BULK_DECODE_H_
+
+#define BULK_DECODE_MAX_THREADS 16
+#define BULK_DECODE_MIN_CHUNK 4096     ///< bytes of lines decoded by a thread at once
+#define BULK_DECODE_MAX_CHUNK 262144
+
+struct r_cfg;
+
+/// Decode the lines of a file as with `-y @file`, the file is mapped and split into line-aligned chunks.
+/// Each thread runs its own copies of the decoders, the outputs are passed on in input order.
+/// Decoders marked as stateful run on the calling thread to see the lines in order.
+/// @p threads of 0 uses one thread per online CPU.
+/// @return the events of the last line, or -1 if the file can't be read
+int bulk_decode_file(struct r_cfg *cfg, char const *path, unsigned threads);
+
+#endif /* INCLUDE_BULK_DECODE_H_ */
@@ -0,0 +1,86 @@
+/** @file
+    compat_pthread addresses compatibility threading functions.
+
+    topic: threads and atomics
+    issue: <pthread.h> is not available on Windows systems, C99 has no atomics
+    solution: provide a minimal thread, mutex, and condition API and atomic accessors for Windows systems
+*/
+
+#ifndef INCLUDE_COMPAT_PTHREAD_H_
+#define INCLUDE_COMPAT_PTHREAD_H_
+
+#ifdef THREADS
+
+#ifdef _WIN32
+
+#include <windows.h>
+#include <process.h>
+
+typedef HANDLE pthread_t;
+typedef DWORD pthread_id_t;
+#define THREAD_CALL __stdcall
+#define THREAD_RETURN unsigned
+#define pthread_create(tp, x, p, d) ((*(tp) = (HANDLE)_beginthreadex(NULL, 0, (p), (d), 0, NULL)) == NULL)
+#define pthread_join(t, x) (WaitForSingleObject((t), INFINITE), CloseHandle(t))
+#define pthread_id_self() GetCurrentThreadId()
+#define pthread_id_equal(a, b) ((a) == (b))
+
+// condition variables need Windows Vista (_WIN32_WINNT 0x0600)
+typedef CRITICAL_SECTION pthread_mutex_t;
+typedef CONDITION_VARIABLE pthread_cond_t;
+#define pthread_mutex_init(mp, a) (InitializeCriticalSection(mp), 0)
+#define pthread_mutex_destroy(mp) DeleteCriticalSection(mp)
+#define pthread_mutex_lock(mp) EnterCriticalSection(mp)
+#define pthread_mutex_unlock(mp) LeaveCriticalSection(mp)
+#define pthread_cond_init(cp, a) (InitializeConditionVariable(cp), 0)
+#define pthread_cond_destroy(cp) ((void)(cp))
+#define pthread_cond_wait(cp, mp) SleepConditionVariableCS((cp), (mp), INFINITE)
+#define pthread_cond_signal(cp) WakeConditionVariable(cp)
+
+#else
+
+#include <pthread.h>
+
+typedef pthread_t pthread_id_t;
+#define THREAD_CALL
+#define THREAD_RETURN void *
+#define pthread_id_self() pthread_self()
+#define pthread_id_equal(a, b) pthread_equal((a), (b))
+
+#endif
+
+#endif /* THREADS */
+
+// atomic accessors for unsigned values shared between threads, and for uint64_t counters
+
+#include <stdint.h>
+
+#if defined(_MSC_VER)
+
+#include <windows.h>
+
+#define atomic_load_acquire(p) ((unsigned)InterlockedCompareExchange((volatile LONG *)(p), 0, 0))
+#define atomic_store_release(p, v) ((void)InterlockedExchange((volatile LONG *)(p), (LONG)(v)))
+#define atomic_exchange_seq(p, v) ((unsigned)InterlockedExchange((volatile LONG *)(p), (LONG)(v)))
+#define atomic_add_fetch_seq(p, v) ((unsigned)InterlockedExchangeAdd((volatile LONG *)(p), (LONG)(v)) + (unsigned)(v))
+#define atomic_sub_fetch_seq(p, v) ((unsigned)InterlockedExchangeAdd((volatile LONG *)(p), -(LONG)(v)) - (unsigned)(v))
+#define atomic_fence_seq() MemoryBarrier()
+#define atomic_load_acquire64(p) ((uint64_t)InterlockedCompareExchange64((volatile LONG64 *)(p), 0, 0))
+#define atomic_store_release64(p, v) ((void)InterlockedExchange64((volatile LONG64 *)(p), (LONG64)(v)))
+#define atomic_add_fetch_seq64(p, v) ((uint64_t)InterlockedExchangeAdd64((volatile LONG64 *)(p), (LONG64)(v)) + (uint64_t)(v))
+
+#else
+
+#define atomic_load_acquire(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define atomic_store_release(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define atomic_exchange_seq(p, v) __atomic_exchange_n((p), (v), __ATOMIC_SEQ_CST)
+#define atomic_add_fetch_seq(p, v) __atomic_add_fetch((p), (v), __ATOMIC_SEQ_CST)
+#define atomic_sub_fetch_seq(p, v) __atomic_sub_fetch((p), (v), __ATOMIC_SEQ_CST)
+#define atomic_fence_seq() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define atomic_load_acquire64(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define atomic_store_release64(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define atomic_add_fetch_seq64(p, v) __atomic_add_fetch((p), (v), __ATOMIC_SEQ_CST)
+
+#endif
+
+#endif /* INCLUDE_COMPAT_PTHREAD_H_ */
@@ -9,6 +9,8 @@
 #ifndef INCLUDE_COMPAT_TIME_H_
 #define INCLUDE_COMPAT_TIME_H_
 
+#include <stdint.h>
+
 // ensure struct timeval is known
 #ifdef _WIN32
 #include <winsock2.h>
@@ -25,6 +27,18 @@
 */
 int timeval_subtract(struct timeval *result, struct timeval *x, struct timeval *y);
 
+/** Monotonic clock for measuring intervals, not related to the wall clock.
+
+    @return microseconds since an arbitrary starting point
+*/
+uint64_t monotonic_usec(void);
+
+/** Monotonic clock for measuring short intervals, not related to the wall clock.
+
+    @return nanoseconds since an arbitrary starting point
+*/
+uint64_t monotonic_nsec(void);
+
 // platform-specific functions
 
 #ifdef _WIN32
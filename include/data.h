@@ -22,6 +22,7 @@
 #define INCLUDE_DATA_H_
 
 #include <stdio.h>
+#include <stdint.h>
 
 #if defined(_MSC_VER) && !defined(__clang__)
     // MSVC has something like C99 restrict as __restrict
@@ -129,6 +130,7 @@ data_t *data_retain(data_t *data);
 void data_free(data_t *data);
 
 struct data_output;
+struct metrics;
 
 typedef struct data_output {
     void (*print_data)(struct data_output *output, data_t *data, char const *format);
@@ -138,7 +140,12 @@ typedef struct data_output {
     void (*print_int)(struct data_output *output, int data, char const *format);
     void (*output_start)(struct data_output *output, char const *const *fields, int num_fields);
     void (*output_free)(struct data_output *output);
+    data_t *(*output_stats)(struct data_output *output);
+    void (*output_metrics)(struct data_output *output, struct metrics *metrics, char const *labels);
     FILE *file;
+    // monotonic timestamps in microseconds for the latency stats, cleared before printing
+    uint64_t serialized_usec; ///< event serialized, set by outputs that serialize first
+    uint64_t queued_usec;     ///< event queued for sending, set by network outputs
 } data_output_t;
 
 /** Construct data output for CSV printer.
@@ -167,8 +174,25 @@ void data_output_start(struct data_output *output, char const *const *fields, in
 /** Prints a structured data object. */
 void data_output_print(struct data_output *output, data_t *data);
 
+/** Mark the event being printed as serialized, for the latency stats. */
+void data_output_mark_serialized(struct data_output *output);
+
+/** Mark the event being printed as queued for sending, for the latency stats. */
+void data_output_mark_queued(struct data_output *output);
+
 void data_output_free(struct data_output *output);
 
+/** Returns the output statistics (e.g. queue depth and drops) or NULL if the output keeps none. */
+data_t *data_output_stats(struct data_output *output);
+
+/** Register the output statistics as metrics, once, the series are read in place on render.
+
+    @param output the data_output handle from data_output_x_create
+    @param metrics the registry to add the series to
+    @param labels pre-rendered labels to tell the outputs apart, e.g. `output="mqtt",index="0"`
+*/
+void data_output_metrics(struct data_output *output, struct metrics *metrics, char const *labels);
+
 /* data output helpers */
 
 void print_value(data_output_t *output, data_type_t type, data_value_t value, char const *format);
@@ -177,4 +201,18 @@ void print_array_value(data_output_t *output, data_array_t *array, char const *f
 
 size_t data_print_jsons(data_t *data, char *dst, size_t len);
 
+/// Print data as JSON string to an allocated buffer of @p size bytes, grown until the output fits.
+/// @return the string, or NULL on alloc failure
+char *data_print_jsons_dup(data_t *data, size_t size);
+
+struct datagram_client;
+
+/** Opens a UDP client to host and port, returns NULL on failure. */
+struct datagram_client *datagram_client_create(const char *host, const char *port);
+
+void datagram_client_free(struct datagram_client *client);
+
+/** Sends a message as a single datagram. */
+void datagram_client_send(struct datagram_client *client, const char *message, size_t message_len);
+
 #endif // INCLUDE_DATA_H_
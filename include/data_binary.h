@@ -0,0 +1,48 @@
+/** @file
+    Binary (CBOR and MessagePack) encoding of data_t trees.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_DATA_BINARY_H_
+#define INCLUDE_DATA_BINARY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct data;
+
+typedef enum {
+    BINARY_CBOR,    ///< RFC 7049
+    BINARY_MSGPACK, ///< MessagePack
+} binary_format_t;
+
+/// Key table, known keys are encoded as their index instead of a string.
+typedef struct binary_schema {
+    char **keys;
+    unsigned num_keys;
+    unsigned *slots; ///< open addressing, index + 1 or 0 if empty
+    unsigned num_slots; ///< always a power of two
+} binary_schema_t;
+
+/// Create a key table from a list of fields, duplicates are ignored.
+binary_schema_t *binary_schema_create(char const *const *fields, int num_fields);
+
+void binary_schema_free(binary_schema_t *schema);
+
+/// Returns the index of a key or -1 if the key is not in the table.
+int binary_schema_find(binary_schema_t const *schema, char const *key);
+
+/// Encode the key table as an array of strings, returns 0 if dst is too small.
+size_t binary_print_schema(binary_schema_t const *schema, binary_format_t format, uint8_t *dst, size_t len);
+
+/// Encode data as a map, keys from the optional schema are encoded as integers.
+/// Returns the encoded length or 0 if dst is too small.
+size_t data_print_binary(struct data *data, binary_format_t format, binary_schema_t const *schema, uint8_t *dst, size_t len);
+
+#endif /* INCLUDE_DATA_BINARY_H_ */
@@ -0,0 +1,44 @@
+/** @file
+    Integer decimation of I/Q samples with a CIC filter.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_DECIMATE_H_
+#define INCLUDE_DECIMATE_H_
+
+#include <stdint.h>
+
+#define DECIMATE_ORDER 4
+#define DECIMATE_MAX_FACTOR 64
+
+/// CIC decimator state, the filter runs on I and Q and keeps its phase across buffers.
+typedef struct decimator {
+    unsigned factor;
+    unsigned phase; ///< input samples since the last output
+    double gain;    ///< 1 / factor^order
+    uint64_t integ[DECIMATE_ORDER][2]; ///< wraps around, the comb output is exact nevertheless
+    uint64_t comb[DECIMATE_ORDER][2];
+    int16_t *buf;   ///< output samples, grown as needed
+    unsigned buf_samples;
+} decimator_t;
+
+/// Create a decimator for a factor of 2 to DECIMATE_MAX_FACTOR, returns NULL on error.
+decimator_t *decimator_create(unsigned factor);
+
+void decimator_free(decimator_t *d);
+
+/// Clear the filter state, e.g. on a discontinuity in the input.
+void decimator_reset(decimator_t *d);
+
+/// Decimate CU8 (sample_size 2) or CS16 (sample_size 4) samples to CS16.
+/// The output is in a buffer owned by the decimator, valid until the next call.
+/// @return the output samples, @p out_samples is set to the number of samples
+int16_t *decimator_process(decimator_t *d, void const *iq_buf, unsigned n_samples, int sample_size, unsigned *out_samples);
+
+#endif /* INCLUDE_DECIMATE_H_ */
@@ -25,6 +25,12 @@
 /// Create a new r_device, copy from dev_template if not NULL.
 r_device *create_device(r_device *dev_template);
 
+/// Search a row for a pattern, as bitbuffer_search().
+/// Uses the hits of the shared preamble matcher for patterns the decoder declared in preambles,
+/// only valid before the decoder changes the bitbuffer.
+unsigned decoder_bitbuffer_search(r_device *decoder, bitbuffer_t *bitbuffer, unsigned row, unsigned start,
+        uint8_t const *pattern, unsigned pattern_bits_len);
+
 /// Output data.
 void decoder_output_data(r_device *decoder, data_t *data);
 
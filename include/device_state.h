@@ -0,0 +1,69 @@
+/** @file
+    Last-known state table of received devices.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_DEVICE_STATE_H_
+#define INCLUDE_DEVICE_STATE_H_
+
+#include <time.h>
+
+struct data;
+
+/// Default limit on the number of devices tracked, least recently seen is evicted first.
+#define DEVICE_STATE_MAX_DEVICES 1000
+
+typedef struct device_entry {
+    struct device_entry *next; ///< hash bucket chaining
+    struct device_entry *lru_prev; ///< more recently seen
+    struct device_entry *lru_next; ///< less recently seen
+    unsigned hash;
+    char *key;   ///< "model[/channel][/id]"
+    char *model;
+    struct data *data; ///< retained latest data
+    time_t first_seen;
+    time_t last_seen;
+    unsigned count;
+    float rssi_avg;
+    float snr_avg;
+} device_entry_t;
+
+typedef struct device_state {
+    device_entry_t **buckets;
+    unsigned num_buckets; ///< always a power of two
+    unsigned len;
+    unsigned max_len;
+    device_entry_t *lru_head; ///< most recently seen
+    device_entry_t *lru_tail; ///< least recently seen, evicted first
+} device_state_t;
+
+device_state_t *device_state_create(unsigned max_len);
+
+void device_state_free(device_state_t *state);
+
+/// Format the lookup key for data into buf, returns NULL if the data has no "model".
+char *device_state_key(struct data *data, char *buf, unsigned size);
+
+/// Retain data as latest state of its device, returns the entry or NULL if the data has no "model".
+device_entry_t *device_state_update(device_state_t *state, struct data *data, time_t now, float rssi, float snr);
+
+/// Find the entry for a key, returns NULL if not found.
+device_entry_t *device_state_find(device_state_t *state, char const *key);
+
+/// Build report data for a single entry.
+struct data *device_state_entry_data(device_entry_t *entry);
+
+/// Build report data for all entries, optionally filtered to a model.
+struct data *device_state_data(device_state_t *state, char const *model);
+
+/// Print all entries, optionally filtered to a model, or the entry of a key if given, as JSON.
+/// @return an allocated string, or NULL if the key is not found
+char *device_state_jsons(device_state_t *state, char const *model, char const *key);
+
+#endif /* INCLUDE_DEVICE_STATE_H_ */
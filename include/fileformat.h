@@ -15,6 +15,10 @@
 #include <stdint.h>
 #include <stdio.h>
 
+struct pulse_log_writer;
+struct recorder;
+struct iq_encoder;
+
 char const *file_basename(char const *path);
 
 /// a single handy number to define the file type.
@@ -41,6 +45,8 @@ enum file_type {
     F_LOGIC    = 5 << 16,
     F_VCD      = 6 << 16,
     F_OOK      = 7 << 16,
+    F_PLOG     = 8 << 16,
+    F_SPANS    = 9 << 16,
     // format types
     F_U8       = F_1CH | F_UNSIGNED | F_INT | F_W8,
     F_S8       = F_1CH | F_SIGNED   | F_INT | F_W8,
@@ -70,6 +76,14 @@ enum file_type {
     U8_LOGIC   = F_LOGIC | F_U8,
     VCD_LOGIC  = F_VCD,
     PULSE_OOK  = F_OOK,
+    PULSE_LOG  = F_PLOG,
+    SPAN_INDEX = F_SPANS,
+};
+
+/// sample codecs, independent of the file type.
+enum file_codec {
+    CODEC_NONE = 0,
+    CODEC_RIQ  = 1, ///< lossless Rice coded CU8 or CS16 blocks
 };
 
 typedef struct {
@@ -80,6 +94,10 @@ typedef struct {
     char const *spec;
     char const *path;
     FILE *file;
+    struct pulse_log_writer *pulse_log; ///< writer state of a pulse log dumper
+    struct recorder *recorder;          ///< writer state of a span index dumper
+    uint32_t codec;
+    struct iq_encoder *iq_encoder;      ///< writer state of a compressed IQ dumper
 } file_info_t;
 
 int parse_file_info(const char *filename, file_info_t *info);
@@ -0,0 +1,87 @@
+/** @file
+    Lossless block compression of CU8 and CS16 IQ samples.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_IQ_CODEC_H_
+#define INCLUDE_IQ_CODEC_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#define IQ_CODEC_VERSION 1
+#define IQ_CODEC_BLOCK_SAMPLES 131072   ///< complex samples per block, a multiple of the default buffer length
+#define IQ_CODEC_HEADER_SIZE 24
+#define IQ_CODEC_BLOCK_HEADER_SIZE 12
+#define IQ_DECODER_THREADS 4
+#define IQ_DECODER_BATCH (2 * IQ_DECODER_THREADS) ///< blocks decoded ahead
+
+/// Encoder state, samples are collected to full blocks.
+typedef struct iq_encoder {
+    FILE *file;
+    int sample_size;            ///< bytes per complex sample, 2 for CU8, 4 for CS16
+    int header_done;
+    uint8_t *block;
+    unsigned block_len;         ///< bytes collected
+    uint8_t *out;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+} iq_encoder_t;
+
+struct iq_decode_batch;
+
+/// Decoder state, a batch of blocks is decoded in parallel while the previous batch is read.
+typedef struct iq_decoder {
+    FILE *file;
+    int sample_size;
+    uint32_t block_samples;
+    uint32_t sample_rate;       ///< from the header, 0 if unknown
+    uint32_t center_frequency;  ///< from the header, 0 if unknown
+    struct iq_decode_batch *batches; ///< two batches, one read and one decoding
+    unsigned cur;
+    unsigned next;              ///< next block of the current batch
+    int eof;
+    int error;
+} iq_decoder_t;
+
+/// Maximum encoded size of a block.
+size_t iq_encode_bound(unsigned n_samples, int sample_size);
+
+/// Encode a block of samples, stored as is if it does not compress.
+/// @return the encoded size including the block header
+size_t iq_encode_block(uint8_t const *samples, unsigned n_samples, int sample_size, uint8_t *out);
+
+/// Decode a block, @p in starts with the block header.
+/// @return the number of samples, -1 on a corrupt block
+int iq_decode_block(uint8_t const *in, size_t in_len, uint8_t *samples, unsigned max_samples);
+
+/// Create an encoder for 2 (CU8) or 4 (CS16) byte samples, the header is written with the first samples.
+iq_encoder_t *iq_encoder_create(FILE *file, int sample_size);
+
+/// Append samples, full blocks are encoded and written.
+/// @return 0 on success, -1 on a write error
+int iq_encoder_write(iq_encoder_t *enc, uint8_t const *buf, size_t len, uint32_t sample_rate, uint32_t center_frequency);
+
+/// Write the last partial block and free the encoder, the file is not closed.
+/// @return 0 on success, -1 on a write error
+int iq_encoder_close(iq_encoder_t *enc);
+
+/// Read the header and create a decoder.
+/// @return the decoder or NULL if the file is not a compressed IQ file
+iq_decoder_t *iq_decoder_open(FILE *file);
+
+/// Get the next decoded block, valid until the next call.
+/// @return the length in bytes, 0 at the end, -1 on a corrupt or truncated file
+long iq_decoder_read(iq_decoder_t *dec, uint8_t const **buf);
+
+/// Free the decoder, the file is not closed.
+void iq_decoder_close(iq_decoder_t *dec);
+
+#endif /* INCLUDE_IQ_CODEC_H_ */
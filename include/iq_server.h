@@ -0,0 +1,49 @@
+/** @file
+    IQ stream server, fans out the acquisition buffers to rtl_tcp clients.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_IQ_SERVER_H_
+#define INCLUDE_IQ_SERVER_H_
+
+#include <stdint.h>
+
+#define IQ_SERVER_MAX_CLIENTS 8
+#define IQ_SERVER_RING 16 ///< blocks queued per client before blocks are dropped for that client
+
+struct iq_server;
+struct data;
+struct metrics;
+
+/// Listen on @p host and @p port, clients are served on a thread if available, otherwise from the pushes.
+/// @p opts are "ring=<blocks>" and "clients=<max>".
+/// @return the server or NULL if the port can't be bound
+struct iq_server *iq_server_start(char const *host, char const *port, char *opts, int verbosity);
+
+/// Close all clients and stop the server.
+void iq_server_stop(struct iq_server *srv);
+
+/// The bound port, e.g. if port 0 was requested.
+unsigned iq_server_port(struct iq_server *srv);
+
+/// Lend a shared block to read the next @p len bytes of CU8 samples into, a following push of it is not copied.
+/// @return the buffer or NULL if no block is free
+unsigned char *iq_server_get_buffer(struct iq_server *srv, uint32_t len);
+
+/// Queue samples to all clients (from the SDR thread), CS16 samples are converted to CU8.
+/// A client with a full ring misses the block, the SDR thread never waits.
+void iq_server_push(struct iq_server *srv, unsigned char const *buf, uint32_t len, int sample_size);
+
+/// Build report data of clients, queue depths and drops.
+struct data *iq_server_stats(struct iq_server *srv);
+
+/// Register client and drop metrics.
+void iq_server_metrics(struct iq_server *srv, struct metrics *metrics);
+
+#endif /* INCLUDE_IQ_SERVER_H_ */
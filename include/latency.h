@@ -0,0 +1,66 @@
+/** @file
+    Latency histograms, from end of package on air to the outputs.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_LATENCY_H_
+#define INCLUDE_LATENCY_H_
+
+#include <stdint.h>
+
+/// Significant bits per bucket, the relative error is below 1 / 2^(LATENCY_SUB_BITS - 1).
+#define LATENCY_SUB_BITS 5
+/// Number of buckets to cover all 32 bit values.
+#define LATENCY_BUCKETS ((34 - LATENCY_SUB_BITS) << (LATENCY_SUB_BITS - 1))
+
+/// HDR-style histogram, buckets are linear below 2^LATENCY_SUB_BITS and logarithmic above.
+typedef struct latency_hist {
+    uint32_t counts[LATENCY_BUCKETS];
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+} latency_hist_t;
+
+/// The stages an event passes, all latencies are in microseconds.
+typedef enum {
+    LATENCY_BUFFER, ///< end of package on air to the sample buffer handed to us
+    LATENCY_DETECT, ///< sample buffer to package detected
+    LATENCY_DECODE, ///< package detected to decoder output
+    LATENCY_QUEUE,  ///< decoder output to the thread running the outputs
+    LATENCY_SERIALIZE, ///< output started to event serialized, for each output that reports it
+    LATENCY_SEND,   ///< event serialized to queued for sending, for each network output
+    LATENCY_TOTAL,  ///< end of package on air to all outputs done
+    LATENCY_STAGES,
+} latency_stage_t;
+
+/// Per stage and per output histograms.
+typedef struct latency_stats {
+    latency_hist_t stage[LATENCY_STAGES];
+    unsigned num_outputs;
+    latency_hist_t *output; ///< end of package on air to this output done
+} latency_stats_t;
+
+/// Add a value to the histogram.
+void latency_hist_record(latency_hist_t *hist, uint32_t value);
+
+/// Highest value of the bucket holding the given percentile (0-100), never above the max.
+uint32_t latency_hist_percentile(latency_hist_t const *hist, double percentile);
+
+/// Mean of all recorded values, 0 if empty.
+uint32_t latency_hist_mean(latency_hist_t const *hist);
+
+/// Name of a stage, for reports.
+char const *latency_stage_name(latency_stage_t stage);
+
+latency_stats_t *latency_stats_create(unsigned num_outputs);
+
+void latency_stats_free(latency_stats_t *stats);
+
+#endif /* INCLUDE_LATENCY_H_ */
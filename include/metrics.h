@@ -0,0 +1,98 @@
+/** @file
+    Metrics registry, rendered in the Prometheus text exposition format.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_METRICS_H_
+#define INCLUDE_METRICS_H_
+
+#include <stddef.h>
+#include "list.h"
+
+struct abuf;
+
+typedef enum {
+    METRIC_COUNTER,
+    METRIC_GAUGE,
+    METRIC_SUMMARY, ///< only for collectors, series are single values
+    METRIC_UNTYPED,
+} metric_type_t;
+
+/// Read a value on render.
+typedef double (*metric_value_fn)(void *ctx);
+
+/// Print whole families on render, for values that are not kept in place.
+typedef void (*metrics_collect_fn)(void *ctx, struct abuf *buf);
+
+typedef enum {
+    METRIC_SRC_UNSIGNED,
+    METRIC_SRC_FLOAT,
+    METRIC_SRC_FN,
+} metric_src_t;
+
+/// A series points to a value that is updated in place, nothing is copied until rendered.
+typedef struct metric_series {
+    char *labels; ///< pre-rendered and escaped, e.g. `protocol="1",name="Foo"`, or NULL
+    metric_src_t src;
+    union {
+        unsigned const *u;
+        float const *f;
+    } value;
+    metric_value_fn fn;
+    void *ctx;
+} metric_series_t;
+
+typedef struct metric_family {
+    char *name;
+    char *help;
+    metric_type_t type;
+    list_t series;
+} metric_family_t;
+
+typedef struct metrics_collector {
+    metrics_collect_fn fn;
+    void *ctx;
+} metrics_collector_t;
+
+typedef struct metrics {
+    list_t families;
+    list_t collectors;
+    char *buf; ///< render buffer, grows as needed and is reused
+    size_t buf_size;
+} metrics_t;
+
+metrics_t *metrics_create(void);
+
+void metrics_free(metrics_t *metrics);
+
+/// Add a family, or get the family of the same name, series are added to the family and rendered in order.
+metric_family_t *metrics_family(metrics_t *metrics, char const *name, char const *help, metric_type_t type);
+
+/// Add a series for an unsigned value, read with an atomic load, labels may be NULL.
+void metric_add_unsigned(metric_family_t *family, char const *labels, unsigned const *value);
+
+/// Add a series for a float value, labels may be NULL.
+void metric_add_float(metric_family_t *family, char const *labels, float const *value);
+
+/// Add a series with a value read by a function, labels may be NULL.
+void metric_add_fn(metric_family_t *family, char const *labels, metric_value_fn fn, void *ctx);
+
+/// Add a collector to print more families after the registered ones.
+void metrics_collector(metrics_t *metrics, metrics_collect_fn fn, void *ctx);
+
+/// Print the HELP and TYPE lines of a family, for use in collectors.
+void metrics_print_header(struct abuf *buf, char const *name, char const *help, metric_type_t type);
+
+/// Escape a label value, the output is truncated to fit dst.
+void metrics_escape_label(char *dst, size_t size, char const *src);
+
+/// Render all metrics, the returned text is valid until the next render or free.
+char const *metrics_render(metrics_t *metrics, size_t *len);
+
+#endif /* INCLUDE_METRICS_H_ */
@@ -0,0 +1,54 @@
+/** @file
+    Network I/O thread, runs the mongoose event loop and all outputs.
+
+    Events are never dropped: with the queue full the SDR thread waits
+    until the outputs have caught up, the stall is counted.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_NET_THREAD_H_
+#define INCLUDE_NET_THREAD_H_
+
+struct r_cfg;
+struct r_event;
+struct data;
+struct net_thread;
+struct metrics;
+
+/// A command run on the SDR thread, e.g. to apply a setting received over the network, or a call back on the network thread.
+typedef void (*net_command_fn)(struct r_cfg *cfg, void *ctx);
+
+/// Start polling the mongoose manager of cfg on a new thread, returns NULL if threads are not available.
+struct net_thread *net_thread_start(struct r_cfg *cfg);
+
+/// Stop and join the thread, pending events are still output, pending commands are discarded.
+void net_thread_stop(struct net_thread *nt);
+
+/// Hand an event to the network thread (from the SDR thread), waits while the queue is full, returns 1.
+int net_thread_post_event(struct net_thread *nt, struct r_event const *ev);
+
+/// Run a call on the network thread (from the SDR thread), in order with the events, e.g. to reply to a command.
+int net_thread_post_call(struct net_thread *nt, net_command_fn fn, void *ctx);
+
+/// Hand a command to the SDR thread (from the network thread), returns 0 if the queue is full.
+int net_thread_post_command(struct net_thread *nt, net_command_fn fn, void *ctx);
+
+/// Run all pending commands, call from the SDR thread.
+void net_thread_run_commands(struct net_thread *nt);
+
+/// Returns 1 if called on the network thread.
+int net_thread_is_current(struct net_thread *nt);
+
+/// Build report data of queue depths and stalls.
+struct data *net_thread_stats(struct net_thread *nt);
+
+/// Register queue depth and stall metrics.
+void net_thread_metrics(struct net_thread *nt, struct metrics *metrics);
+
+#endif /* INCLUDE_NET_THREAD_H_ */
@@ -0,0 +1,27 @@
+/** @file
+    Binary (CBOR or MessagePack) event stream output for rtl_433 events.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_OUTPUT_BINARY_H_
+#define INCLUDE_OUTPUT_BINARY_H_
+
+#include "data.h"
+#include "data_binary.h"
+
+struct mg_mgr;
+
+/// Frame types, each frame is a 4-byte big-endian length (of type and payload), the type byte, and the payload.
+#define BINARY_FRAME_SCHEMA 'S' ///< payload is an array of key strings, events refer to keys by index
+#define BINARY_FRAME_EVENT  'E' ///< payload is a map of the event
+
+/// Create a binary output, param is a file name (default stdout), "udp://host:port", or "tcp://host:port".
+struct data_output *data_output_binary_create(struct mg_mgr *mgr, binary_format_t format, char *param);
+
+#endif /* INCLUDE_OUTPUT_BINARY_H_ */
@@ -0,0 +1,71 @@
+/** @file
+    Shared multi-pattern preamble matcher for all decoders.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_PREAMBLE_MATCH_H_
+#define INCLUDE_PREAMBLE_MATCH_H_
+
+#include <stdint.h>
+#include "bitbuffer.h"
+#include "list.h"
+
+struct r_device;
+
+#define PREAMBLE_NONE 0xffff
+#define PREAMBLE_CACHE_SLOTS 8 // distinct bitbuffers kept, e.g. for the slicings of one package
+
+typedef struct preamble_pattern {
+    struct r_device *r_dev;
+    unsigned len;
+    uint8_t bits[BITBUF_COLS];
+} preamble_pattern_t;
+
+/// Hits of a scanned bitbuffer, found again by the hash of its content.
+typedef struct preamble_scan {
+    uint64_t hash;
+    unsigned num_rows;
+    uint16_t bits_per_row[BITBUF_ROWS];
+    uint16_t *first; ///< first hit offset for each row and pattern, PREAMBLE_NONE if absent
+    int valid;
+} preamble_scan_t;
+
+/// Aho-Corasick automaton over the declared preamble patterns of all decoders.
+typedef struct preamble_matcher {
+    unsigned num_patterns;
+    preamble_pattern_t *patterns;
+    unsigned num_states;
+    unsigned *next;     ///< two next states for each state
+    unsigned *dict;     ///< nearest proper suffix state that ends a pattern, 0 for none
+    int *end_head;      ///< first pattern ending at each state, -1 for none
+    int *end_next;      ///< next pattern ending at the same state, -1 for none
+    preamble_scan_t cache[PREAMBLE_CACHE_SLOTS];
+    unsigned cache_next; ///< slot to replace next
+    bitbuffer_t const *scanned; ///< bitbuffer the hits are for, only while the decoder runs
+    uint16_t const *hits;       ///< first hits of the scanned bitbuffer
+    unsigned scans;
+    unsigned scans_cached;
+} preamble_matcher_t;
+
+/// Build the matcher for all decoders with preambles, sets the matcher of each decoder.
+/// @return the matcher or NULL if no decoder declares preambles
+preamble_matcher_t *preamble_matcher_create(list_t *r_devs);
+
+void preamble_matcher_free(preamble_matcher_t *m);
+
+/// Scan the rows for all patterns, unless a bitbuffer of the same content was scanned recently.
+/// @return nonzero if any pattern of the decoder is found in any row
+int preamble_matcher_scan(preamble_matcher_t *m, struct r_device *r_dev, bitbuffer_t const *bitbuffer);
+
+/// Find the first hit of a declared pattern in a row of the scanned bitbuffer.
+/// @return the offset, the row length if absent, or -1 if not known from the scan
+int preamble_matcher_find(preamble_matcher_t *m, struct r_device *r_dev, bitbuffer_t const *bitbuffer,
+        unsigned row, uint8_t const *pattern, unsigned pattern_bits_len);
+
+#endif /* INCLUDE_PREAMBLE_MATCH_H_ */
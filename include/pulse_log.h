@@ -0,0 +1,84 @@
+/** @file
+    Compact binary pulse log with a seek index.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_PULSE_LOG_H_
+#define INCLUDE_PULSE_LOG_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "pulse_detect.h"
+
+#define PULSE_LOG_VERSION 1
+#define PULSE_LOG_INDEX_INTERVAL 64 ///< packages between index entries
+
+/// Seek index entry, points to the start of a package record.
+typedef struct pulse_log_index {
+    uint64_t pos;       ///< file position of the record
+    uint64_t offset;    ///< sample offset of the package
+    int64_t time_us;    ///< wall clock when written, 0 if unknown
+} pulse_log_index_t;
+
+/// Writer state, the index is kept in memory and appended on close.
+typedef struct pulse_log_writer {
+    FILE *file;
+    uint64_t pos;       ///< bytes written, the file might not be seekable
+    unsigned packages;
+    unsigned num_index;
+    unsigned max_index;
+    pulse_log_index_t *index;
+} pulse_log_writer_t;
+
+/// Reader state, immutable after open so any number of cursors can read concurrently.
+typedef struct pulse_log_reader {
+    uint8_t const *data;
+    size_t size;
+    int mapped;         ///< data is mmap'ed, otherwise allocated
+    size_t start;       ///< first record
+    size_t end;         ///< end of package records
+    unsigned num_index;
+    pulse_log_index_t *index;
+} pulse_log_reader_t;
+
+/// Create a writer and write the file header.
+pulse_log_writer_t *pulse_log_writer_create(FILE *file);
+
+/// Append a package, adds an index entry every PULSE_LOG_INDEX_INTERVAL packages.
+void pulse_log_write(pulse_log_writer_t *w, pulse_data_t const *data);
+
+/// Write the index and trailer and free the writer, the file is not closed.
+void pulse_log_writer_close(pulse_log_writer_t *w);
+
+/// Open a pulse log, "-" reads all of stdin.
+/// The index is read from the trailer or rebuilt with a scan if the log was not closed.
+/// @return the reader or NULL on error
+pulse_log_reader_t *pulse_log_open(char const *path);
+
+void pulse_log_close(pulse_log_reader_t *r);
+
+/// Decode the package at cursor @p pos and advance the cursor.
+/// @return 1 if a package was read, 0 at the end, -1 on a corrupt record
+int pulse_log_read(pulse_log_reader_t const *r, size_t *pos, pulse_data_t *data);
+
+/// Find the first package at or after a sample offset.
+/// @return a cursor for pulse_log_read()
+size_t pulse_log_seek_offset(pulse_log_reader_t const *r, uint64_t offset);
+
+/// Find the indexed package nearest before a wall clock time.
+/// @return a cursor for pulse_log_read()
+size_t pulse_log_seek_time(pulse_log_reader_t const *r, int64_t time_us);
+
+/// Split the log at index entries into up to @p parts ranges of similar size.
+/// Range k runs from @p starts[k] to @p starts[k + 1], @p starts needs room for parts + 1 cursors.
+/// @return the number of ranges
+unsigned pulse_log_split(pulse_log_reader_t const *r, unsigned parts, size_t *starts);
+
+#endif /* INCLUDE_PULSE_LOG_H_ */
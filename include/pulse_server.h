@@ -0,0 +1,68 @@
+/** @file
+    Pulse ingest server, receives pulse packets from remote receivers.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_PULSE_SERVER_H_
+#define INCLUDE_PULSE_SERVER_H_
+
+#include <stdint.h>
+#include "pulse_detect.h"
+#include "compat_time.h"
+
+#define PULSE_SERVER_QUEUE 64           ///< packets waiting for the decoders before packets are dropped
+#define PULSE_SERVER_MAX_CLIENTS 64     ///< TCP connections
+#define PULSE_SERVER_MAX_SOURCES 1024   ///< receivers with their own statistics
+#define PULSE_SERVER_NAME_MAX 32        ///< receiver name length, including the terminating NUL
+#define PULSE_SERVER_MAX_PACKET 16384   ///< binary packet or RfRaw line length
+
+#define PULSE_PACKET_MAGIC 0xa5
+#define PULSE_PACKET_VERSION 1
+#define PULSE_PACKET_HEADER_LEN 18
+#define PULSE_PACKET_FSK 0x01           ///< flag for FSK pulses, OOK otherwise
+
+struct pulse_server;
+struct data;
+struct metrics;
+
+/// A package of pulses with the receiver it came from.
+typedef struct pulse_packet {
+    char source[PULSE_SERVER_NAME_MAX]; ///< receiver name, or the sender address if unnamed
+    struct timeval received;
+    pulse_data_t data;
+} pulse_packet_t;
+
+/// Listen for UDP datagrams and TCP connections on @p host and @p port.
+/// Packets are received on a thread if available, otherwise in pulse_server_read().
+/// @p opts are "queue=<packets>" and "clients=<max>".
+/// @return the server or NULL if the port can't be bound
+struct pulse_server *pulse_server_start(char const *host, char const *port, char *opts, int verbosity);
+
+/// Close all connections and stop the server.
+void pulse_server_stop(struct pulse_server *srv);
+
+/// The bound port, e.g. if port 0 was requested.
+unsigned pulse_server_port(struct pulse_server *srv);
+
+/// Wait up to @p timeout_ms for the next packet (on the decoder thread).
+/// @return the packet, valid until the next read, or NULL on timeout
+pulse_packet_t const *pulse_server_read(struct pulse_server *srv, int timeout_ms);
+
+/// Parse a binary packet or a line of RfRaw text at @p buf, sets @p used to the bytes consumed.
+/// With @p eof set a truncated packet is consumed as bad, otherwise more bytes are needed.
+/// @return 1 for a packet, 0 if more bytes are needed, -1 for a bad packet, -2 for a blank or comment line
+int pulse_packet_parse(uint8_t const *buf, size_t len, int eof, size_t *used, pulse_packet_t *packet);
+
+/// Build report data of connections, receivers, and drops.
+struct data *pulse_server_stats(struct pulse_server *srv);
+
+/// Register packet, drop, and receiver metrics.
+void pulse_server_metrics(struct pulse_server *srv, struct metrics *metrics);
+
+#endif /* INCLUDE_PULSE_SERVER_H_ */
@@ -13,6 +13,7 @@
 #define INCLUDE_R_API_H_
 
 #include <stdint.h>
+#include <time.h>
 
 struct r_cfg;
 struct r_device;
@@ -20,6 +21,7 @@ struct data;
 struct pulse_data;
 struct list;
 struct mg_mgr;
+struct metrics;
 
 /* general */
 
@@ -41,6 +43,9 @@ void unregister_protocol(struct r_cfg *cfg, struct r_device *r_dev);
 
 void register_all_protocols(struct r_cfg *cfg, unsigned disabled);
 
+/// Build the preamble matcher shared by the registered protocols, call once all are registered.
+void build_preamble_matcher(struct r_cfg *cfg);
+
 /* output helper */
 
 void calc_rssi_snr(struct r_cfg *cfg, struct pulse_data *pulse_data);
@@ -55,14 +60,67 @@ int run_ook_demods(struct list *r_devs, struct pulse_data *pulse_data);
 
 int run_fsk_demods(struct list *r_devs, struct pulse_data *fsk_pulse_data);
 
+/// Process a buffer of CU8 or CS16 samples, ctx is the r_cfg_t, used as SDR callback.
+void sdr_callback(unsigned char *iq_buf, uint32_t len, void *ctx);
+
 /* handlers */
 
+typedef enum {
+    R_EVENT_DATA,     ///< print to all outputs
+    R_EVENT_ACQUIRED, ///< decoded data, also apply the tags and keep the device state
+    R_EVENT_REPORT,   ///< stats report, also append the output stats
+    R_EVENT_CALL,     ///< no data, run call(cfg, ctx) on the thread running the outputs
+} r_event_kind_t;
+
+/// Data on its way to the outputs, with the receive info captured on the SDR thread.
+typedef struct r_event {
+    r_event_kind_t kind;
+    struct data *data;
+    float rssi;
+    float snr;
+    time_t now;
+    // monotonic timestamps in microseconds for the latency stats, 0 if unknown
+    uint64_t end_usec;    ///< end of package on air, estimated from the buffer position
+    uint64_t buffer_usec; ///< sample buffer handed to us
+    uint64_t detect_usec; ///< package detected
+    uint64_t decode_usec; ///< decoder output
+    // R_EVENT_CALL only
+    void (*call)(struct r_cfg *cfg, void *ctx);
+    void *ctx;
+} r_event_t;
+
+/// Print an event to all outputs on the calling thread, releases the data.
+void output_event(struct r_cfg *cfg, r_event_t *ev);
+
+/// Print an event to all outputs, on the network thread if there is one.
+void dispatch_event(struct r_cfg *cfg, r_event_t *ev);
+
 void event_occurred_handler(struct r_cfg *cfg, struct data *data);
 
+void report_occurred_handler(struct r_cfg *cfg, struct data *data);
+
 void data_acquired_handler(struct r_device *r_dev, struct data *data);
 
 struct data *create_report_data(struct r_cfg *cfg, int level);
 
+/// Append the network thread and output stats to report data, call on the thread running the outputs.
+struct data *append_output_stats(struct r_cfg *cfg, struct data *data);
+
+/// Build report data of the latency histograms, call on the thread running the outputs.
+struct data *latency_report_data(struct r_cfg *cfg);
+
+/// Create a report of decoders ranked by CPU time, top 0 reports all, NULL if not measured.
+struct data *cpu_report_data(struct r_cfg *cfg, int top);
+
+/// Build report data of the input buffers and lost samples, NULL if the input keeps no statistics.
+struct data *input_report_data(struct r_cfg *cfg);
+
+/// Create a metrics registry of the SDR and decoder counters since start, render on the SDR thread.
+struct metrics *create_metrics(struct r_cfg *cfg);
+
+/// Create a metrics registry of the network thread, servers and outputs, render on the thread running the outputs.
+struct metrics *create_output_metrics(struct r_cfg *cfg);
+
 void flush_report_data(struct r_cfg *cfg);
 
 /* setup */
@@ -77,10 +135,16 @@ void add_mqtt_output(struct r_cfg *cfg, char *param);
 
 void add_influx_output(struct r_cfg *cfg, char *param);
 
+void add_binary_output(struct r_cfg *cfg, int msgpack, char *param);
+
 void add_syslog_output(struct r_cfg *cfg, char *param);
 
 void add_http_output(struct r_cfg *cfg, char *param);
 
+void add_rtltcp_output(struct r_cfg *cfg, char *param);
+
+void add_pulse_input(struct r_cfg *cfg, char *param);
+
 void add_null_output(struct r_cfg *cfg, char *param);
 
 void start_outputs(struct r_cfg *cfg, char const *const *well_known);
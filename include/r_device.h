@@ -5,6 +5,8 @@
 #ifndef INCLUDE_R_DEVICE_H_
 #define INCLUDE_R_DEVICE_H_
 
+#include <stdint.h>
+
 /** Supported modulation types. */
 enum modulation_types {
     OOK_PULSE_MANCHESTER_ZEROBIT = 3,  ///< Manchester encoding. Hardcoded zerobit. Rising Edge = 0, Falling edge = 1.
@@ -37,6 +39,7 @@ enum decode_return_codes {
 
 struct bitbuffer;
 struct data;
+struct preamble_matcher;
 
 /** Device protocol decoder struct. */
 typedef struct r_device {
@@ -55,6 +58,8 @@ typedef struct r_device {
     struct r_device *(*create_fn)(char *args);
     unsigned disabled;
     char **fields; ///< List of fields this decoder produces; required for CSV output. NULL-terminated.
+    char const *const *preambles; ///< Optional preamble patterns, e.g. "{24}aa2dd4", the decoder is skipped if none is in any row. NULL-terminated.
+    unsigned stateful; ///< Set if decoding depends on earlier messages, e.g. a learned id; bulk decoding then keeps the input order for this decoder.
 
     /* public for each decoder */
     int verbose;
@@ -66,6 +71,22 @@ typedef struct r_device {
     unsigned decode_ok;
     unsigned decode_messages;
     unsigned decode_fails[5];
+    unsigned decode_skipped; ///< runs skipped by the preamble matcher, not counted as events
+    /* Decoder statistics since start, not reset by reports */
+    unsigned total_events;
+    unsigned total_ok;
+    unsigned total_messages;
+    unsigned total_fails[5];
+    unsigned total_skipped;
+    /* CPU time accounting since start, only if cpu_time is set */
+    int cpu_time;
+    unsigned demod_calls;  ///< slicer runs
+    uint64_t demod_nsec;   ///< time in the slicer, including the decoder
+    uint64_t decode_nsec;  ///< time in the decoder
+
+    /* private for the shared preamble matcher */
+    struct preamble_matcher *preamble_matcher;
+    unsigned preamble_index; ///< index of the first pattern in the matcher
 
     /* private for flex decoder and output callback */
     void *decode_ctx;
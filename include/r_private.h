@@ -13,12 +13,27 @@
 #include "fileformat.h"
 #include "samp_grab.h"
 #include "am_analyze.h"
+#include "decimate.h"
+#include "preamble_match.h"
 #include "rtl_433.h"
 #include "compat_time.h"
 
+/// Stages of the sample processing, timed with a profile.
+enum profile_stage {
+    PROFILE_DECIMATE, ///< decimation of the input
+    PROFILE_ENVELOPE, ///< AM demodulation and noise estimate
+    PROFILE_LOWPASS,  ///< low pass filter on AM
+    PROFILE_FM,       ///< FM demodulation
+    PROFILE_DETECT,   ///< pulse detection
+    PROFILE_DEMOD,    ///< slicers and decoders, including the outputs
+    PROFILE_OUTPUT,   ///< outputs, from data_acquired_handler()
+    PROFILE_STAGES,
+};
+
 struct dm_state {
     float auto_level;
     float squelch_offset;
+    unsigned squelch_hold; ///< samples to keep processing after the last signal frame
     float level_limit;
     float noise_level;
     float min_level_auto;
@@ -37,6 +52,10 @@ struct dm_state {
     uint8_t u8_buf[MAXIMAL_BUF_LENGTH]; // format conversion buffer
     float f32_buf[MAXIMAL_BUF_LENGTH]; // format conversion buffer
     int sample_size; // CU8: 2, CS16: 4
+    unsigned decimation;    ///< integer decimation right after acquisition, 0 or 1 for none
+    decimator_t *decimator;
+    uint32_t sample_rate;   ///< processing sample rate, the input rate after decimation
+    int proc_sample_size;   ///< processing sample size, CS16 after decimation
     pulse_detect_t *pulse_detect;
     filter_state_t lowpass_filter_state;
     demodfm_state_t demod_FM_state;
@@ -51,6 +70,7 @@ struct dm_state {
 
     /* Protocol states */
     list_t r_devs;
+    preamble_matcher_t *preamble_matcher; ///< shared over all r_devs, rebuilt on changes
 
     pulse_data_t    pulse_data;
     pulse_data_t    fsk_pulse_data;
@@ -58,6 +78,12 @@ struct dm_state {
     unsigned frame_start_ago;
     unsigned frame_end_ago;
     struct timeval now;
+    uint64_t buffer_usec; ///< monotonic time the current sample buffer was handed to us
+    uint64_t detect_usec; ///< monotonic time the current package was detected
+
+    /* stage profile, only if profile is set */
+    int profile;
+    uint64_t profile_nsec[PROFILE_STAGES]; ///< time spent per stage
     float sample_file_pos;
 };
 
@@ -0,0 +1,94 @@
+/** @file
+    Continuous recording to rotating segments with an index of package spans.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_RECORDER_H_
+#define INCLUDE_RECORDER_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include "pulse_detect.h"
+
+#define RECORDER_DEFAULT_SEGMENT_SECS 600
+#define RECORDER_DEFAULT_PAD_MS 200
+
+/// Recorder state, IQ samples go to segment files, package spans to the index.
+typedef struct recorder {
+    char *index_path;
+    char *prefix;               ///< segment file path prefix
+    FILE *index;
+    FILE *segment;
+    unsigned segment_num;
+    unsigned segment_secs;
+    uint64_t segment_start;     ///< stream offset of the current segment
+    uint64_t pos;               ///< stream offset of the next sample
+    int sample_size;
+    uint32_t sample_rate;
+    uint32_t center_frequency;
+    unsigned spans;
+} recorder_t;
+
+/// A segment file of the recording.
+typedef struct span_segment {
+    uint64_t offset;            ///< stream offset of the first sample
+    uint64_t samples;
+    uint32_t sample_rate;
+    uint32_t center_frequency;
+    int sample_size;
+    char *path;
+    uint64_t run_start;         ///< start of the contiguous run of segments of the same format
+    uint64_t run_end;           ///< end of the run
+} span_segment_t;
+
+/// A padded range of samples to replay, within one run of segments.
+typedef struct span_range {
+    uint64_t start;
+    uint64_t end;
+    unsigned segment;           ///< the segment of the start
+} span_range_t;
+
+/// A loaded span index, the spans are padded, sorted and merged.
+typedef struct span_index {
+    unsigned num_segments;
+    span_segment_t *segments;
+    unsigned num_spans;
+    span_range_t *spans;
+    uint64_t total_samples;     ///< samples in all segments
+    FILE *file;                 ///< open segment for reading
+    unsigned file_segment;
+} span_index_t;
+
+/// Create a recorder from a spec of "path.spans[,segment=<time>]".
+/// Segments are written next to the index as "path-NNNNN.cu8" or ".cs16".
+/// @return the recorder or NULL on error
+recorder_t *recorder_create(char const *spec, int overwrite);
+
+/// Write samples at a stream offset, starts a new segment when the segment is full,
+/// the format, rate, or frequency changed, or the offset is not contiguous.
+/// @return 0 on success, -1 on a write error
+int recorder_write(recorder_t *rec, uint64_t offset, uint8_t const *iq_buf, unsigned n_samples,
+        int sample_size, uint32_t sample_rate, uint32_t center_frequency);
+
+/// Add the span of a detected package to the index.
+void recorder_add_span(recorder_t *rec, pulse_data_t const *data);
+
+void recorder_free(recorder_t *rec);
+
+/// Load a span index from a spec of "path.spans[,pad=<ms>]".
+/// @return the index or NULL on error
+span_index_t *span_index_load(char const *spec);
+
+void span_index_free(span_index_t *idx);
+
+/// Read samples at a stream offset, up to the end of the segment holding the offset.
+/// @return the number of samples read, 0 if not recorded or on error
+unsigned span_index_read(span_index_t *idx, uint64_t offset, uint8_t *buf, unsigned max_samples);
+
+#endif /* INCLUDE_RECORDER_H_ */
@@ -15,7 +15,10 @@
 #define DEFAULT_HOP_TIME        (60*10)
 #define DEFAULT_ASYNC_BUF_NUMBER    0 // Force use of default value (librtlsdr default: 15)
 #define DEFAULT_BUF_LENGTH      (16 * 32 * 512) // librtlsdr default
+#define DEFAULT_LOW_LATENCY_MS  20 // transfer duration in low latency mode
+#define LOW_LATENCY_BUF_NUMBER  32 // more, smaller, transfers in low latency mode
 #define FSK_PULSE_DETECTOR_LIMIT 800000000
+#define CPU_REPORT_TOP          10 // decoders ranked by CPU time in stats reports
 
 #define MINIMAL_BUF_LENGTH      512
 #define MAXIMAL_BUF_LENGTH      (256 * 16384)
@@ -27,6 +30,12 @@
 struct sdr_dev;
 struct r_device;
 struct mg_mgr;
+struct device_state;
+struct net_thread;
+struct iq_server;
+struct pulse_server;
+struct latency_stats;
+struct metrics;
 
 typedef enum {
     CONVERT_NATIVE,
@@ -50,6 +59,7 @@ typedef struct r_cfg {
     char *settings_str;
     int ppm_error;
     uint32_t out_block_size;
+    int low_latency; ///< target transfer duration in ms, 0=off
     char const *test_data;
     list_t in_files;
     char const *in_filename;
@@ -85,6 +95,7 @@ typedef struct r_cfg {
     int report_time_utc;
     int report_description;
     int report_stats;
+    int report_cpu; ///< measure CPU time per decoder
     int stats_interval;
     volatile sig_atomic_t stats_now;
     time_t stats_time;
@@ -101,7 +112,18 @@ typedef struct r_cfg {
     unsigned frames_count; ///< stats counter for interval
     unsigned frames_fsk; ///< stats counter for interval
     unsigned frames_events; ///< stats counter for interval
+    unsigned total_frames; ///< stats counter since start
+    unsigned total_frames_fsk; ///< stats counter since start
+    unsigned total_frames_events; ///< stats counter since start
+    struct metrics *metrics; ///< metrics registry of the SDR and decoders, created on first use by the SDR thread
+    struct metrics *output_metrics; ///< metrics registry of the outputs, created on first use by the thread running the outputs
     struct mg_mgr *mgr;
+    struct device_state *device_state; ///< last-known device states, only kept if the HTTP API is enabled
+    struct net_thread *net_thread; ///< runs the mongoose manager and the outputs, if started
+    struct iq_server *iq_server; ///< rtl_tcp compatible IQ server, if enabled
+    struct pulse_server *pulse_server; ///< pulse ingest server for remote receivers, if enabled
+    char const *pulse_source; ///< receiver of the pulse data being decoded, if from the pulse server
+    struct latency_stats *latency; ///< latency histograms, owned by the thread running the outputs
 } r_cfg_t;
 
 #endif /* INCLUDE_RTL_433_H_ */
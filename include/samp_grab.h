@@ -14,27 +14,58 @@
 
 #include <stdint.h>
 
+/// A pooled acquisition buffer, free when no references are held.
+typedef struct samp_block {
+    unsigned refs;              ///< look-back window, lender, and writer references
+    uint32_t len;               ///< bytes used
+    unsigned char *data;
+} samp_block_t;
+
+struct samp_grab_job;
+
+/// The look-back window is a ring of references to pooled blocks.
+/// Blocks lent to the SDR are retained without a copy, other buffers are copied in.
 typedef struct samp_grab {
     uint32_t *frequency;
     uint32_t *samp_rate;
     int *sample_size;
 
     unsigned sg_counter;
-    char *sg_buf;
-    unsigned sg_size;
-    unsigned sg_index;
-    unsigned sg_len;
+    int compress;               ///< save grabs lossless compressed ("riq")
+    unsigned sg_size;           ///< look-back window in bytes
+    unsigned sg_len;            ///< bytes in the window
+
+    uint32_t block_size;        ///< allocated on first use, from the first buffer length
+    unsigned num_blocks;
+    samp_block_t *blocks;
+    unsigned char *slab;
+    samp_block_t **window;      ///< ring of num_blocks entries
+    unsigned window_head;       ///< oldest entry
+    unsigned window_count;
+    unsigned next_free;         ///< free block scan start
+    samp_block_t *lent;         ///< block lent by samp_grab_get_buffer() and not pushed yet
+
+    struct samp_grab_job *job;  ///< pending async write
+
+    uint64_t bytes_retained;    ///< pushed without a copy
+    uint64_t bytes_copied;
+    unsigned overruns;          ///< pushes dropped with no free block
 } samp_grab_t;
 
 samp_grab_t *samp_grab_create(unsigned size);
 
 void samp_grab_free(samp_grab_t *g);
 
+/// Lend a free block to read the next @p len bytes into, a following push of it is not copied.
+/// @return the buffer or NULL if no block is free or @p len exceeds the block size
+unsigned char *samp_grab_get_buffer(samp_grab_t *g, uint32_t len);
+
 void samp_grab_push(samp_grab_t *g, unsigned char *iq_buf, uint32_t len);
 
 void samp_grab_reset(samp_grab_t *g);
 
 /// grab_end is counted in samples from end of buf.
+/// The file is written asynchronously from the retained blocks if threads are available.
 void samp_grab_write(samp_grab_t *g, unsigned grab_len, unsigned grab_end);
 
 #endif /* INCLUDE_SAMP_GRAB_H_ */
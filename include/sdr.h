@@ -37,6 +37,22 @@ typedef struct sdr_event {
 
 typedef void (*sdr_event_cb_t)(sdr_event_t *ev, void *ctx);
 
+/// Provide the buffer for the next read of @p len bytes, NULL to use the internal buffer.
+typedef void *(*sdr_buffer_fn_t)(void *ctx, uint32_t len);
+
+/// Input statistics, kept for rtl_tcp only.
+typedef struct sdr_stats {
+    uint64_t bytes_received;    ///< since start
+    uint64_t bytes_dropped;     ///< received but dropped with all buffers waiting for processing
+    int64_t bytes_missing;      ///< expected at the sample rate but not received, an estimate, negative if ahead
+    unsigned gaps;              ///< times the missing bytes grew by more than a buffer
+    unsigned buffers;           ///< buffers in the ring
+    unsigned queued;            ///< buffers waiting for processing
+    unsigned max_queued;
+    int rcvbuf;                 ///< effective socket receive buffer size
+    int sample_size;
+} sdr_stats_t;
+
 /** Find the closest matching device, optionally report status.
 
     @param out_dev device output returned
@@ -172,6 +188,25 @@ int sdr_deactivate(sdr_dev_t *dev);
 */
 int sdr_reset(sdr_dev_t *dev, int verbose);
 
+/** Set a provider of read buffers (only used for rtl_tcp without threads and SoapySDR).
+
+    A buffer is passed once to the data callback and not used again by the device.
+    The provider is called on the thread running the data callback.
+
+    @param dev the device handle
+    @param fn the buffer provider, NULL to use the internal buffer
+    @param ctx the provider context
+*/
+void sdr_set_buffer_fn(sdr_dev_t *dev, sdr_buffer_fn_t fn, void *ctx);
+
+/** Get input statistics, safe to call from any thread.
+
+    @param dev the device handle
+    @param stats the statistics output
+    @return 0 on success, -1 if the device keeps no statistics
+*/
+int sdr_get_stats(sdr_dev_t *dev, sdr_stats_t *stats);
+
 int sdr_start(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, uint32_t buf_num, uint32_t buf_len);
 int sdr_stop(sdr_dev_t *dev);
 
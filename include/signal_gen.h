@@ -0,0 +1,80 @@
+/** @file
+    Synthetic IQ signal generator, renders pulse data to CU8, CS16 or CF32 samples.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_SIGNAL_GEN_H_
+#define INCLUDE_SIGNAL_GEN_H_
+
+#include <stdint.h>
+#include "list.h"
+
+struct pulse_data;
+
+/// A transmission in progress, pulses are FSK if fsk_f2_est is set.
+typedef struct signal_gen_tx {
+    struct pulse_data const *pulses;
+    uint64_t start;    ///< sample position of the first pulse
+    double scale;      ///< samples per pulse data unit
+    float amplitude;
+    double mark_re;    ///< phase rotation per sample for pulses
+    double mark_im;
+    double space_re;   ///< phase rotation per sample for gaps
+    double space_im;
+    int space_on;      ///< gaps carry a carrier (FSK)
+    double phase_re;
+    double phase_im;
+    unsigned pulse;    ///< current pulse index
+    int in_gap;
+    int remain;        ///< samples left in the current pulse or gap
+} signal_gen_tx_t;
+
+typedef struct signal_gen {
+    uint32_t sample_rate;
+    float noise;       ///< noise standard deviation for each of I and Q
+    uint32_t rng;      ///< xorshift32 state
+    uint64_t pos;      ///< sample position of the next render
+    list_t txs;        ///< signal_gen_tx_t, pending and active
+} signal_gen_t;
+
+/// Create a generator, the noise level is in dB full scale, the seed makes runs repeatable.
+signal_gen_t *signal_gen_create(uint32_t sample_rate, float noise_dbfs, uint32_t seed);
+
+void signal_gen_free(signal_gen_t *gen);
+
+/// Schedule pulses at a sample position, the pulses must be kept until rendered.
+/// FSK pulses are sent at offset plus deviation, gaps at offset minus deviation.
+int signal_gen_add(signal_gen_t *gen, struct pulse_data const *pulses, uint64_t start, float level_dbfs, float offset_hz, float deviation_hz);
+
+/// Number of transmissions scheduled or in progress.
+unsigned signal_gen_pending(signal_gen_t *gen);
+
+/// Number of transmissions in progress at the next sample.
+unsigned signal_gen_active(signal_gen_t *gen);
+
+/// Render the next len samples as interleaved CF32, finished transmissions are dropped.
+void signal_gen_render(signal_gen_t *gen, float *iq, unsigned len);
+
+/// A uniform random number in [0, 1) from the generator state.
+double signal_gen_random(signal_gen_t *gen);
+
+/// Length of pulse data in samples at the generator sample rate, including the last gap.
+uint64_t signal_gen_duration(signal_gen_t *gen, struct pulse_data const *pulses);
+
+/// Convert len interleaved CF32 samples to CU8, clipped to full scale.
+void signal_gen_to_cu8(float const *iq, uint8_t *out, unsigned len);
+
+/// Convert len interleaved CF32 samples to CS16, clipped to full scale.
+void signal_gen_to_cs16(float const *iq, int16_t *out, unsigned len);
+
+/// Parse a flex-style spec into pulses in us, e.g. "m=OOK_PWM,s=464,l=1404,g=4000,r=14000,repeats=3,codes={25}5a3c80".
+/// Supports OOK_PCM, OOK_PPM, OOK_PWM, OOK_MC_ZEROBIT, FSK_PCM, FSK_PWM, FSK_MC_ZEROBIT, returns 0 on success.
+int signal_gen_parse_spec(struct pulse_data *pulses, char const *spec);
+
+#endif /* INCLUDE_SIGNAL_GEN_H_ */
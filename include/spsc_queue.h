@@ -0,0 +1,40 @@
+/** @file
+    Bounded lock-free single-producer single-consumer queue.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_SPSC_QUEUE_H_
+#define INCLUDE_SPSC_QUEUE_H_
+
+#include <stddef.h>
+
+/// Elements are copied in and out, one thread may push while another pops.
+typedef struct spsc_queue {
+    unsigned capacity; ///< always a power of two
+    size_t elem_size;
+    unsigned head; ///< next element to pop, written by the consumer only
+    unsigned tail; ///< next element to push, written by the producer only
+    unsigned char *elems;
+} spsc_queue_t;
+
+/// Create a queue, the capacity is rounded up to a power of two.
+spsc_queue_t *spsc_queue_create(unsigned capacity, size_t elem_size);
+
+void spsc_queue_free(spsc_queue_t *queue);
+
+/// Copy an element into the queue, returns 0 if the queue is full.
+int spsc_queue_push(spsc_queue_t *queue, void const *elem);
+
+/// Copy the oldest element out of the queue, returns 0 if the queue is empty.
+int spsc_queue_pop(spsc_queue_t *queue, void *elem);
+
+/// Number of queued elements, only a snapshot if the other thread is active.
+unsigned spsc_queue_len(spsc_queue_t *queue);
+
+#endif /* INCLUDE_SPSC_QUEUE_H_ */
@@ -0,0 +1,532 @@
+/** @file
+    Bulk decoding of code and RfRaw test data files on a pool of threads.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+/*
+    The file is split into chunks of whole lines, a batch of one chunk per thread
+    is decoded while the outputs of the previous batch are passed on. Workers run
+    copies of the decoders which collect the output data per line instead of
+    passing it on. The calling thread then walks the lines in order and, for each
+    line, interleaves the collected data with the outputs of the stateful decoders
+    it runs itself, in the order of the registered decoders. The result is the
+    same as from decoding the lines one by one.
+
+    Lines are split as fgets() with INPUT_LINE_MAX would, chunks end after a newline.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "bulk_decode.h"
+#include "rtl_433.h"
+#include "r_private.h"
+#include "r_device.h"
+#include "r_api.h"
+#include "pulse_demod.h"
+#include "preamble_match.h"
+#include "rfraw.h"
+#include "list.h"
+#include "compat_pthread.h"
+#include "fatal.h"
+
+typedef struct bulk_entry {
+    unsigned dev;       ///< index of the registered decoder
+    struct data *data;
+} bulk_entry_t;
+
+typedef struct bulk_line {
+    size_t offset;
+    unsigned len;
+    int events;         ///< events of the decoders run by the worker
+    unsigned entries_end;
+} bulk_line_t;
+
+typedef struct bulk_chunk {
+    size_t start;
+    size_t end;
+    bulk_line_t *lines;
+    unsigned num_lines;
+    unsigned lines_size;
+    bulk_entry_t *entries;
+    unsigned num_entries;
+    unsigned entries_size;
+} bulk_chunk_t;
+
+struct bulk;
+
+typedef struct bulk_worker {
+    struct bulk *bulk;
+    r_device *devs;         ///< copies of the stateless decoders
+    unsigned *dev_index;    ///< registered index of each copy
+    unsigned num_devs;
+    list_t r_devs;
+    preamble_matcher_t *matcher;
+    bulk_chunk_t *chunk;
+#ifdef THREADS
+    pthread_t thread;
+    int running;
+#endif
+} bulk_worker_t;
+
+typedef struct bulk {
+    char const *buf;
+    size_t size;
+    size_t chunk_size;
+    r_device **devs;        ///< the registered decoders
+    int *copy_of;           ///< copy index of each registered decoder, -1 if stateful
+    unsigned num_devs;
+    unsigned threads;
+    bulk_worker_t *workers;
+    bulk_chunk_t *chunks;   ///< two batches of a chunk per thread
+} bulk_t;
+
+/// Length of the line at @p p as read by fgets() into INPUT_LINE_MAX.
+static unsigned line_len(char const *p, char const *end)
+{
+    size_t max = end - p;
+    if (max > INPUT_LINE_MAX - 1)
+        max = INPUT_LINE_MAX - 1;
+    char const *nl = memchr(p, '\n', max);
+    return nl ? (unsigned)(nl - p + 1) : (unsigned)max;
+}
+
+static void copy_line(char *line, bulk_t *bulk, bulk_line_t const *l)
+{
+    memcpy(line, &bulk->buf[l->offset], l->len);
+    line[l->len] = '\0';
+}
+
+/// Find the decoder for a "[N]" line prefix, sets @p code to the code after the prefix.
+/// @return the registered index, -1 for a bad number, -2 for an unknown protocol
+static int single_decoder(bulk_t *bulk, char *line, char **code, unsigned *num)
+{
+    char *e = NULL;
+    unsigned d = (unsigned)strtol(&line[1], &e, 10);
+    if (!e || *e != ']')
+        return -1;
+    *code = e + 1;
+    *num  = d;
+    for (unsigned i = 0; i < bulk->num_devs; ++i) {
+        if (bulk->devs[i]->protocol_num == d)
+            return i;
+    }
+    return -2;
+}
+
+static int run_line(list_t *r_devs, char const *code)
+{
+    int events = 0;
+    if (rfraw_check(code)) {
+        pulse_data_t pulse_data = {0};
+        rfraw_parse(&pulse_data, code);
+        if (!pulse_data.fsk_f2_est)
+            events += run_ook_demods(r_devs, &pulse_data);
+        else
+            events += run_fsk_demods(r_devs, &pulse_data);
+    }
+    else {
+        for (void **iter = r_devs->elems; iter && *iter; ++iter) {
+            events += pulse_demod_string(code, *iter);
+        }
+    }
+    return events;
+}
+
+static int run_single(r_device *r_dev, char const *code)
+{
+    void *elems[2] = {r_dev, NULL};
+    list_t single  = {elems, 2, 1};
+    return run_line(&single, code);
+}
+
+/// Output callback of the worker copies, collects the data for the current line.
+static void bulk_output(r_device *decoder, struct data *data)
+{
+    bulk_worker_t *worker = decoder->output_ctx;
+    bulk_chunk_t *chunk   = worker->chunk;
+    if (chunk->num_entries == chunk->entries_size) {
+        unsigned size = chunk->entries_size ? 2 * chunk->entries_size : 64;
+        bulk_entry_t *entries = realloc(chunk->entries, size * sizeof(*entries));
+        if (!entries)
+            FATAL_REALLOC("bulk_output()");
+        chunk->entries      = entries;
+        chunk->entries_size = size;
+    }
+    bulk_entry_t *entry = &chunk->entries[chunk->num_entries++];
+    entry->dev  = worker->dev_index[decoder - worker->devs];
+    entry->data = data;
+}
+
+static void clear_stats(r_device *r_dev)
+{
+    r_dev->decode_events   = 0;
+    r_dev->decode_ok       = 0;
+    r_dev->decode_messages = 0;
+    r_dev->total_events    = 0;
+    r_dev->total_ok        = 0;
+    r_dev->total_messages  = 0;
+    r_dev->decode_skipped  = 0;
+    r_dev->total_skipped   = 0;
+    for (int i = 0; i < 5; ++i) {
+        r_dev->decode_fails[i] = 0;
+        r_dev->total_fails[i]  = 0;
+    }
+    r_dev->demod_calls = 0;
+    r_dev->demod_nsec  = 0;
+    r_dev->decode_nsec = 0;
+}
+
+static void add_stats(r_device *r_dev, r_device const *copy)
+{
+    r_dev->decode_events   += copy->decode_events;
+    r_dev->decode_ok       += copy->decode_ok;
+    r_dev->decode_messages += copy->decode_messages;
+    r_dev->total_events    += copy->total_events;
+    r_dev->total_ok        += copy->total_ok;
+    r_dev->total_messages  += copy->total_messages;
+    r_dev->decode_skipped  += copy->decode_skipped;
+    r_dev->total_skipped   += copy->total_skipped;
+    for (int i = 0; i < 5; ++i) {
+        r_dev->decode_fails[i] += copy->decode_fails[i];
+        r_dev->total_fails[i]  += copy->total_fails[i];
+    }
+    r_dev->demod_calls += copy->demod_calls;
+    r_dev->demod_nsec  += copy->demod_nsec;
+    r_dev->decode_nsec += copy->decode_nsec;
+}
+
+static void bulk_worker_run(bulk_worker_t *worker)
+{
+    bulk_t *bulk        = worker->bulk;
+    bulk_chunk_t *chunk = worker->chunk;
+    char line[INPUT_LINE_MAX];
+
+    chunk->num_lines   = 0;
+    chunk->num_entries = 0;
+    for (size_t pos = chunk->start; pos < chunk->end;) {
+        if (chunk->num_lines == chunk->lines_size) {
+            unsigned size = chunk->lines_size ? 2 * chunk->lines_size : 256;
+            bulk_line_t *lines = realloc(chunk->lines, size * sizeof(*lines));
+            if (!lines)
+                FATAL_REALLOC("bulk_worker_run()");
+            chunk->lines      = lines;
+            chunk->lines_size = size;
+        }
+        bulk_line_t *l = &chunk->lines[chunk->num_lines++];
+        l->offset = pos;
+        l->len    = line_len(&bulk->buf[pos], &bulk->buf[chunk->end]);
+        pos += l->len;
+        copy_line(line, bulk, l);
+
+        l->events = 0;
+        if (*line == '[') {
+            char *code;
+            unsigned num;
+            int i = single_decoder(bulk, line, &code, &num);
+            // bad lines are reported in order by the calling thread
+            if (i >= 0 && bulk->copy_of[i] >= 0)
+                l->events = run_single(&worker->devs[bulk->copy_of[i]], code);
+        }
+        else {
+            l->events = run_line(&worker->r_devs, line);
+        }
+        l->entries_end = chunk->num_entries;
+    }
+}
+
+#ifdef THREADS
+static THREAD_RETURN THREAD_CALL bulk_worker_thread(void *arg)
+{
+    bulk_worker_run(arg);
+    return (THREAD_RETURN)0;
+}
+#endif
+
+/// Split the next chunks off the file and start decoding them.
+static unsigned bulk_batch_start(bulk_t *bulk, bulk_chunk_t *batch, size_t *pos)
+{
+    unsigned count = 0;
+    while (*pos < bulk->size && count < bulk->threads) {
+        bulk_chunk_t *chunk = &batch[count++];
+        chunk->start = *pos;
+        chunk->end   = bulk->size;
+        if (bulk->size - *pos > bulk->chunk_size) {
+            size_t from    = *pos + bulk->chunk_size - 1;
+            char const *nl = memchr(&bulk->buf[from], '\n', bulk->size - from);
+            if (nl)
+                chunk->end = nl - bulk->buf + 1;
+        }
+        *pos = chunk->end;
+    }
+
+    for (unsigned i = 0; i < count; ++i) {
+        bulk_worker_t *worker = &bulk->workers[i];
+        worker->chunk = &batch[i];
+#ifdef THREADS
+        worker->running = !pthread_create(&worker->thread, NULL, bulk_worker_thread, worker);
+        if (worker->running)
+            continue;
+#endif
+        bulk_worker_run(worker);
+    }
+    return count;
+}
+
+static void bulk_batch_wait(bulk_t *bulk)
+{
+#ifdef THREADS
+    for (unsigned i = 0; i < bulk->threads; ++i) {
+        bulk_worker_t *worker = &bulk->workers[i];
+        if (worker->running)
+            pthread_join(worker->thread, NULL);
+        worker->running = 0;
+    }
+#else
+    (void)bulk;
+#endif
+}
+
+/// Pass on the outputs of a chunk in order, runs the stateful decoders.
+/// @return the events of the last line
+static int bulk_chunk_emit(bulk_t *bulk, bulk_chunk_t *chunk)
+{
+    char line[INPUT_LINE_MAX];
+    int events     = 0;
+    unsigned entry = 0;
+
+    for (unsigned n = 0; n < chunk->num_lines; ++n) {
+        bulk_line_t *l = &chunk->lines[n];
+        copy_line(line, bulk, l);
+        events = l->events;
+
+        if (*line == '[') {
+            char *code;
+            unsigned num;
+            int i = single_decoder(bulk, line, &code, &num);
+            if (i == -1) {
+                fprintf(stderr, "Bad protocol number %.5s.\n", line);
+                exit(1);
+            }
+            if (i == -2) {
+                fprintf(stderr, "Unknown protocol number %u.\n", num);
+                exit(1);
+            }
+            if (bulk->copy_of[i] < 0)
+                events += run_single(bulk->devs[i], code);
+        }
+        else {
+            for (unsigned i = 0; i < bulk->num_devs; ++i) {
+                if (bulk->copy_of[i] < 0)
+                    events += run_single(bulk->devs[i], line);
+                for (; entry < l->entries_end && chunk->entries[entry].dev == i; ++entry) {
+                    data_acquired_handler(bulk->devs[i], chunk->entries[entry].data);
+                }
+            }
+        }
+        for (; entry < l->entries_end; ++entry) {
+            bulk_entry_t *e = &chunk->entries[entry];
+            data_acquired_handler(bulk->devs[e->dev], e->data);
+        }
+    }
+    return events;
+}
+
+static unsigned online_cpus(void)
+{
+#if defined(THREADS) && defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#elif defined(THREADS) && defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (unsigned)n : 1;
+#else
+    return 1;
+#endif
+}
+
+/// Map a regular file, or read it on systems without mmap().
+/// @return the contents or NULL, the size is 0 for an empty file
+static char *map_file(char const *path, size_t *size)
+{
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    if (fstat(fd, &st) || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return NULL;
+    }
+    *size = (size_t)st.st_size;
+    if (!*size) {
+        close(fd);
+        return (char *)"";
+    }
+    void *buf = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (buf == MAP_FAILED)
+        return NULL;
+#ifdef MADV_SEQUENTIAL
+    madvise(buf, *size, MADV_SEQUENTIAL);
+#endif
+    return buf;
+#else
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return NULL;
+    char *buf = NULL;
+    long len  = -1;
+    if (!fseek(fp, 0, SEEK_END))
+        len = ftell(fp);
+    if (len >= 0 && !fseek(fp, 0, SEEK_SET)) {
+        buf = malloc(len ? len : 1);
+        if (!buf)
+            WARN_MALLOC("map_file()");
+    }
+    if (buf && fread(buf, 1, len, fp) != (size_t)len) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(fp);
+    *size = len;
+    return buf;
+#endif
+}
+
+static void unmap_file(char *buf, size_t size)
+{
+#ifndef _WIN32
+    if (size)
+        munmap(buf, size);
+#else
+    (void)size;
+    free(buf);
+#endif
+}
+
+int bulk_decode_file(r_cfg_t *cfg, char const *path, unsigned threads)
+{
+    size_t size = 0;
+    char *buf   = map_file(path, &size);
+    if (!buf)
+        return -1;
+
+#ifdef THREADS
+    if (!threads)
+        threads = online_cpus();
+    if (threads > BULK_DECODE_MAX_THREADS)
+        threads = BULK_DECODE_MAX_THREADS;
+#else
+    threads = 1;
+#endif
+
+    bulk_t bulk = {0};
+    bulk.buf     = buf;
+    bulk.size    = size;
+    bulk.threads = threads;
+
+    bulk.chunk_size = size / (threads * 8);
+    if (bulk.chunk_size < BULK_DECODE_MIN_CHUNK)
+        bulk.chunk_size = BULK_DECODE_MIN_CHUNK;
+    if (bulk.chunk_size > BULK_DECODE_MAX_CHUNK)
+        bulk.chunk_size = BULK_DECODE_MAX_CHUNK;
+
+    list_t *r_devs = &cfg->demod->r_devs;
+    for (void **iter = r_devs->elems; iter && *iter; ++iter) {
+        bulk.num_devs++;
+    }
+    bulk.devs = (r_device **)r_devs->elems;
+
+    unsigned num_copies = 0;
+    bulk.copy_of = calloc(bulk.num_devs + 1, sizeof(*bulk.copy_of));
+    if (!bulk.copy_of)
+        FATAL_CALLOC("bulk_decode_file()");
+    for (unsigned i = 0; i < bulk.num_devs; ++i) {
+        bulk.copy_of[i] = bulk.devs[i]->stateful ? -1 : (int)num_copies++;
+    }
+
+    bulk.workers = calloc(threads, sizeof(*bulk.workers));
+    if (!bulk.workers)
+        FATAL_CALLOC("bulk_decode_file()");
+    bulk.chunks = calloc(2 * threads, sizeof(*bulk.chunks));
+    if (!bulk.chunks)
+        FATAL_CALLOC("bulk_decode_file()");
+    for (unsigned t = 0; t < threads; ++t) {
+        bulk_worker_t *worker = &bulk.workers[t];
+        worker->bulk     = &bulk;
+        worker->num_devs = num_copies;
+        worker->devs     = calloc(num_copies + 1, sizeof(*worker->devs));
+        if (!worker->devs)
+            FATAL_CALLOC("bulk_decode_file()");
+        worker->dev_index = calloc(num_copies + 1, sizeof(*worker->dev_index));
+        if (!worker->dev_index)
+            FATAL_CALLOC("bulk_decode_file()");
+        for (unsigned i = 0; i < bulk.num_devs; ++i) {
+            int k = bulk.copy_of[i];
+            if (k < 0)
+                continue;
+            r_device *copy = &worker->devs[k];
+            *copy = *bulk.devs[i]; // the decode_ctx is shared, only stateful decoders write to it
+            clear_stats(copy);
+            copy->output_fn        = bulk_output;
+            copy->output_ctx       = worker;
+            copy->preamble_matcher = NULL;
+            worker->dev_index[k]   = i;
+            list_push(&worker->r_devs, copy);
+        }
+        worker->matcher = preamble_matcher_create(&worker->r_devs);
+    }
+
+    int events     = 0;
+    size_t pos     = 0;
+    unsigned cur   = 0;
+    unsigned count[2];
+    count[cur] = bulk_batch_start(&bulk, &bulk.chunks[0], &pos);
+    while (count[cur]) {
+        bulk_chunk_t *batch = &bulk.chunks[cur * threads];
+        bulk_batch_wait(&bulk);
+        count[!cur] = bulk_batch_start(&bulk, &bulk.chunks[!cur * threads], &pos);
+        for (unsigned i = 0; i < count[cur]; ++i) {
+            events = bulk_chunk_emit(&bulk, &batch[i]);
+        }
+        cur = !cur;
+    }
+    bulk_batch_wait(&bulk);
+
+    for (unsigned t = 0; t < threads; ++t) {
+        bulk_worker_t *worker = &bulk.workers[t];
+        for (unsigned k = 0; k < worker->num_devs; ++k) {
+            add_stats(bulk.devs[worker->dev_index[k]], &worker->devs[k]);
+        }
+        preamble_matcher_free(worker->matcher);
+        list_free_elems(&worker->r_devs, NULL);
+        free(worker->devs);
+        free(worker->dev_index);
+    }
+    for (unsigned i = 0; i < 2 * threads; ++i) {
+        free(bulk.chunks[i].lines);
+        free(bulk.chunks[i].entries);
+    }
+    free(bulk.chunks);
+    free(bulk.workers);
+    free(bulk.copy_of);
+    unmap_file(buf, size);
+
+    return events;
+}
@@ -51,6 +51,7 @@
 #include "abuf.h"
 #include "fatal.h"
 #include "r_util.h"
+#include "compat_time.h"
 
 #include "data.h"
 
@@ -402,6 +403,16 @@ void data_output_print(data_output_t *output, data_t *data)
     }
 }
 
+void data_output_mark_serialized(struct data_output *output)
+{
+    output->serialized_usec = monotonic_usec();
+}
+
+void data_output_mark_queued(struct data_output *output)
+{
+    output->queued_usec = monotonic_usec();
+}
+
 void data_output_start(struct data_output *output, char const *const *fields, int num_fields)
 {
     if (!output || !output->output_start)
@@ -416,6 +427,20 @@ void data_output_free(data_output_t *output)
     output->output_free(output);
 }
 
+data_t *data_output_stats(data_output_t *output)
+{
+    if (!output || !output->output_stats)
+        return NULL;
+    return output->output_stats(output);
+}
+
+void data_output_metrics(data_output_t *output, struct metrics *metrics, char const *labels)
+{
+    if (!output || !output->output_metrics)
+        return;
+    output->output_metrics(output, metrics, labels);
+}
+
 /* output helpers */
 
 void print_value(data_output_t *output, data_type_t type, data_value_t value, char const *format)
@@ -947,19 +972,27 @@ struct data_output *data_output_csv_create(FILE *file)
 typedef struct {
     struct data_output output;
     abuf_t msg;
+    int truncated; ///< some output did not fit
 } data_print_jsons_t;
 
+static void jsons_cat(data_print_jsons_t *jsons, char const *str)
+{
+    if (jsons->msg.left < strlen(str) + 1)
+        jsons->truncated = 1;
+    abuf_cat(&jsons->msg, str);
+}
+
 static void format_jsons_array(data_output_t *output, data_array_t *array, char const *format)
 {
     data_print_jsons_t *jsons = (data_print_jsons_t *)output;
 
-    abuf_cat(&jsons->msg, "[");
+    jsons_cat(jsons, "[");
     for (int c = 0; c < array->num_values; ++c) {
         if (c)
-            abuf_cat(&jsons->msg, ",");
+            jsons_cat(jsons, ",");
         print_array_value(output, array, format, c);
     }
-    abuf_cat(&jsons->msg, "]");
+    jsons_cat(jsons, "]");
 }
 
 static void format_jsons_object(data_output_t *output, data_t *data, char const *format)
@@ -968,17 +1001,17 @@ static void format_jsons_object(data_output_t *output, data_t *data, char const
     data_print_jsons_t *jsons = (data_print_jsons_t *)output;
 
     bool separator = false;
-    abuf_cat(&jsons->msg, "{");
+    jsons_cat(jsons, "{");
     while (data) {
         if (separator)
-            abuf_cat(&jsons->msg, ",");
+            jsons_cat(jsons, ",");
         output->print_string(output, data->key, NULL);
-        abuf_cat(&jsons->msg, ":");
+        jsons_cat(jsons, ":");
         print_value(output, data->type, data->value, data->format);
         separator = true;
         data      = data->next;
     }
-    abuf_cat(&jsons->msg, "}");
+    jsons_cat(jsons, "}");
 }
 
 static void format_jsons_string(data_output_t *output, const char *str, char const *format)
@@ -991,12 +1024,13 @@ static void format_jsons_string(data_output_t *output, const char *str, char con
 
     size_t str_len = strlen(str);
     if (size < str_len + 3) {
+        jsons->truncated = 1;
         return;
     }
 
     if (str[0] == '{' && str[str_len - 1] == '}') {
         // Print embedded JSON object verbatim
-        abuf_cat(&jsons->msg, str);
+        jsons_cat(jsons, str);
         return;
     }
 
@@ -1031,7 +1065,10 @@ static void format_jsons_string(data_output_t *output, const char *str, char con
         *buf++ = *str;
         size--;
     }
-    if (size >= 2) {
+    if (*str || size < 2) {
+        jsons->truncated = 1;
+    }
+    else {
         *buf++ = '"';
         size--;
     }
@@ -1046,11 +1083,14 @@ static void format_jsons_double(data_output_t *output, double data, char const *
     UNUSED(format);
     data_print_jsons_t *jsons = (data_print_jsons_t *)output;
     // use scientific notation for very big/small values
+    size_t left = jsons->msg.left;
     if (data > 1e7 || data < 1e-4) {
-        abuf_printf(&jsons->msg, "%g", data);
+        if (abuf_printf(&jsons->msg, "%g", data) >= (int)left)
+            jsons->truncated = 1;
     }
     else {
-        abuf_printf(&jsons->msg, "%.5f", data);
+        if (abuf_printf(&jsons->msg, "%.5f", data) >= (int)left)
+            jsons->truncated = 1;
         // remove trailing zeros, always keep one digit after the decimal point
         while (jsons->msg.left > 0 && *(jsons->msg.tail - 1) == '0' && *(jsons->msg.tail - 2) != '.') {
             jsons->msg.tail--;
@@ -1064,10 +1104,12 @@ static void format_jsons_int(data_output_t *output, int data, char const *format
 {
     UNUSED(format);
     data_print_jsons_t *jsons = (data_print_jsons_t *)output;
-    abuf_printf(&jsons->msg, "%d", data);
+    size_t left = jsons->msg.left;
+    if (abuf_printf(&jsons->msg, "%d", data) >= (int)left)
+        jsons->truncated = 1;
 }
 
-size_t data_print_jsons(data_t *data, char *dst, size_t len)
+static size_t print_jsons(data_t *data, char *dst, size_t len, int *truncated)
 {
     data_print_jsons_t jsons = {
             .output = {
@@ -1083,12 +1125,36 @@ size_t data_print_jsons(data_t *data, char *dst, size_t len)
 
     format_jsons_object(&jsons.output, data, NULL);
 
+    if (truncated)
+        *truncated = jsons.truncated;
     return len - jsons.msg.left;
 }
 
+size_t data_print_jsons(data_t *data, char *dst, size_t len)
+{
+    return print_jsons(data, dst, len, NULL);
+}
+
+char *data_print_jsons_dup(data_t *data, size_t size)
+{
+    for (;;) {
+        char *buf = malloc(size);
+        if (!buf) {
+            WARN_MALLOC("data_print_jsons_dup()");
+            return NULL;
+        }
+        int truncated = 0;
+        print_jsons(data, buf, size, &truncated);
+        if (!truncated)
+            return buf;
+        free(buf);
+        size *= 2;
+    }
+}
+
 /* Datagram (UDP) client */
 
-typedef struct {
+typedef struct datagram_client {
     struct sockaddr_storage addr;
     socklen_t addr_len;
     SOCKET sock;
@@ -1150,7 +1216,7 @@ static void datagram_client_close(datagram_client_t *client)
 #endif
 }
 
-static void datagram_client_send(datagram_client_t *client, const char *message, size_t message_len)
+void datagram_client_send(datagram_client_t *client, const char *message, size_t message_len)
 {
     int r =  sendto(client->sock, message, message_len, 0, (struct sockaddr *)&client->addr, client->addr_len);
     if (r == -1) {
@@ -1158,6 +1224,41 @@ static void datagram_client_send(datagram_client_t *client, const char *message,
     }
 }
 
+datagram_client_t *datagram_client_create(const char *host, const char *port)
+{
+    datagram_client_t *client = calloc(1, sizeof(datagram_client_t));
+    if (!client) {
+        WARN_CALLOC("datagram_client_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+#ifdef _WIN32
+    WSADATA wsa;
+
+    if (WSAStartup(MAKEWORD(2,2),&wsa) != 0) {
+        perror("WSAStartup()");
+        free(client);
+        return NULL;
+    }
+#endif
+
+    client->sock = INVALID_SOCKET;
+    if (datagram_client_open(client, host, port) != 0) {
+        datagram_client_close(client);
+        free(client);
+        return NULL;
+    }
+    return client;
+}
+
+void datagram_client_free(datagram_client_t *client)
+{
+    if (!client)
+        return;
+
+    datagram_client_close(client);
+    free(client);
+}
+
 /* Syslog UDP printer, RFC 5424 (IETF-syslog protocol) */
 
 typedef struct {
@@ -1194,9 +1295,11 @@ static void print_syslog_data(data_output_t *output, data_t *data, char const *f
     msg.tail += data_print_jsons(data, msg.tail, msg.left);
     if (msg.tail >= msg.head + sizeof(message))
         return; // abort on overflow, we don't actually want to send more than fits the MTU
+    data_output_mark_serialized(output);
 
     size_t abuf_len = msg.tail - msg.head;
     datagram_client_send(&syslog->client, message, abuf_len);
+    data_output_mark_queued(output);
 }
 
 static void data_output_syslog_free(data_output_t *output)
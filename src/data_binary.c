@@ -0,0 +1,418 @@
+/** @file
+    Binary (CBOR and MessagePack) encoding of data_t trees.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "data_binary.h"
+#include "data.h"
+#include "fatal.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+/* key table */
+
+// FNV-1a
+static unsigned hash_str(char const *s)
+{
+    unsigned h = 2166136261u;
+    for (; *s; ++s) {
+        h ^= (unsigned char)*s;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+int binary_schema_find(binary_schema_t const *schema, char const *key)
+{
+    if (!schema || !schema->num_slots)
+        return -1;
+    unsigned mask = schema->num_slots - 1;
+    for (unsigned i = hash_str(key) & mask;; i = (i + 1) & mask) {
+        unsigned slot = schema->slots[i];
+        if (!slot)
+            return -1;
+        if (!strcmp(schema->keys[slot - 1], key))
+            return (int)slot - 1;
+    }
+}
+
+binary_schema_t *binary_schema_create(char const *const *fields, int num_fields)
+{
+    binary_schema_t *schema = calloc(1, sizeof(binary_schema_t));
+    if (!schema) {
+        WARN_CALLOC("binary_schema_create()");
+        return NULL;
+    }
+
+    // at most half full
+    schema->num_slots = 16;
+    while (schema->num_slots < 2 * (unsigned)num_fields)
+        schema->num_slots *= 2;
+    schema->slots = calloc(schema->num_slots, sizeof(unsigned));
+    if (!schema->slots) {
+        WARN_CALLOC("binary_schema_create()");
+        free(schema);
+        return NULL;
+    }
+    if (num_fields > 0) {
+        schema->keys = calloc(num_fields, sizeof(char *));
+        if (!schema->keys) {
+            WARN_CALLOC("binary_schema_create()");
+            binary_schema_free(schema);
+            return NULL;
+        }
+    }
+
+    unsigned mask = schema->num_slots - 1;
+    for (int i = 0; i < num_fields; ++i) {
+        char const *key = fields[i];
+        if (!key || binary_schema_find(schema, key) >= 0)
+            continue;
+        char *copy = strdup(key);
+        if (!copy) {
+            WARN_STRDUP("binary_schema_create()");
+            binary_schema_free(schema);
+            return NULL;
+        }
+        unsigned slot = hash_str(key) & mask;
+        while (schema->slots[slot])
+            slot = (slot + 1) & mask;
+        schema->keys[schema->num_keys] = copy;
+        schema->slots[slot]            = ++schema->num_keys;
+    }
+
+    return schema;
+}
+
+void binary_schema_free(binary_schema_t *schema)
+{
+    if (!schema)
+        return;
+
+    for (unsigned i = 0; i < schema->num_keys; ++i)
+        free(schema->keys[i]);
+    free(schema->keys);
+    free(schema->slots);
+    free(schema);
+}
+
+/* encoder */
+
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    size_t size;
+    int overflow;
+    binary_format_t format;
+    binary_schema_t const *schema;
+} binary_writer_t;
+
+static void put_bytes(binary_writer_t *w, void const *src, size_t len)
+{
+    if (w->overflow || w->size - w->len < len) {
+        w->overflow = 1;
+        return;
+    }
+    memcpy(&w->buf[w->len], src, len);
+    w->len += len;
+}
+
+/// Write a type byte followed by a big-endian value of n bytes.
+static void put_be(binary_writer_t *w, uint8_t type, uint64_t val, unsigned n)
+{
+    uint8_t b[9];
+    b[0] = type;
+    for (unsigned i = 0; i < n; ++i)
+        b[n - i] = (uint8_t)(val >> (8 * i));
+    put_bytes(w, b, n + 1);
+}
+
+/// CBOR major type with argument in the shortest form.
+static void cbor_head(binary_writer_t *w, unsigned major, uint64_t val)
+{
+    uint8_t mt = (uint8_t)(major << 5);
+    if (val < 24)
+        put_bytes(w, (uint8_t[]){mt | (uint8_t)val}, 1);
+    else if (val <= 0xff)
+        put_be(w, mt | 24, val, 1);
+    else if (val <= 0xffff)
+        put_be(w, mt | 25, val, 2);
+    else if (val <= 0xffffffff)
+        put_be(w, mt | 26, val, 4);
+    else
+        put_be(w, mt | 27, val, 8);
+}
+
+/// MessagePack header for str (0xa0, 0xd9), array (0x90, 0xdc) or map (0x80, 0xde).
+static void msgpack_head(binary_writer_t *w, uint8_t fix, unsigned fix_max, uint8_t type8, uint32_t len)
+{
+    if (len <= fix_max)
+        put_bytes(w, (uint8_t[]){fix | (uint8_t)len}, 1);
+    else if (type8 == 0xd9 && len <= 0xff)
+        put_be(w, type8, len, 1);
+    else if (len <= 0xffff)
+        put_be(w, type8 == 0xd9 ? 0xda : type8, len, 2);
+    else
+        put_be(w, type8 == 0xd9 ? 0xdb : type8 + 1, len, 4);
+}
+
+static void write_int(binary_writer_t *w, int val)
+{
+    if (w->format == BINARY_CBOR) {
+        if (val >= 0)
+            cbor_head(w, 0, (uint64_t)val);
+        else
+            cbor_head(w, 1, (uint64_t)(-1 - (int64_t)val));
+    }
+    else {
+        if (val >= 0 && val <= 127)
+            put_bytes(w, (uint8_t[]){(uint8_t)val}, 1);
+        else if (val < 0 && val >= -32)
+            put_bytes(w, (uint8_t[]){(uint8_t)val}, 1);
+        else if (val >= 0 && val <= 0xff)
+            put_be(w, 0xcc, (uint64_t)val, 1);
+        else if (val >= 0 && val <= 0xffff)
+            put_be(w, 0xcd, (uint64_t)val, 2);
+        else if (val >= 0)
+            put_be(w, 0xce, (uint64_t)val, 4);
+        else if (val >= -128)
+            put_be(w, 0xd0, (uint8_t)val, 1);
+        else if (val >= -32768)
+            put_be(w, 0xd1, (uint16_t)val, 2);
+        else
+            put_be(w, 0xd2, (uint32_t)val, 4);
+    }
+}
+
+static void write_double(binary_writer_t *w, double val)
+{
+    int cbor  = w->format == BINARY_CBOR;
+    float flt = (float)val;
+    if ((double)flt == val) {
+        uint32_t bits;
+        memcpy(&bits, &flt, sizeof(bits));
+        put_be(w, cbor ? 0xfa : 0xca, bits, 4);
+    }
+    else {
+        uint64_t bits;
+        memcpy(&bits, &val, sizeof(bits));
+        put_be(w, cbor ? 0xfb : 0xcb, bits, 8);
+    }
+}
+
+static void write_string(binary_writer_t *w, char const *str)
+{
+    size_t len = strlen(str);
+    if (w->format == BINARY_CBOR)
+        cbor_head(w, 3, len);
+    else
+        msgpack_head(w, 0xa0, 31, 0xd9, (uint32_t)len);
+    put_bytes(w, str, len);
+}
+
+static void write_nil(binary_writer_t *w)
+{
+    put_bytes(w, (uint8_t[]){w->format == BINARY_CBOR ? 0xf6 : 0xc0}, 1);
+}
+
+static void write_array_head(binary_writer_t *w, unsigned len)
+{
+    if (w->format == BINARY_CBOR)
+        cbor_head(w, 4, len);
+    else
+        msgpack_head(w, 0x90, 15, 0xdc, len);
+}
+
+static void write_map_head(binary_writer_t *w, unsigned len)
+{
+    if (w->format == BINARY_CBOR)
+        cbor_head(w, 5, len);
+    else
+        msgpack_head(w, 0x80, 15, 0xde, len);
+}
+
+static void write_object(binary_writer_t *w, data_t *data);
+
+static void write_value(binary_writer_t *w, data_type_t type, void *value);
+
+static void write_array(binary_writer_t *w, data_array_t *array)
+{
+    write_array_head(w, (unsigned)array->num_values);
+    for (int i = 0; i < array->num_values; ++i) {
+        switch (array->type) {
+        case DATA_INT:
+            write_int(w, ((int *)array->values)[i]);
+            break;
+        case DATA_DOUBLE:
+            write_double(w, ((double *)array->values)[i]);
+            break;
+        default: // boxed types
+            write_value(w, array->type, ((void **)array->values)[i]);
+            break;
+        }
+    }
+}
+
+static void write_value(binary_writer_t *w, data_type_t type, void *value)
+{
+    switch (type) {
+    case DATA_DATA:
+        write_object(w, value);
+        break;
+    case DATA_STRING:
+        write_string(w, value);
+        break;
+    case DATA_ARRAY:
+        write_array(w, value);
+        break;
+    default:
+        // the map and array heads count every entry, keep the count right
+        write_nil(w);
+        break;
+    }
+}
+
+static void write_object(binary_writer_t *w, data_t *data)
+{
+    unsigned len = 0;
+    for (data_t *d = data; d; d = d->next)
+        ++len;
+
+    write_map_head(w, len);
+    for (; data; data = data->next) {
+        int idx = binary_schema_find(w->schema, data->key);
+        if (idx >= 0)
+            write_int(w, idx);
+        else
+            write_string(w, data->key);
+
+        if (data->type == DATA_INT)
+            write_int(w, data->value.v_int);
+        else if (data->type == DATA_DOUBLE)
+            write_double(w, data->value.v_dbl);
+        else
+            write_value(w, data->type, data->value.v_ptr);
+    }
+}
+
+size_t binary_print_schema(binary_schema_t const *schema, binary_format_t format, uint8_t *dst, size_t len)
+{
+    binary_writer_t w = {.buf = dst, .size = len, .format = format};
+
+    write_array_head(&w, schema->num_keys);
+    for (unsigned i = 0; i < schema->num_keys; ++i)
+        write_string(&w, schema->keys[i]);
+
+    return w.overflow ? 0 : w.len;
+}
+
+size_t data_print_binary(data_t *data, binary_format_t format, binary_schema_t const *schema, uint8_t *dst, size_t len)
+{
+    binary_writer_t w = {.buf = dst, .size = len, .format = format, .schema = schema};
+
+    write_object(&w, data);
+
+    return w.overflow ? 0 : w.len;
+}
+
+#ifdef _TEST
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d\n", (int)(a), (int)(b)); \
+        } \
+    } while (0)
+
+#define ASSERT_BYTES(buf, len, exp) \
+    do { \
+        if ((len) == sizeof(exp) - 1 && !memcmp((buf), (exp), (len))) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: encoding of length %d\n", (int)(len)); \
+        } \
+    } while (0)
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+    uint8_t buf[256];
+    size_t len;
+    data_t *data;
+
+    fprintf(stderr, "data_binary:: test\n");
+
+    fprintf(stderr, "data_binary::binary_schema_create()\n");
+    char const *fields[] = {"time", "model", "id", "model", "temperature_C"};
+    binary_schema_t *schema = binary_schema_create(fields, 5);
+    ASSERT_EQUALS(schema->num_keys, 4);
+    ASSERT_EQUALS(binary_schema_find(schema, "time"), 0);
+    ASSERT_EQUALS(binary_schema_find(schema, "id"), 2);
+    ASSERT_EQUALS(binary_schema_find(schema, "temperature_C"), 3);
+    ASSERT_EQUALS(binary_schema_find(schema, "humidity"), -1);
+
+    fprintf(stderr, "data_binary::binary_print_schema()\n");
+    len = binary_print_schema(schema, BINARY_CBOR, buf, sizeof(buf));
+    ASSERT_BYTES(buf, len, "\x84\x64time\x65model\x62id\x6dtemperature_C");
+    len = binary_print_schema(schema, BINARY_MSGPACK, buf, sizeof(buf));
+    ASSERT_BYTES(buf, len, "\x94\xa4time\xa5model\xa2id\xadtemperature_C");
+
+    fprintf(stderr, "data_binary::data_print_binary() CBOR\n");
+    data = data_make(
+            "id", "", DATA_INT, 500,
+            "temperature_C", "", DATA_DOUBLE, 1.5,
+            "battery", "", DATA_INT, -1,
+            "code", "", DATA_ARRAY, data_array(2, DATA_INT, (int[2]){24, -25}),
+            NULL);
+    len = data_print_binary(data, BINARY_CBOR, schema, buf, sizeof(buf));
+    ASSERT_BYTES(buf, len, "\xa4\x02\x19\x01\xf4\x03\xfa\x3f\xc0\x00\x00\x67" "battery\x20\x64" "code\x82\x18\x18\x38\x18");
+    ASSERT_EQUALS(data_print_binary(data, BINARY_CBOR, schema, buf, 10), 0);
+
+    fprintf(stderr, "data_binary::data_print_binary() MessagePack\n");
+    len = data_print_binary(data, BINARY_MSGPACK, schema, buf, sizeof(buf));
+    ASSERT_BYTES(buf, len, "\x84\x02\xcd\x01\xf4\x03\xca\x3f\xc0\x00\x00\xa7" "battery\xff\xa4" "code\x92\x18\xe7");
+    data_free(data);
+
+    fprintf(stderr, "data_binary::data_print_binary() nested\n");
+    data = data_make(
+            "model", "", DATA_STRING, "Test",
+            "temperature_C", "", DATA_DOUBLE, 0.1,
+            "data", "", DATA_DATA, data_make("id", "", DATA_INT, 1, NULL),
+            NULL);
+    len = data_print_binary(data, BINARY_CBOR, NULL, buf, sizeof(buf));
+    ASSERT_BYTES(buf, len, "\xa3\x65model\x64Test\x6dtemperature_C\xfb\x3f\xb9\x99\x99\x99\x99\x99\x9a\x64" "data\xa1\x62id\x01");
+    len = data_print_binary(data, BINARY_MSGPACK, schema, buf, sizeof(buf));
+    ASSERT_BYTES(buf, len, "\x83\x01\xa4Test\x03\xcb\x3f\xb9\x99\x99\x99\x99\x99\x9a\xa4" "data\x81\x02\x01");
+    data_free(data);
+
+    fprintf(stderr, "data_binary::data_print_binary() invalid type\n");
+    data = data_make(
+            "id", "", DATA_INT, 1,
+            "model", "", DATA_STRING, "Test",
+            NULL);
+    data->type = DATA_COUNT;
+    len = data_print_binary(data, BINARY_CBOR, NULL, buf, sizeof(buf));
+    ASSERT_BYTES(buf, len, "\xa2\x62id\xf6\x65model\x64Test");
+    len = data_print_binary(data, BINARY_MSGPACK, NULL, buf, sizeof(buf));
+    ASSERT_BYTES(buf, len, "\x82\xa2id\xc0\xa5model\xa4Test");
+    data->type = DATA_INT;
+    data_free(data);
+
+    binary_schema_free(schema);
+
+    fprintf(stderr, "data_binary:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+
+    return failed;
+}
+#endif /* _TEST */
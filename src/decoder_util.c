@@ -14,6 +14,7 @@
 #include "data.h"
 #include "util.h"
 #include "decoder_util.h"
+#include "preamble_match.h"
 #include "fatal.h"
 
 // create decoder functions
@@ -111,6 +112,20 @@ void decoder_output_bitrowf(r_device *decoder, uint8_t const *bitrow, unsigned b
     decoder_output_bitrow(decoder, bitrow, bit_len, msg);
 }
 
+// search functions
+
+unsigned decoder_bitbuffer_search(r_device *decoder, bitbuffer_t *bitbuffer, unsigned row, unsigned start,
+        uint8_t const *pattern, unsigned pattern_bits_len)
+{
+    if (decoder->preamble_matcher) {
+        int pos = preamble_matcher_find(decoder->preamble_matcher, decoder, bitbuffer, row, pattern, pattern_bits_len);
+        // the first hit, or none at all, answers a search from any start before it
+        if (pos >= 0 && (unsigned)pos >= start)
+            return pos;
+    }
+    return bitbuffer_search(bitbuffer, row, start, pattern, pattern_bits_len);
+}
+
 // output functions
 
 void decoder_output_data(r_device *decoder, data_t *data)
@@ -0,0 +1,435 @@
+/** @file
+    Last-known state table of received devices.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "device_state.h"
+#include "data.h"
+#include "list.h"
+#include "fatal.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define DEVICE_STATE_MIN_BUCKETS 64
+// the averages are exact for the first few messages, then decay with this window
+#define DEVICE_STATE_AVG_WINDOW 16
+
+// FNV-1a
+static unsigned hash_str(char const *s)
+{
+    unsigned h = 2166136261u;
+    for (; *s; ++s) {
+        h ^= (unsigned char)*s;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+device_state_t *device_state_create(unsigned max_len)
+{
+    device_state_t *state = calloc(1, sizeof(device_state_t));
+    if (!state) {
+        WARN_CALLOC("device_state_create()");
+        return NULL;
+    }
+
+    state->buckets = calloc(DEVICE_STATE_MIN_BUCKETS, sizeof(device_entry_t *));
+    if (!state->buckets) {
+        WARN_CALLOC("device_state_create()");
+        free(state);
+        return NULL;
+    }
+    state->num_buckets = DEVICE_STATE_MIN_BUCKETS;
+    state->max_len     = max_len ? max_len : DEVICE_STATE_MAX_DEVICES;
+
+    return state;
+}
+
+static void entry_free(device_entry_t *entry)
+{
+    data_free(entry->data);
+    free(entry->model);
+    free(entry->key);
+    free(entry);
+}
+
+void device_state_free(device_state_t *state)
+{
+    if (!state)
+        return;
+
+    for (unsigned i = 0; i < state->num_buckets; ++i) {
+        device_entry_t *entry = state->buckets[i];
+        while (entry) {
+            device_entry_t *next = entry->next;
+            entry_free(entry);
+            entry = next;
+        }
+    }
+    free(state->buckets);
+    free(state);
+}
+
+static int print_key_value(data_t *d, char *buf, unsigned size)
+{
+    if (d->type == DATA_INT)
+        return snprintf(buf, size, "/%d", d->value.v_int);
+    else if (d->type == DATA_STRING)
+        return snprintf(buf, size, "/%s", (char const *)d->value.v_ptr);
+    return 0;
+}
+
+char *device_state_key(data_t *data, char *buf, unsigned size)
+{
+    data_t *model   = NULL;
+    data_t *channel = NULL;
+    data_t *id      = NULL;
+    for (data_t *d = data; d; d = d->next) {
+        if (!strcmp(d->key, "model"))
+            model = d;
+        else if (!strcmp(d->key, "channel"))
+            channel = d;
+        else if (!strcmp(d->key, "id"))
+            id = d;
+    }
+    if (!model || model->type != DATA_STRING)
+        return NULL;
+
+    int len = snprintf(buf, size, "%s", (char const *)model->value.v_ptr);
+    if (channel && len >= 0 && (unsigned)len < size)
+        len += print_key_value(channel, buf + len, size - len);
+    if (id && len >= 0 && (unsigned)len < size)
+        len += print_key_value(id, buf + len, size - len);
+
+    return buf;
+}
+
+device_entry_t *device_state_find(device_state_t *state, char const *key)
+{
+    unsigned hash = hash_str(key);
+    for (device_entry_t *entry = state->buckets[hash & (state->num_buckets - 1)]; entry; entry = entry->next) {
+        if (entry->hash == hash && !strcmp(entry->key, key))
+            return entry;
+    }
+    return NULL;
+}
+
+static void lru_remove(device_state_t *state, device_entry_t *entry)
+{
+    if (entry->lru_prev)
+        entry->lru_prev->lru_next = entry->lru_next;
+    else
+        state->lru_head = entry->lru_next;
+    if (entry->lru_next)
+        entry->lru_next->lru_prev = entry->lru_prev;
+    else
+        state->lru_tail = entry->lru_prev;
+    entry->lru_prev = NULL;
+    entry->lru_next = NULL;
+}
+
+static void lru_push_head(device_state_t *state, device_entry_t *entry)
+{
+    entry->lru_prev = NULL;
+    entry->lru_next = state->lru_head;
+    if (state->lru_head)
+        state->lru_head->lru_prev = entry;
+    else
+        state->lru_tail = entry;
+    state->lru_head = entry;
+}
+
+static void entry_unlink(device_state_t *state, device_entry_t *entry)
+{
+    device_entry_t **link = &state->buckets[entry->hash & (state->num_buckets - 1)];
+    while (*link && *link != entry)
+        link = &(*link)->next;
+    if (*link) {
+        *link = entry->next;
+        state->len--;
+    }
+    lru_remove(state, entry);
+}
+
+static void evict_oldest(device_state_t *state)
+{
+    device_entry_t *oldest = state->lru_tail;
+    if (oldest) {
+        entry_unlink(state, oldest);
+        entry_free(oldest);
+    }
+}
+
+static void grow_buckets(device_state_t *state)
+{
+    unsigned num_buckets     = state->num_buckets * 2;
+    device_entry_t **buckets = calloc(num_buckets, sizeof(device_entry_t *));
+    if (!buckets) {
+        WARN_CALLOC("grow_buckets()");
+        return; // NOTE: keep the smaller table on alloc failure.
+    }
+
+    for (unsigned i = 0; i < state->num_buckets; ++i) {
+        device_entry_t *entry = state->buckets[i];
+        while (entry) {
+            device_entry_t *next = entry->next;
+            device_entry_t **head = &buckets[entry->hash & (num_buckets - 1)];
+            entry->next = *head;
+            *head       = entry;
+            entry       = next;
+        }
+    }
+    free(state->buckets);
+    state->buckets     = buckets;
+    state->num_buckets = num_buckets;
+}
+
+static device_entry_t *entry_create(device_state_t *state, data_t *data, char const *key, time_t now)
+{
+    device_entry_t *entry = calloc(1, sizeof(device_entry_t));
+    if (!entry) {
+        WARN_CALLOC("entry_create()");
+        return NULL;
+    }
+    entry->key = strdup(key);
+    if (!entry->key) {
+        WARN_STRDUP("entry_create()");
+        free(entry);
+        return NULL;
+    }
+    for (data_t *d = data; d; d = d->next) {
+        if (!strcmp(d->key, "model")) {
+            entry->model = strdup(d->value.v_ptr);
+            if (!entry->model) {
+                WARN_STRDUP("entry_create()");
+                free(entry->key);
+                free(entry);
+                return NULL;
+            }
+            break;
+        }
+    }
+    entry->hash       = hash_str(key);
+    entry->first_seen = now;
+
+    if (state->len >= state->max_len)
+        evict_oldest(state);
+    if (state->len >= state->num_buckets)
+        grow_buckets(state);
+
+    device_entry_t **head = &state->buckets[entry->hash & (state->num_buckets - 1)];
+    entry->next = *head;
+    *head       = entry;
+    state->len++;
+    lru_push_head(state, entry);
+
+    return entry;
+}
+
+device_entry_t *device_state_update(device_state_t *state, data_t *data, time_t now, float rssi, float snr)
+{
+    char key[256];
+    if (!device_state_key(data, key, sizeof(key)))
+        return NULL;
+
+    device_entry_t *entry = device_state_find(state, key);
+    if (!entry)
+        entry = entry_create(state, data, key, now);
+    if (!entry)
+        return NULL;
+    if (entry != state->lru_head) {
+        lru_remove(state, entry);
+        lru_push_head(state, entry);
+    }
+
+    data_free(entry->data);
+    entry->data      = data_retain(data);
+    entry->last_seen = now;
+    entry->count++;
+
+    float alpha = entry->count < DEVICE_STATE_AVG_WINDOW ? 1.0f / entry->count : 1.0f / DEVICE_STATE_AVG_WINDOW;
+    entry->rssi_avg += alpha * (rssi - entry->rssi_avg);
+    entry->snr_avg += alpha * (snr - entry->snr_avg);
+
+    return entry;
+}
+
+data_t *device_state_entry_data(device_entry_t *entry)
+{
+    return data_make(
+            "key",          "", DATA_STRING, entry->key,
+            "model",        "", DATA_STRING, entry->model,
+            "first_seen",   "", DATA_INT, (int)entry->first_seen,
+            "last_seen",    "", DATA_INT, (int)entry->last_seen,
+            "count",        "", DATA_INT, entry->count,
+            "rssi",         "", DATA_FORMAT, "%.1f", DATA_DOUBLE, (double)entry->rssi_avg,
+            "snr",          "", DATA_FORMAT, "%.1f", DATA_DOUBLE, (double)entry->snr_avg,
+            "data",         "", DATA_DATA, data_retain(entry->data),
+            NULL);
+}
+
+data_t *device_state_data(device_state_t *state, char const *model)
+{
+    list_t devs = {0};
+    list_ensure_size(&devs, state->len + 1);
+
+    for (unsigned i = 0; i < state->num_buckets; ++i) {
+        for (device_entry_t *entry = state->buckets[i]; entry; entry = entry->next) {
+            if (model && *model && strcmp(entry->model, model))
+                continue;
+            list_push(&devs, device_state_entry_data(entry));
+        }
+    }
+
+    data_t *data = data_make(
+            "devices", "", DATA_ARRAY, data_array(devs.len, DATA_DATA, devs.elems),
+            NULL);
+    list_free_elems(&devs, NULL);
+    return data;
+}
+
+char *device_state_jsons(device_state_t *state, char const *model, char const *key)
+{
+    data_t *data;
+    if (key && *key) {
+        device_entry_t *entry = device_state_find(state, key);
+        if (!entry)
+            return NULL;
+        data = device_state_entry_data(entry);
+    }
+    else {
+        data = device_state_data(state, model);
+    }
+
+    // a device state is usually around 500 bytes, the buffer grows for larger ones
+    char *buf = data_print_jsons_dup(data, 1024 + state->len * 512);
+    data_free(data);
+    return buf;
+}
+
+#ifdef _TEST
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d\n", (a), (b)); \
+        } \
+    } while (0)
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+    char key[256];
+
+    fprintf(stderr, "device_state:: test\n");
+
+    device_state_t *state = device_state_create(100);
+
+    fprintf(stderr, "device_state::device_state_key()\n");
+    data_t *data = data_make(
+            "model", "", DATA_STRING, "Test-TH",
+            "channel", "", DATA_INT, 2,
+            "id", "", DATA_STRING, "a1",
+            NULL);
+    ASSERT_EQUALS(strcmp(device_state_key(data, key, sizeof(key)), "Test-TH/2/a1"), 0);
+    data_t *nomodel = data_make("id", "", DATA_INT, 1, NULL);
+    ASSERT_EQUALS(device_state_key(nomodel, key, sizeof(key)) == NULL, 1);
+    ASSERT_EQUALS(device_state_update(state, nomodel, 0, 0, 0) == NULL, 1);
+    data_free(nomodel);
+
+    fprintf(stderr, "device_state::device_state_update()\n");
+    device_state_update(state, data, 10, -10.0f, 20.0f);
+    data_free(data); // still retained by the table
+    data = data_make(
+            "model", "", DATA_STRING, "Test-TH",
+            "channel", "", DATA_INT, 2,
+            "id", "", DATA_STRING, "a1",
+            NULL);
+    device_entry_t *entry = device_state_update(state, data, 20, -20.0f, 10.0f);
+    data_free(data);
+    ASSERT_EQUALS(entry->count, 2u);
+    ASSERT_EQUALS((int)entry->first_seen, 10);
+    ASSERT_EQUALS((int)entry->last_seen, 20);
+    ASSERT_EQUALS((int)entry->rssi_avg, -15);
+    ASSERT_EQUALS((int)entry->snr_avg, 15);
+    ASSERT_EQUALS(entry->data == data, 1);
+    ASSERT_EQUALS(state->len, 1u);
+
+    fprintf(stderr, "device_state::device_state_find()\n");
+    ASSERT_EQUALS(device_state_find(state, "Test-TH/2/a1") == entry, 1);
+    ASSERT_EQUALS(device_state_find(state, "Test-TH/2") == NULL, 1);
+
+    fprintf(stderr, "device_state:: grow and evict\n");
+    for (int i = 0; i < 150; ++i) {
+        data = data_make(
+                "model", "", DATA_STRING, i & 1 ? "Odd" : "Even",
+                "id", "", DATA_INT, i,
+                NULL);
+        device_state_update(state, data, 100 + i, 0, 0);
+        data_free(data);
+    }
+    ASSERT_EQUALS(state->len, 100u);
+    ASSERT_EQUALS(state->num_buckets >= 100, 1);
+    ASSERT_EQUALS(device_state_find(state, "Test-TH/2/a1") == NULL, 1);
+    ASSERT_EQUALS(device_state_find(state, "Even/48") == NULL, 1);
+    ASSERT_EQUALS(device_state_find(state, "Even/50") != NULL, 1);
+    ASSERT_EQUALS(device_state_find(state, "Odd/149") != NULL, 1);
+
+    // seen again, the next least recently seen is evicted instead
+    data = data_make("model", "", DATA_STRING, "Even", "id", "", DATA_INT, 50, NULL);
+    device_state_update(state, data, 300, 0, 0);
+    data_free(data);
+    data = data_make("model", "", DATA_STRING, "New", "id", "", DATA_INT, 1, NULL);
+    device_state_update(state, data, 301, 0, 0);
+    data_free(data);
+    ASSERT_EQUALS(state->len, 100u);
+    ASSERT_EQUALS(device_state_find(state, "Even/50") != NULL, 1);
+    ASSERT_EQUALS(device_state_find(state, "Odd/51") == NULL, 1);
+    ASSERT_EQUALS(state->lru_tail == device_state_find(state, "Even/52"), 1);
+
+    fprintf(stderr, "device_state::device_state_data()\n");
+    data = device_state_data(state, "Odd");
+    ASSERT_EQUALS(((data_array_t *)data->value.v_ptr)->num_values, 49);
+    data_free(data);
+
+    fprintf(stderr, "device_state::device_state_jsons()\n");
+    char large[20000];
+    memset(large, 'x', sizeof(large) - 1);
+    large[sizeof(large) - 1] = '\0';
+    data = data_make(
+            "model", "", DATA_STRING, "Large",
+            "id", "", DATA_INT, 1,
+            "payload", "", DATA_STRING, large,
+            NULL);
+    device_state_update(state, data, 400, 0, 0);
+    data_free(data);
+    char *json = device_state_jsons(state, NULL, "Large/1");
+    ASSERT_EQUALS(json != NULL, 1);
+    ASSERT_EQUALS(strlen(json) > sizeof(large), 1);
+    ASSERT_EQUALS(json[strlen(json) - 1], '}');
+    ASSERT_EQUALS(strstr(json, large) != NULL, 1);
+    free(json);
+    json = device_state_jsons(state, NULL, NULL);
+    ASSERT_EQUALS(json != NULL, 1);
+    ASSERT_EQUALS(strstr(json, large) != NULL, 1);
+    ASSERT_EQUALS(strcmp(&json[strlen(json) - 2], "]}"), 0);
+    free(json);
+    ASSERT_EQUALS(device_state_jsons(state, NULL, "None/1") == NULL, 1);
+
+    device_state_free(state);
+
+    fprintf(stderr, "device_state:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+
+    return failed;
+}
+#endif /* _TEST */
@@ -111,7 +111,7 @@ int const acurite_5n1_winddirections[] = {
 //  00 = C
 //  10 = B
 //  11 = A
-static char chLetter[4] = {'C','E','B','A'}; // 'E' stands for error
+static char const chLetter[4] = {'C','E','B','A'}; // 'E' stands for error
 
 static char acurite_getChannel(uint8_t byte)
 {
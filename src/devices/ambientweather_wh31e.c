@@ -187,7 +187,7 @@ static int ambientweather_whx_decode(r_device *decoder, bitbuffer_t *bitbuffer)
 
     for (row = 0; row < bitbuffer->num_rows; ++row) {
         // Validate message and reject it as fast as possible : check for preamble
-        unsigned start_pos = bitbuffer_search(bitbuffer, row, 0, preamble, 24);
+        unsigned start_pos = decoder_bitbuffer_search(decoder, bitbuffer, row, 0, preamble, 24);
         // no preamble detected, move to the next row
         if (start_pos == bitbuffer->bits_per_row[row])
             continue; // DECODE_ABORT_EARLY
@@ -382,6 +382,8 @@ static char *output_fields[] = {
         NULL,
 };
 
+static char const *const preambles[] = {"{24}aa2dd4", NULL};
+
 r_device ambientweather_wh31e = {
         .name        = "Ambient Weather WH31E Thermo-Hygrometer Sensor, EcoWitt WH40 rain gauge",
         .modulation  = FSK_PULSE_PCM,
@@ -392,4 +394,5 @@ r_device ambientweather_wh31e = {
         .decode_fn   = &ambientweather_whx_decode,
         .disabled    = 0,
         .fields      = output_fields,
+        .preambles   = preambles,
 };
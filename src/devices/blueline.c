@@ -448,5 +448,6 @@ r_device blueline = {
         .create_fn   = &blueline_create,
         .disabled    = 0,
         .fields      = output_fields,
+        .stateful    = 1, // learns the sensor id
 };
 
@@ -77,7 +77,7 @@ static int bresser_5in1_decode(r_device *decoder, bitbuffer_t *bitbuffer)
         return DECODE_ABORT_EARLY; // Unrecognized data
     }
 
-    unsigned start_pos = bitbuffer_search(bitbuffer, 0, 0,
+    unsigned start_pos = decoder_bitbuffer_search(decoder, bitbuffer, 0, 0,
             preamble_pattern, sizeof (preamble_pattern) * 8);
 
     if (start_pos == bitbuffer->bits_per_row[0]) {
@@ -180,6 +180,8 @@ static char *output_fields[] = {
         NULL,
 };
 
+static char const *const preambles[] = {"{40}aaaaaa2dd4", NULL};
+
 r_device bresser_5in1 = {
         .name        = "Bresser Weather Center 5-in-1",
         .modulation  = FSK_PULSE_PCM,
@@ -189,4 +191,5 @@ r_device bresser_5in1 = {
         .decode_fn   = &bresser_5in1_decode,
         .disabled    = 0,
         .fields      = output_fields,
+        .preambles   = preambles,
 };
@@ -97,7 +97,7 @@ static int bresser_6in1_decode(r_device *decoder, bitbuffer_t *bitbuffer)
         return DECODE_ABORT_EARLY; // Unrecognized data
     }
 
-    unsigned start_pos = bitbuffer_search(bitbuffer, 0, 0,
+    unsigned start_pos = decoder_bitbuffer_search(decoder, bitbuffer, 0, 0,
             preamble_pattern, sizeof (preamble_pattern) * 8);
 
     if (start_pos >= bitbuffer->bits_per_row[0]) {
@@ -223,6 +223,8 @@ static char *output_fields[] = {
         NULL,
 };
 
+static char const *const preambles[] = {"{32}aaaa2dd4", NULL};
+
 r_device bresser_6in1 = {
         .name        = "Bresser Weather Center 6-in-1, 7-in-1 indoor, new 5-in-1, 3-in-1 wind gauge, Froggit WH6000, Ventus C8488A",
         .modulation  = FSK_PULSE_PCM,
@@ -232,4 +234,5 @@ r_device bresser_6in1 = {
         .decode_fn   = &bresser_6in1_decode,
         .disabled    = 0,
         .fields      = output_fields,
+        .preambles   = preambles,
 };
@@ -57,7 +57,7 @@ static int bresser_7in1_decode(r_device *decoder, bitbuffer_t *bitbuffer)
         return DECODE_ABORT_LENGTH; // unrecognized
     }
 
-    unsigned start_pos = bitbuffer_search(bitbuffer, 0, 0,
+    unsigned start_pos = decoder_bitbuffer_search(decoder, bitbuffer, 0, 0,
             preamble_pattern, sizeof(preamble_pattern) * 8);
     start_pos += sizeof(preamble_pattern) * 8;
 
@@ -155,6 +155,8 @@ static char *output_fields[] = {
         NULL,
 };
 
+static char const *const preambles[] = {"{40}aaaaaa2dd4", NULL};
+
 r_device bresser_7in1 = {
         .name        = "Bresser Weather Center 7-in-1",
         .modulation  = FSK_PULSE_PCM,
@@ -164,4 +166,5 @@ r_device bresser_7in1 = {
         .decode_fn   = &bresser_7in1_decode,
         .disabled    = 0,
         .fields      = output_fields,
+        .preambles   = preambles,
 };
@@ -34,9 +34,9 @@ struct emontx {
 // specifically looking for emonTx packets, we can require a
 // little bit more. We look for a group of 0xD2, and we
 // expect the CDA bits in the header to all be zero:
-static unsigned char preamble[3] = { 0xaa, 0xaa, 0xaa };
-static unsigned char pkt_hdr_inverted[3] = { 0xd2, 0x2d, 0xc0 };
-static unsigned char pkt_hdr[3] = { 0x2d, 0xd2, 0x00 };
+static uint8_t const preamble[3] = { 0xaa, 0xaa, 0xaa };
+static uint8_t const pkt_hdr_inverted[3] = { 0xd2, 0x2d, 0xc0 };
+static uint8_t const pkt_hdr[3] = { 0x2d, 0xd2, 0x00 };
 
 static int emontx_callback(r_device *decoder, bitbuffer_t *bitbuffer)
 {
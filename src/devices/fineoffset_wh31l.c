@@ -89,7 +89,7 @@ static int fineoffset_wh31l_decode(r_device *decoder, bitbuffer_t *bitbuffer)
 
     int row = 0;
     // Search for preamble and sync-word
-    unsigned start_pos = bitbuffer_search(bitbuffer, row, 0, preamble, 24);
+    unsigned start_pos = decoder_bitbuffer_search(decoder, bitbuffer, row, 0, preamble, 24);
     // No preamble detected
     if (start_pos == bitbuffer->bits_per_row[row])
         return DECODE_ABORT_EARLY;
@@ -167,6 +167,8 @@ static char *output_fields[] = {
         NULL,
 };
 
+static char const *const preambles[] = {"{24}aa2dd4", NULL};
+
 r_device fineoffset_wh31l = {
         .name        = "Ambient Weather (Fine Offset) WH31L Lightning-Strike sensor",
         .modulation  = FSK_PULSE_PCM,
@@ -175,4 +177,5 @@ r_device fineoffset_wh31l = {
         .reset_limit = 1000,
         .decode_fn   = &fineoffset_wh31l_decode,
         .fields      = output_fields,
+        .preambles   = preambles,
 };
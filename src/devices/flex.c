@@ -94,8 +94,134 @@ struct flex_params {
     uint8_t preamble_bits[128];
     struct flex_get getter[GETTER_SLOTS];
     unsigned decode_uart;
+    char const *preambles[3]; ///< match and preamble codes for the shared preamble matcher, stored after prog
+    // compiled program
+    unsigned rewrite;     ///< rows are transformed, aligned, or decoded
+    uint8_t xform[256];   ///< invert and reflect for each byte
+    uint16_t prog[];      ///< match then preamble automaton, two next states for each state
 };
 
+/// Compile a bit pattern to a KMP automaton, the state is the number of matched bits.
+static void compile_pattern(uint16_t *dfa, uint8_t const *pattern, unsigned len)
+{
+    unsigned x = 0; // state after the longest proper suffix that is a prefix
+    for (unsigned j = 0; j < len; ++j) {
+        unsigned b = bit(pattern, j);
+        if (j == 0) {
+            dfa[0] = 0;
+            dfa[1] = 0;
+        }
+        else {
+            dfa[2 * j]     = dfa[2 * x];
+            dfa[2 * j + 1] = dfa[2 * x + 1];
+            x = dfa[2 * x + b];
+        }
+        dfa[2 * j + b] = j + 1;
+    }
+}
+
+#define FLEX_ROW_MATCH    1
+#define FLEX_ROW_PREAMBLE 2
+
+/// Run the compiled program on a row in a single pass.
+/// Transforms the bytes, searches match and preamble, aligns at the preamble, and decodes UART in place.
+/// @return FLEX_ROW_MATCH and FLEX_ROW_PREAMBLE flags if found
+static unsigned flex_run_row(struct flex_params const *params, uint8_t *row, uint16_t *bits_per_row)
+{
+    uint16_t const *match_dfa    = params->prog;
+    uint16_t const *preamble_dfa = params->prog + 2 * params->match_len;
+    unsigned match_len    = params->match_len;
+    unsigned preamble_len = params->preamble_len;
+    unsigned rewrite      = params->rewrite;
+    unsigned uart         = params->decode_uart;
+
+    unsigned len   = *bits_per_row;
+    unsigned mpos  = 0;
+    unsigned ppos  = 0;
+    unsigned out   = 0; // output bits, or bytes for UART
+    unsigned acc   = 0; // output bits not yet stored
+    unsigned frame = 0; // UART frame bits
+    unsigned frame_bits = 0;
+    unsigned uart_done  = 0;
+    unsigned last       = 0; // the last transformed byte
+
+    for (unsigned j = 0; j * 8 < len; ++j) {
+        if (!rewrite && mpos == match_len)
+            break; // nothing left to do
+        unsigned n = len - j * 8 < 8 ? len - j * 8 : 8;
+        unsigned x = params->xform[row[j]];
+        if (n < 8 && params->invert) {
+            // as bitbuffer_invert(), the unused bits of the last byte are not inverted
+            uint8_t v = row[j] ^ (0xff00 >> n);
+            x = params->reflect ? reverse8(v) : v;
+        }
+        last = x;
+
+        // searches done, store the whole byte
+        if (n == 8 && rewrite && !uart && mpos == match_len && ppos == preamble_len) {
+            unsigned r    = out & 7;
+            row[out / 8]  = (uint8_t)(acc << (8 - r) | x >> r);
+            acc           = x & ((1 << r) - 1);
+            out += 8;
+            continue;
+        }
+
+        for (unsigned i = 0; i < n; ++i) {
+            unsigned b = x >> (7 - i) & 1;
+            if (mpos < match_len)
+                mpos = match_dfa[2 * mpos + b];
+            if (ppos < preamble_len) {
+                ppos = preamble_dfa[2 * ppos + b];
+                if (ppos == preamble_len) {
+                    // restart the output after the preamble
+                    out = acc = frame = frame_bits = uart_done = 0;
+                    continue;
+                }
+            }
+            if (!rewrite)
+                continue;
+            if (uart) {
+                if (uart_done)
+                    continue;
+                frame = frame << 1 | b;
+                if (++frame_bits == 10) {
+                    // start bit, 8 data bits LSB first, stop bit
+                    if ((frame & 0x200) || !(frame & 1))
+                        uart_done = 1;
+                    else
+                        row[out++] = reverse8((frame >> 1) & 0xff);
+                    frame      = 0;
+                    frame_bits = 0;
+                }
+            }
+            else {
+                acc = acc << 1 | b;
+                if ((++out & 7) == 0) {
+                    row[out / 8 - 1] = (uint8_t)acc;
+                    acc              = 0;
+                }
+            }
+        }
+    }
+
+    unsigned found = (match_len && mpos == match_len ? FLEX_ROW_MATCH : 0)
+            | (preamble_len && ppos == preamble_len ? FLEX_ROW_PREAMBLE : 0);
+
+    if (uart) {
+        *bits_per_row = out * 8;
+    }
+    else if (rewrite) {
+        if (out & 7) {
+            if (found & FLEX_ROW_PREAMBLE)
+                row[out / 8] = (uint8_t)(acc << (8 - (out & 7))); // aligned, zero the bottom bits
+            else
+                row[out / 8] = (uint8_t)last; // keep the unused bits as transformed
+        }
+        *bits_per_row = out;
+    }
+    return found;
+}
+
 static void print_row_bytes(char *row_bytes, uint8_t *bits, int num_bits)
 {
     row_bytes[0] = '\0';
@@ -171,63 +297,40 @@ static int flex_callback(r_device *decoder, bitbuffer_t *bitbuffer)
         return DECODE_ABORT_EARLY;
     // TODO: set match_count to count of repeated rows
 
-    if (params->invert) {
-        bitbuffer_invert(bitbuffer);
-    }
-
-    if (params->reflect) {
-        // TODO: refactor to utils
-        for (i = 0; i < bitbuffer->num_rows; ++i) {
-            reflect_bytes(bitbuffer->bb[i], (bitbuffer->bits_per_row[i] + 7) / 8);
-        }
-    }
-
-    // discard unless match
-    if (params->match_len) {
-        r = -1;
-        match_count = 0;
+    // invert, reflect, match, preamble, and decode_uart in one pass over each row
+    if (params->rewrite || params->match_len) {
+        int match_row     = -1;
+        int preamble_row  = -1;
+        int match_rows    = 0;
+        int preamble_rows = 0;
         for (i = 0; i < bitbuffer->num_rows; i++) {
-            if (bitbuffer_search(bitbuffer, i, 0, params->match_bits, params->match_len) < bitbuffer->bits_per_row[i]) {
-                if (r < 0)
-                    r = i;
-                match_count++;
+            unsigned found = flex_run_row(params, bitbuffer->bb[i], &bitbuffer->bits_per_row[i]);
+            if (found & FLEX_ROW_MATCH) {
+                if (match_row < 0)
+                    match_row = i;
+                match_rows++;
+            }
+            if (found & FLEX_ROW_PREAMBLE) {
+                if (preamble_row < 0)
+                    preamble_row = i;
+                preamble_rows++;
             }
         }
-        if (!match_count)
-            return DECODE_FAIL_SANITY;
-    }
 
-    // discard unless match, this should be an AND condition
-    if (params->preamble_len) {
-        r = -1;
-        match_count = 0;
-        for (i = 0; i < bitbuffer->num_rows; i++) {
-            unsigned pos = bitbuffer_search(bitbuffer, i, 0, params->preamble_bits, params->preamble_len);
-            if (pos < bitbuffer->bits_per_row[i]) {
-                if (r < 0)
-                    r = i;
-                match_count++;
-                pos += params->preamble_len;
-                // TODO: refactor to bitbuffer_shift_row()
-                unsigned len = bitbuffer->bits_per_row[i] - pos;
-                bitbuffer_t tmp = {0};
-                bitbuffer_extract_bytes(bitbuffer, i, pos, tmp.bb[0], len);
-                memcpy(bitbuffer->bb[i], tmp.bb[0], (len + 7) / 8);
-                bitbuffer->bits_per_row[i] = len;
-            }
+        // discard unless match
+        if (params->match_len) {
+            if (!match_rows)
+                return DECODE_FAIL_SANITY;
+            r           = match_row;
+            match_count = match_rows;
         }
-        if (!match_count)
-            return DECODE_FAIL_SANITY;
-    }
 
-    if (params->decode_uart) {
-        for (i = 0; i < bitbuffer->num_rows; i++) {
-            // TODO: refactor to bitbuffer_decode_uart_row()
-            unsigned len = bitbuffer->bits_per_row[i];
-            bitbuffer_t tmp = {0};
-            len = extract_bytes_uart(bitbuffer->bb[i], 0, len, tmp.bb[0]);
-            memcpy(bitbuffer->bb[i], tmp.bb[0], len);
-            bitbuffer->bits_per_row[i] = len * 8;
+        // discard unless match, this should be an AND condition
+        if (params->preamble_len) {
+            if (!preamble_rows)
+                return DECODE_FAIL_SANITY;
+            r           = preamble_row;
+            match_count = preamble_rows;
         }
     }
 
@@ -530,6 +633,8 @@ r_device *flex_create_device(char *spec)
     }
     dev->decode_ctx = params;
     int get_count = 0;
+    char const *match_code    = NULL;
+    char const *preamble_code = NULL;
 
     spec = strdup(spec);
     if (!spec)
@@ -597,11 +702,15 @@ r_device *flex_create_device(char *spec)
         else if (!strcasecmp(key, "reflect"))
             params->reflect = val ? atoi(val) : 1;
 
-        else if (!strcasecmp(key, "match"))
+        else if (!strcasecmp(key, "match")) {
             params->match_len = parse_bits(val, params->match_bits);
+            match_code        = val;
+        }
 
-        else if (!strcasecmp(key, "preamble"))
+        else if (!strcasecmp(key, "preamble")) {
             params->preamble_len = parse_bits(val, params->preamble_bits);
+            preamble_code        = val;
+        }
 
         else if (!strcasecmp(key, "countonly"))
             params->count_only = val ? atoi(val) : 1;
@@ -632,6 +741,44 @@ r_device *flex_create_device(char *spec)
     if (params->min_bits > 0 && params->min_repeats < 1)
         params->min_repeats = 1;
 
+    // the shared matcher sees the bits before invert and reflect
+    int use_preambles = !params->invert && !params->reflect && (match_code || preamble_code);
+    size_t codes_size = 0;
+    if (use_preambles) {
+        codes_size += match_code ? strlen(match_code) + 1 : 0;
+        codes_size += preamble_code ? strlen(preamble_code) + 1 : 0;
+    }
+
+    // compile the automatons, and copy the codes, to the end of the params
+    unsigned prog_len = params->match_len + params->preamble_len;
+    if (prog_len || codes_size) {
+        params = realloc(params, sizeof(*params) + prog_len * 2 * sizeof(uint16_t) + codes_size);
+        if (!params)
+            FATAL_REALLOC("flex_create_device()");
+        dev->decode_ctx = params;
+        compile_pattern(params->prog, params->match_bits, params->match_len);
+        compile_pattern(params->prog + 2 * params->match_len, params->preamble_bits, params->preamble_len);
+    }
+    for (int b = 0; b < 256; ++b) {
+        uint8_t x = params->invert ? ~b : b;
+        params->xform[b] = params->reflect ? reverse8(x) : x;
+    }
+    params->rewrite = params->invert || params->reflect || params->preamble_len || params->decode_uart;
+
+    if (use_preambles) {
+        // freed with the params
+        char *codes = (char *)(params->prog + prog_len * 2);
+        int n       = 0;
+        if (match_code) {
+            params->preambles[n++] = strcpy(codes, match_code);
+            codes += strlen(match_code) + 1;
+        }
+        if (preamble_code) {
+            params->preambles[n++] = strcpy(codes, preamble_code);
+        }
+        dev->preambles = params->preambles;
+    }
+
     // sanity checks
 
     if (!params->name || !*params->name) {
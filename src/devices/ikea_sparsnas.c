@@ -308,4 +308,5 @@ r_device ikea_sparsnas = {
     .decode_fn     = &ikea_sparsnas_decode,
     .disabled      = 0,
     .fields        = output_fields,
+    .stateful      = 1, // learns the sensor id
 };
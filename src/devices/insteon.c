@@ -351,7 +351,7 @@ static int parse_insteon_pkt(r_device *decoder, bitbuffer_t *bits, unsigned int
 
     // Format data
     /*
-    static int data_payload[35];
+    int data_payload[35];
     for (int j = 0; j < min_pkt_len; j++) {
         data_payload[j] = (int)results[j];
     }
@@ -104,7 +104,7 @@ static int lacrosse_it(r_device *decoder, bitbuffer_t *bitbuffer, int device29or
 
     for (brow = 0; brow < bitbuffer->num_rows; ++brow) {
         // Validate message and reject it as fast as possible : check for preamble
-        unsigned int start_pos = bitbuffer_search(bitbuffer, brow, 0, preamble, 26);
+        unsigned int start_pos = decoder_bitbuffer_search(decoder, bitbuffer, brow, 0, preamble, 26);
         // no preamble detected, move to the next row
         if (start_pos == bitbuffer->bits_per_row[brow])
             continue; // DECODE_ABORT_EARLY
@@ -191,6 +191,8 @@ static char *output_fields[] = {
     NULL,
 };
 
+static char const *const preambles[] = {"{26}a8b7524", NULL};
+
 // Receiver for the TX29 and TX25U device
 r_device lacrosse_tx29 = {
     .name           = "LaCrosse TX29IT, TFA Dostmann 30.3159.IT Temperature sensor",
@@ -201,6 +203,7 @@ r_device lacrosse_tx29 = {
     .decode_fn      = &lacrossetx29_callback,
     .disabled       = 0,
     .fields         = output_fields,
+    .preambles      = preambles,
 };
 
 // Receiver for the TX35 device
@@ -213,4 +216,5 @@ r_device lacrosse_tx35 = {
     .decode_fn      = &lacrossetx35_callback,
     .disabled       = 0,
     .fields         = output_fields,
+    .preambles      = preambles,
 };
@@ -176,28 +176,28 @@ typedef struct {
     uint8_t     data[512];
 } m_bus_data_t;
 
-static float humidity_factor[2] = { 0.1, 1 };
+static float const humidity_factor[2] = { 0.1, 1 };
 
 
-static char* oms_hum[4][4] = {
+static char const *const oms_hum[4][4] = {
 {"humidity","average_humidity_1h","average_humidity_24h","error_04", },
 {"maximum_humidity_1h","maximum_humidity_24h","error_13","error_14",},
 {"minimum_humidity_1h","minimum_humidity_24h","error_23","error_24",},
 {"error_31","error_32","error_33","error_34",}
 };
 
-static char* oms_hum_el[4][4] = {
+static char const *const oms_hum_el[4][4] = {
 {"Humidity","Average Humidity 1h","Average Humidity 24h","Error [0][4]", },
 {"Maximum Humidity 1h","Maximum Humidity 24h","Error [1][3]","Error [1][4]",},
 {"Minimum Humidity 1h","Minimum Humidity 24h","Error [2][3]","Error [2][4]",},
 {"Error 31","Error 32","Error 33","Error 34",}
 };
 
-static char *history_hours[4] = {
+static char const *const history_hours[4] = {
         "1h", "24h", "err[2]", "err[3]",
 };
 
-static char *history_months[12][2] = {
+static char const *const history_months[12][2] = {
         {"m1", "of month -1"},
         {"m2", "of month -2"},
         {"m3", "of month -3"},
@@ -212,7 +212,7 @@ static char *history_months[12][2] = {
         {"m12", "of month -12"},
 };
 
-static char *value_types_tab[4][2] = {
+static char const *const value_types_tab[4][2] = {
         {"inst", ""},
         {"max", "Max"},
         {"min", "Min"},
@@ -248,7 +248,7 @@ enum UnitType {
     kOperTimeDays,
 };
 
-static char *unit_names[][3] = {
+static char const *const unit_names[][3] = {
         /* 0 */ {"energy_wh", "Energy", "Wh"},
         /* 1 */ {"energy_j", "Energy", "J"},
         /* 2 */ {"volume", "Volume", "m3"},
@@ -279,7 +279,7 @@ static char *unit_names[][3] = {
 
 // exponent                    -3     -2    -1    0  1   2    3     4
 // index                        0      1     2    3  4   5    6     7
-static double pow10_table[8] = { 0.001, 0.01, 0.1, 1, 10, 100, 1000, 10000 };
+static double const pow10_table[8] = { 0.001, 0.01, 0.1, 1, 10, 100, 1000, 10000 };
 
 
 static data_t *append_str(data_t *data, enum UnitType unit_type, uint8_t value_type, uint8_t sn, const char* extra, const char* value)
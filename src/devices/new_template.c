@@ -153,6 +153,10 @@ static int new_template_decode(r_device *decoder, bitbuffer_t *bitbuffer)
     /*
      * Or (preferred) search for the message preamble:
      * See bitbuffer_search()
+     *
+     * Declare the preamble in r_device as e.g. .preambles = {"{24}aa2dd4", NULL}
+     * to skip the decoder when no row has it, then decoder_bitbuffer_search()
+     * reuses the hits of the shared preamble matcher.
      */
 
     /*
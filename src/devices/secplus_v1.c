@@ -421,4 +421,5 @@ r_device secplus_v1 = {
         .decode_fn   = &secplus_v1_callback,
         .disabled    = 0,
         .fields      = output_fields,
+        .stateful    = 1, // pairs the two halves of a message
 };
@@ -132,6 +132,8 @@ static char *output_fields[] = {
     NULL,
 };
 
+static char const *const preambles[] = {"{16}5556", NULL}; // before the invert, aa a9 inverted
+
 r_device tpms_citroen = {
     .name           = "Citroen TPMS",
     .modulation     = FSK_PULSE_PCM,
@@ -141,4 +143,5 @@ r_device tpms_citroen = {
     .decode_fn      = &tpms_citroen_callback,
     .disabled       = 0,
     .fields         = output_fields,
+    .preambles      = preambles,
 };
@@ -42,7 +42,9 @@ void check_read_file_info(file_info_t *info)
             && info->format != CS16_IQ
             && info->format != CF32_IQ
             && info->format != S16_AM
-            && info->format != PULSE_OOK) {
+            && info->format != PULSE_OOK
+            && info->format != PULSE_LOG
+            && info->format != SPAN_INDEX) {
         fprintf(stderr, "File type not supported as input (%s).\n", info->spec);
         exit(1);
     }
@@ -82,6 +84,8 @@ char const *file_info_string(file_info_t *info)
     case VCD_LOGIC: return "VCD logic (text)"; break;
     case U8_LOGIC:  return "U8 logic (1ch uint8)"; break;
     case PULSE_OOK: return "OOK pulse data (text)"; break;
+    case PULSE_LOG: return "Pulse log (binary)"; break;
+    case SPAN_INDEX: return "Span index (text)"; break;
     default:        return "Unknown";  break;
     }
 }
@@ -112,6 +116,8 @@ static uint32_t file_type_guess_auto_format(uint32_t type)
     else if (type == F_U8) return U8_LOGIC;
     else if (type == F_VCD) return VCD_LOGIC;
     else if (type == F_OOK) return PULSE_OOK;
+    else if (type == F_PLOG) return PULSE_LOG;
+    else if (type == F_SPANS) return SPAN_INDEX;
     else if (type == F_CS16) return CS16_IQ;
     else if (type == F_CF32) return CF32_IQ;
     else return type;
@@ -190,6 +196,9 @@ static void file_type(char const *filename, file_info_t *info)
             else if (len == 3 && !strncasecmp("f32", t, 3)) file_type_set_format(&info->format, F_F32);
             else if (len == 3 && !strncasecmp("vcd", t, 3)) file_type_set_content(&info->format, F_VCD);
             else if (len == 3 && !strncasecmp("ook", t, 3)) file_type_set_content(&info->format, F_OOK);
+            else if (len == 4 && !strncasecmp("plog", t, 4)) file_type_set_content(&info->format, F_PLOG);
+            else if (len == 5 && !strncasecmp("spans", t, 5)) file_type_set_content(&info->format, F_SPANS);
+            else if (len == 3 && !strncasecmp("riq", t, 3)) info->codec = CODEC_RIQ;
             else if (len == 4 && !strncasecmp("cs16", t, 4)) file_type_set_format(&info->format, F_CS16);
             else if (len == 4 && !strncasecmp("cs32", t, 4)) file_type_set_format(&info->format, F_CS32);
             else if (len == 4 && !strncasecmp("cf32", t, 4)) file_type_set_format(&info->format, F_CF32);
@@ -228,7 +237,9 @@ Parse "[A-Za-z][0-9A-Za-z]+" as format or content specifier:
 
 2ch formats: "cu8", "cs8", "cs16", "cs32", "cf32"
 1ch formats: "u8", "s8", "s16", "u16", "s32", "u32", "f32"
-text formats: "vcd", "ook"
+text formats: "vcd", "ook", "spans"
+binary formats: "plog"
+codecs: "riq"
 content types: "iq", "i", "q", "am", "fm", "logic"
 
 Parses left to right, with the exception of a prefix up to the last colon ":"
@@ -248,6 +259,7 @@ int parse_file_info(char const *filename, file_info_t *info)
     }
 
     info->spec = filename;
+    info->codec = CODEC_NONE;
 
     char const *p = last_plain_colon(filename);
     if (p && p - filename < 64) {
@@ -281,6 +293,17 @@ void assert_file_type(int check, char const *spec)
     }
 }
 
+void assert_file_codec(uint32_t check, char const *spec)
+{
+    file_info_t info = {0};
+    parse_file_info(spec, &info);
+    if (check != info.codec) {
+        fprintf(stderr, "\nTEST failed: parse_file_info(\"%s\", &foo) codec = %u == %u\n", spec, info.codec, check);
+    } else {
+        fprintf(stderr, ".");
+    }
+}
+
 void assert_str_equal(char const *a, char const *b)
 {
     if (a != b && (!a || !b || strcmp(a, b))) {
@@ -321,6 +344,7 @@ int main(void)
     assert_file_type(S16_FM, "s16_fm:");
     assert_file_type(S16_FM, "fm+s16:");
     assert_file_type(S16_FM, "s16,fm:");
+    assert_file_type(PULSE_LOG, "plog:");
 
     assert_file_type(CU8_IQ, ".cu8");
     assert_file_type(CS16_IQ, ".cs16");
@@ -342,6 +366,16 @@ int main(void)
     assert_file_type(S16_FM, ".s16-fm");
     assert_file_type(S16_FM, ".s16_fm");
     assert_file_type(S16_FM, ".s16,fm");
+    assert_file_type(PULSE_LOG, ".plog");
+    assert_file_type(SPAN_INDEX, ".spans");
+    assert_file_type(SPAN_INDEX, ".spans,pad=100");
+    assert_file_type(CU8_IQ, ".riq");
+    assert_file_type(CU8_IQ, ".cu8.riq");
+    assert_file_type(CS16_IQ, ".cs16.riq");
+    assert_file_type(CS16_IQ, "riq:cs16:");
+    assert_file_codec(CODEC_RIQ, ".cu8.riq");
+    assert_file_codec(CODEC_RIQ, "riq:file.cu8");
+    assert_file_codec(CODEC_NONE, ".cu8");
 
     fprintf(stderr, "\nDone!\n");
 }
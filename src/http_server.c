@@ -19,6 +19,9 @@ A choice of endpoints are available:
 - "/cmd": simple JSON command API
 - "/events": HTTP (chunked) streaming API, streams JSON events
 - "/stream": HTTP (plain) streaming API, streams JSON events
+- "/devices": last-known state of all devices, filter with "?model=..." or get one with "?key=..."
+- "/metrics": counters since start and gauges in the Prometheus text format
+- "/clients": streaming clients with their queued bytes and sent and dropped messages
 - "/api": RESTful API (not implemented)
 - "ws:": Websocket API (similar to cmd/events API)
 
@@ -42,10 +45,16 @@ Examples:
     {"result": "Ok"}
     {"error": "Invalid Request"}}
 
+With the network I/O thread setters are queued to the SDR thread and applied with the next
+sample buffer, the "Ok" result only means the command was accepted.
+
 ## HTTP events / streaming / Websocket API
 
 You will receive JSON events, one per line terminated with CRLF.
 On Events and Stream endpoints a keep-alive of CRLF will be send every 60 seconds.
+Events are queued for each client, a client that does not keep up gets the oldest
+events dropped once the queue is full (default 1 MB, "-F http:...,queue=<bytes>"),
+or is disconnected with "-F http:...,slow=close".
 Use e.g. httpie with `http --stream --timeout=70 :8433/events`
 or `(echo "GET /stream HTTP/1.0\n"; sleep 600) | socat - tcp:127.0.0.1:8433`
 
@@ -69,6 +78,33 @@ or `(echo "GET /stream HTTP/1.0\n"; sleep 600) | socat - tcp:127.0.0.1:8433`
     Found Rafael Micro R820T tuner
     Using device 0: Generic RTL2832U OEM
 
+- "devices"
+    last-known state of each device, keyed on "model[/channel][/id]"
+    .key
+    .model
+    .first_seen
+    .last_seen
+    .count
+    .rssi (average)
+    .snr (average)
+    .data (latest event)
+
+- "latency"
+    latency histograms in microseconds, also part of "stats"
+    .buffer (end of package on air to sample buffer)
+    .detect (sample buffer to package detected)
+    .decode (package detected to decoder output)
+    .queue (decoder output to the output thread)
+    .total (end of package on air to all outputs done)
+    .outputs (end of package on air to each output done, in order of the -F options)
+
+- "cpu"
+    decoders ranked by CPU time since start, with "-M cpu", the top ones are also part of "stats"
+    .total_ms
+    .decoders (device, name, slicer, calls, events, cpu_ms, decode_ms, ns_per_call, share)
+    .slicers (slicer, calls, cpu_ms outside of decoders)
+    the "val" limits the number of decoders, 0 for all
+
 - "settings"
     "device":           0
     "gain":             0
@@ -95,6 +131,9 @@ or `(echo "GET /stream HTTP/1.0\n"; sleep 600) | socat - tcp:127.0.0.1:8433`
 
 #include "http_server.h"
 #include "data.h"
+#include "device_state.h"
+#include "metrics.h"
+#include "net_thread.h"
 #include "rtl_433.h"
 #include "r_api.h"
 #include "r_device.h" // used for protocols
@@ -320,6 +359,15 @@ static data_t *protocols_data(r_cfg_t *cfg)
     return data;
 }
 
+// returns an allocated JSON string of the device states, or a single device if key is given
+static char *devices_jsons(r_cfg_t *cfg, char const *model, char const *key)
+{
+    if (!cfg->device_state)
+        return NULL;
+
+    return device_state_jsons(cfg->device_state, model, key);
+}
+
 // very narrowly tailored JSON parsing
 
 typedef struct rpc rpc_t;
@@ -512,11 +560,137 @@ static int jsonrpc_parse(rpc_t *rpc, struct mg_str const *json)
     return 0;
 }
 
+// methods that change the SDR or decoder state, these run on the SDR thread
+static char const *const rpc_setters[] = {
+        "hop_interval",
+        "report_meta",
+        "convert",
+        "raw_mode",
+        "verbosity",
+        "verbose_bits",
+        "protocol",
+        "device",
+        "gain",
+        "center_frequency",
+        "ppm_error",
+        "sample_rate",
+        NULL,
+};
+
+static int rpc_is_setter(char const *method)
+{
+    for (char const *const *p = rpc_setters; *p; ++p) {
+        if (!strcmp(method, *p))
+            return 1;
+    }
+    return 0;
+}
+
+void rpc_exec(rpc_t *rpc, r_cfg_t *cfg);
+
+// the reply was already sent when the command was posted, only report errors
+static void rpc_response_deferred(rpc_t *rpc, int ret_code, char const *message, int arg)
+{
+    UNUSED(arg);
+    if (ret_code < 0)
+        fprintf(stderr, "RPC %s failed: %s\n", rpc->method, message);
+}
+
+static void rpc_exec_deferred(r_cfg_t *cfg, void *ctx)
+{
+    rpc_t *rpc = ctx;
+    rpc_exec(rpc, cfg);
+    free(rpc); // strings are allocated with the struct
+}
+
+/// Post a setter to the SDR thread, returns 0 if the rpc should run here instead.
+static int rpc_post(rpc_t *rpc, r_cfg_t *cfg)
+{
+    if (!cfg->net_thread || rpc->response == rpc_response_deferred)
+        return 0;
+
+    size_t method_len = strlen(rpc->method) + 1;
+    size_t arg_len    = rpc->arg ? strlen(rpc->arg) + 1 : 0;
+    rpc_t *cmd        = calloc(1, sizeof(rpc_t) + method_len + arg_len);
+    if (!cmd) {
+        WARN_CALLOC("rpc_post()");
+        rpc->response(rpc, -1, "Out of memory", 0);
+        return 1;
+    }
+    cmd->response = rpc_response_deferred;
+    cmd->val      = rpc->val;
+    cmd->method   = memcpy((char *)(cmd + 1), rpc->method, method_len);
+    if (rpc->arg)
+        cmd->arg = memcpy((char *)(cmd + 1) + method_len, rpc->arg, arg_len);
+
+    if (!net_thread_post_command(cfg->net_thread, rpc_exec_deferred, cmd)) {
+        free(cmd);
+        rpc->response(rpc, -1, "Try again later", 0);
+        return 1;
+    }
+    rpc->response(rpc, 0, "Ok", 0);
+    return 1;
+}
+
+// getters answered on the network thread, the latency stats and device states are kept there
+static char const *const rpc_net_getters[] = {
+        "get_latency",
+        "get_devices",
+        "get_device",
+        NULL,
+};
+
+static int rpc_is_net_getter(char const *method)
+{
+    for (char const *const *p = rpc_net_getters; *p; ++p) {
+        if (!strcmp(method, *p))
+            return 1;
+    }
+    return 0;
+}
+
+/// A getter run on the SDR thread, the reply is handed back to the network thread.
+typedef struct rpc_call {
+    rpc_t rpc; ///< first member, the capture response casts back
+    struct http_server_context *server;
+    unsigned serial;
+    int ret_code;
+    int arg;
+    char *message;
+    data_t *data; ///< stats report, the output stats are appended on the network thread
+} rpc_call_t;
+
+// keep the reply of a getter for the network thread
+static void rpc_response_capture(rpc_t *rpc, int ret_code, char const *message, int arg)
+{
+    rpc_call_t *call = (rpc_call_t *)rpc;
+    call->ret_code   = ret_code;
+    call->arg        = arg;
+    if (message) {
+        call->message = strdup(message);
+        if (!call->message) {
+            WARN_STRDUP("rpc_response_capture()");
+            call->ret_code = -1; // replied as out of memory
+        }
+    }
+}
+
+/// Post a getter to the SDR thread, returns 0 if the rpc should run here instead.
+static int rpc_post_getter(rpc_t *rpc, r_cfg_t *cfg);
+
 void rpc_exec(rpc_t *rpc, r_cfg_t *cfg)
 {
     if (!rpc || !rpc->method || !*rpc->method) {
         rpc->response(rpc, -1, "Method invalid", 0);
     }
+    // Setters are posted to the SDR thread if the network runs on its own thread
+    else if (rpc_is_setter(rpc->method) && rpc_post(rpc, cfg)) {
+        // reply sent, the command runs with the next SDR buffer
+    }
+    // Getters of the SDR and decoder state also run on the SDR thread
+    else if (!rpc_is_net_getter(rpc->method) && rpc_post_getter(rpc, cfg)) {
+        // the reply follows once the SDR thread ran the getter
+    }
     // Getter
     else if (!strcmp(rpc->method, "get_dev_query")) {
         rpc->response(rpc, 0, cfg->dev_query, 0);
@@ -556,12 +730,42 @@ void rpc_exec(rpc_t *rpc, r_cfg_t *cfg)
         rpc->response(rpc, 2, NULL, cfg->conversion_mode);
     }
     else if (!strcmp(rpc->method, "get_stats")) {
-        char buf[20480]; // we expect the stats string to be around 15k bytes.
         data_t *data = create_report_data(cfg, 2/*report active devices*/);
         // flush_report_data(cfg); // snapshot, do not flush
-        data_print_jsons(data, buf, sizeof(buf));
-        rpc->response(rpc, 1, buf, 0);
-        data_free(data);
+        if (rpc->response == rpc_response_capture) {
+            ((rpc_call_t *)rpc)->data = data; // the network thread appends the output stats
+        }
+        else {
+            char buf[20480]; // we expect the stats string to be around 15k bytes.
+            data = append_output_stats(cfg, data);
+            data_print_jsons(data, buf, sizeof(buf));
+            rpc->response(rpc, 1, buf, 0);
+            data_free(data);
+        }
+    }
+    else if (!strcmp(rpc->method, "get_latency")) {
+        char buf[8192]; // we expect the latency string to be around 1k bytes.
+        data_t *data = latency_report_data(cfg);
+        if (!data) {
+            rpc->response(rpc, -1, "No latency stats", 0);
+        }
+        else {
+            data_print_jsons(data, buf, sizeof(buf));
+            rpc->response(rpc, 1, buf, 0);
+            data_free(data);
+        }
+    }
+    else if (!strcmp(rpc->method, "get_cpu")) {
+        char buf[65536]; // we expect the cpu string to be around 200 bytes per decoder.
+        data_t *data = cpu_report_data(cfg, (int)rpc->val);
+        if (!data) {
+            rpc->response(rpc, -1, "No cpu stats, use -M cpu", 0);
+        }
+        else {
+            data_print_jsons(data, buf, sizeof(buf));
+            rpc->response(rpc, 1, buf, 0);
+            data_free(data);
+        }
     }
     else if (!strcmp(rpc->method, "get_meta")) {
         char buf[2048]; // we expect the meta string to be around 500 bytes.
@@ -570,6 +774,22 @@ void rpc_exec(rpc_t *rpc, r_cfg_t *cfg)
         rpc->response(rpc, 1, buf, 0);
         data_free(data);
     }
+    else if (!strcmp(rpc->method, "get_devices")) {
+        char *buf = devices_jsons(cfg, rpc->arg, NULL);
+        if (!buf)
+            rpc->response(rpc, -1, "No device states", 0);
+        else
+            rpc->response(rpc, 1, buf, 0);
+        free(buf);
+    }
+    else if (!strcmp(rpc->method, "get_device")) {
+        char *buf = rpc->arg && *rpc->arg ? devices_jsons(cfg, NULL, rpc->arg) : NULL;
+        if (!buf)
+            rpc->response(rpc, -1, "Unknown device", 0);
+        else
+            rpc->response(rpc, 1, buf, 0);
+        free(buf);
+    }
     else if (!strcmp(rpc->method, "get_protocols")) {
         char buf[65536]; // we expect the protocol string to be around 60k bytes.
         data_t *data = protocols_data(cfg);
@@ -658,8 +878,13 @@ void rpc_exec(rpc_t *rpc, r_cfg_t *cfg)
         rpc->response(rpc, 0, "Ok", 0);
     }
     else if (!strcmp(rpc->method, "sample_rate")) {
-        set_sample_rate(cfg, rpc->val);
-        rpc->response(rpc, 0, "Ok", 0);
+        if (cfg->demod->decimator && (unsigned)rpc->val % cfg->demod->decimation) {
+            rpc->response(rpc, -1, "Sample rate is not a multiple of the decimation", 0);
+        }
+        else {
+            set_sample_rate(cfg, rpc->val);
+            rpc->response(rpc, 0, "Ok", 0);
+        }
     }
 
     // Invalid
@@ -672,18 +897,345 @@ void rpc_exec(rpc_t *rpc, r_cfg_t *cfg)
 
 #define KEEP_ALIVE 60 /* seconds */
 
+#define DEFAULT_MAX_QUEUED (1024 * 1024) /* bytes queued for each client */
+#define SEND_WINDOW 16384 /* bytes handed to mongoose for each client at once */
+
+/// Marks connections that have a struct nc_context as user_data.
+#define HTTP_F_CLIENT MG_F_USER_2
+
+/// Marks connections that wait for the reply of a getter from the SDR thread.
+#define HTTP_F_PENDING MG_F_USER_3
+
+/// A broadcast message, shared by the history and all client queues.
+typedef struct http_frame {
+    unsigned refs;
+    size_t len;
+    char msg[];
+} http_frame_t;
+
+static http_frame_t *http_frame_create(char const *msg, size_t len)
+{
+    http_frame_t *frame = malloc(sizeof(*frame) + len + 1);
+    if (!frame) {
+        WARN_MALLOC("http_frame_create()");
+        return NULL;
+    }
+    frame->refs = 1;
+    frame->len  = len;
+    memcpy(frame->msg, msg, len);
+    frame->msg[len] = '\0';
+    return frame;
+}
+
+static http_frame_t *http_frame_ref(http_frame_t *frame)
+{
+    frame->refs++;
+    return frame;
+}
+
+static void http_frame_unref(http_frame_t *frame)
+{
+    if (frame && --frame->refs == 0)
+        free(frame);
+}
+
 struct http_server_context {
     struct mg_connection *conn;
     struct mg_serve_http_opts server_opts;
     r_cfg_t *cfg;
     struct data_output *output;
-    ring_list_t *history;
+    ring_list_t *history; ///< http_frame_t
+    size_t max_queued;    ///< bytes queued for each client, 0 for no limit
+    int slow_close;       ///< disconnect slow clients instead of dropping the oldest messages
+    unsigned clients;
+    size_t queued;
+    unsigned sent;
+    unsigned dropped;
+    unsigned disconnected;
+    list_t pending;  ///< rpc_pending_t waiting for the SDR thread
+    unsigned serial; ///< serial of the last pending reply
 };
 
 struct nc_context {
     int is_chunked;
+    int is_websocket;
+    struct http_server_context *server;
+    char addr[64];     ///< remote address, kept for logging on close
+    list_t queue;      ///< http_frame_t not yet handed to mongoose
+    size_t queue_head; ///< index of the oldest frame in the queue
+    size_t queued;     ///< bytes in the queue
+    unsigned sent;
+    unsigned dropped;
 };
 
+static struct nc_context *client_create(struct mg_connection *nc, struct http_server_context *server)
+{
+    struct nc_context *cctx = calloc(1, sizeof(*cctx));
+    if (!cctx) {
+        WARN_CALLOC("client_create()");
+        return NULL;
+    }
+    cctx->server  = server;
+    mg_conn_addr_to_str(nc, cctx->addr, sizeof(cctx->addr), MG_SOCK_STRINGIFY_IP | MG_SOCK_STRINGIFY_PORT | MG_SOCK_STRINGIFY_REMOTE);
+    nc->user_data = cctx;
+    nc->flags |= HTTP_F_CLIENT;
+    server->clients++;
+    return cctx;
+}
+
+static http_frame_t *client_shift(struct nc_context *cctx)
+{
+    if (cctx->queue_head >= cctx->queue.len)
+        return NULL;
+    http_frame_t *frame = cctx->queue.elems[cctx->queue_head++];
+    if (cctx->queue_head == cctx->queue.len) {
+        cctx->queue_head = 0;
+        list_clear(&cctx->queue, NULL);
+    }
+    // move the rest to the front once half the list is consumed, a client that never drains fully stays bounded
+    else if (cctx->queue_head >= cctx->queue.len / 2) {
+        size_t left = cctx->queue.len - cctx->queue_head;
+        memmove(cctx->queue.elems, cctx->queue.elems + cctx->queue_head, left * sizeof(*cctx->queue.elems));
+        cctx->queue.elems[left] = NULL;
+        cctx->queue.len         = left;
+        cctx->queue_head        = 0;
+    }
+    cctx->queued -= frame->len;
+    cctx->server->queued -= frame->len;
+    return frame;
+}
+
+static void client_free(struct mg_connection *nc)
+{
+    struct nc_context *cctx = nc->user_data;
+    struct http_server_context *server = cctx->server;
+
+    if (cctx->dropped)
+        fprintf(stderr, "HTTP client %s dropped %u of %u messages\n", cctx->addr, cctx->dropped, cctx->sent + cctx->dropped);
+
+    http_frame_t *frame;
+    while ((frame = client_shift(cctx)))
+        http_frame_unref(frame);
+    list_free_elems(&cctx->queue, NULL);
+    server->clients--;
+
+    nc->flags &= ~HTTP_F_CLIENT;
+    nc->user_data = NULL;
+    free(cctx);
+}
+
+/// Hand queued frames to mongoose while the send buffer is below the window.
+static void client_flush(struct mg_connection *nc)
+{
+    struct nc_context *cctx = nc->user_data;
+    int sent = 0;
+
+    while (nc->send_mbuf.len < SEND_WINDOW) {
+        http_frame_t *frame = client_shift(cctx);
+        if (!frame)
+            break;
+        if (cctx->is_websocket) {
+            mg_send_websocket_frame(nc, WEBSOCKET_OP_TEXT, frame->msg, frame->len);
+        }
+        else if (cctx->is_chunked) {
+            mg_send_http_chunk(nc, frame->msg, frame->len);
+            mg_send_http_chunk(nc, "\r\n", 2);
+        }
+        else {
+            mg_send(nc, frame->msg, frame->len);
+            mg_send(nc, "\r\n", 2);
+        }
+        http_frame_unref(frame);
+        cctx->sent++;
+        cctx->server->sent++;
+        sent = 1;
+    }
+
+    if (sent && !cctx->is_websocket)
+        mg_set_timer(nc, mg_time() + KEEP_ALIVE); // reset keep alive timer
+}
+
+/// Queue a frame for a client, applies the queue limit.
+static void client_push(struct mg_connection *nc, http_frame_t *frame)
+{
+    struct nc_context *cctx = nc->user_data;
+    struct http_server_context *server = cctx->server;
+
+    if (nc->flags & MG_F_CLOSE_IMMEDIATELY)
+        return;
+
+    if (server->max_queued && cctx->queued + frame->len > server->max_queued && cctx->queued) {
+        if (server->slow_close) {
+            fprintf(stderr, "HTTP client %s is too slow, disconnecting\n", cctx->addr);
+            cctx->dropped++;
+            server->dropped++;
+            server->disconnected++;
+            nc->flags |= MG_F_CLOSE_IMMEDIATELY;
+            return;
+        }
+        // drop the oldest
+        while (cctx->queued && cctx->queued + frame->len > server->max_queued) {
+            http_frame_unref(client_shift(cctx));
+            cctx->dropped++;
+            server->dropped++;
+        }
+    }
+
+    list_push(&cctx->queue, http_frame_ref(frame));
+    cctx->queued += frame->len;
+    server->queued += frame->len;
+}
+
+/// A connection waiting for the reply of a getter from the SDR thread.
+typedef struct rpc_pending {
+    unsigned serial;
+    struct mg_connection *nc;
+    rpc_response_fn response;
+    char *id; ///< copy of the jsonrpc id
+} rpc_pending_t;
+
+static void rpc_pending_free(void *ptr)
+{
+    rpc_pending_t *pending = ptr;
+    free(pending->id);
+    free(pending);
+}
+
+static struct http_server_context *rpc_server(struct mg_connection *nc)
+{
+    if (nc->flags & HTTP_F_CLIENT) {
+        struct nc_context *cctx = nc->user_data;
+        return cctx->server;
+    }
+    return nc->user_data;
+}
+
+// drop the replies pending for a closing connection
+static void rpc_pending_close(struct mg_connection *nc)
+{
+    struct http_server_context *server = rpc_server(nc);
+    if (!server)
+        return;
+    for (size_t i = server->pending.len; i > 0; --i) {
+        rpc_pending_t *pending = server->pending.elems[i - 1];
+        if (pending->nc == nc)
+            list_remove(&server->pending, i - 1, rpc_pending_free);
+    }
+}
+
+// reply to a getter that ran on the SDR thread, runs on the network thread
+static void rpc_reply(r_cfg_t *cfg, void *ctx)
+{
+    rpc_call_t *call = ctx;
+    struct http_server_context *server = call->server;
+
+    rpc_pending_t *pending = NULL;
+    for (size_t i = 0; i < server->pending.len; ++i) {
+        rpc_pending_t *p = server->pending.elems[i];
+        if (p->serial == call->serial) {
+            pending = p;
+            list_remove(&server->pending, i, NULL);
+            break;
+        }
+    }
+
+    // the connection might have closed meanwhile
+    if (pending) {
+        rpc_t rpc = {
+                .nc       = pending->nc,
+                .response = pending->response,
+                .method   = call->rpc.method,
+                .arg      = call->rpc.arg,
+                .val      = call->rpc.val,
+                .id       = pending->id,
+        };
+        if (call->data) {
+            char buf[20480]; // we expect the stats string to be around 15k bytes.
+            data_t *data = append_output_stats(cfg, call->data);
+            call->data   = NULL;
+            data_print_jsons(data, buf, sizeof(buf));
+            rpc.response(&rpc, 1, buf, 0);
+            data_free(data);
+        }
+        else if (call->ret_code < 0 && !call->message) {
+            rpc.response(&rpc, -1, "Out of memory", 0);
+        }
+        else {
+            rpc.response(&rpc, call->ret_code, call->message, call->arg);
+        }
+        rpc_pending_free(pending);
+    }
+
+    if (call->data)
+        data_free(call->data);
+    free(call->message);
+    free(call);
+}
+
+/// Post fn with a copy of the rpc to the SDR thread, fn hands the call to rpc_reply() on the network thread.
+static int rpc_post_call(rpc_t *rpc, r_cfg_t *cfg, net_command_fn fn)
+{
+    struct http_server_context *server = rpc_server(rpc->nc);
+
+    size_t method_len = strlen(rpc->method) + 1;
+    size_t arg_len    = rpc->arg ? strlen(rpc->arg) + 1 : 0;
+    rpc_call_t *call  = calloc(1, sizeof(rpc_call_t) + method_len + arg_len);
+    if (!call) {
+        WARN_CALLOC("rpc_post_call()");
+        rpc->response(rpc, -1, "Out of memory", 0);
+        return 1;
+    }
+    rpc_pending_t *pending = calloc(1, sizeof(rpc_pending_t));
+    if (!pending) {
+        WARN_CALLOC("rpc_post_call()");
+        free(call);
+        rpc->response(rpc, -1, "Out of memory", 0);
+        return 1;
+    }
+    call->rpc.response = rpc_response_capture;
+    call->rpc.val      = rpc->val;
+    call->rpc.method   = memcpy((char *)(call + 1), rpc->method, method_len);
+    if (rpc->arg)
+        call->rpc.arg = memcpy((char *)(call + 1) + method_len, rpc->arg, arg_len);
+    call->server = server;
+    call->serial = ++server->serial;
+
+    pending->serial   = call->serial;
+    pending->nc       = rpc->nc;
+    pending->response = rpc->response;
+    if (rpc->id) {
+        pending->id = strdup(rpc->id);
+        if (!pending->id)
+            WARN_STRDUP("rpc_post_call()"); // replied with a null id
+    }
+
+    // the command holds no reference to the pending list, it can be discarded with a plain free()
+    if (!net_thread_post_command(cfg->net_thread, fn, call)) {
+        rpc_pending_free(pending);
+        free(call);
+        rpc->response(rpc, -1, "Try again later", 0);
+        return 1;
+    }
+    list_push(&server->pending, pending);
+    rpc->nc->flags |= HTTP_F_PENDING;
+    return 1;
+}
+
+static void rpc_exec_getter(r_cfg_t *cfg, void *ctx)
+{
+    rpc_call_t *call = ctx;
+    rpc_exec(&call->rpc, cfg);
+    net_thread_post_call(cfg->net_thread, rpc_reply, call);
+}
+
+static int rpc_post_getter(rpc_t *rpc, r_cfg_t *cfg)
+{
+    if (!cfg->net_thread || rpc->response == rpc_response_deferred || rpc->response == rpc_response_capture)
+        return 0;
+
+    return rpc_post_call(rpc, cfg, rpc_exec_getter);
+}
+
 static void handle_options(struct mg_connection *nc, struct http_message *hm)
 {
     UNUSED(hm);
@@ -846,13 +1398,10 @@ static void handle_json_events(struct mg_connection *nc, struct http_message *hm
     mg_printf(nc, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n");
 
     /* Mark connection */
-    struct nc_context *ctx = calloc(1, sizeof(*ctx));
-    if (!ctx) {
-        WARN_CALLOC("handle_json_events()");
+    struct nc_context *cctx = client_create(nc, nc->user_data);
+    if (!cctx)
         return;
-    }
-    ctx->is_chunked = 1;
-    nc->user_data   = ctx;
+    cctx->is_chunked = 1;
 
     mg_set_timer(nc, mg_time() + KEEP_ALIVE); // set keep alive timer
 }
@@ -865,17 +1414,140 @@ static void handle_json_stream(struct mg_connection *nc, struct http_message *hm
     mg_printf(nc, "HTTP/1.1 200 OK\r\n\r\n");
 
     /* Mark connection */
-    struct nc_context *ctx = calloc(1, sizeof(*ctx));
-    if (!ctx) {
-        WARN_CALLOC("handle_json_stream()");
+    struct nc_context *cctx = client_create(nc, nc->user_data);
+    if (!cctx)
         return;
-    }
-    ctx->is_chunked = 0;
-    nc->user_data   = ctx;
 
     mg_set_timer(nc, mg_time() + KEEP_ALIVE); // set keep alive timer
 }
 
+// Handles GET of device states
+// http :8433/devices model==Acurite-Tower
+// http :8433/devices key==Acurite-Tower/A/1234
+static void handle_devices(struct mg_connection *nc, struct http_message *hm)
+{
+    struct http_server_context *ctx = nc->user_data;
+    char model[100], key[256];
+
+    mg_get_http_var(&hm->query_string, "model", model, sizeof(model));
+    mg_get_http_var(&hm->query_string, "key", key, sizeof(key));
+
+    char *buf = devices_jsons(ctx->cfg, model, key);
+    if (!buf) {
+        mg_http_send_error(nc, 404, NULL);
+        return;
+    }
+    mg_printf(nc,
+            "HTTP/1.1 200 OK\r\n"
+            "Content-Type: application/json\r\n"
+            "Content-Length: %u\r\n"
+            "\r\n", (unsigned)strlen(buf));
+    mg_send(nc, buf, strlen(buf));
+    free(buf);
+}
+
+// Send the SDR metrics text followed by the output metrics, runs on the network thread
+static void send_metrics(struct mg_connection *nc, r_cfg_t *cfg, char const *sdr_text)
+{
+    // outputs are set up once we serve requests
+    if (!cfg->output_metrics)
+        cfg->output_metrics = create_output_metrics(cfg);
+
+    size_t len = 0;
+    char const *text = cfg->output_metrics ? metrics_render(cfg->output_metrics, &len) : NULL;
+    if (!sdr_text || !text) {
+        mg_http_send_error(nc, 500, NULL);
+        return;
+    }
+    size_t sdr_len = strlen(sdr_text);
+    mg_printf(nc,
+            "HTTP/1.1 200 OK\r\n"
+            "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+            "Content-Length: %u\r\n"
+            "\r\n", (unsigned)(sdr_len + len));
+    mg_send(nc, sdr_text, sdr_len);
+    mg_send(nc, text, len);
+}
+
+// reply to a metrics scrape
+static void rpc_response_metrics(rpc_t *rpc, int ret_code, char const *message, int arg)
+{
+    UNUSED(arg);
+    struct http_server_context *ctx = rpc->nc->user_data;
+    send_metrics(rpc->nc, ctx->cfg, ret_code < 0 ? NULL : message);
+}
+
+// render the SDR metrics, runs on the SDR thread
+static void metrics_exec(r_cfg_t *cfg, void *ctx)
+{
+    rpc_call_t *call = ctx;
+
+    // decoders are set up once we serve requests
+    if (!cfg->metrics)
+        cfg->metrics = create_metrics(cfg);
+
+    size_t len = 0;
+    char const *text = cfg->metrics ? metrics_render(cfg->metrics, &len) : NULL;
+    if (!text)
+        call->rpc.response(&call->rpc, -1, "No metrics", 0);
+    else
+        call->rpc.response(&call->rpc, 1, text, 0);
+    net_thread_post_call(cfg->net_thread, rpc_reply, call);
+}
+
+// Handles GET of metrics in the Prometheus text format
+// curl http://127.0.0.1:8433/metrics
+static void handle_metrics(struct mg_connection *nc, struct http_message *hm)
+{
+    UNUSED(hm);
+    struct http_server_context *ctx = nc->user_data;
+    r_cfg_t *cfg = ctx->cfg;
+
+    // the SDR and decoder counters are read on the SDR thread
+    if (cfg->net_thread) {
+        rpc_t rpc = {
+                .nc       = nc,
+                .response = rpc_response_metrics,
+                .method   = "metrics",
+        };
+        rpc_post_call(&rpc, cfg, metrics_exec);
+        return;
+    }
+
+    if (!cfg->metrics)
+        cfg->metrics = create_metrics(cfg);
+    size_t len = 0;
+    send_metrics(nc, cfg, cfg->metrics ? metrics_render(cfg->metrics, &len) : NULL);
+}
+
+static void ev_handler(struct mg_connection *nc, int ev, void *ev_data);
+
+// Handles GET of the streaming clients
+// http :8433/clients
+static void handle_clients(struct mg_connection *nc, struct http_message *hm)
+{
+    UNUSED(hm);
+    struct http_server_context *ctx = nc->user_data;
+
+    /* Send headers */
+    mg_printf(nc, "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nTransfer-Encoding: chunked\r\n\r\n");
+
+    mg_printf_http_chunk(nc, "{\"max_queued\": %u, \"slow\": \"%s\", \"clients\": [",
+            (unsigned)ctx->max_queued, ctx->slow_close ? "close" : "drop");
+    char const *sep = "";
+    for (struct mg_connection *c = mg_next(nc->mgr, NULL); c != NULL; c = mg_next(nc->mgr, c)) {
+        if (c->handler != ev_handler || !(c->flags & HTTP_F_CLIENT))
+            continue;
+        struct nc_context *cctx = c->user_data;
+        mg_printf_http_chunk(nc, "%s{\"address\": \"%s\", \"type\": \"%s\", \"queued\": %u, \"queued_bytes\": %u, \"sent\": %u, \"dropped\": %u}",
+                sep, cctx->addr, cctx->is_websocket ? "ws" : cctx->is_chunked ? "events" : "stream",
+                (unsigned)(cctx->queue.len - cctx->queue_head), (unsigned)cctx->queued, cctx->sent, cctx->dropped);
+        sep = ", ";
+    }
+    mg_printf_http_chunk(nc, "]}");
+    mg_send_http_chunk(nc, "", 0); /* Send empty chunk, the end of response */
+}
+
 // Handles GET with query string and POST with form-encoded body
 // curl -D - 'http://127.0.0.1:8433/cmd?cmd=report_meta&arg=level'
 // curl -D - -d "cmd=report_meta&arg=level" -X POST 'http://127.0.0.1:8433/cmd'
@@ -946,7 +1618,10 @@ static void handle_json_rpc(struct mg_connection *nc, struct http_message *hm)
 // Handles WS with JSON command
 static void handle_ws_rpc(struct mg_connection *nc, struct websocket_message *wm)
 {
-    struct http_server_context *ctx = nc->user_data;
+    struct nc_context *cctx = nc->user_data;
+    if (!(nc->flags & HTTP_F_CLIENT))
+        return; // this should not happen
+    struct http_server_context *ctx = cctx->server;
 
     rpc_t rpc = {
             .nc       = nc,
@@ -970,15 +1645,13 @@ static void handle_ws_rpc(struct mg_connection *nc, struct websocket_message *wm
     free(rpc.arg);
 }
 
-static void ev_handler(struct mg_connection *nc, int ev, void *ev_data);
-
 static void send_keep_alive(struct mg_connection *nc)
 {
     if (nc->handler != ev_handler)
         return; // this should not happen
 
     struct nc_context *ctx = nc->user_data;
-    if (!ctx)
+    if (!(nc->flags & HTTP_F_CLIENT))
         return; // this should not happen
 
     if (ctx->is_chunked) {
@@ -998,15 +1671,24 @@ static void ev_handler(struct mg_connection *nc, int ev, void *ev_data)
         break;
     case MG_EV_WEBSOCKET_HANDSHAKE_DONE: {
         struct http_server_context *ctx = nc->user_data;
+        struct nc_context *cctx = client_create(nc, ctx);
+        if (!cctx)
+            break;
+        cctx->is_websocket = 1;
         /* New websocket connection. Send meta. */
         data_t *meta = meta_data(ctx->cfg);
         data_output_print(ctx->output, meta);
         data_free(meta);
         /* Send history */
         for (void **iter = ring_list_iter(ctx->history); iter; iter = ring_list_next(ctx->history, iter))
-            mg_send_websocket_frame(nc, WEBSOCKET_OP_TEXT, (char *)*iter, strlen((char *)*iter));
+            client_push(nc, *iter);
+        client_flush(nc);
         break;
     }
+    case MG_EV_SEND:
+        if (nc->flags & HTTP_F_CLIENT)
+            client_flush(nc);
+        break;
     case MG_EV_WEBSOCKET_FRAME: {
         struct websocket_message *wm = (struct websocket_message *)ev_data;
 
@@ -1038,6 +1720,15 @@ static void ev_handler(struct mg_connection *nc, int ev, void *ev_data)
         else if (mg_vcmp(&hm->uri, "/stream") == 0) {
             handle_json_stream(nc, hm);
         }
+        else if (mg_vcmp(&hm->uri, "/devices") == 0) {
+            handle_devices(nc, hm);
+        }
+        else if (mg_vcmp(&hm->uri, "/metrics") == 0) {
+            handle_metrics(nc, hm);
+        }
+        else if (mg_vcmp(&hm->uri, "/clients") == 0) {
+            handle_clients(nc, hm);
+        }
         else if (mg_vcmp(&hm->uri, "/api") == 0) {
             //handle_api_query(nc, hm);
         }
@@ -1051,53 +1742,39 @@ static void ev_handler(struct mg_connection *nc, int ev, void *ev_data)
     }
     case MG_EV_CLOSE:
         //fprintf(stderr, "MG_EV_CLOSE %p %p %p\n", ev_data, nc, nc->user_data);
+        if (nc->flags & HTTP_F_PENDING)
+            rpc_pending_close(nc);
+        if (nc->flags & HTTP_F_CLIENT)
+            client_free(nc);
         break;
     default:
         break;
     }
 }
 
-static int is_websocket(const struct mg_connection *nc)
-{
-    return nc->flags & MG_F_IS_WEBSOCKET;
-}
-
 // event handler to broadcast to all our sockets
 static void http_broadcast_send(struct http_server_context *ctx, char const *msg, size_t len)
 {
     struct mg_connection *nc;
     struct mg_mgr *mgr = ctx->conn->mgr;
 
-    char *dup = strdup(msg);
-    if (!dup) {
-        WARN_STRDUP("http_broadcast_send()");
-    }
-    else {
-        free(ring_list_push(ctx->history, dup));
-    }
+    // one copy of the message is shared by the history and all clients
+    http_frame_t *frame = http_frame_create(msg, len);
+    if (!frame)
+        return; // NOTE: skip output on alloc failure.
 
     for (nc = mg_next(mgr, NULL); nc != NULL; nc = mg_next(mgr, nc)) {
-        if (nc->handler != ev_handler)
+        if (nc->handler != ev_handler || !(nc->flags & HTTP_F_CLIENT))
             continue;
 
-        struct nc_context *cctx = nc->user_data; // might not be valid
-        if (is_websocket(nc)) {
-            mg_send_websocket_frame(nc, WEBSOCKET_OP_TEXT, msg, len);
-        }
-        else if (cctx && cctx->is_chunked) {
-            mg_send_http_chunk(nc, msg, len);
-            mg_send_http_chunk(nc, "\r\n", 2);
-            mg_set_timer(nc, mg_time() + KEEP_ALIVE); // reset keep alive timer
-        }
-        else if (cctx && !cctx->is_chunked) {
-            mg_send(nc, msg, len);
-            mg_send(nc, "\r\n", 2);
-            mg_set_timer(nc, mg_time() + KEEP_ALIVE); // reset keep alive timer
-        }
+        client_push(nc, frame);
+        client_flush(nc);
     }
+
+    http_frame_unref(ring_list_push(ctx->history, frame));
 }
 
-static struct http_server_context *http_server_start(struct mg_mgr *mgr, char const *host, char const *port, r_cfg_t *cfg, struct data_output *output)
+static struct http_server_context *http_server_start(struct mg_mgr *mgr, char const *host, char const *port, char *opts, r_cfg_t *cfg, struct data_output *output)
 {
     struct mg_bind_opts bind_opts;
     const char *err_str;
@@ -1109,9 +1786,28 @@ static struct http_server_context *http_server_start(struct mg_mgr *mgr, char co
         return NULL;
     }
 
-    ctx->cfg     = cfg;
-    ctx->output  = output;
-    ctx->history = ring_list_new(DEFAULT_HISTORY_SIZE);
+    ctx->cfg        = cfg;
+    ctx->output     = output;
+    ctx->history    = ring_list_new(DEFAULT_HISTORY_SIZE);
+    ctx->max_queued = DEFAULT_MAX_QUEUED;
+
+    char *key, *val;
+    while (getkwargs(&opts, &key, &val)) {
+        key = remove_ws(key);
+        val = trim_ws(val);
+        if (!key || !*key)
+            continue;
+        else if (!strcasecmp(key, "queue"))
+            ctx->max_queued = atouint32_metric(val, "queue= ");
+        else if (!strcasecmp(key, "slow") && val && !strcasecmp(val, "close"))
+            ctx->slow_close = 1;
+        else if (!strcasecmp(key, "slow") && val && !strcasecmp(val, "drop"))
+            ctx->slow_close = 0;
+        else {
+            fprintf(stderr, "Invalid key \"%s\" option.\n", key);
+            exit(1);
+        }
+    }
 
     char address[253 + 6 + 1]; // dns max + port
     // if the host is an IPv6 address it needs quoting
@@ -1160,25 +1856,30 @@ static int http_server_stop(struct http_server_context *ctx)
         if (nc->handler != ev_handler)
             continue;
 
-        struct nc_context *cctx = nc->user_data; // might not be valid
-        if (is_websocket(nc)) {
+        if (!(nc->flags & HTTP_F_CLIENT))
+            continue;
+
+        struct nc_context *cctx = nc->user_data;
+        if (cctx->is_websocket) {
             mg_send_websocket_frame(nc, WEBSOCKET_OP_TEXT, SHUTDOWN_JSON, sizeof(SHUTDOWN_JSON) - 1);
         }
-        else if (cctx && cctx->is_chunked) {
+        else if (cctx->is_chunked) {
             mg_send_http_chunk(nc, SHUTDOWN_JSON, sizeof(SHUTDOWN_JSON) - 1);
             mg_send_http_chunk(nc, "\r\n", 2);
             mg_send_http_chunk(nc, "", 0);            /* Send empty chunk, the end of response */
         }
-        else if (cctx && !cctx->is_chunked) {
+        else {
             mg_send(nc, SHUTDOWN_JSON, sizeof(SHUTDOWN_JSON) - 1);
             mg_send(nc, "\r\n", 2);
         }
     }
 
     for (void **iter = ring_list_iter(ctx->history); iter; iter = ring_list_next(ctx->history, iter))
-        free((data_t *)*iter);
+        http_frame_unref(*iter);
     ring_list_free(ctx->history);
 
+    list_free_elems(&ctx->pending, rpc_pending_free);
+
     return 0;
 }
 
@@ -1205,7 +1906,9 @@ static void print_http_data(data_output_t *output, data_t *data, char const *for
         // "events"
         char buf[2048]; // we expect the biggest strings to be around 500 bytes.
         size_t len = data_print_jsons(data, buf, sizeof(buf));
+        data_output_mark_serialized(output);
         http_broadcast_send(http->server, buf, len);
+        data_output_mark_queued(output);
     }
     else {
         // "states"
@@ -1216,11 +1919,52 @@ static void print_http_data(data_output_t *output, data_t *data, char const *for
             return; // NOTE: skip output on alloc failure.
         }
         size_t len = data_print_jsons(data, buf, buf_size);
+        data_output_mark_serialized(output);
         http_broadcast_send(http->server, buf, len);
+        data_output_mark_queued(output);
         free(buf);
     }
 }
 
+static data_t *data_output_http_stats(data_output_t *output)
+{
+    data_output_http_t *http = (data_output_http_t *)output;
+    struct http_server_context *ctx = http->server;
+
+    return data_make(
+            "output",           "", DATA_STRING, "http",
+            "clients",          "", DATA_INT, (int)ctx->clients,
+            "queued_bytes",     "", DATA_INT, (int)ctx->queued,
+            "sent",             "", DATA_INT, (int)ctx->sent,
+            "dropped",          "", DATA_INT, (int)ctx->dropped,
+            "disconnected",     "", DATA_INT, (int)ctx->disconnected,
+            NULL);
+}
+
+static double http_queued_bytes(void *ctx)
+{
+    struct http_server_context *server = ctx;
+    return server->queued;
+}
+
+static void data_output_http_metrics(data_output_t *output, metrics_t *metrics, char const *labels)
+{
+    data_output_http_t *http = (data_output_http_t *)output;
+    struct http_server_context *ctx = http->server;
+
+    metric_family_t *family;
+    family = metrics_family(metrics, "rtl_433_output_clients", "Clients streaming from the output.", METRIC_GAUGE);
+    metric_add_unsigned(family, labels, &ctx->clients);
+    family = metrics_family(metrics, "rtl_433_output_pending_bytes", "Bytes waiting to be sent by the output.", METRIC_GAUGE);
+    metric_add_fn(family, labels, http_queued_bytes, ctx);
+    family = metrics_family(metrics, "rtl_433_output_sent_total", "Messages sent by the output.", METRIC_COUNTER);
+    metric_add_unsigned(family, labels, &ctx->sent);
+    family = metrics_family(metrics, "rtl_433_output_dropped_total", "Messages dropped by the output.", METRIC_COUNTER);
+    metric_add_unsigned(family, labels, &ctx->dropped);
+    family = metrics_family(metrics, "rtl_433_output_disconnected_total", "Slow clients disconnected by the output.", METRIC_COUNTER);
+    metric_add_unsigned(family, labels, &ctx->disconnected);
+}
+
 static void data_output_http_free(data_output_t *output)
 {
     data_output_http_t *http = (data_output_http_t *)output;
@@ -1233,7 +1977,7 @@ static void data_output_http_free(data_output_t *output)
     free(http);
 }
 
-struct data_output *data_output_http_create(struct mg_mgr *mgr, char const *host, char const *port, r_cfg_t *cfg)
+struct data_output *data_output_http_create(struct mg_mgr *mgr, char const *host, char const *port, char *opts, r_cfg_t *cfg)
 {
     data_output_http_t *http = calloc(1, sizeof(data_output_http_t));
     if (!http) {
@@ -1242,9 +1986,11 @@ struct data_output *data_output_http_create(struct mg_mgr *mgr, char const *host
     }
 
     http->output.print_data   = print_http_data;
+    http->output.output_stats = data_output_http_stats;
+    http->output.output_metrics = data_output_http_metrics;
     http->output.output_free  = data_output_http_free;
 
-    http->server = http_server_start(mgr, host, port, cfg, &http->output);
+    http->server = http_server_start(mgr, host, port, opts, cfg, &http->output);
     if (!http->server) {
         exit(1);
     }
@@ -0,0 +1,792 @@
+/** @file
+    Lossless block compression of CU8 and CS16 IQ samples.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+/*
+    File layout, all values little-endian:
+
+    header: "rtl433iq", u8 version, u8 sample size, u16 reserved,
+            u32 samples per block, u32 sample rate, u32 center frequency
+    blocks: u8 type, u8 sample size, u8 shift, u8 reserved, u32 samples, u32 payload length, payload
+
+    Blocks are independent. A stored block holds the raw samples, a Rice block holds
+    sub-blocks of 64 samples. For each of I and Q a sub-block has a predictor bit
+    (0: the value minus the mid level, 1: the delta to the previous value), a 5 bit
+    Rice parameter k, and the zigzag coded residuals. A residual is coded as the
+    quotient in unary and k remainder bits, a quotient of 24 or more escapes to
+    the raw residual in 9 (CU8) or 17 (CS16) bits. CS16 values are shifted right by
+    the low zero bits common to the block, e.g. 4 bits for 12 bit converters.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "iq_codec.h"
+#include "compat_pthread.h"
+#include "fatal.h"
+
+#define IQ_BLOCK_STORED 0
+#define IQ_BLOCK_RICE   1
+
+#define IQ_SUB_SAMPLES 64
+#define IQ_ESCAPE      24
+#define IQ_MAX_BLOCK_SAMPLES (1 << 22)
+
+static char const iq_magic[8] = {'r', 't', 'l', '4', '3', '3', 'i', 'q'};
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = (v >> 24) & 0xff;
+}
+
+static uint32_t get_u32(uint8_t const *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/* bit I/O, MSB first */
+
+typedef struct bit_writer {
+    uint8_t *p;
+    uint64_t acc;
+    unsigned bits;
+} bit_writer_t;
+
+static inline void bit_put(bit_writer_t *w, uint32_t val, unsigned n)
+{
+    w->acc = (w->acc << n) | val;
+    w->bits += n;
+    while (w->bits >= 8) {
+        w->bits -= 8;
+        *w->p++ = (uint8_t)(w->acc >> w->bits);
+    }
+}
+
+static inline void bit_flush(bit_writer_t *w)
+{
+    if (w->bits) {
+        *w->p++ = (uint8_t)(w->acc << (8 - w->bits));
+        w->bits = 0;
+    }
+}
+
+typedef struct bit_reader {
+    uint8_t const *p;
+    uint8_t const *end;
+    uint64_t acc;               ///< left aligned
+    unsigned bits;
+    unsigned over;              ///< zero bytes filled past the end
+} bit_reader_t;
+
+static inline void bit_fill(bit_reader_t *r)
+{
+    while (r->bits <= 56) {
+        uint64_t b = 0;
+        if (r->p < r->end)
+            b = *r->p++;
+        else
+            r->over++;
+        r->acc |= b << (56 - r->bits);
+        r->bits += 8;
+    }
+}
+
+static inline uint32_t bit_get(bit_reader_t *r, unsigned n)
+{
+    if (!n)
+        return 0;
+    uint32_t v = (uint32_t)(r->acc >> (64 - n));
+    r->acc <<= n;
+    r->bits -= n;
+    return v;
+}
+
+static inline unsigned bit_lead_ones(bit_reader_t *r)
+{
+#if defined(__GNUC__)
+    uint64_t inv = ~r->acc;
+    return inv ? (unsigned)__builtin_clzll(inv) : 64;
+#else
+    unsigned n = 0;
+    while (n < IQ_ESCAPE && (r->acc << n) >> 63)
+        n++;
+    return n;
+#endif
+}
+
+/* block coding */
+
+static inline uint32_t zigzag(int32_t v)
+{
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t z)
+{
+    return (int32_t)(z >> 1) ^ -(int32_t)(z & 1);
+}
+
+/// Rice parameter with the least coded size for the residuals, near log2 of the mean.
+static unsigned rice_param(uint32_t const *z, unsigned n, uint64_t sum, unsigned k_max)
+{
+    unsigned k = 0;
+    while (k < k_max && ((uint64_t)n << (k + 1)) <= sum)
+        k++;
+    if (k == 0)
+        return 0;
+    uint64_t cost_k = 0, cost_lo = 0;
+    for (unsigned i = 0; i < n; ++i) {
+        cost_k += z[i] >> k;
+        cost_lo += z[i] >> (k - 1);
+    }
+    return cost_lo + n * (k - 1) < cost_k + n * k ? k - 1 : k;
+}
+
+size_t iq_encode_bound(unsigned n_samples, int sample_size)
+{
+    // a Rice block is given up once it grows past the stored size, plus a sub-block
+    return IQ_CODEC_BLOCK_HEADER_SIZE + (size_t)n_samples * sample_size + 1024;
+}
+
+static void put_block_header(uint8_t *out, int type, int sample_size, unsigned shift, unsigned n_samples, size_t payload_len)
+{
+    out[0] = type;
+    out[1] = sample_size;
+    out[2] = shift;
+    out[3] = 0;
+    put_u32(&out[4], n_samples);
+    put_u32(&out[8], (uint32_t)payload_len);
+}
+
+size_t iq_encode_block(uint8_t const *samples, unsigned n_samples, int sample_size, uint8_t *out)
+{
+    size_t raw_len   = (size_t)n_samples * sample_size;
+    int cs16         = sample_size == 4;
+    int32_t mid      = cs16 ? 0 : 128;
+    unsigned k_max   = cs16 ? 16 : 8;
+    unsigned raw_bits = cs16 ? 17 : 9;
+    uint8_t *payload = out + IQ_CODEC_BLOCK_HEADER_SIZE;
+
+    // low zero bits common to all CS16 values
+    unsigned shift = 0;
+    if (cs16) {
+        int16_t const *in = (int16_t const *)samples;
+        unsigned bits = 0;
+        for (unsigned i = 0; i < n_samples * 2 && !(bits & 1); ++i)
+            bits |= (uint16_t)in[i];
+        while (shift < 15 && !(bits & (1u << shift)))
+            shift++;
+        if (!bits)
+            shift = 0;
+    }
+
+    bit_writer_t w = {payload, 0, 0};
+    int32_t prev[2] = {mid, mid};
+    int32_t x[IQ_SUB_SAMPLES];
+    uint32_t z0[IQ_SUB_SAMPLES];
+    uint32_t z1[IQ_SUB_SAMPLES];
+
+    for (unsigned s = 0; s < n_samples; s += IQ_SUB_SAMPLES) {
+        unsigned n = n_samples - s < IQ_SUB_SAMPLES ? n_samples - s : IQ_SUB_SAMPLES;
+        for (int c = 0; c < 2; ++c) {
+            if (cs16) {
+                int16_t const *in = (int16_t const *)samples + 2 * s + c;
+                for (unsigned i = 0; i < n; ++i)
+                    x[i] = in[2 * i] >> shift;
+            }
+            else {
+                uint8_t const *in = samples + 2 * s + c;
+                for (unsigned i = 0; i < n; ++i)
+                    x[i] = in[2 * i];
+            }
+
+            uint64_t sum0 = 0, sum1 = 0;
+            int32_t p = prev[c];
+            for (unsigned i = 0; i < n; ++i) {
+                z0[i] = zigzag(x[i] - mid);
+                z1[i] = zigzag(x[i] - p);
+                p = x[i];
+                sum0 += z0[i];
+                sum1 += z1[i];
+            }
+            prev[c] = p;
+
+            int delta      = sum1 < sum0;
+            uint32_t *z    = delta ? z1 : z0;
+            unsigned k     = rice_param(z, n, delta ? sum1 : sum0, k_max);
+            uint32_t mask  = (1u << k) - 1;
+            bit_put(&w, (delta << 5) | k, 6);
+            for (unsigned i = 0; i < n; ++i) {
+                uint32_t q = z[i] >> k;
+                if (q < IQ_ESCAPE) {
+                    bit_put(&w, ((1u << q) - 1) << 1, q + 1);
+                    bit_put(&w, z[i] & mask, k);
+                }
+                else {
+                    bit_put(&w, (1u << IQ_ESCAPE) - 1, IQ_ESCAPE);
+                    bit_put(&w, z[i], raw_bits);
+                }
+            }
+        }
+        if ((size_t)(w.p - payload) >= raw_len)
+            break; // does not compress
+    }
+    bit_flush(&w);
+
+    size_t payload_len = w.p - payload;
+    if (payload_len >= raw_len) {
+        memcpy(payload, samples, raw_len);
+        put_block_header(out, IQ_BLOCK_STORED, sample_size, 0, n_samples, raw_len);
+        return IQ_CODEC_BLOCK_HEADER_SIZE + raw_len;
+    }
+    put_block_header(out, IQ_BLOCK_RICE, sample_size, shift, n_samples, payload_len);
+    return IQ_CODEC_BLOCK_HEADER_SIZE + payload_len;
+}
+
+int iq_decode_block(uint8_t const *in, size_t in_len, uint8_t *samples, unsigned max_samples)
+{
+    if (in_len < IQ_CODEC_BLOCK_HEADER_SIZE)
+        return -1;
+    int type           = in[0];
+    int sample_size    = in[1];
+    unsigned shift     = in[2];
+    unsigned n_samples = get_u32(&in[4]);
+    size_t payload_len = get_u32(&in[8]);
+    if ((sample_size != 2 && sample_size != 4)
+            || shift > (sample_size == 4 ? 15u : 0u)
+            || n_samples > max_samples
+            || payload_len > in_len - IQ_CODEC_BLOCK_HEADER_SIZE)
+        return -1;
+    uint8_t const *payload = in + IQ_CODEC_BLOCK_HEADER_SIZE;
+
+    if (type == IQ_BLOCK_STORED) {
+        if (payload_len != (size_t)n_samples * sample_size)
+            return -1;
+        memcpy(samples, payload, payload_len);
+        return n_samples;
+    }
+    if (type != IQ_BLOCK_RICE)
+        return -1;
+
+    int cs16          = sample_size == 4;
+    int32_t mid       = cs16 ? 0 : 128;
+    int32_t lo        = cs16 ? INT16_MIN >> shift : 0;
+    int32_t hi        = cs16 ? INT16_MAX >> shift : 255;
+    unsigned raw_bits = cs16 ? 17 : 9;
+
+    bit_reader_t r = {payload, payload + payload_len, 0, 0, 0};
+    int32_t prev[2] = {mid, mid};
+
+    for (unsigned s = 0; s < n_samples; s += IQ_SUB_SAMPLES) {
+        unsigned n = n_samples - s < IQ_SUB_SAMPLES ? n_samples - s : IQ_SUB_SAMPLES;
+        for (int c = 0; c < 2; ++c) {
+            bit_fill(&r);
+            uint32_t hdr  = bit_get(&r, 6);
+            int delta     = hdr >> 5;
+            unsigned k    = hdr & 0x1f;
+            int32_t p     = prev[c];
+            int32_t base  = mid;
+            if (k > raw_bits)
+                return -1;
+            for (unsigned i = 0; i < n; ++i) {
+                if (r.bits < 48)
+                    bit_fill(&r);
+                uint32_t z;
+                unsigned q = bit_lead_ones(&r);
+                if (q >= IQ_ESCAPE) {
+                    bit_get(&r, IQ_ESCAPE);
+                    z = bit_get(&r, raw_bits);
+                }
+                else {
+                    bit_get(&r, q + 1);
+                    z = (q << k) | bit_get(&r, k);
+                }
+                if (delta)
+                    base = p;
+                int32_t v = base + unzigzag(z);
+                if (v < lo || v > hi)
+                    return -1;
+                p = v;
+                if (cs16)
+                    ((int16_t *)samples)[2 * (s + i) + c] = (int16_t)(v * (1 << shift));
+                else
+                    samples[2 * (s + i) + c] = (uint8_t)v;
+            }
+            prev[c] = p;
+        }
+    }
+    // phantom bits past the end were consumed
+    if (r.over * 8 > r.bits)
+        return -1;
+
+    return n_samples;
+}
+
+/* stream encoder */
+
+iq_encoder_t *iq_encoder_create(FILE *file, int sample_size)
+{
+    if (sample_size != 2 && sample_size != 4) {
+        fprintf(stderr, "Compressed IQ needs CU8 or CS16 samples.\n");
+        return NULL;
+    }
+
+    iq_encoder_t *enc = calloc(1, sizeof(*enc));
+    if (!enc) {
+        WARN_CALLOC("iq_encoder_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    enc->file        = file;
+    enc->sample_size = sample_size;
+
+    enc->block = malloc((size_t)IQ_CODEC_BLOCK_SAMPLES * sample_size);
+    if (!enc->block) {
+        WARN_MALLOC("iq_encoder_create()");
+        free(enc);
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    enc->out = malloc(iq_encode_bound(IQ_CODEC_BLOCK_SAMPLES, sample_size));
+    if (!enc->out) {
+        WARN_MALLOC("iq_encoder_create()");
+        free(enc->block);
+        free(enc);
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+
+    return enc;
+}
+
+static int iq_encoder_flush(iq_encoder_t *enc)
+{
+    unsigned n_samples = enc->block_len / enc->sample_size;
+    if (!n_samples)
+        return 0;
+    size_t len = iq_encode_block(enc->block, n_samples, enc->sample_size, enc->out);
+    enc->block_len = 0;
+    enc->bytes_out += len;
+    return fwrite(enc->out, 1, len, enc->file) == len ? 0 : -1;
+}
+
+int iq_encoder_write(iq_encoder_t *enc, uint8_t const *buf, size_t len, uint32_t sample_rate, uint32_t center_frequency)
+{
+    if (!enc->header_done) {
+        uint8_t hdr[IQ_CODEC_HEADER_SIZE] = {0};
+        memcpy(hdr, iq_magic, sizeof(iq_magic));
+        hdr[8] = IQ_CODEC_VERSION;
+        hdr[9] = enc->sample_size;
+        put_u32(&hdr[12], IQ_CODEC_BLOCK_SAMPLES);
+        put_u32(&hdr[16], sample_rate);
+        put_u32(&hdr[20], center_frequency);
+        if (fwrite(hdr, 1, sizeof(hdr), enc->file) != sizeof(hdr))
+            return -1;
+        enc->header_done = 1;
+        enc->bytes_out += sizeof(hdr);
+    }
+
+    size_t block_size = (size_t)IQ_CODEC_BLOCK_SAMPLES * enc->sample_size;
+    enc->bytes_in += len;
+    while (len) {
+        size_t chunk_len = block_size - enc->block_len;
+        if (chunk_len > len)
+            chunk_len = len;
+        memcpy(&enc->block[enc->block_len], buf, chunk_len);
+        enc->block_len += chunk_len;
+        buf += chunk_len;
+        len -= chunk_len;
+        if (enc->block_len == block_size && iq_encoder_flush(enc))
+            return -1;
+    }
+    return 0;
+}
+
+int iq_encoder_close(iq_encoder_t *enc)
+{
+    if (!enc)
+        return 0;
+
+    int r = iq_encoder_flush(enc);
+    free(enc->out);
+    free(enc->block);
+    free(enc);
+    return r;
+}
+
+/* stream decoder */
+
+typedef struct iq_decode_job {
+    uint8_t *in;
+    size_t in_len;
+    size_t in_size;
+    uint8_t *out;
+    int samples;                ///< decoded samples, -1 on error
+} iq_decode_job_t;
+
+struct iq_decode_batch;
+
+typedef struct iq_decode_worker {
+    struct iq_decode_batch *batch;
+    unsigned first;
+#ifdef THREADS
+    pthread_t thread;
+    int running;
+#endif
+} iq_decode_worker_t;
+
+typedef struct iq_decode_batch {
+    unsigned count;
+    unsigned max_samples;
+    iq_decode_job_t jobs[IQ_DECODER_BATCH];
+    iq_decode_worker_t workers[IQ_DECODER_THREADS];
+} iq_decode_batch_t;
+
+static void iq_decode_worker_run(iq_decode_worker_t *worker)
+{
+    iq_decode_batch_t *batch = worker->batch;
+    for (unsigned i = worker->first; i < batch->count; i += IQ_DECODER_THREADS) {
+        iq_decode_job_t *job = &batch->jobs[i];
+        job->samples = iq_decode_block(job->in, job->in_len, job->out, batch->max_samples);
+    }
+}
+
+#ifdef THREADS
+static THREAD_RETURN THREAD_CALL iq_decode_worker_thread(void *arg)
+{
+    iq_decode_worker_run(arg);
+    return (THREAD_RETURN)0;
+}
+#endif
+
+iq_decoder_t *iq_decoder_open(FILE *file)
+{
+    uint8_t hdr[IQ_CODEC_HEADER_SIZE];
+    if (fread(hdr, 1, sizeof(hdr), file) != sizeof(hdr)
+            || memcmp(hdr, iq_magic, sizeof(iq_magic))
+            || hdr[8] != IQ_CODEC_VERSION
+            || (hdr[9] != 2 && hdr[9] != 4)) {
+        return NULL;
+    }
+    uint32_t block_samples = get_u32(&hdr[12]);
+    if (!block_samples || block_samples > IQ_MAX_BLOCK_SAMPLES)
+        return NULL;
+
+    iq_decoder_t *dec = calloc(1, sizeof(*dec));
+    if (!dec) {
+        WARN_CALLOC("iq_decoder_open()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    dec->file             = file;
+    dec->sample_size      = hdr[9];
+    dec->block_samples    = block_samples;
+    dec->sample_rate      = get_u32(&hdr[16]);
+    dec->center_frequency = get_u32(&hdr[20]);
+
+    dec->batches = calloc(2, sizeof(*dec->batches));
+    if (!dec->batches) {
+        WARN_CALLOC("iq_decoder_open()");
+        free(dec);
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    for (int b = 0; b < 2; ++b) {
+        iq_decode_batch_t *batch = &dec->batches[b];
+        batch->max_samples = block_samples;
+        for (unsigned i = 0; i < IQ_DECODER_THREADS; ++i) {
+            batch->workers[i].batch = batch;
+            batch->workers[i].first = i;
+        }
+        for (unsigned i = 0; i < IQ_DECODER_BATCH; ++i) {
+            iq_decode_job_t *job = &batch->jobs[i];
+            job->out = malloc((size_t)block_samples * dec->sample_size);
+            if (!job->out) {
+                WARN_MALLOC("iq_decoder_open()");
+                iq_decoder_close(dec);
+                return NULL; // NOTE: returns NULL on alloc failure.
+            }
+        }
+    }
+    // start with the first batch consumed
+    dec->cur = 0;
+
+    return dec;
+}
+
+/// Read the next blocks into a batch and start decoding them.
+static void iq_decode_batch_start(iq_decoder_t *dec, iq_decode_batch_t *batch)
+{
+    batch->count = 0;
+    while (!dec->eof && batch->count < IQ_DECODER_BATCH) {
+        iq_decode_job_t *job = &batch->jobs[batch->count];
+        uint8_t hdr[IQ_CODEC_BLOCK_HEADER_SIZE];
+        size_t n = fread(hdr, 1, sizeof(hdr), dec->file);
+        if (n != sizeof(hdr)) {
+            dec->eof   = 1;
+            dec->error = n != 0;
+            break;
+        }
+        size_t len = IQ_CODEC_BLOCK_HEADER_SIZE + (size_t)get_u32(&hdr[8]);
+        if (len > iq_encode_bound(dec->block_samples, dec->sample_size)) {
+            dec->eof   = 1;
+            dec->error = 1;
+            break;
+        }
+        if (job->in_size < len) {
+            uint8_t *in = realloc(job->in, len);
+            if (!in) {
+                WARN_REALLOC("iq_decode_batch_start()");
+                dec->eof   = 1;
+                dec->error = 1;
+                break;
+            }
+            job->in      = in;
+            job->in_size = len;
+        }
+        memcpy(job->in, hdr, sizeof(hdr));
+        if (fread(job->in + sizeof(hdr), 1, len - sizeof(hdr), dec->file) != len - sizeof(hdr)) {
+            dec->eof   = 1;
+            dec->error = 1;
+            break;
+        }
+        job->in_len = len;
+        batch->count++;
+    }
+
+    for (unsigned i = 0; i < IQ_DECODER_THREADS; ++i) {
+        iq_decode_worker_t *worker = &batch->workers[i];
+        if (worker->first >= batch->count)
+            continue;
+#ifdef THREADS
+        worker->running = !pthread_create(&worker->thread, NULL, iq_decode_worker_thread, worker);
+        if (worker->running)
+            continue;
+#endif
+        iq_decode_worker_run(worker);
+    }
+}
+
+static void iq_decode_batch_wait(iq_decode_batch_t *batch)
+{
+#ifdef THREADS
+    for (unsigned i = 0; i < IQ_DECODER_THREADS; ++i) {
+        iq_decode_worker_t *worker = &batch->workers[i];
+        if (worker->running)
+            pthread_join(worker->thread, NULL);
+        worker->running = 0;
+    }
+#else
+    (void)batch;
+#endif
+}
+
+long iq_decoder_read(iq_decoder_t *dec, uint8_t const **buf)
+{
+    iq_decode_batch_t *batch = &dec->batches[dec->cur];
+    if (dec->next >= batch->count) {
+        iq_decode_batch_t *pending = &dec->batches[!dec->cur];
+        // the first batch was not started ahead
+        if (!pending->count && !dec->eof)
+            iq_decode_batch_start(dec, pending);
+        iq_decode_batch_wait(pending);
+        if (!pending->count)
+            return dec->error ? -1 : 0;
+
+        // decode ahead into the consumed batch
+        dec->cur  = !dec->cur;
+        dec->next = 0;
+        batch->count = 0;
+        iq_decode_batch_start(dec, batch);
+        batch = pending;
+    }
+
+    iq_decode_job_t *job = &batch->jobs[dec->next++];
+    if (job->samples < 0) {
+        dec->error = 1;
+        return -1;
+    }
+    *buf = job->out;
+    return (long)job->samples * dec->sample_size;
+}
+
+void iq_decoder_close(iq_decoder_t *dec)
+{
+    if (!dec)
+        return;
+
+    for (int b = 0; b < 2; ++b) {
+        iq_decode_batch_t *batch = &dec->batches[b];
+        iq_decode_batch_wait(batch);
+        for (unsigned i = 0; i < IQ_DECODER_BATCH; ++i) {
+            free(batch->jobs[i].in);
+            free(batch->jobs[i].out);
+        }
+    }
+    free(dec->batches);
+    free(dec);
+}
+
+#ifdef _TEST
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %s:%d: %s <> %s\n", __FILE__, __LINE__, #a, #b); \
+        } \
+    } while (0)
+
+static uint32_t test_rng = 1;
+
+static uint32_t test_random(void)
+{
+    test_rng ^= test_rng << 13;
+    test_rng ^= test_rng >> 17;
+    test_rng ^= test_rng << 5;
+    return test_rng;
+}
+
+/// Noise around the mid level with a burst of a strong carrier and some full scale edges.
+static void test_fill(uint8_t *buf, unsigned n_samples, int sample_size)
+{
+    for (unsigned i = 0; i < n_samples * 2; ++i) {
+        int noise = (int)(test_random() % 7) - 3;
+        int burst = (i / 2) % 5000 < 1000 ? ((i / 2) % 16 < 8 ? 100 : -100) : 0;
+        int v     = noise + burst;
+        if (i % 9973 == 0)
+            v = i % 2 ? 127 : -128;
+        if (sample_size == 2) {
+            buf[i] = (uint8_t)(v + 128);
+        }
+        else {
+            int w = v * 256 + (int)(test_random() % 64) - 32;
+            ((int16_t *)buf)[i] = (int16_t)(w < INT16_MIN ? INT16_MIN : w > INT16_MAX ? INT16_MAX : w);
+        }
+    }
+}
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+
+    fprintf(stderr, "iq_codec:: test\n");
+
+    unsigned const n_max = 3 * IQ_CODEC_BLOCK_SAMPLES + 12345;
+    uint8_t *in = malloc((size_t)n_max * 4);
+    if (!in)
+        FATAL_MALLOC("main()");
+    uint8_t *out = malloc((size_t)n_max * 4);
+    if (!out)
+        FATAL_MALLOC("main()");
+    uint8_t *enc = malloc(iq_encode_bound(IQ_CODEC_BLOCK_SAMPLES, 4));
+    if (!enc)
+        FATAL_MALLOC("main()");
+
+    for (int sample_size = 2; sample_size <= 4; sample_size += 2) {
+        // a single block with a short last sub-block
+        unsigned n = 10007;
+        test_fill(in, n, sample_size);
+        size_t len = iq_encode_block(in, n, sample_size, enc);
+        ASSERT_EQUALS(enc[0], IQ_BLOCK_RICE);
+        ASSERT_EQUALS(len < (size_t)n * sample_size * 7 / 8, 1);
+        ASSERT_EQUALS(iq_decode_block(enc, len, out, n), (int)n);
+        ASSERT_EQUALS(memcmp(in, out, (size_t)n * sample_size), 0);
+        // truncated and too small
+        ASSERT_EQUALS(iq_decode_block(enc, len - 1, out, n), -1);
+        ASSERT_EQUALS(iq_decode_block(enc, len, out, n - 1), -1);
+
+        // 12 bit samples, the common low zero bits are shifted out
+        if (sample_size == 4) {
+            for (unsigned i = 0; i < n * 2; ++i)
+                ((int16_t *)in)[i] = (int16_t)(((int)(test_random() % 4096) - 2048) * 16);
+            len = iq_encode_block(in, n, sample_size, enc);
+            ASSERT_EQUALS(enc[0], IQ_BLOCK_RICE);
+            ASSERT_EQUALS(enc[2], 4);
+            ASSERT_EQUALS(iq_decode_block(enc, len, out, n), (int)n);
+            ASSERT_EQUALS(memcmp(in, out, (size_t)n * sample_size), 0);
+        }
+
+        // white noise is stored
+        for (unsigned i = 0; i < n * sample_size; ++i)
+            in[i] = (uint8_t)test_random();
+        len = iq_encode_block(in, n, sample_size, enc);
+        ASSERT_EQUALS(enc[0], IQ_BLOCK_STORED);
+        ASSERT_EQUALS(iq_decode_block(enc, len, out, n), (int)n);
+        ASSERT_EQUALS(memcmp(in, out, (size_t)n * sample_size), 0);
+
+        // a stream of odd sized writes through a file
+        test_fill(in, n_max, sample_size);
+        FILE *file = tmpfile();
+        ASSERT_EQUALS(file != NULL, 1);
+        if (!file)
+            break;
+        iq_encoder_t *e = iq_encoder_create(file, sample_size);
+        ASSERT_EQUALS(e != NULL, 1);
+        for (size_t pos = 0; pos < (size_t)n_max * sample_size;) {
+            size_t chunk = 1000 * sample_size + test_random() % 300000;
+            if (chunk > (size_t)n_max * sample_size - pos)
+                chunk = (size_t)n_max * sample_size - pos;
+            ASSERT_EQUALS(iq_encoder_write(e, &in[pos], chunk, 250000, 433920000), 0);
+            pos += chunk;
+        }
+        ASSERT_EQUALS(iq_encoder_close(e), 0);
+        long file_len = ftell(file);
+        rewind(file);
+
+        iq_decoder_t *d = iq_decoder_open(file);
+        ASSERT_EQUALS(d != NULL, 1);
+        if (!d)
+            break;
+        ASSERT_EQUALS(d->sample_size, sample_size);
+        ASSERT_EQUALS(d->sample_rate, 250000);
+        ASSERT_EQUALS(d->center_frequency, 433920000);
+        size_t pos = 0;
+        long r;
+        uint8_t const *buf;
+        while ((r = iq_decoder_read(d, &buf)) > 0) {
+            if (pos + r <= (size_t)n_max * sample_size)
+                memcpy(&out[pos], buf, r);
+            pos += r;
+        }
+        ASSERT_EQUALS(r, 0);
+        ASSERT_EQUALS(pos, (size_t)n_max * sample_size);
+        ASSERT_EQUALS(memcmp(in, out, (size_t)n_max * sample_size), 0);
+        iq_decoder_close(d);
+
+        // a truncated stream decodes the complete blocks, then fails
+        rewind(file);
+        uint8_t *copy = malloc(file_len);
+        if (!copy)
+            FATAL_MALLOC("main()");
+        ASSERT_EQUALS(fread(copy, 1, file_len, file), (size_t)file_len);
+        fclose(file);
+        file = tmpfile();
+        fwrite(copy, 1, file_len - 100, file);
+        free(copy);
+        rewind(file);
+        d = iq_decoder_open(file);
+        ASSERT_EQUALS(d != NULL, 1);
+        pos = 0;
+        while ((r = iq_decoder_read(d, &buf)) > 0)
+            pos += r;
+        ASSERT_EQUALS(r, -1);
+        ASSERT_EQUALS(pos, (size_t)3 * IQ_CODEC_BLOCK_SAMPLES * sample_size);
+        iq_decoder_close(d);
+        fclose(file);
+    }
+
+    free(enc);
+    free(out);
+    free(in);
+    fprintf(stderr, "iq_codec:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+    return failed;
+}
+#endif /* _TEST */
@@ -0,0 +1,846 @@
+/** @file
+    IQ stream server, fans out the acquisition buffers to rtl_tcp clients.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+/*
+    Each acquisition buffer is put into a shared block once, converted to CU8
+    if needed, and a reference to the block is queued to every client.
+    Buffers read into a block lent with iq_server_get_buffer() are not copied.
+
+    Every client has a ring of block references (single producer, the SDR
+    thread, and single consumer, the server thread). If a client does not keep
+    up its ring fills and further blocks are dropped and counted for that client
+    only, the SDR thread never waits on a client.
+
+    A block is free again when the last client sent it. Commands from clients
+    are read and counted but not applied, all clients share the tuning of the
+    local receiver.
+
+    Stats are written by the server and SDR threads and read by others, all
+    counters are updated atomically. Totals are counted as they happen, never
+    folded in from a closing client, so they only grow.
+*/
+
+#include "iq_server.h"
+#include "spsc_queue.h"
+#include "compat_pthread.h"
+#include "optparse.h"
+#include "data.h"
+#include "list.h"
+#include "metrics.h"
+#include "fatal.h"
+#include "r_util.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "mongoose.h"
+
+#ifndef _WIN32
+#include <signal.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#define IQ_SERVER_POLL_MS 100 // poll timeout, the SDR thread wakes us up on new blocks
+#define IQ_SERVER_MIN_BLOCK 16384
+
+// exported by mongoose.c but not declared in mongoose.h
+void mg_set_non_blocking_mode(sock_t sock);
+
+/// A shared sample block, free when no references are held.
+typedef struct iq_block {
+    unsigned refs;              ///< lender or pusher and queued references
+    uint32_t len;               ///< bytes used
+    uint32_t size;              ///< bytes allocated
+    unsigned char *data;
+} iq_block_t;
+
+typedef struct iq_client {
+    unsigned active;            ///< set by the server thread, read by the SDR thread
+    unsigned pushing;           ///< set by the SDR thread while queueing
+    spsc_queue_t *ring;         ///< iq_block_t pointers to send
+    // server thread only
+    sock_t sock;
+    iq_block_t *sending;
+    uint32_t offset;
+    unsigned char cmd[5];
+    unsigned cmd_len;
+    char addr[64];
+    // stats, atomic
+    uint64_t sent_bytes;
+    unsigned sent_blocks;
+    uint64_t dropped_bytes;     ///< written by the SDR thread
+    unsigned dropped_blocks;    ///< written by the SDR thread
+    unsigned commands;
+    unsigned max_queued;
+} iq_client_t;
+
+struct iq_server {
+    sock_t listener;
+    sock_t wake[2];             ///< written by the SDR thread, read by the server loop
+    unsigned port;
+    int verbosity;
+    unsigned stop;
+    int threaded;
+#ifdef THREADS
+    pthread_t thread;
+#endif
+
+    unsigned max_clients;
+    iq_client_t *clients;
+
+    // SDR thread only
+    unsigned max_blocks;
+    unsigned num_blocks;
+    iq_block_t *blocks;
+    unsigned next_free;         ///< free block scan start
+    iq_block_t *lent;           ///< block lent by iq_server_get_buffer() and not pushed yet
+
+    // stats, atomic
+    unsigned stat_accepted;
+    unsigned stat_rejected;
+    unsigned stat_blocks;
+    unsigned stat_retained;     ///< pushed without a copy
+    unsigned stat_overruns;     ///< pushes dropped with no free block
+    uint64_t stat_sent_bytes;   ///< of all clients
+    uint64_t stat_dropped_bytes; ///< of all clients
+    unsigned stat_dropped_blocks; ///< of all clients
+};
+
+#pragma pack(push, 1)
+struct rtl_tcp_info {
+    char magic[4];             // "RTL0"
+    uint32_t tuner_number;     // big endian
+    uint32_t tuner_gain_count; // big endian
+};
+#pragma pack(pop)
+
+static int would_block(void)
+{
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+/* block pool, SDR thread */
+
+static void block_release(iq_block_t *blk)
+{
+    atomic_sub_fetch_seq(&blk->refs, 1);
+}
+
+/// Take a free block of at least @p len bytes, a reference is held for the caller.
+static iq_block_t *block_take(struct iq_server *srv, uint32_t len)
+{
+    iq_block_t *blk = NULL;
+    for (unsigned i = 0; i < srv->num_blocks; ++i) {
+        unsigned idx = (srv->next_free + i) % srv->num_blocks;
+        if (atomic_load_acquire(&srv->blocks[idx].refs) == 0) {
+            blk            = &srv->blocks[idx];
+            srv->next_free = (idx + 1) % srv->num_blocks;
+            break;
+        }
+    }
+    if (!blk && srv->num_blocks < srv->max_blocks) {
+        blk = &srv->blocks[srv->num_blocks++];
+    }
+    if (!blk)
+        return NULL;
+
+    if (blk->size < len) {
+        uint32_t size = len < IQ_SERVER_MIN_BLOCK ? IQ_SERVER_MIN_BLOCK : len;
+        unsigned char *data = realloc(blk->data, size);
+        if (!data) {
+            WARN_REALLOC("block_take()");
+            return NULL;
+        }
+        blk->data = data;
+        blk->size = size;
+    }
+    blk->len = 0;
+    atomic_store_release(&blk->refs, 1);
+    return blk;
+}
+
+/* clients, server thread */
+
+static void client_close(struct iq_server *srv, iq_client_t *c)
+{
+    // stop the SDR thread from queueing, then wait for a push in progress
+    atomic_exchange_seq(&c->active, 0);
+    atomic_fence_seq();
+    while (atomic_load_acquire(&c->pushing)) {
+        // the SDR thread is queueing a block
+    }
+
+    iq_block_t *blk;
+    if (c->sending)
+        block_release(c->sending);
+    c->sending = NULL;
+    while (spsc_queue_pop(c->ring, &blk))
+        block_release(blk);
+
+    closesocket(c->sock);
+    c->sock = INVALID_SOCKET;
+
+    if (srv->verbosity)
+        fprintf(stderr, "rtl_tcp client %s disconnected, %.0f bytes sent, %u blocks dropped\n",
+                c->addr, (double)atomic_load_acquire64(&c->sent_bytes), atomic_load_acquire(&c->dropped_blocks));
+}
+
+static void client_accept(struct iq_server *srv)
+{
+    struct sockaddr_storage sa;
+    socklen_t sa_len = sizeof(sa);
+    sock_t sock = accept(srv->listener, (struct sockaddr *)&sa, &sa_len);
+    if (sock == INVALID_SOCKET)
+        return;
+
+    iq_client_t *c = NULL;
+    for (unsigned i = 0; i < srv->max_clients; ++i) {
+        if (srv->clients[i].sock == INVALID_SOCKET) {
+            c = &srv->clients[i];
+            break;
+        }
+    }
+    if (!c) {
+        atomic_add_fetch_seq(&srv->stat_rejected, 1);
+        closesocket(sock);
+        return;
+    }
+
+    memset(c->cmd, 0, sizeof(c->cmd));
+    c->cmd_len        = 0;
+    c->offset         = 0;
+    c->sent_bytes     = 0;
+    c->sent_blocks    = 0;
+    c->dropped_bytes  = 0;
+    c->dropped_blocks = 0;
+    c->commands       = 0;
+    c->max_queued     = 0;
+    c->sock           = sock;
+    if (getnameinfo((struct sockaddr *)&sa, sa_len, c->addr, sizeof(c->addr), NULL, 0, NI_NUMERICHOST))
+        snprintf(c->addr, sizeof(c->addr), "unknown");
+    atomic_add_fetch_seq(&srv->stat_accepted, 1);
+
+    // activate before the header, samples queued meanwhile are sent after it
+    atomic_store_release(&c->active, 1);
+
+    struct rtl_tcp_info info = {
+            .magic            = {'R', 'T', 'L', '0'},
+            .tuner_number     = htonl(0), // unknown, tuning commands are not applied
+            .tuner_gain_count = htonl(0),
+    };
+    // a new socket has an empty send buffer, the header is sent in full
+    if (send(sock, (char const *)&info, sizeof(info), MSG_NOSIGNAL) != sizeof(info)) {
+        client_close(srv, c);
+        return;
+    }
+    mg_set_non_blocking_mode(sock);
+
+    if (srv->verbosity)
+        fprintf(stderr, "rtl_tcp client %s connected\n", c->addr);
+}
+
+/// Read and count commands, returns -1 if the client closed.
+static int client_recv(struct iq_server *srv, iq_client_t *c)
+{
+    for (;;) {
+        int r = recv(c->sock, (char *)&c->cmd[c->cmd_len], sizeof(c->cmd) - c->cmd_len, 0);
+        if (r == 0)
+            return -1;
+        if (r < 0)
+            return would_block() ? 0 : -1;
+        c->cmd_len += r;
+        if (c->cmd_len == sizeof(c->cmd)) {
+            atomic_add_fetch_seq(&c->commands, 1);
+            if (srv->verbosity > 1) {
+                unsigned param = (unsigned)c->cmd[1] << 24 | c->cmd[2] << 16 | c->cmd[3] << 8 | c->cmd[4];
+                fprintf(stderr, "rtl_tcp client %s command 0x%02x (%u) ignored\n", c->addr, c->cmd[0], param);
+            }
+            c->cmd_len = 0;
+        }
+    }
+}
+
+/// Send queued blocks until the socket is full, returns -1 on error.
+static int client_send(struct iq_server *srv, iq_client_t *c)
+{
+    for (;;) {
+        if (!c->sending) {
+            unsigned queued = spsc_queue_len(c->ring);
+            if (queued > atomic_load_acquire(&c->max_queued))
+                atomic_store_release(&c->max_queued, queued);
+            if (!spsc_queue_pop(c->ring, &c->sending))
+                return 0;
+            c->offset = 0;
+        }
+        iq_block_t *blk = c->sending;
+        int r = send(c->sock, (char const *)&blk->data[c->offset], blk->len - c->offset, MSG_NOSIGNAL);
+        if (r < 0)
+            return would_block() ? 0 : -1;
+        c->offset += r;
+        atomic_add_fetch_seq64(&c->sent_bytes, (uint64_t)r);
+        atomic_add_fetch_seq64(&srv->stat_sent_bytes, (uint64_t)r);
+        if (c->offset == blk->len) {
+            atomic_add_fetch_seq(&c->sent_blocks, 1);
+            c->sending = NULL;
+            block_release(blk);
+        }
+    }
+}
+
+/// Accept clients, read commands and send blocks, waits up to @p timeout_ms for activity.
+static void iq_server_poll(struct iq_server *srv, int timeout_ms)
+{
+    fd_set read_set, write_set;
+    FD_ZERO(&read_set);
+    FD_ZERO(&write_set);
+    sock_t max_fd = srv->listener;
+    FD_SET(srv->listener, &read_set);
+    if (srv->threaded) {
+        FD_SET(srv->wake[1], &read_set);
+        if (srv->wake[1] > max_fd)
+            max_fd = srv->wake[1];
+    }
+    for (unsigned i = 0; i < srv->max_clients; ++i) {
+        iq_client_t *c = &srv->clients[i];
+        if (c->sock == INVALID_SOCKET)
+            continue;
+        FD_SET(c->sock, &read_set);
+        if (c->sending || spsc_queue_len(c->ring))
+            FD_SET(c->sock, &write_set);
+        if (c->sock > max_fd)
+            max_fd = c->sock;
+    }
+
+    struct timeval tv = {timeout_ms / 1000, timeout_ms % 1000 * 1000};
+    int n = select((int)max_fd + 1, &read_set, &write_set, NULL, &tv);
+    if (n <= 0)
+        return;
+
+    if (srv->threaded && FD_ISSET(srv->wake[1], &read_set)) {
+        char buf[64];
+        while (recv(srv->wake[1], buf, sizeof(buf), 0) > 0) {
+            // the wake up data carries no information, blocks are in the rings
+        }
+    }
+
+    for (unsigned i = 0; i < srv->max_clients; ++i) {
+        iq_client_t *c = &srv->clients[i];
+        if (c->sock == INVALID_SOCKET)
+            continue;
+        if (FD_ISSET(c->sock, &read_set) && client_recv(srv, c) < 0) {
+            client_close(srv, c);
+            continue;
+        }
+        // try to send to every client, blocks might have been queued after the select
+        if (client_send(srv, c) < 0)
+            client_close(srv, c);
+    }
+
+    if (FD_ISSET(srv->listener, &read_set))
+        client_accept(srv);
+}
+
+#ifdef THREADS
+static THREAD_RETURN THREAD_CALL iq_server_run(void *arg)
+{
+    struct iq_server *srv = arg;
+
+#ifndef _WIN32
+    // signals are handled by the SDR thread
+    sigset_t sigset;
+    sigfillset(&sigset);
+    pthread_sigmask(SIG_BLOCK, &sigset, NULL);
+#endif
+
+    while (!atomic_load_acquire(&srv->stop)) {
+        iq_server_poll(srv, IQ_SERVER_POLL_MS);
+    }
+
+    return (THREAD_RETURN)0;
+}
+#endif
+
+static sock_t iq_server_listen(char const *host, char const *port, unsigned *bound_port)
+{
+    struct addrinfo hints, *res, *res0;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = PF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags    = AI_PASSIVE;
+
+    int ret = getaddrinfo(host, port, &hints, &res0);
+    if (ret) {
+        fprintf(stderr, "%s\n", gai_strerror(ret));
+        return INVALID_SOCKET;
+    }
+    sock_t sock = INVALID_SOCKET;
+    for (res = res0; res; res = res->ai_next) {
+        sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+        if (sock == INVALID_SOCKET)
+            continue;
+        int const value_one = 1;
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (char const *)&value_one, sizeof(value_one));
+        if (bind(sock, res->ai_addr, (socklen_t)res->ai_addrlen) == 0 && listen(sock, 4) == 0)
+            break; // success
+        closesocket(sock);
+        sock = INVALID_SOCKET;
+    }
+    freeaddrinfo(res0);
+    if (sock == INVALID_SOCKET) {
+        perror("rtl_tcp server");
+        return INVALID_SOCKET;
+    }
+
+    struct sockaddr_storage sa;
+    socklen_t sa_len = sizeof(sa);
+    *bound_port = 0;
+    if (getsockname(sock, (struct sockaddr *)&sa, &sa_len) == 0) {
+        if (sa.ss_family == AF_INET)
+            *bound_port = ntohs(((struct sockaddr_in *)&sa)->sin_port);
+        else if (sa.ss_family == AF_INET6)
+            *bound_port = ntohs(((struct sockaddr_in6 *)&sa)->sin6_port);
+    }
+    mg_set_non_blocking_mode(sock);
+    return sock;
+}
+
+struct iq_server *iq_server_start(char const *host, char const *port, char *opts, int verbosity)
+{
+    unsigned ring        = IQ_SERVER_RING;
+    unsigned max_clients = IQ_SERVER_MAX_CLIENTS;
+
+    char *key, *val;
+    while (getkwargs(&opts, &key, &val)) {
+        key = remove_ws(key);
+        val = trim_ws(val);
+        if (!key || !*key)
+            continue;
+        else if (!strcasecmp(key, "ring"))
+            ring = atouint32_metric(val, "ring= ");
+        else if (!strcasecmp(key, "clients"))
+            max_clients = atouint32_metric(val, "clients= ");
+        else {
+            fprintf(stderr, "Invalid key \"%s\" option.\n", key);
+            return NULL;
+        }
+    }
+    if (ring < 2 || max_clients < 1 || max_clients > FD_SETSIZE - 2) {
+        fprintf(stderr, "rtl_tcp server needs a ring of 2 or more blocks and 1 to %d clients.\n", FD_SETSIZE - 2);
+        return NULL;
+    }
+
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        perror("WSAStartup()");
+        return NULL;
+    }
+#endif
+
+    struct iq_server *srv = calloc(1, sizeof(*srv));
+    if (!srv) {
+        WARN_CALLOC("iq_server_start()");
+        return NULL;
+    }
+    srv->verbosity   = verbosity;
+    srv->max_clients = max_clients;
+    // every client holds up to a ring and one block being sent, plus a lent and a pushed block
+    srv->max_blocks  = max_clients * (ring + 1) + 2;
+    srv->wake[0]     = INVALID_SOCKET;
+    srv->wake[1]     = INVALID_SOCKET;
+
+    srv->clients = calloc(max_clients, sizeof(*srv->clients));
+    if (!srv->clients) {
+        WARN_CALLOC("iq_server_start()");
+        goto fail;
+    }
+    for (unsigned i = 0; i < max_clients; ++i)
+        srv->clients[i].sock = INVALID_SOCKET;
+    srv->blocks = calloc(srv->max_blocks, sizeof(*srv->blocks));
+    if (!srv->blocks) {
+        WARN_CALLOC("iq_server_start()");
+        goto fail;
+    }
+    for (unsigned i = 0; i < max_clients; ++i) {
+        srv->clients[i].ring = spsc_queue_create(ring, sizeof(iq_block_t *));
+        if (!srv->clients[i].ring)
+            goto fail;
+    }
+
+    srv->listener = iq_server_listen(host, port, &srv->port);
+    if (srv->listener == INVALID_SOCKET)
+        goto fail;
+
+#ifdef THREADS
+    if (!mg_socketpair(srv->wake, SOCK_DGRAM)) {
+        fprintf(stderr, "Failed to create the rtl_tcp server wake up socket.\n");
+        goto fail;
+    }
+    mg_set_non_blocking_mode(srv->wake[0]);
+    mg_set_non_blocking_mode(srv->wake[1]);
+    srv->threaded = 1;
+    if (pthread_create(&srv->thread, NULL, iq_server_run, srv)) {
+        fprintf(stderr, "Failed to start the rtl_tcp server thread.\n");
+        srv->threaded = 0;
+        goto fail;
+    }
+#endif
+
+    return srv;
+
+fail:
+    iq_server_stop(srv);
+    return NULL;
+}
+
+void iq_server_stop(struct iq_server *srv)
+{
+    if (!srv)
+        return;
+
+#ifdef THREADS
+    if (srv->threaded) {
+        atomic_store_release(&srv->stop, 1);
+        send(srv->wake[0], "", 1, 0);
+        pthread_join(srv->thread, NULL);
+    }
+#endif
+
+    for (unsigned i = 0; srv->clients && i < srv->max_clients; ++i) {
+        if (srv->clients[i].sock != INVALID_SOCKET)
+            client_close(srv, &srv->clients[i]);
+        spsc_queue_free(srv->clients[i].ring);
+    }
+    if (srv->listener != INVALID_SOCKET && srv->listener != 0)
+        closesocket(srv->listener);
+    if (srv->wake[0] != INVALID_SOCKET)
+        closesocket(srv->wake[0]);
+    if (srv->wake[1] != INVALID_SOCKET)
+        closesocket(srv->wake[1]);
+    for (unsigned i = 0; srv->blocks && i < srv->num_blocks; ++i)
+        free(srv->blocks[i].data);
+    free(srv->blocks);
+    free(srv->clients);
+    free(srv);
+}
+
+unsigned iq_server_port(struct iq_server *srv)
+{
+    return srv->port;
+}
+
+unsigned char *iq_server_get_buffer(struct iq_server *srv, uint32_t len)
+{
+    // a block lent but not pushed, e.g. after a failed read, is lent again
+    if (srv->lent && srv->lent->size >= len)
+        return srv->lent->data;
+    if (srv->lent)
+        block_release(srv->lent);
+
+    srv->lent = block_take(srv, len);
+    return srv->lent ? srv->lent->data : NULL;
+}
+
+void iq_server_push(struct iq_server *srv, unsigned char const *buf, uint32_t len, int sample_size)
+{
+    uint32_t out_len = sample_size == 4 ? len / 2 : len;
+    iq_block_t *blk;
+    if (srv->lent && buf == srv->lent->data && sample_size == 2) {
+        blk       = srv->lent; // the lender reference is passed on
+        srv->lent = NULL;
+        atomic_add_fetch_seq(&srv->stat_retained, 1);
+    }
+    else {
+        blk = block_take(srv, out_len);
+        if (!blk) {
+            atomic_add_fetch_seq(&srv->stat_overruns, 1);
+            if (!srv->threaded)
+                iq_server_poll(srv, 0);
+            return;
+        }
+        if (sample_size == 4) {
+            int16_t const *s16 = (int16_t const *)buf;
+            for (uint32_t i = 0; i < out_len; ++i)
+                blk->data[i] = (unsigned char)((s16[i] + 32768) >> 8);
+        }
+        else {
+            memcpy(blk->data, buf, len);
+        }
+    }
+    blk->len = out_len;
+    atomic_add_fetch_seq(&srv->stat_blocks, 1);
+
+    for (unsigned i = 0; i < srv->max_clients; ++i) {
+        iq_client_t *c = &srv->clients[i];
+        // announce the push, the server thread waits for it before a client is closed
+        atomic_exchange_seq(&c->pushing, 1);
+        atomic_fence_seq();
+        if (atomic_load_acquire(&c->active)) {
+            atomic_add_fetch_seq(&blk->refs, 1);
+            if (!spsc_queue_push(c->ring, &blk)) {
+                block_release(blk);
+                atomic_add_fetch_seq(&c->dropped_blocks, 1);
+                atomic_add_fetch_seq64(&c->dropped_bytes, (uint64_t)out_len);
+                atomic_add_fetch_seq(&srv->stat_dropped_blocks, 1);
+                atomic_add_fetch_seq64(&srv->stat_dropped_bytes, (uint64_t)out_len);
+            }
+        }
+        atomic_store_release(&c->pushing, 0);
+    }
+    block_release(blk);
+
+    if (srv->threaded)
+        send(srv->wake[0], "", 1, 0); // a failed send means a wake up is pending anyway
+    else
+        iq_server_poll(srv, 0);
+}
+
+data_t *iq_server_stats(struct iq_server *srv)
+{
+    list_t client_data_list = {0};
+    unsigned clients = 0;
+    for (unsigned i = 0; i < srv->max_clients; ++i) {
+        iq_client_t *c = &srv->clients[i];
+        if (!atomic_load_acquire(&c->active))
+            continue;
+        clients++;
+        list_push(&client_data_list, data_make(
+                "addr",             "", DATA_STRING, c->addr,
+                "queued",           "", DATA_INT, spsc_queue_len(c->ring),
+                "max_queued",       "", DATA_INT, atomic_load_acquire(&c->max_queued),
+                "sent_blocks",      "", DATA_INT, atomic_load_acquire(&c->sent_blocks),
+                "sent_bytes",       "", DATA_DOUBLE, (double)atomic_load_acquire64(&c->sent_bytes),
+                "dropped_blocks",   "", DATA_INT, atomic_load_acquire(&c->dropped_blocks),
+                "dropped_bytes",    "", DATA_DOUBLE, (double)atomic_load_acquire64(&c->dropped_bytes),
+                "commands",         "", DATA_INT, atomic_load_acquire(&c->commands),
+                NULL));
+    }
+
+    data_t *data = data_make(
+            "port",             "", DATA_INT, srv->port,
+            "clients",          "", DATA_INT, clients,
+            "accepted",         "", DATA_INT, atomic_load_acquire(&srv->stat_accepted),
+            "rejected",         "", DATA_INT, atomic_load_acquire(&srv->stat_rejected),
+            "blocks",           "", DATA_INT, atomic_load_acquire(&srv->stat_blocks),
+            "retained",         "", DATA_INT, atomic_load_acquire(&srv->stat_retained),
+            "overruns",         "", DATA_INT, atomic_load_acquire(&srv->stat_overruns),
+            "sent_bytes",       "", DATA_DOUBLE, (double)atomic_load_acquire64(&srv->stat_sent_bytes),
+            "dropped_blocks",   "", DATA_INT, atomic_load_acquire(&srv->stat_dropped_blocks),
+            "dropped_bytes",    "", DATA_DOUBLE, (double)atomic_load_acquire64(&srv->stat_dropped_bytes),
+            "connections",      "", DATA_COND, client_data_list.len > 0, DATA_ARRAY, data_array(client_data_list.len, DATA_DATA, client_data_list.elems),
+            NULL);
+    list_free_elems(&client_data_list, NULL);
+    return data;
+}
+
+static double iq_server_clients(void *ctx)
+{
+    struct iq_server *srv = ctx;
+    unsigned clients = 0;
+    for (unsigned i = 0; i < srv->max_clients; ++i)
+        clients += atomic_load_acquire(&srv->clients[i].active) ? 1 : 0;
+    return clients;
+}
+
+static double iq_server_sent_bytes(void *ctx)
+{
+    struct iq_server *srv = ctx;
+    return (double)atomic_load_acquire64(&srv->stat_sent_bytes);
+}
+
+static double iq_server_dropped_bytes(void *ctx)
+{
+    struct iq_server *srv = ctx;
+    return (double)atomic_load_acquire64(&srv->stat_dropped_bytes);
+}
+
+void iq_server_metrics(struct iq_server *srv, metrics_t *metrics)
+{
+    metric_family_t *family;
+    family = metrics_family(metrics, "rtl_433_iq_server_clients", "Connected rtl_tcp clients.", METRIC_GAUGE);
+    metric_add_fn(family, NULL, iq_server_clients, srv);
+    family = metrics_family(metrics, "rtl_433_iq_server_accepted_total", "rtl_tcp clients accepted.", METRIC_COUNTER);
+    metric_add_unsigned(family, NULL, &srv->stat_accepted);
+    family = metrics_family(metrics, "rtl_433_iq_server_rejected_total", "rtl_tcp clients rejected with all slots in use.", METRIC_COUNTER);
+    metric_add_unsigned(family, NULL, &srv->stat_rejected);
+    family = metrics_family(metrics, "rtl_433_iq_server_blocks_total", "Sample blocks queued to the rtl_tcp clients.", METRIC_COUNTER);
+    metric_add_unsigned(family, NULL, &srv->stat_blocks);
+    family = metrics_family(metrics, "rtl_433_iq_server_overruns_total", "Sample blocks dropped with no free shared block.", METRIC_COUNTER);
+    metric_add_unsigned(family, NULL, &srv->stat_overruns);
+    family = metrics_family(metrics, "rtl_433_iq_server_sent_bytes_total", "Sample bytes sent to the rtl_tcp clients.", METRIC_COUNTER);
+    metric_add_fn(family, NULL, iq_server_sent_bytes, srv);
+    family = metrics_family(metrics, "rtl_433_iq_server_dropped_bytes_total", "Sample bytes dropped for slow rtl_tcp clients.", METRIC_COUNTER);
+    metric_add_fn(family, NULL, iq_server_dropped_bytes, srv);
+}
+
+#ifdef _TEST
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %s:%d: %s <> %s\n", __FILE__, __LINE__, #a, #b); \
+        } \
+    } while (0)
+
+static sock_t test_connect(unsigned port)
+{
+    char port_str[8];
+    snprintf(port_str, sizeof(port_str), "%u", port);
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo("127.0.0.1", port_str, &hints, &res))
+        return INVALID_SOCKET;
+    sock_t sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (sock != INVALID_SOCKET && connect(sock, res->ai_addr, (socklen_t)res->ai_addrlen)) {
+        closesocket(sock);
+        sock = INVALID_SOCKET;
+    }
+    freeaddrinfo(res);
+    return sock;
+}
+
+/// Receive exactly @p len bytes, returns 0 on a short read.
+static int test_recv(sock_t sock, unsigned char *buf, unsigned len)
+{
+    unsigned n = 0;
+    while (n < len) {
+        int r = recv(sock, (char *)&buf[n], len - n, 0);
+        if (r <= 0)
+            return 0;
+        n += r;
+    }
+    return 1;
+}
+
+static void test_sleep_ms(int ms)
+{
+    struct timeval tv = {0, ms * 1000};
+    select(0, NULL, NULL, NULL, &tv);
+}
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+
+#ifdef THREADS
+    fprintf(stderr, "iq_server:: test\n");
+
+    char opts[] = "ring=4,clients=2";
+    struct iq_server *srv = iq_server_start("127.0.0.1", "0", opts, 0);
+    ASSERT_EQUALS(srv != NULL, 1);
+    if (!srv)
+        return 1;
+    ASSERT_EQUALS(iq_server_port(srv) > 0, 1);
+
+    // the header arrives after the client is active
+    sock_t a = test_connect(iq_server_port(srv));
+    ASSERT_EQUALS(a != INVALID_SOCKET, 1);
+    struct rtl_tcp_info info;
+    ASSERT_EQUALS(test_recv(a, (unsigned char *)&info, sizeof(info)) != 0, 1);
+    ASSERT_EQUALS(memcmp(info.magic, "RTL0", 4), 0);
+
+    fprintf(stderr, "iq_server::iq_server_push()\n");
+    unsigned char buf[4096];
+    unsigned char got[4096];
+    for (unsigned k = 0; k < 3; ++k) {
+        for (unsigned i = 0; i < sizeof(buf); ++i)
+            buf[i] = (unsigned char)(i * 7 + k);
+        iq_server_push(srv, buf, sizeof(buf), 2);
+        ASSERT_EQUALS(test_recv(a, got, sizeof(got)) != 0, 1);
+        ASSERT_EQUALS(memcmp(buf, got, sizeof(got)), 0);
+    }
+    ASSERT_EQUALS(srv->stat_retained, 0);
+
+    fprintf(stderr, "iq_server::iq_server_get_buffer()\n");
+    unsigned char *lent = iq_server_get_buffer(srv, sizeof(buf));
+    ASSERT_EQUALS(lent != NULL, 1);
+    ASSERT_EQUALS(iq_server_get_buffer(srv, sizeof(buf)) == lent, 1);
+    for (unsigned i = 0; lent && i < sizeof(buf); ++i)
+        lent[i] = (unsigned char)(i * 3);
+    iq_server_push(srv, lent, sizeof(buf), 2);
+    ASSERT_EQUALS(srv->stat_retained, 1);
+    ASSERT_EQUALS(test_recv(a, got, sizeof(got)) != 0, 1);
+    ASSERT_EQUALS(got[1], 3);
+    ASSERT_EQUALS(got[100], (unsigned char)300);
+
+    fprintf(stderr, "iq_server::iq_server_push() CS16\n");
+    int16_t s16[1024];
+    for (unsigned i = 0; i < 1024; ++i)
+        s16[i] = (int16_t)(i * 64 - 32768);
+    iq_server_push(srv, (unsigned char *)s16, sizeof(s16), 4);
+    ASSERT_EQUALS(test_recv(a, got, 1024) != 0, 1);
+    ASSERT_EQUALS(got[0], 0);
+    ASSERT_EQUALS(got[4], 1);
+    ASSERT_EQUALS(got[1023], 255);
+
+    fprintf(stderr, "iq_server:: slow client\n");
+    sock_t b = test_connect(iq_server_port(srv));
+    ASSERT_EQUALS(b != INVALID_SOCKET, 1);
+    ASSERT_EQUALS(test_recv(b, (unsigned char *)&info, sizeof(info)) != 0, 1);
+    closesocket(a); // a is not read anymore, let the server drop it
+    test_sleep_ms(200);
+    ASSERT_EQUALS(srv->stat_sent_bytes, 4 * 4096 + 1024);
+
+    // b does not read, the socket buffers fill, then the ring, then blocks are dropped
+    static unsigned char big[65536];
+    for (unsigned k = 0; k < 200; ++k) {
+        iq_server_push(srv, big, sizeof(big), 2);
+        test_sleep_ms(1);
+    }
+    ASSERT_EQUALS(srv->clients[1].dropped_blocks > 0 || srv->clients[0].dropped_blocks > 0, 1);
+    ASSERT_EQUALS(srv->stat_overruns, 0);
+    ASSERT_EQUALS(srv->num_blocks <= srv->max_blocks, 1);
+
+    // a third client is rejected with clients=2
+    sock_t c = test_connect(iq_server_port(srv));
+    sock_t d = test_connect(iq_server_port(srv));
+    test_sleep_ms(200);
+    ASSERT_EQUALS(srv->stat_rejected, 1);
+    closesocket(d);
+    closesocket(c);
+    closesocket(b);
+    test_sleep_ms(200);
+
+    // all blocks are released once the clients are gone
+    ASSERT_EQUALS(iq_server_clients(srv), 0);
+    unsigned held = 0;
+    for (unsigned i = 0; i < srv->num_blocks; ++i)
+        held += srv->blocks[i].refs;
+    ASSERT_EQUALS(held, 0);
+    ASSERT_EQUALS(srv->stat_dropped_blocks > 0, 1);
+    ASSERT_EQUALS(srv->stat_dropped_bytes, srv->stat_dropped_blocks * 65536.0);
+
+    data_t *data = iq_server_stats(srv);
+    ASSERT_EQUALS(data != NULL, 1);
+    data_free(data);
+
+    iq_server_stop(srv);
+#endif
+
+    fprintf(stderr, "iq_server:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+    return failed;
+}
+
+#endif /* _TEST */
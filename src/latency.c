@@ -0,0 +1,179 @@
+/** @file
+    Latency histograms, from end of package on air to the outputs.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "latency.h"
+#include "fatal.h"
+#include <stdlib.h>
+#include <stdio.h>
+
+#define LATENCY_HALF (1u << (LATENCY_SUB_BITS - 1))
+
+static unsigned latency_bucket(uint32_t value)
+{
+    if (value < 2 * LATENCY_HALF)
+        return value;
+
+    // keep LATENCY_SUB_BITS significant bits
+    unsigned shift = 1;
+    while ((value >> shift) >= 2 * LATENCY_HALF)
+        shift++;
+    return shift * LATENCY_HALF + (value >> shift);
+}
+
+static uint32_t latency_bucket_highest(unsigned bucket)
+{
+    if (bucket < 2 * LATENCY_HALF)
+        return bucket;
+
+    unsigned shift = bucket / LATENCY_HALF - 1;
+    uint64_t top   = bucket - shift * LATENCY_HALF;
+    uint64_t value = ((top + 1) << shift) - 1;
+    return value > UINT32_MAX ? UINT32_MAX : (uint32_t)value;
+}
+
+void latency_hist_record(latency_hist_t *hist, uint32_t value)
+{
+    hist->counts[latency_bucket(value)]++;
+    if (!hist->count || value < hist->min)
+        hist->min = value;
+    if (value > hist->max)
+        hist->max = value;
+    hist->count++;
+    hist->sum += value;
+}
+
+uint32_t latency_hist_percentile(latency_hist_t const *hist, double percentile)
+{
+    if (!hist->count)
+        return 0;
+
+    uint64_t rank = (uint64_t)(percentile / 100.0 * hist->count + 0.5);
+    if (rank < 1)
+        rank = 1;
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < LATENCY_BUCKETS; ++i) {
+        seen += hist->counts[i];
+        if (seen >= rank) {
+            uint32_t value = latency_bucket_highest(i);
+            return value < hist->max ? value : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+uint32_t latency_hist_mean(latency_hist_t const *hist)
+{
+    return hist->count ? (uint32_t)(hist->sum / hist->count) : 0;
+}
+
+char const *latency_stage_name(latency_stage_t stage)
+{
+    switch (stage) {
+    case LATENCY_BUFFER: return "buffer";
+    case LATENCY_DETECT: return "detect";
+    case LATENCY_DECODE: return "decode";
+    case LATENCY_QUEUE: return "queue";
+    case LATENCY_SERIALIZE: return "serialize";
+    case LATENCY_SEND: return "send";
+    case LATENCY_TOTAL: return "total";
+    default: return "";
+    }
+}
+
+latency_stats_t *latency_stats_create(unsigned num_outputs)
+{
+    latency_stats_t *stats = calloc(1, sizeof(latency_stats_t));
+    if (!stats) {
+        WARN_CALLOC("latency_stats_create()");
+        return NULL;
+    }
+
+    if (num_outputs) {
+        stats->output = calloc(num_outputs, sizeof(latency_hist_t));
+        if (!stats->output) {
+            WARN_CALLOC("latency_stats_create()");
+            free(stats);
+            return NULL;
+        }
+        stats->num_outputs = num_outputs;
+    }
+
+    return stats;
+}
+
+void latency_stats_free(latency_stats_t *stats)
+{
+    if (!stats)
+        return;
+
+    free(stats->output);
+    free(stats);
+}
+
+#ifdef _TEST
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %u <> %u\n", (unsigned)(a), (unsigned)(b)); \
+        } \
+    } while (0)
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+
+    fprintf(stderr, "latency:: test\n");
+
+    fprintf(stderr, "latency::latency_bucket()\n");
+    ASSERT_EQUALS(latency_bucket(0), 0);
+    ASSERT_EQUALS(latency_bucket(31), 31);
+    ASSERT_EQUALS(latency_bucket(32), 32);
+    ASSERT_EQUALS(latency_bucket(33), 32);
+    ASSERT_EQUALS(latency_bucket(34), 33);
+    ASSERT_EQUALS(latency_bucket(64), 48);
+    ASSERT_EQUALS(latency_bucket(UINT32_MAX), LATENCY_BUCKETS - 1);
+    ASSERT_EQUALS(latency_bucket_highest(32), 33);
+    ASSERT_EQUALS(latency_bucket_highest(48), 67);
+    ASSERT_EQUALS(latency_bucket_highest(LATENCY_BUCKETS - 1), UINT32_MAX);
+    // buckets are contiguous
+    for (unsigned i = 1; i < LATENCY_BUCKETS; ++i) {
+        if (latency_bucket(latency_bucket_highest(i - 1) + 1) != i) {
+            ASSERT_EQUALS(latency_bucket(latency_bucket_highest(i - 1) + 1), i);
+            break;
+        }
+    }
+
+    fprintf(stderr, "latency::latency_hist_percentile()\n");
+    latency_hist_t hist = {0};
+    ASSERT_EQUALS(latency_hist_percentile(&hist, 50.0), 0);
+    for (uint32_t v = 1; v <= 1000; ++v)
+        latency_hist_record(&hist, v * 100);
+    ASSERT_EQUALS(hist.count, 1000);
+    ASSERT_EQUALS(hist.min, 100);
+    ASSERT_EQUALS(hist.max, 100000);
+    ASSERT_EQUALS(latency_hist_mean(&hist), 50050);
+    // within the bucket precision of 1/16
+    uint32_t p50 = latency_hist_percentile(&hist, 50.0);
+    ASSERT_EQUALS(p50 >= 50000 && p50 <= 50000 + 50000 / 16, 1);
+    uint32_t p99 = latency_hist_percentile(&hist, 99.0);
+    ASSERT_EQUALS(p99 >= 99000 && p99 <= 100000, 1);
+    ASSERT_EQUALS(latency_hist_percentile(&hist, 100.0), 100000);
+    ASSERT_EQUALS(latency_hist_percentile(&hist, 0.0) <= 100 + 100 / 16, 1);
+
+    fprintf(stderr, "latency:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+
+    return failed;
+}
+#endif /* _TEST */
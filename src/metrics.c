@@ -0,0 +1,326 @@
+/** @file
+    Metrics registry, rendered in the Prometheus text exposition format.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "metrics.h"
+#include "abuf.h"
+#include "compat_pthread.h"
+#include "fatal.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#define METRICS_MIN_BUF 16384
+#define METRICS_MAX_BUF (16 * 1024 * 1024)
+
+metrics_t *metrics_create(void)
+{
+    metrics_t *metrics = calloc(1, sizeof(metrics_t));
+    if (!metrics) {
+        WARN_CALLOC("metrics_create()");
+        return NULL;
+    }
+    return metrics;
+}
+
+static void metric_series_free(metric_series_t *series)
+{
+    free(series->labels);
+    free(series);
+}
+
+static void metric_family_free(metric_family_t *family)
+{
+    list_free_elems(&family->series, (list_elem_free_fn)metric_series_free);
+    free(family->name);
+    free(family->help);
+    free(family);
+}
+
+void metrics_free(metrics_t *metrics)
+{
+    if (!metrics)
+        return;
+
+    list_free_elems(&metrics->families, (list_elem_free_fn)metric_family_free);
+    list_free_elems(&metrics->collectors, free);
+    free(metrics->buf);
+    free(metrics);
+}
+
+metric_family_t *metrics_family(metrics_t *metrics, char const *name, char const *help, metric_type_t type)
+{
+    // a family is printed once, series registered from several places are grouped
+    for (size_t i = 0; i < metrics->families.len; ++i) {
+        metric_family_t *family = metrics->families.elems[i];
+        if (!strcmp(family->name, name))
+            return family;
+    }
+
+    metric_family_t *family = calloc(1, sizeof(metric_family_t));
+    if (!family) {
+        WARN_CALLOC("metrics_family()");
+        return NULL;
+    }
+    family->name = strdup(name);
+    if (!family->name) {
+        WARN_STRDUP("metrics_family()");
+        free(family);
+        return NULL;
+    }
+    family->help = strdup(help);
+    if (!family->help) {
+        WARN_STRDUP("metrics_family()");
+        free(family->name);
+        free(family);
+        return NULL;
+    }
+    family->type = type;
+
+    list_push(&metrics->families, family);
+    return family;
+}
+
+static metric_series_t *metric_add(metric_family_t *family, char const *labels, metric_src_t src)
+{
+    if (!family)
+        return NULL; // NOTE: skip metrics on alloc failure.
+
+    metric_series_t *series = calloc(1, sizeof(metric_series_t));
+    if (!series) {
+        WARN_CALLOC("metric_add()");
+        return NULL;
+    }
+    if (labels && *labels) {
+        series->labels = strdup(labels);
+        if (!series->labels) {
+            WARN_STRDUP("metric_add()");
+            free(series);
+            return NULL;
+        }
+    }
+    series->src = src;
+
+    list_push(&family->series, series);
+    return series;
+}
+
+void metric_add_unsigned(metric_family_t *family, char const *labels, unsigned const *value)
+{
+    metric_series_t *series = metric_add(family, labels, METRIC_SRC_UNSIGNED);
+    if (series)
+        series->value.u = value;
+}
+
+void metric_add_float(metric_family_t *family, char const *labels, float const *value)
+{
+    metric_series_t *series = metric_add(family, labels, METRIC_SRC_FLOAT);
+    if (series)
+        series->value.f = value;
+}
+
+void metric_add_fn(metric_family_t *family, char const *labels, metric_value_fn fn, void *ctx)
+{
+    metric_series_t *series = metric_add(family, labels, METRIC_SRC_FN);
+    if (series) {
+        series->fn  = fn;
+        series->ctx = ctx;
+    }
+}
+
+void metrics_collector(metrics_t *metrics, metrics_collect_fn fn, void *ctx)
+{
+    metrics_collector_t *collector = calloc(1, sizeof(metrics_collector_t));
+    if (!collector) {
+        WARN_CALLOC("metrics_collector()");
+        return;
+    }
+    collector->fn  = fn;
+    collector->ctx = ctx;
+
+    list_push(&metrics->collectors, collector);
+}
+
+void metrics_print_header(abuf_t *buf, char const *name, char const *help, metric_type_t type)
+{
+    char const *type_str = type == METRIC_COUNTER ? "counter"
+            : type == METRIC_GAUGE ? "gauge"
+            : type == METRIC_SUMMARY ? "summary"
+            : "untyped";
+    abuf_printf(buf, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type_str);
+}
+
+void metrics_escape_label(char *dst, size_t size, char const *src)
+{
+    if (!size)
+        return;
+    char *end = dst + size - 1;
+    for (; *src && dst < end; ++src) {
+        char c = *src == '\n' ? 'n' : *src;
+        if (*src == '\\' || *src == '"' || *src == '\n') {
+            if (dst + 1 >= end)
+                break;
+            *dst++ = '\\';
+        }
+        *dst++ = c;
+    }
+    *dst = '\0';
+}
+
+static void metrics_print_value(abuf_t *buf, double value)
+{
+    if (isnan(value))
+        abuf_cat(buf, "NaN\n");
+    else if (isinf(value))
+        abuf_cat(buf, value > 0 ? "+Inf\n" : "-Inf\n");
+    else
+        abuf_printf(buf, "%.10g\n", value);
+}
+
+static void metrics_render_buf(metrics_t *metrics, abuf_t *buf)
+{
+    for (void **iter = metrics->families.elems; iter && *iter; ++iter) {
+        metric_family_t *family = *iter;
+        metrics_print_header(buf, family->name, family->help, family->type);
+
+        for (void **s_iter = family->series.elems; s_iter && *s_iter; ++s_iter) {
+            metric_series_t *series = *s_iter;
+            if (series->labels)
+                abuf_printf(buf, "%s{%s} ", family->name, series->labels);
+            else
+                abuf_printf(buf, "%s ", family->name);
+
+            if (series->src == METRIC_SRC_UNSIGNED)
+                abuf_printf(buf, "%u\n", atomic_load_acquire(series->value.u)); // might be counted on another thread
+            else if (series->src == METRIC_SRC_FLOAT)
+                metrics_print_value(buf, *series->value.f);
+            else
+                metrics_print_value(buf, series->fn(series->ctx));
+        }
+    }
+
+    for (void **iter = metrics->collectors.elems; iter && *iter; ++iter) {
+        metrics_collector_t *collector = *iter;
+        collector->fn(collector->ctx, buf);
+    }
+}
+
+char const *metrics_render(metrics_t *metrics, size_t *len)
+{
+    for (;;) {
+        abuf_t buf;
+        abuf_init(&buf, metrics->buf, metrics->buf_size);
+        metrics_render_buf(metrics, &buf);
+        // a full buffer might have been truncated
+        if (buf.left > 1) {
+            *len = buf.tail - metrics->buf;
+            return metrics->buf;
+        }
+
+        size_t buf_size = metrics->buf_size ? metrics->buf_size * 2 : METRICS_MIN_BUF;
+        if (buf_size > METRICS_MAX_BUF) {
+            fprintf(stderr, "metrics_render: output too large\n");
+            return NULL;
+        }
+        char *new_buf = realloc(metrics->buf, buf_size);
+        if (!new_buf) {
+            WARN_REALLOC("metrics_render()");
+            return NULL;
+        }
+        metrics->buf      = new_buf;
+        metrics->buf_size = buf_size;
+    }
+}
+
+#ifdef _TEST
+static double test_value_fn(void *ctx)
+{
+    return *(double *)ctx;
+}
+
+static void test_collect_fn(void *ctx, abuf_t *buf)
+{
+    metrics_print_header(buf, "test_collected", "Collected.", METRIC_UNTYPED);
+    abuf_printf(buf, "test_collected{id=\"%d\"} 1\n", *(int *)ctx);
+}
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+
+    fprintf(stderr, "metrics:: test\n");
+
+    unsigned count = 3;
+    float level    = -12.5f;
+    double value   = NAN;
+    int id         = 7;
+    char label[64];
+
+    metrics_t *metrics = metrics_create();
+    metric_family_t *family = metrics_family(metrics, "test_count_total", "Counted.", METRIC_COUNTER);
+    metric_add_unsigned(family, NULL, &count);
+    metrics_escape_label(label, sizeof(label), "a\"b\\c\nd");
+    char labels[80];
+    snprintf(labels, sizeof(labels), "name=\"%s\"", label);
+    family = metrics_family(metrics, "test_level", "Level.", METRIC_GAUGE);
+    metric_add_float(family, labels, &level);
+    metric_add_fn(family, "name=\"fn\"", test_value_fn, &value);
+    family = metrics_family(metrics, "test_count_total", "Counted again.", METRIC_COUNTER);
+    metric_add_unsigned(family, "name=\"again\"", &count);
+    metrics_collector(metrics, test_collect_fn, &id);
+
+    char const *expected = "# HELP test_count_total Counted.\n"
+                           "# TYPE test_count_total counter\n"
+                           "test_count_total 4\n"
+                           "test_count_total{name=\"again\"} 4\n"
+                           "# HELP test_level Level.\n"
+                           "# TYPE test_level gauge\n"
+                           "test_level{name=\"a\\\"b\\\\c\\nd\"} -12.5\n"
+                           "test_level{name=\"fn\"} NaN\n"
+                           "# HELP test_collected Collected.\n"
+                           "# TYPE test_collected untyped\n"
+                           "test_collected{id=\"7\"} 1\n";
+
+    fprintf(stderr, "metrics::metrics_render()\n");
+    count++; // values are read in place
+    size_t len;
+    char const *text = metrics_render(metrics, &len);
+    if (text && len == strlen(expected) && !strcmp(text, expected)) {
+        passed++;
+    }
+    else {
+        failed++;
+        fprintf(stderr, "FAIL: rendered\n%s\nexpected\n%s\n", text ? text : "(null)", expected);
+    }
+
+    fprintf(stderr, "metrics:: buffer growth\n");
+    family = metrics_family(metrics, "test_many", "Many.", METRIC_GAUGE);
+    for (int i = 0; i < 1000; ++i) {
+        snprintf(labels, sizeof(labels), "i=\"%d\"", i);
+        metric_add_unsigned(family, labels, &count);
+    }
+    text = metrics_render(metrics, &len);
+    if (text && len > METRICS_MIN_BUF && len == strlen(text) && strstr(text, "test_many{i=\"999\"} 4\n")) {
+        passed++;
+    }
+    else {
+        failed++;
+        fprintf(stderr, "FAIL: buffer growth\n");
+    }
+
+    metrics_free(metrics);
+
+    fprintf(stderr, "metrics:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+
+    return failed;
+}
+#endif /* _TEST */
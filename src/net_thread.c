@@ -0,0 +1,346 @@
+/** @file
+    Network I/O thread, runs the mongoose event loop and all outputs.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "net_thread.h"
+#include "spsc_queue.h"
+#include "compat_pthread.h"
+#include "rtl_433.h"
+#include "r_api.h"
+#include "data.h"
+#include "metrics.h"
+#include "fatal.h"
+#include "r_util.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "mongoose.h"
+
+#ifdef THREADS
+
+#ifndef _WIN32
+#include <signal.h>
+#include <time.h>
+#endif
+
+#define NET_THREAD_EVENTS 4096 // events pending output before the SDR thread waits
+#define NET_THREAD_COMMANDS 64 // commands pending for the SDR thread
+#define NET_THREAD_POLL_MS 100 // poll timeout, the SDR thread wakes us up on new events
+
+// exported by mongoose.c but not declared in mongoose.h
+void mg_set_non_blocking_mode(sock_t sock);
+
+typedef struct {
+    net_command_fn fn;
+    void *ctx;
+} net_command_t;
+
+struct net_thread {
+    r_cfg_t *cfg;
+    struct mg_mgr *mgr;
+    spsc_queue_t *events;   ///< r_event_t from the SDR thread
+    spsc_queue_t *commands; ///< net_command_t to the SDR thread
+    sock_t wake[2];         ///< written by the SDR thread, read by the mongoose loop
+    unsigned idle;          ///< set while the network thread may block in poll
+    unsigned stop;
+    pthread_t thread;
+    pthread_id_t thread_id;
+    int has_thread_id;
+    // stats, atomic as written by one thread and read by the other
+    unsigned stat_events;
+    unsigned stat_stalls;
+    unsigned stat_max_queued;
+    unsigned stat_wakeups;
+    unsigned stat_commands;
+};
+
+static void net_thread_drain(struct net_thread *nt)
+{
+    r_event_t ev;
+    unsigned len = spsc_queue_len(nt->events);
+    if (len > atomic_load_acquire(&nt->stat_max_queued))
+        atomic_store_release(&nt->stat_max_queued, len);
+
+    while (spsc_queue_pop(nt->events, &ev)) {
+        if (ev.kind == R_EVENT_CALL) {
+            ev.call(nt->cfg, ev.ctx);
+            continue;
+        }
+        output_event(nt->cfg, &ev);
+        atomic_add_fetch_seq(&nt->stat_events, 1);
+    }
+}
+
+static void net_thread_wake_handler(struct mg_connection *nc, int ev, void *ev_data)
+{
+    UNUSED(ev_data);
+    // the wake up data carries no information, events are in the queue
+    if (ev == MG_EV_RECV)
+        mbuf_remove(&nc->recv_mbuf, nc->recv_mbuf.len);
+}
+
+static THREAD_RETURN THREAD_CALL net_thread_run(void *arg)
+{
+    struct net_thread *nt = arg;
+
+#ifndef _WIN32
+    // signals are handled by the SDR thread
+    sigset_t sigset;
+    sigfillset(&sigset);
+    pthread_sigmask(SIG_BLOCK, &sigset, NULL);
+#endif
+
+    nt->thread_id     = pthread_id_self();
+    nt->has_thread_id = 1;
+
+    while (!atomic_load_acquire(&nt->stop)) {
+        // announce that we might sleep, then check for events posted meanwhile
+        atomic_exchange_seq(&nt->idle, 1);
+        atomic_fence_seq();
+        int timeout = spsc_queue_len(nt->events) ? 0 : NET_THREAD_POLL_MS;
+        mg_mgr_poll(nt->mgr, timeout);
+        atomic_exchange_seq(&nt->idle, 0);
+
+        net_thread_drain(nt);
+    }
+
+    return (THREAD_RETURN)0;
+}
+
+struct net_thread *net_thread_start(r_cfg_t *cfg)
+{
+    if (!cfg->mgr)
+        return NULL; // nothing to poll
+
+    struct net_thread *nt = calloc(1, sizeof(struct net_thread));
+    if (!nt) {
+        WARN_CALLOC("net_thread_start()");
+        return NULL;
+    }
+    nt->cfg = cfg;
+    nt->mgr = cfg->mgr;
+
+    nt->events = spsc_queue_create(NET_THREAD_EVENTS, sizeof(r_event_t));
+    if (!nt->events) {
+        free(nt);
+        return NULL;
+    }
+    nt->commands = spsc_queue_create(NET_THREAD_COMMANDS, sizeof(net_command_t));
+    if (!nt->commands) {
+        spsc_queue_free(nt->events);
+        free(nt);
+        return NULL;
+    }
+
+    if (!mg_socketpair(nt->wake, SOCK_DGRAM)) {
+        fprintf(stderr, "Failed to create the network thread wake up socket.\n");
+        goto fail;
+    }
+    mg_set_non_blocking_mode(nt->wake[0]);
+    if (!mg_add_sock(nt->mgr, nt->wake[1], net_thread_wake_handler)) {
+        closesocket(nt->wake[1]);
+        closesocket(nt->wake[0]);
+        goto fail;
+    }
+
+    if (pthread_create(&nt->thread, NULL, net_thread_run, nt)) {
+        fprintf(stderr, "Failed to start the network thread.\n");
+        closesocket(nt->wake[0]);
+        goto fail; // the wake[1] connection is closed with the manager
+    }
+
+    return nt;
+
+fail:
+    spsc_queue_free(nt->commands);
+    spsc_queue_free(nt->events);
+    free(nt);
+    return NULL;
+}
+
+static void net_thread_wake(struct net_thread *nt)
+{
+    atomic_fence_seq();
+    if (atomic_exchange_seq(&nt->idle, 0)) {
+        // a failed send means the socket buffer is full, i.e. a wake up is pending anyway
+        if (send(nt->wake[0], "", 1, 0) == 1)
+            atomic_add_fetch_seq(&nt->stat_wakeups, 1);
+    }
+}
+
+void net_thread_stop(struct net_thread *nt)
+{
+    if (!nt)
+        return;
+
+    atomic_store_release(&nt->stop, 1);
+    atomic_store_release(&nt->idle, 1);
+    net_thread_wake(nt);
+    pthread_join(nt->thread, NULL);
+
+    // output what is left on the calling thread
+    net_thread_drain(nt);
+
+    net_command_t cmd;
+    while (spsc_queue_pop(nt->commands, &cmd))
+        free(cmd.ctx);
+
+    closesocket(nt->wake[0]);
+    spsc_queue_free(nt->commands);
+    spsc_queue_free(nt->events);
+    free(nt);
+}
+
+static void net_thread_pause(void)
+{
+#ifdef _WIN32
+    Sleep(1);
+#else
+    struct timespec ts = {0, 1000000}; // 1 ms
+    nanosleep(&ts, NULL);
+#endif
+}
+
+int net_thread_post_event(struct net_thread *nt, r_event_t const *ev)
+{
+    if (!spsc_queue_push(nt->events, ev)) {
+        // the outputs fall behind, rather wait than lose data, the network thread never waits on us
+        if (atomic_add_fetch_seq(&nt->stat_stalls, 1) == 1)
+            fprintf(stderr, "Output queue full, waiting for the outputs to catch up.\n");
+        do {
+            net_thread_wake(nt);
+            net_thread_pause();
+        } while (!spsc_queue_push(nt->events, ev));
+    }
+    net_thread_wake(nt);
+    return 1;
+}
+
+int net_thread_post_call(struct net_thread *nt, net_command_fn fn, void *ctx)
+{
+    r_event_t ev = {.kind = R_EVENT_CALL, .call = fn, .ctx = ctx};
+    return net_thread_post_event(nt, &ev);
+}
+
+int net_thread_post_command(struct net_thread *nt, net_command_fn fn, void *ctx)
+{
+    net_command_t cmd = {.fn = fn, .ctx = ctx};
+    return spsc_queue_push(nt->commands, &cmd);
+}
+
+void net_thread_run_commands(struct net_thread *nt)
+{
+    net_command_t cmd;
+    while (spsc_queue_pop(nt->commands, &cmd)) {
+        cmd.fn(nt->cfg, cmd.ctx);
+        atomic_add_fetch_seq(&nt->stat_commands, 1);
+    }
+}
+
+int net_thread_is_current(struct net_thread *nt)
+{
+    return nt && nt->has_thread_id && pthread_id_equal(nt->thread_id, pthread_id_self());
+}
+
+data_t *net_thread_stats(struct net_thread *nt)
+{
+    return data_make(
+            "queued",       "", DATA_INT, spsc_queue_len(nt->events),
+            "max_queued",   "", DATA_INT, atomic_load_acquire(&nt->stat_max_queued),
+            "events",       "", DATA_INT, atomic_load_acquire(&nt->stat_events),
+            "stalls",       "", DATA_INT, atomic_load_acquire(&nt->stat_stalls),
+            "wakeups",      "", DATA_INT, atomic_load_acquire(&nt->stat_wakeups),
+            "commands",     "", DATA_INT, atomic_load_acquire(&nt->stat_commands),
+            NULL);
+}
+
+static double net_thread_queued(void *ctx)
+{
+    struct net_thread *nt = ctx;
+    return spsc_queue_len(nt->events);
+}
+
+void net_thread_metrics(struct net_thread *nt, metrics_t *metrics)
+{
+    metric_family_t *family;
+    family = metrics_family(metrics, "rtl_433_net_thread_queued", "Events queued for the outputs.", METRIC_GAUGE);
+    metric_add_fn(family, NULL, net_thread_queued, nt);
+    family = metrics_family(metrics, "rtl_433_net_thread_max_queued", "Most events queued for the outputs at once.", METRIC_GAUGE);
+    metric_add_unsigned(family, NULL, &nt->stat_max_queued);
+    family = metrics_family(metrics, "rtl_433_net_thread_events_total", "Events passed to the outputs.", METRIC_COUNTER);
+    metric_add_unsigned(family, NULL, &nt->stat_events);
+    family = metrics_family(metrics, "rtl_433_net_thread_stalls_total", "Times the SDR thread waited on a full queue.", METRIC_COUNTER);
+    metric_add_unsigned(family, NULL, &nt->stat_stalls);
+    family = metrics_family(metrics, "rtl_433_net_thread_commands_total", "Commands run on the SDR thread.", METRIC_COUNTER);
+    metric_add_unsigned(family, NULL, &nt->stat_commands);
+}
+
+#else /* THREADS */
+
+struct net_thread *net_thread_start(r_cfg_t *cfg)
+{
+    UNUSED(cfg);
+    return NULL; // mongoose is polled from the SDR thread
+}
+
+void net_thread_stop(struct net_thread *nt)
+{
+    UNUSED(nt);
+}
+
+int net_thread_post_event(struct net_thread *nt, r_event_t const *ev)
+{
+    UNUSED(nt);
+    UNUSED(ev);
+    return 0;
+}
+
+int net_thread_post_call(struct net_thread *nt, net_command_fn fn, void *ctx)
+{
+    UNUSED(nt);
+    UNUSED(fn);
+    UNUSED(ctx);
+    return 0;
+}
+
+int net_thread_post_command(struct net_thread *nt, net_command_fn fn, void *ctx)
+{
+    UNUSED(nt);
+    UNUSED(fn);
+    UNUSED(ctx);
+    return 0;
+}
+
+void net_thread_run_commands(struct net_thread *nt)
+{
+    UNUSED(nt);
+}
+
+int net_thread_is_current(struct net_thread *nt)
+{
+    UNUSED(nt);
+    return 0;
+}
+
+data_t *net_thread_stats(struct net_thread *nt)
+{
+    UNUSED(nt);
+    return NULL;
+}
+
+void net_thread_metrics(struct net_thread *nt, metrics_t *metrics)
+{
+    UNUSED(nt);
+    UNUSED(metrics);
+}
+
+#endif /* THREADS */
@@ -0,0 +1,370 @@
+/** @file
+    Binary (CBOR or MessagePack) event stream output for rtl_433 events.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "output_binary.h"
+#include "optparse.h"
+#include "metrics.h"
+#include "fatal.h"
+#include "r_util.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "mongoose.h"
+
+#define BINARY_HEADER_SIZE 5 // length and frame type
+#define BINARY_MIN_BUFFER 4096
+#define BINARY_MAX_BUFFER (1024 * 1024)        // largest event we encode
+#define BINARY_MAX_PENDING (1024 * 1024)       // TCP data not yet sent before we drop events
+#define BINARY_SCHEMA_EVENTS 100               // resend the schema over UDP after this many events
+#define BINARY_SCHEMA_INTERVAL 10.0            // or after this many seconds
+#define BINARY_MAX_BACKOFF 30.0                // seconds between reconnect attempts at most
+
+typedef struct {
+    struct data_output output;
+    binary_format_t format;
+    binary_schema_t *schema;
+    uint8_t *buf;
+    size_t buf_size;
+    // transport, one of
+    FILE *file;
+    struct datagram_client *udp;
+    struct mg_connection *conn;
+    // tcp
+    struct mg_connection *timer; ///< timer-only connection to reconnect after a delay
+    char address[300]; ///< "tcp://host:port"
+    int connected;
+    int prev_status;
+    double backoff;
+    // udp
+    unsigned schema_events;
+    double schema_time;
+    // stats
+    unsigned stat_events;
+    unsigned stat_bytes;
+    unsigned stat_dropped;
+    unsigned stat_reconnects;
+} data_output_binary_t;
+
+static char const *format_name(binary_format_t format)
+{
+    return format == BINARY_CBOR ? "cbor" : "msgpack";
+}
+
+static void binary_send(data_output_binary_t *binary, uint8_t *frame, size_t len)
+{
+    if (binary->file) {
+        fwrite(frame, 1, len, binary->file);
+        fflush(binary->file);
+    }
+    else if (binary->udp) {
+        datagram_client_send(binary->udp, (char const *)frame, len);
+    }
+    else if (binary->conn) {
+        mg_send(binary->conn, frame, (int)len);
+    }
+    binary->stat_bytes += len;
+}
+
+/// Encode into the frame buffer, growing it as needed, returns the frame length or 0.
+static size_t binary_encode(data_output_binary_t *binary, data_t *data, char frame_type)
+{
+    size_t len = 0;
+    while (!len) {
+        uint8_t *dst = &binary->buf[BINARY_HEADER_SIZE];
+        size_t size  = binary->buf_size - BINARY_HEADER_SIZE;
+        if (frame_type == BINARY_FRAME_SCHEMA)
+            len = binary_print_schema(binary->schema, binary->format, dst, size);
+        else
+            len = data_print_binary(data, binary->format, binary->schema, dst, size);
+        if (len)
+            break;
+
+        if (binary->buf_size >= BINARY_MAX_BUFFER) {
+            fprintf(stderr, "Binary output: event too large, dropped.\n");
+            return 0;
+        }
+        uint8_t *buf = realloc(binary->buf, binary->buf_size * 2);
+        if (!buf) {
+            WARN_REALLOC("binary_encode()");
+            return 0;
+        }
+        binary->buf = buf;
+        binary->buf_size *= 2;
+    }
+
+    size_t frame_len = len + 1;
+    binary->buf[0]   = (uint8_t)(frame_len >> 24);
+    binary->buf[1]   = (uint8_t)(frame_len >> 16);
+    binary->buf[2]   = (uint8_t)(frame_len >> 8);
+    binary->buf[3]   = (uint8_t)(frame_len);
+    binary->buf[4]   = (uint8_t)frame_type;
+    return len + BINARY_HEADER_SIZE;
+}
+
+static void binary_send_schema(data_output_binary_t *binary)
+{
+    if (!binary->schema)
+        return;
+    size_t len = binary_encode(binary, NULL, BINARY_FRAME_SCHEMA);
+    if (len)
+        binary_send(binary, binary->buf, len);
+
+    binary->schema_events = 0;
+    binary->schema_time   = mg_time();
+}
+
+static void binary_connect(data_output_binary_t *binary, struct mg_mgr *mgr);
+
+/// connect again after a delay, doubled with each failed attempt
+static void binary_schedule_reconnect(data_output_binary_t *binary)
+{
+    binary->backoff = binary->backoff > 0 ? binary->backoff * 2 : 1.0;
+    if (binary->backoff > BINARY_MAX_BACKOFF)
+        binary->backoff = BINARY_MAX_BACKOFF;
+    mg_set_timer(binary->timer, mg_time() + binary->backoff);
+}
+
+static void binary_client_event(struct mg_connection *nc, int ev, void *ev_data)
+{
+    // note that while shutting down the binary is NULL
+    data_output_binary_t *binary = (data_output_binary_t *)nc->user_data;
+
+    switch (ev) {
+    case MG_EV_CONNECT: {
+        int connect_status = *(int *)ev_data;
+        if (!binary)
+            break;
+        if (connect_status == 0) {
+            fprintf(stderr, "Binary output connected to %s\n", binary->address);
+            binary->connected = 1;
+            binary->backoff   = 0;
+            binary_send_schema(binary);
+        }
+        else if (binary->prev_status != connect_status) {
+            // Error, print only once
+            fprintf(stderr, "Binary output connect error: %s\n", strerror(connect_status));
+        }
+        binary->prev_status = connect_status;
+        break;
+    }
+    case MG_EV_CLOSE:
+        if (!binary)
+            break; // shutting down
+        if (binary->connected)
+            fprintf(stderr, "Binary output connection to %s closed\n", binary->address);
+        binary->connected = 0;
+        binary->conn      = NULL;
+        binary_schedule_reconnect(binary);
+        break;
+    }
+}
+
+static void binary_timer_event(struct mg_connection *nc, int ev, void *ev_data)
+{
+    UNUSED(ev_data);
+    // note that while shutting down the binary is NULL
+    data_output_binary_t *binary = (data_output_binary_t *)nc->user_data;
+
+    if (ev == MG_EV_TIMER && binary && !binary->conn) {
+        binary->stat_reconnects++;
+        binary_connect(binary, nc->mgr);
+    }
+}
+
+static void binary_connect(data_output_binary_t *binary, struct mg_mgr *mgr)
+{
+    char const *error_string = NULL;
+    struct mg_connect_opts opts = {.user_data = binary, .error_string = &error_string};
+    binary->conn = mg_connect_opt(mgr, binary->address, binary_client_event, opts);
+    if (!binary->conn) {
+        fprintf(stderr, "Binary output connect (%s) failed%s%s\n", binary->address,
+                error_string ? ": " : "", error_string ? error_string : "");
+        binary_schedule_reconnect(binary);
+    }
+}
+
+static void print_binary_data(data_output_t *output, data_t *data, char const *format)
+{
+    UNUSED(format);
+    data_output_binary_t *binary = (data_output_binary_t *)output;
+
+    if (binary->address[0] && (!binary->connected || !binary->conn
+            || binary->conn->send_mbuf.len > BINARY_MAX_PENDING)) {
+        binary->stat_dropped++;
+        return;
+    }
+
+    if (binary->udp && (binary->schema_events >= BINARY_SCHEMA_EVENTS
+            || mg_time() - binary->schema_time >= BINARY_SCHEMA_INTERVAL))
+        binary_send_schema(binary);
+
+    size_t len = binary_encode(binary, data, BINARY_FRAME_EVENT);
+    if (!len) {
+        binary->stat_dropped++;
+        return;
+    }
+    data_output_mark_serialized(output);
+    binary_send(binary, binary->buf, len);
+    data_output_mark_queued(output);
+    binary->stat_events++;
+    binary->schema_events++;
+}
+
+static void data_output_binary_start(data_output_t *output, char const *const *fields, int num_fields)
+{
+    data_output_binary_t *binary = (data_output_binary_t *)output;
+
+    binary_schema_free(binary->schema);
+    binary->schema = binary_schema_create(fields, num_fields);
+
+    if (binary->connected || !binary->address[0])
+        binary_send_schema(binary);
+    // otherwise the schema is sent on connect
+}
+
+static data_t *data_output_binary_stats(data_output_t *output)
+{
+    data_output_binary_t *binary = (data_output_binary_t *)output;
+
+    data_t *data = data_make(
+            "output",       "", DATA_STRING, format_name(binary->format),
+            "events",       "", DATA_INT, binary->stat_events,
+            "bytes",        "", DATA_INT, binary->stat_bytes,
+            "dropped",      "", DATA_INT, binary->stat_dropped,
+            NULL);
+    if (binary->address[0]) {
+        data = data_append(data,
+                "connected",    "", DATA_INT, binary->connected,
+                "reconnects",   "", DATA_INT, binary->stat_reconnects,
+                "pending",      "", DATA_INT, binary->conn ? (int)binary->conn->send_mbuf.len : 0,
+                NULL);
+    }
+    return data;
+}
+
+static double binary_connected(void *ctx)
+{
+    data_output_binary_t *binary = ctx;
+    return binary->connected;
+}
+
+static double binary_pending(void *ctx)
+{
+    data_output_binary_t *binary = ctx;
+    return binary->conn ? binary->conn->send_mbuf.len : 0;
+}
+
+static void data_output_binary_metrics(data_output_t *output, metrics_t *metrics, char const *labels)
+{
+    data_output_binary_t *binary = (data_output_binary_t *)output;
+
+    metric_family_t *family;
+    family = metrics_family(metrics, "rtl_433_output_events_total", "Events serialized by the output.", METRIC_COUNTER);
+    metric_add_unsigned(family, labels, &binary->stat_events);
+    family = metrics_family(metrics, "rtl_433_output_sent_bytes_total", "Bytes sent by the output.", METRIC_COUNTER);
+    metric_add_unsigned(family, labels, &binary->stat_bytes);
+    family = metrics_family(metrics, "rtl_433_output_dropped_total", "Messages dropped by the output.", METRIC_COUNTER);
+    metric_add_unsigned(family, labels, &binary->stat_dropped);
+    if (binary->address[0]) {
+        family = metrics_family(metrics, "rtl_433_output_connected", "Output connected to the server.", METRIC_GAUGE);
+        metric_add_fn(family, labels, binary_connected, binary);
+        family = metrics_family(metrics, "rtl_433_output_reconnects_total", "Output reconnect attempts.", METRIC_COUNTER);
+        metric_add_unsigned(family, labels, &binary->stat_reconnects);
+        family = metrics_family(metrics, "rtl_433_output_pending_bytes", "Bytes waiting to be sent by the output.", METRIC_GAUGE);
+        metric_add_fn(family, labels, binary_pending, binary);
+    }
+}
+
+static void data_output_binary_free(data_output_t *output)
+{
+    data_output_binary_t *binary = (data_output_binary_t *)output;
+
+    if (!binary)
+        return;
+
+    if (binary->conn) {
+        binary->conn->user_data = NULL;
+        binary->conn->flags |= MG_F_SEND_AND_CLOSE;
+    }
+    if (binary->timer) {
+        binary->timer->user_data = NULL;
+        binary->timer->flags |= MG_F_CLOSE_IMMEDIATELY;
+    }
+    datagram_client_free(binary->udp);
+    if (binary->file && binary->file != stdout)
+        fclose(binary->file);
+    binary_schema_free(binary->schema);
+    free(binary->buf);
+    free(binary);
+}
+
+struct data_output *data_output_binary_create(struct mg_mgr *mgr, binary_format_t format, char *param)
+{
+    data_output_binary_t *binary = calloc(1, sizeof(data_output_binary_t));
+    if (!binary)
+        FATAL_CALLOC("data_output_binary_create()");
+
+    binary->buf_size = BINARY_MIN_BUFFER;
+    binary->buf      = malloc(binary->buf_size);
+    if (!binary->buf)
+        FATAL_MALLOC("data_output_binary_create()");
+
+    binary->format              = format;
+    binary->output.print_data   = print_binary_data;
+    binary->output.output_start = data_output_binary_start;
+    binary->output.output_free  = data_output_binary_free;
+    binary->output.output_stats = data_output_binary_stats;
+    binary->output.output_metrics = data_output_binary_metrics;
+    // NOTE: output.file stays NULL, data_output_print() would append a newline otherwise.
+
+    if (param && (strncmp(param, "udp:", 4) == 0 || strncmp(param, "tcp:", 4) == 0)) {
+        int is_tcp = param[0] == 't';
+        char *host = "localhost";
+        char *port = NULL;
+        hostport_param(param + 4, &host, &port);
+        if (!port) {
+            fprintf(stderr, "Binary output needs a port, e.g. -F %s:%s://localhost:1433\n", format_name(format), is_tcp ? "tcp" : "udp");
+            exit(1);
+        }
+        fprintf(stderr, "Publishing %s events to %s://%s:%s\n", format_name(format), is_tcp ? "tcp" : "udp", host, port);
+
+        if (is_tcp) {
+            snprintf(binary->address, sizeof(binary->address), "tcp://%s:%s", host, port);
+            struct mg_add_sock_opts timer_opts = {.user_data = binary};
+            binary->timer = mg_add_sock_opt(mgr, INVALID_SOCKET, binary_timer_event, timer_opts);
+            if (!binary->timer) {
+                FATAL("data_output_binary_create()");
+            }
+            binary_connect(binary, mgr);
+        }
+        else {
+            binary->udp = datagram_client_create(host, port);
+            if (!binary->udp) {
+                fprintf(stderr, "Binary output failed to open UDP socket to %s:%s\n", host, port);
+                exit(1);
+            }
+        }
+    }
+    else if (param && *param) {
+        binary->file = fopen(param, "ab");
+        if (!binary->file) {
+            fprintf(stderr, "rtl_433: failed to open output file\n");
+            exit(1);
+        }
+    }
+    else {
+        binary->file = stdout;
+    }
+
+    return &binary->output;
+}
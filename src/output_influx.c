@@ -15,6 +15,7 @@
 #include "output_influx.h"
 #include "optparse.h"
 #include "util.h"
+#include "metrics.h"
 #include "fatal.h"
 #include "r_util.h"
 
@@ -25,24 +26,126 @@
 
 #include "mongoose.h"
 
+#ifdef ZLIB
+#include <zlib.h>
+#endif
+
 /* InfluxDB client abstraction / printer */
 
+#define INFLUX_DEFAULT_BATCH_SIZE 100
+#define INFLUX_DEFAULT_MAX_BUFFER (1024 * 1024)
+#define INFLUX_MAX_BACKOFF 30.0 // seconds
+
 typedef struct {
     struct data_output output;
     struct mg_mgr *mgr;
-    struct mg_connection *conn;
+    struct mg_connection *conn; ///< kept alive between requests
+    struct mg_connection *timer; ///< timer-only connection to flush and retry without traffic
     int prev_status;
     int prev_resp_code;
     char hostname[64];
     char url[400];
-    char extra_headers[150];
+    char address[300]; ///< "tcp://host:port"
+    char host[256];    ///< for the Host header
+    char path[400];    ///< path and query
+    int use_ssl;
+    char extra_headers[400];
     int databufidxfill;
-    struct mbuf databufs[2];
-
+    struct mbuf databufs[2]; ///< the fill buffer and the buffer of the request in-flight
+    int busy;                ///< a request is in-flight
+    // batching
+    int batch_size;       ///< send when this many lines are buffered
+    double flush_interval; ///< or when the oldest line is this old, seconds
+    size_t max_buffer;    ///< bound on buffered (and retried) data, oldest lines are dropped
+    int gzip;
+    unsigned fill_lines;
+    unsigned sent_lines;
+    double fill_since;
+    double retry_at;
+    double backoff;
+    // stats
+    unsigned stat_requests;
+    unsigned stat_lines;
+    unsigned stat_retries;
+    unsigned stat_dropped;
 } influx_client_t;
 
 static void influx_client_send(influx_client_t *ctx);
 
+/// wake up at @p at to send, unless an earlier wake up is pending
+static void influx_schedule(influx_client_t *ctx, double at)
+{
+    if (ctx->timer && (ctx->timer->ev_timer_time <= 0 || at < ctx->timer->ev_timer_time))
+        mg_set_timer(ctx->timer, at);
+}
+
+/// drop the oldest lines until the fill buffer is within bounds
+static void influx_trim_buffer(influx_client_t *ctx)
+{
+    struct mbuf *buf = &ctx->databufs[ctx->databufidxfill];
+
+    size_t cut = 0;
+    while (buf->len - cut > ctx->max_buffer && ctx->fill_lines) {
+        char *eol = memchr(&buf->buf[cut], '\n', buf->len - cut);
+        if (!eol)
+            break;
+        cut = eol - buf->buf + 1;
+        ctx->fill_lines--;
+        ctx->stat_dropped++;
+    }
+    if (cut)
+        mbuf_remove(buf, cut);
+}
+
+/// put the lines of the failed request back in front of the fill buffer
+static void influx_retry(influx_client_t *ctx)
+{
+    struct mbuf *sent = &ctx->databufs[ctx->databufidxfill ^ 1];
+    struct mbuf *fill = &ctx->databufs[ctx->databufidxfill];
+
+    mbuf_insert(fill, 0, sent->buf, sent->len);
+    sent->len = 0;
+    ctx->fill_lines += ctx->sent_lines;
+    ctx->sent_lines = 0;
+    ctx->fill_since = mg_time();
+    ctx->stat_retries++;
+    influx_trim_buffer(ctx);
+
+    ctx->backoff  = ctx->backoff > 0 ? ctx->backoff * 2 : 1.0;
+    if (ctx->backoff > INFLUX_MAX_BACKOFF)
+        ctx->backoff = INFLUX_MAX_BACKOFF;
+    ctx->retry_at = mg_time() + ctx->backoff;
+    influx_schedule(ctx, ctx->retry_at);
+}
+
+static void influx_client_reply(influx_client_t *ctx, int resp_code, struct http_message *hm)
+{
+    struct mbuf *sent = &ctx->databufs[ctx->databufidxfill ^ 1];
+
+    ctx->busy = 0;
+    if (resp_code >= 200 && resp_code < 300) {
+        ctx->stat_lines += ctx->sent_lines;
+        ctx->sent_lines = 0;
+        sent->len       = 0;
+        ctx->backoff    = 0;
+    }
+    else if (resp_code == 429 || resp_code >= 500) {
+        // server busy or unavailable, keep the data
+        if (ctx->prev_resp_code != resp_code)
+            fprintf(stderr, "InfluxDB replied HTTP code: %d, will retry\n", resp_code);
+        influx_retry(ctx);
+    }
+    else {
+        // the data was rejected, retrying won't help
+        if (ctx->prev_resp_code != resp_code)
+            fprintf(stderr, "InfluxDB replied HTTP code: %d with message:\n%.*s\n", resp_code, (int)hm->body.len, hm->body.p);
+        ctx->stat_dropped += ctx->sent_lines;
+        ctx->sent_lines = 0;
+        sent->len       = 0;
+    }
+    ctx->prev_resp_code = resp_code;
+}
+
 static void influx_client_event(struct mg_connection *nc, int ev, void *ev_data)
 {
     // note that while shutting down the ctx is NULL
@@ -54,68 +157,177 @@ static void influx_client_event(struct mg_connection *nc, int ev, void *ev_data)
         int connect_status = *(int *)ev_data;
         if (connect_status != 0) {
             // Error, print only once
-            if (ctx) {
-                if (ctx->prev_status != connect_status)
-                    fprintf(stderr, "InfluxDB connect error: %s\n", strerror(connect_status));
-                ctx->conn = NULL;
-            }
+            if (ctx && ctx->prev_status != connect_status)
+                fprintf(stderr, "InfluxDB connect error: %s\n", strerror(connect_status));
         }
         if (ctx)
             ctx->prev_status = connect_status;
         break;
     }
-    case MG_EV_HTTP_CHUNK: // response is normally empty (so mongoose thinks we received a chunk only)
+    case MG_EV_HTTP_CHUNK:
+        // a 204 response has no Content-Length, mongoose would wait for the body until the connection closes
+        if (hm->resp_code != 204)
+            break;
+        mbuf_remove(&nc->recv_mbuf, nc->recv_mbuf.len);
+        // fall through
     case MG_EV_HTTP_REPLY:
-        nc->flags |= MG_F_CLOSE_IMMEDIATELY;
-        if (hm->resp_code == 204) {
-            // mark influx data as sent
-        }
-        else {
-            if (ctx && ctx->prev_resp_code != hm->resp_code)
-                fprintf(stderr, "InfluxDB replied HTTP code: %d with message:\n%s\n", hm->resp_code, hm->body.p);
-        }
-        if (ctx) {
-            ctx->prev_resp_code = hm->resp_code;
+        if (ctx && ctx->conn == nc && ctx->busy) {
+            influx_client_reply(ctx, hm->resp_code, hm);
+            influx_client_send(ctx);
         }
         break;
+    case MG_EV_POLL:
+        if (ctx && ctx->conn == nc)
+            influx_client_send(ctx);
+        break;
     case MG_EV_CLOSE:
-        if (ctx) {
+        if (ctx && ctx->conn == nc) {
             ctx->conn = NULL;
+            if (ctx->busy) {
+                // connection lost with a request in-flight
+                ctx->busy = 0;
+                influx_retry(ctx);
+            }
             influx_client_send(ctx);
         }
         break;
     }
 }
 
+static void influx_timer_event(struct mg_connection *nc, int ev, void *ev_data)
+{
+    UNUSED(ev_data);
+    // note that while shutting down the ctx is NULL
+    influx_client_t *ctx = (influx_client_t *)nc->user_data;
+
+    if (ev == MG_EV_TIMER && ctx)
+        influx_client_send(ctx);
+}
+
 static influx_client_t *influx_client_init(influx_client_t *ctx, char const *url, char const *token)
 {
     strncpy(ctx->url, url, sizeof(ctx->url));
     ctx->url[sizeof(ctx->url) - 1] = '\0';
-    snprintf(ctx->extra_headers, sizeof (ctx->extra_headers), "Authorization: Token %s\r\n", token);
+
+    struct mg_str scheme, user_info, host, path, query;
+    unsigned port = 0;
+    mg_parse_uri(mg_mk_str(ctx->url), &scheme, &user_info, &host, &port, &path, &query, NULL);
+    ctx->use_ssl = mg_vcmp(&scheme, "https") == 0;
+    if (!port)
+        port = ctx->use_ssl ? 443 : 80;
+    snprintf(ctx->address, sizeof(ctx->address), "tcp://%.*s:%u", (int)host.len, host.p, port);
+    snprintf(ctx->host, sizeof(ctx->host), "%.*s", (int)host.len, host.p);
+    if (query.len)
+        snprintf(ctx->path, sizeof(ctx->path), "%.*s?%.*s", (int)path.len, path.p, (int)query.len, query.p);
+    else
+        snprintf(ctx->path, sizeof(ctx->path), "%.*s", (int)path.len, path.p);
+
+    char *headers = ctx->extra_headers;
+    size_t size   = sizeof(ctx->extra_headers);
+    int len       = 0;
+    if (user_info.len) {
+        struct mbuf auth;
+        mbuf_init(&auth, 0);
+        mg_basic_auth_header(user_info, mg_mk_str(NULL), &auth);
+        len += snprintf(headers + len, size - len, "%.*s", (int)auth.len, auth.buf);
+        mbuf_free(&auth);
+    }
+    if (token)
+        len += snprintf(headers + len, size - len, "Authorization: Token %s\r\n", token);
+    if (ctx->gzip)
+        snprintf(headers + len, size - len, "Content-Encoding: gzip\r\n");
 
     return ctx;
 }
 
+#ifdef ZLIB
+/// gzip the data into out, returns 0 on success
+static int influx_gzip(struct mbuf *in, struct mbuf *out)
+{
+    z_stream strm = {0};
+    if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return -1;
+
+    mbuf_resize(out, deflateBound(&strm, in->len));
+    strm.next_in   = (Bytef *)in->buf;
+    strm.avail_in  = in->len;
+    strm.next_out  = (Bytef *)out->buf;
+    strm.avail_out = out->size;
+    int ret        = deflate(&strm, Z_FINISH);
+    out->len       = strm.total_out;
+    deflateEnd(&strm);
+
+    return ret == Z_STREAM_END ? 0 : -1;
+}
+#endif
+
 static void influx_client_send(influx_client_t *ctx)
 {
     struct mbuf *buf = &ctx->databufs[ctx->databufidxfill];
 
-    /*fprintf(stderr, "Influx %p msg: \"%s\" with %lu/%lu %s\n",
-            (void*)ctx, buf->buf, buf->len, buf->size,
-            ctx->conn ? "buffering" : "to be sent");*/
+    if (ctx->busy || !buf->len)
+        return;
 
-    if (ctx->conn || !buf->len)
+    double now = mg_time();
+    if (now < ctx->retry_at) {
+        influx_schedule(ctx, ctx->retry_at);
+        return;
+    }
+    if ((int)ctx->fill_lines < ctx->batch_size && now - ctx->fill_since < ctx->flush_interval) {
+        influx_schedule(ctx, ctx->fill_since + ctx->flush_interval);
         return;
+    }
 
-    struct mg_connect_opts opts = {.user_data = ctx};
-    if ((ctx->conn = mg_connect_http_opt(ctx->mgr, influx_client_event, opts, ctx->url, ctx->extra_headers, buf->buf)) == NULL) {
-        fprintf(stderr, "Connect to InfluxDB (%s) failed\n", ctx->url);
+    if (!ctx->conn) {
+        struct mg_connect_opts opts = {.user_data = ctx};
+#if MG_ENABLE_SSL
+        if (ctx->use_ssl)
+            opts.ssl_ca_cert = "*"; // TLS is enabled but no cert verification is performed.
+#endif
+        ctx->conn = mg_connect_opt(ctx->mgr, ctx->address, influx_client_event, opts);
+        if (!ctx->conn) {
+            fprintf(stderr, "Connect to InfluxDB (%s) failed\n", ctx->url);
+            ctx->backoff  = ctx->backoff > 0 ? ctx->backoff * 2 : 1.0;
+            if (ctx->backoff > INFLUX_MAX_BACKOFF)
+                ctx->backoff = INFLUX_MAX_BACKOFF;
+            ctx->retry_at = now + ctx->backoff;
+            influx_schedule(ctx, ctx->retry_at);
+            return;
+        }
+        mg_set_protocol_http_websocket(ctx->conn);
     }
-    else {
-        ctx->databufidxfill ^= 1;
-        buf->len = 0;
-        *buf->buf = '\0';
+
+    char const *body = buf->buf;
+    size_t body_len  = buf->len;
+#ifdef ZLIB
+    struct mbuf zbuf;
+    mbuf_init(&zbuf, 0);
+    if (ctx->gzip) {
+        if (influx_gzip(buf, &zbuf)) {
+            fprintf(stderr, "InfluxDB gzip failed\n");
+            mbuf_free(&zbuf);
+            return;
+        }
+        body     = zbuf.buf;
+        body_len = zbuf.len;
     }
+#endif
+
+    mg_printf(ctx->conn, "POST %s HTTP/1.1\r\nHost: %s\r\nContent-Length: %zu\r\n%s\r\n",
+            ctx->path, ctx->host, body_len, ctx->extra_headers);
+    mg_send(ctx->conn, body, body_len);
+#ifdef ZLIB
+    mbuf_free(&zbuf);
+#endif
+
+    // swap buffers, the sent data is kept in case of a retry
+    ctx->busy = 1;
+    ctx->stat_requests++;
+    ctx->sent_lines = ctx->fill_lines;
+    ctx->fill_lines = 0;
+    ctx->databufidxfill ^= 1;
+    buf = &ctx->databufs[ctx->databufidxfill];
+    buf->len = 0;
 }
 
 /* Helper */
@@ -370,8 +582,15 @@ static void print_influx_data(data_output_t *output, data_t *data, char const *f
         }
     }
     mbuf_snprintf(buf, "\n");
+    data_output_mark_serialized(output);
+
+    if (!influx->fill_lines)
+        influx->fill_since = mg_time();
+    influx->fill_lines++;
+    influx_trim_buffer(influx);
 
     influx_client_send(influx);
+    data_output_mark_queued(output); // batched, sent once the batch is due
 }
 
 static void print_influx_double(data_output_t *output, double data, char const *format)
@@ -390,6 +609,61 @@ static void print_influx_int(data_output_t *output, int data, char const *format
     mbuf_snprintf(buf, "%d", data);
 }
 
+static data_t *data_output_influx_stats(data_output_t *output)
+{
+    influx_client_t *influx = (influx_client_t *)output;
+
+    return data_make(
+            "output",           "", DATA_STRING, "influx",
+            "connected",        "", DATA_INT, influx->conn != NULL,
+            "buffered",         "", DATA_INT, influx->fill_lines + influx->sent_lines,
+            "buffered_bytes",   "", DATA_INT, (int)(influx->databufs[0].len + influx->databufs[1].len),
+            "requests",         "", DATA_INT, influx->stat_requests,
+            "sent",             "", DATA_INT, influx->stat_lines,
+            "retries",          "", DATA_INT, influx->stat_retries,
+            "dropped",          "", DATA_INT, influx->stat_dropped,
+            NULL);
+}
+
+static double influx_connected(void *ctx)
+{
+    influx_client_t *influx = ctx;
+    return influx->conn != NULL;
+}
+
+static double influx_buffered(void *ctx)
+{
+    influx_client_t *influx = ctx;
+    return influx->fill_lines + influx->sent_lines;
+}
+
+static double influx_buffered_bytes(void *ctx)
+{
+    influx_client_t *influx = ctx;
+    return influx->databufs[0].len + influx->databufs[1].len;
+}
+
+static void data_output_influx_metrics(data_output_t *output, metrics_t *metrics, char const *labels)
+{
+    influx_client_t *influx = (influx_client_t *)output;
+
+    metric_family_t *family;
+    family = metrics_family(metrics, "rtl_433_output_connected", "Output connected to the server.", METRIC_GAUGE);
+    metric_add_fn(family, labels, influx_connected, influx);
+    family = metrics_family(metrics, "rtl_433_output_queued", "Messages waiting to be sent by the output.", METRIC_GAUGE);
+    metric_add_fn(family, labels, influx_buffered, influx);
+    family = metrics_family(metrics, "rtl_433_output_pending_bytes", "Bytes waiting to be sent by the output.", METRIC_GAUGE);
+    metric_add_fn(family, labels, influx_buffered_bytes, influx);
+    family = metrics_family(metrics, "rtl_433_output_requests_total", "Requests made by the output.", METRIC_COUNTER);
+    metric_add_unsigned(family, labels, &influx->stat_requests);
+    family = metrics_family(metrics, "rtl_433_output_sent_total", "Messages sent by the output.", METRIC_COUNTER);
+    metric_add_unsigned(family, labels, &influx->stat_lines);
+    family = metrics_family(metrics, "rtl_433_output_retries_total", "Requests retried by the output.", METRIC_COUNTER);
+    metric_add_unsigned(family, labels, &influx->stat_retries);
+    family = metrics_family(metrics, "rtl_433_output_dropped_total", "Messages dropped by the output.", METRIC_COUNTER);
+    metric_add_unsigned(family, labels, &influx->stat_dropped);
+}
+
 static void data_output_influx_free(data_output_t *output)
 {
     influx_client_t *influx = (influx_client_t *)output;
@@ -402,7 +676,13 @@ static void data_output_influx_free(data_output_t *output)
         influx->conn->user_data = NULL;
         influx->conn->flags |= MG_F_CLOSE_IMMEDIATELY;
     }
+    if (influx->timer) {
+        influx->timer->user_data = NULL;
+        influx->timer->flags |= MG_F_CLOSE_IMMEDIATELY;
+    }
 
+    mbuf_free(&influx->databufs[0]);
+    mbuf_free(&influx->databufs[1]);
     free(influx);
 }
 
@@ -422,6 +702,8 @@ struct data_output *data_output_influx_create(struct mg_mgr *mgr, char *opts)
     influx_sanitize_tag(influx->hostname, NULL);
 
     char *token = NULL;
+    influx->batch_size = INFLUX_DEFAULT_BATCH_SIZE;
+    influx->max_buffer = INFLUX_DEFAULT_MAX_BUFFER;
 
     // param/opts starts with URL
     char *url = opts;
@@ -457,6 +739,21 @@ struct data_output *data_output_influx_create(struct mg_mgr *mgr, char *opts)
             continue;
         else if (!strcasecmp(key, "t") || !strcasecmp(key, "token"))
             token = val;
+        else if (!strcasecmp(key, "batch_size"))
+            influx->batch_size = atoiv(val, INFLUX_DEFAULT_BATCH_SIZE);
+        else if (!strcasecmp(key, "flush_interval"))
+            influx->flush_interval = atoiv(val, 1000) / 1000.0;
+        else if (!strcasecmp(key, "max_buffer"))
+            influx->max_buffer = atoiv(val, INFLUX_DEFAULT_MAX_BUFFER);
+        else if (!strcasecmp(key, "gzip")) {
+            influx->gzip = atobv(val, 1);
+#ifndef ZLIB
+            if (influx->gzip) {
+                fprintf(stderr, "InfluxDB gzip not available\n");
+                exit(1);
+            }
+#endif
+        }
         else {
             fprintf(stderr, "Invalid key \"%s\" option.\n", key);
             exit(1);
@@ -469,11 +766,20 @@ struct data_output *data_output_influx_create(struct mg_mgr *mgr, char *opts)
     influx->output.print_double = print_influx_double;
     influx->output.print_int    = print_influx_int;
     influx->output.output_free  = data_output_influx_free;
+    influx->output.output_stats = data_output_influx_stats;
+    influx->output.output_metrics = data_output_influx_metrics;
 
     fprintf(stderr, "Publishing data to InfluxDB (%s)\n", url);
 
     influx->mgr = mgr;
     influx_client_init(influx, url, token);
 
+    // flush_interval and retries are due without any connection or new data
+    struct mg_add_sock_opts timer_opts = {.user_data = influx};
+    influx->timer = mg_add_sock_opt(mgr, INVALID_SOCKET, influx_timer_event, timer_opts);
+    if (!influx->timer) {
+        FATAL("data_output_influx_create()");
+    }
+
     return &influx->output;
 }
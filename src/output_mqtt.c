@@ -13,6 +13,7 @@
 #include "output_mqtt.h"
 #include "optparse.h"
 #include "util.h"
+#include "metrics.h"
 #include "fatal.h"
 #include "r_util.h"
 
@@ -24,17 +25,159 @@
 
 /* MQTT client abstraction */
 
+#define MQTT_DEFAULT_QUEUE_SIZE 1000
+#define MQTT_DEFAULT_MAX_INFLIGHT 20
+#define MQTT_MAX_SEND_BUFFER 65536 // don't pile up more than this in the socket buffer
+#define MQTT_MAX_SPOOL_SIZE (16 * 1024 * 1024)
+#define MQTT_MAX_TOPIC_LEN 65535 // MQTT limit
+#define MQTT_TOPIC_BUCKETS 256 // index of the messages held back for coalescing
+#define MQTT_PUBLISH_DUP 0x8 // DUP flag of the fixed header, mongoose's MG_MQTT_DUP 0x4 overlaps the QoS bits
+
+typedef struct mqtt_msg {
+    struct mqtt_msg *next;
+    struct mqtt_msg *topic_next; ///< next coalescing message in the same topic bucket
+    double queued; ///< time of enqueue, for latency
+    double due;    ///< earliest time to publish, later for coalescing messages
+    int coalesce;  ///< a later message with the same topic replaces this one
+    int sent;      ///< published before, now sent again after a reconnect
+    uint16_t message_id; ///< while waiting for the acknowledgement, kept for a resend
+    char *topic;
+    char *payload;
+} mqtt_msg_t;
+
 typedef struct mqtt_client {
     struct mg_connect_opts connect_opts;
     struct mg_send_mqtt_handshake_opts mqtt_opts;
     struct mg_connection *conn;
     int prev_status;
+    int connected; ///< set on CONNACK, cleared on close
     char address[253 + 6 + 1]; // dns max + port
     char client_id[256];
     uint16_t message_id;
     int publish_flags; // MG_MQTT_RETAIN | MG_MQTT_QOS(0)
+    // outbound queue
+    mqtt_msg_t *head;
+    mqtt_msg_t *tail;
+    unsigned queue_len;
+    unsigned queue_size;
+    mqtt_msg_t *topics[MQTT_TOPIC_BUCKETS]; ///< queued messages held back for coalescing, by topic
+    // published messages kept until acknowledged, sent again on reconnect
+    mqtt_msg_t *inflight_head;
+    mqtt_msg_t *inflight_tail;
+    unsigned inflight;
+    unsigned max_inflight;
+    double coalesce_window; ///< seconds
+    // spool for overflow while disconnected
+    char *spool_path;
+    FILE *spool;
+    long spool_rpos;
+    long spool_wpos;
+    unsigned spool_len;
+    // stats
+    unsigned published;
+    unsigned resent;
+    unsigned coalesced;
+    unsigned dropped;
+    double latency_sum;
+    double latency_max;
 } mqtt_client_t;
 
+static void mqtt_client_flush(mqtt_client_t *ctx);
+
+static void mqtt_msg_free(mqtt_msg_t *msg)
+{
+    free(msg->topic);
+    free(msg->payload);
+    free(msg);
+}
+
+// FNV-1a
+static unsigned hash_str(char const *s)
+{
+    unsigned h = 2166136261u;
+    for (; *s; ++s) {
+        h ^= (unsigned char)*s;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static mqtt_msg_t **mqtt_topic_bucket(mqtt_client_t *ctx, char const *topic)
+{
+    return &ctx->topics[hash_str(topic) % MQTT_TOPIC_BUCKETS];
+}
+
+static mqtt_msg_t *mqtt_topic_find(mqtt_client_t *ctx, char const *topic)
+{
+    for (mqtt_msg_t *msg = *mqtt_topic_bucket(ctx, topic); msg; msg = msg->topic_next) {
+        if (!strcmp(msg->topic, topic))
+            return msg;
+    }
+    return NULL;
+}
+
+static void mqtt_topic_remove(mqtt_client_t *ctx, mqtt_msg_t *msg)
+{
+    for (mqtt_msg_t **p = mqtt_topic_bucket(ctx, msg->topic); *p; p = &(*p)->topic_next) {
+        if (*p == msg) {
+            *p = msg->topic_next;
+            break;
+        }
+    }
+    msg->topic_next = NULL;
+}
+
+static void mqtt_inflight_push(mqtt_client_t *ctx, mqtt_msg_t *msg)
+{
+    if (ctx->inflight_tail)
+        ctx->inflight_tail->next = msg;
+    else
+        ctx->inflight_head = msg;
+    ctx->inflight_tail = msg;
+    ctx->inflight++;
+}
+
+/// Release the message acknowledged by a PUBACK or PUBCOMP.
+static void mqtt_inflight_ack(mqtt_client_t *ctx, uint16_t message_id)
+{
+    mqtt_msg_t *prev = NULL;
+    for (mqtt_msg_t *msg = ctx->inflight_head; msg; prev = msg, msg = msg->next) {
+        if (msg->message_id != message_id)
+            continue;
+        if (prev)
+            prev->next = msg->next;
+        else
+            ctx->inflight_head = msg->next;
+        if (ctx->inflight_tail == msg)
+            ctx->inflight_tail = prev;
+        ctx->inflight--;
+        mqtt_msg_free(msg);
+        return;
+    }
+}
+
+/// Put unacknowledged messages back in front of the queue, in order.
+static void mqtt_inflight_requeue(mqtt_client_t *ctx)
+{
+    if (!ctx->inflight_head)
+        return;
+    ctx->inflight_tail->next = ctx->head;
+    if (!ctx->tail)
+        ctx->tail = ctx->inflight_tail;
+    ctx->head = ctx->inflight_head;
+    ctx->queue_len += ctx->inflight;
+    ctx->inflight_head = NULL;
+    ctx->inflight_tail = NULL;
+    ctx->inflight      = 0;
+}
+
+typedef struct mqtt_queue_opts {
+    int queue_size;
+    int max_inflight;
+    int coalesce_ms;
+    char const *spool_file;
+} mqtt_queue_opts_t;
+
 static void mqtt_client_event(struct mg_connection *nc, int ev, void *ev_data)
 {
     // note that while shutting down the ctx is NULL
@@ -70,10 +213,23 @@ static void mqtt_client_event(struct mg_connection *nc, int ev, void *ev_data)
         }
         else {
             fprintf(stderr, "MQTT Connection established.\n");
+            if (ctx) {
+                ctx->connected = 1;
+                mqtt_client_flush(ctx);
+            }
         }
         break;
     case MG_EV_MQTT_PUBACK:
-        fprintf(stderr, "MQTT Message publishing acknowledged (msg_id: %d)\n", msg->message_id);
+    case MG_EV_MQTT_PUBCOMP:
+        if (ctx)
+            mqtt_inflight_ack(ctx, msg->message_id);
+        break;
+    case MG_EV_MQTT_PUBREC:
+        mg_mqtt_pubrel(nc, msg->message_id);
+        break;
+    case MG_EV_POLL:
+        if (ctx && ctx->conn == nc)
+            mqtt_client_flush(ctx);
         break;
     case MG_EV_MQTT_SUBACK:
         fprintf(stderr, "MQTT Subscription acknowledged.\n");
@@ -88,6 +244,9 @@ static void mqtt_client_event(struct mg_connection *nc, int ev, void *ev_data)
             break; // shuttig down
         if (ctx->prev_status == 0)
             fprintf(stderr, "MQTT Connection failed...\n");
+        // the queue is kept for the next connection, unacknowledged messages are sent again
+        ctx->connected = 0;
+        mqtt_inflight_requeue(ctx);
         // reconnect
         char const *error_string = NULL;
         ctx->connect_opts.error_string = &error_string;
@@ -101,12 +260,32 @@ static void mqtt_client_event(struct mg_connection *nc, int ev, void *ev_data)
     }
 }
 
-static mqtt_client_t *mqtt_client_init(struct mg_mgr *mgr, tls_opts_t *tls_opts, char const *host, char const *port, char const *user, char const *pass, char const *client_id, int retain, int qos)
+static void mqtt_spool_scan(mqtt_client_t *ctx);
+
+static mqtt_client_t *mqtt_client_init(struct mg_mgr *mgr, tls_opts_t *tls_opts, char const *host, char const *port, char const *user, char const *pass, char const *client_id, int retain, int qos, mqtt_queue_opts_t *queue_opts)
 {
     mqtt_client_t *ctx = calloc(1, sizeof(*ctx));
     if (!ctx)
         FATAL_CALLOC("mqtt_client_init()");
 
+    ctx->queue_size      = queue_opts->queue_size;
+    ctx->max_inflight    = queue_opts->max_inflight;
+    ctx->coalesce_window = queue_opts->coalesce_ms / 1000.0;
+    if (queue_opts->spool_file) {
+        ctx->spool_path = strdup(queue_opts->spool_file);
+        if (!ctx->spool_path)
+            FATAL_STRDUP("mqtt_client_init()");
+        // keep what a previous run left in the spool
+        ctx->spool = fopen(ctx->spool_path, "r+b");
+        if (!ctx->spool)
+            ctx->spool = fopen(ctx->spool_path, "w+b");
+        if (!ctx->spool) {
+            fprintf(stderr, "MQTT failed to open spool file \"%s\"\n", queue_opts->spool_file);
+            exit(1);
+        }
+        mqtt_spool_scan(ctx);
+    }
+
     ctx->mqtt_opts.user_name = user;
     ctx->mqtt_opts.password  = pass;
     ctx->publish_flags  = MG_MQTT_QOS(qos) | (retain ? MG_MQTT_RETAIN : 0);
@@ -151,13 +330,316 @@ static mqtt_client_t *mqtt_client_init(struct mg_mgr *mgr, tls_opts_t *tls_opts,
     return ctx;
 }
 
-static void mqtt_client_publish(mqtt_client_t *ctx, char const *topic, char const *str)
+static mqtt_msg_t *mqtt_msg_create(char const *topic, char const *payload)
+{
+    mqtt_msg_t *msg = calloc(1, sizeof(*msg));
+    if (!msg) {
+        WARN_CALLOC("mqtt_msg_create()");
+        return NULL;
+    }
+    msg->topic = strdup(topic);
+    if (!msg->topic) {
+        WARN_STRDUP("mqtt_msg_create()");
+        free(msg);
+        return NULL;
+    }
+    msg->payload = strdup(payload);
+    if (!msg->payload) {
+        WARN_STRDUP("mqtt_msg_create()");
+        free(msg->topic);
+        free(msg);
+        return NULL;
+    }
+    return msg;
+}
+
+static void mqtt_queue_push(mqtt_client_t *ctx, mqtt_msg_t *msg)
+{
+    if (ctx->tail)
+        ctx->tail->next = msg;
+    else
+        ctx->head = msg;
+    ctx->tail = msg;
+    ctx->queue_len++;
+    if (msg->coalesce) {
+        mqtt_msg_t **bucket = mqtt_topic_bucket(ctx, msg->topic);
+        msg->topic_next     = *bucket;
+        *bucket             = msg;
+    }
+}
+
+static mqtt_msg_t *mqtt_queue_unlink(mqtt_client_t *ctx, mqtt_msg_t *prev, mqtt_msg_t *msg)
+{
+    if (prev)
+        prev->next = msg->next;
+    else
+        ctx->head = msg->next;
+    if (ctx->tail == msg)
+        ctx->tail = prev;
+    ctx->queue_len--;
+    msg->next = NULL;
+    if (msg->coalesce) {
+        mqtt_topic_remove(ctx, msg);
+        msg->coalesce = 0; // no longer pending, never replaced
+    }
+    return msg;
+}
+
+// spool records are "<mark> <topic_len> <payload_len> <queued>\n<topic><payload>",
+// the mark is '+' for a waiting message and '-' once the message is taken from the spool
+static int mqtt_spool_write(mqtt_client_t *ctx, mqtt_msg_t *msg)
+{
+    if (ctx->spool_wpos >= MQTT_MAX_SPOOL_SIZE)
+        return -1;
+
+    fseek(ctx->spool, ctx->spool_wpos, SEEK_SET);
+    fprintf(ctx->spool, "+ %zu %zu %f\n", strlen(msg->topic), strlen(msg->payload), msg->queued);
+    fputs(msg->topic, ctx->spool);
+    fputs(msg->payload, ctx->spool);
+    if (ferror(ctx->spool)) {
+        clearerr(ctx->spool);
+        return -1;
+    }
+    ctx->spool_wpos = ftell(ctx->spool);
+    ctx->spool_len++;
+    return 0;
+}
+
+/// Empty and truncate the spool.
+static void mqtt_spool_reset(mqtt_client_t *ctx)
+{
+    ctx->spool_rpos = ctx->spool_wpos = 0;
+    ctx->spool_len  = 0;
+    ctx->spool      = freopen(ctx->spool_path, "w+b", ctx->spool);
+    if (!ctx->spool)
+        fprintf(stderr, "MQTT failed to reopen spool file \"%s\", spooling stopped\n", ctx->spool_path);
+}
+
+/// Parse a record header, returns the mark or 0 if the record is invalid.
+static int mqtt_spool_header(mqtt_client_t *ctx, size_t *topic_len, size_t *payload_len, double *queued)
+{
+    char mark;
+    if (fscanf(ctx->spool, "%c %zu %zu %lf", &mark, topic_len, payload_len, queued) != 4
+            || fgetc(ctx->spool) != '\n'
+            || (mark != '+' && mark != '-')
+            || *topic_len > MQTT_MAX_TOPIC_LEN
+            || *payload_len > MQTT_MAX_SPOOL_SIZE)
+        return 0;
+    return mark;
+}
+
+/// Find the waiting messages a previous run left in the spool, these are sent first.
+static void mqtt_spool_scan(mqtt_client_t *ctx)
+{
+    size_t topic_len;
+    size_t payload_len;
+    double queued;
+
+    fseek(ctx->spool, 0, SEEK_END);
+    long size = ftell(ctx->spool);
+    long pos  = 0;
+    rewind(ctx->spool);
+    while (pos < size) {
+        int mark = mqtt_spool_header(ctx, &topic_len, &payload_len, &queued);
+        if (!mark)
+            break;
+        long end = ftell(ctx->spool) + (long)(topic_len + payload_len);
+        if (end > size)
+            break; // truncated record
+        if (mark == '+' && !ctx->spool_len++)
+            ctx->spool_rpos = pos;
+        pos = end;
+        fseek(ctx->spool, pos, SEEK_SET);
+    }
+
+    if (!ctx->spool_len) {
+        mqtt_spool_reset(ctx);
+        return;
+    }
+    ctx->spool_wpos = pos;
+    fprintf(stderr, "MQTT spool file has %u messages to send\n", ctx->spool_len);
+}
+
+static mqtt_msg_t *mqtt_spool_read(mqtt_client_t *ctx)
+{
+    size_t topic_len;
+    size_t payload_len;
+    double queued;
+
+    fseek(ctx->spool, ctx->spool_rpos, SEEK_SET);
+    if (mqtt_spool_header(ctx, &topic_len, &payload_len, &queued) != '+') {
+        fprintf(stderr, "MQTT spool file corrupt, discarding %u messages\n", ctx->spool_len);
+        ctx->dropped += ctx->spool_len;
+        mqtt_spool_reset(ctx);
+        return NULL;
+    }
+
+    mqtt_msg_t *msg = calloc(1, sizeof(*msg));
+    if (!msg) {
+        WARN_CALLOC("mqtt_spool_read()");
+        return NULL;
+    }
+    msg->topic = malloc(topic_len + 1);
+    if (!msg->topic) {
+        WARN_MALLOC("mqtt_spool_read()");
+        mqtt_msg_free(msg);
+        return NULL;
+    }
+    msg->payload = malloc(payload_len + 1);
+    if (!msg->payload) {
+        WARN_MALLOC("mqtt_spool_read()");
+        mqtt_msg_free(msg);
+        return NULL;
+    }
+    if (fread(msg->topic, 1, topic_len, ctx->spool) != topic_len
+            || fread(msg->payload, 1, payload_len, ctx->spool) != payload_len) {
+        fprintf(stderr, "MQTT spool file truncated, discarding %u messages\n", ctx->spool_len);
+        ctx->dropped += ctx->spool_len;
+        mqtt_spool_reset(ctx);
+        mqtt_msg_free(msg);
+        return NULL;
+    }
+    msg->topic[topic_len]     = '\0';
+    msg->payload[payload_len] = '\0';
+    msg->queued = queued;
+    msg->due    = queued;
+
+    // mark the record as taken, a restart only sends the rest
+    long next = ftell(ctx->spool);
+    fseek(ctx->spool, ctx->spool_rpos, SEEK_SET);
+    fputc('-', ctx->spool);
+    fflush(ctx->spool);
+
+    ctx->spool_rpos = next;
+    ctx->spool_len--;
+    if (!ctx->spool_len)
+        mqtt_spool_reset(ctx); // truncate an empty spool
+    return msg;
+}
+
+/// Refill the memory queue from the spool, keeps the queue half full to allow new messages in.
+static void mqtt_spool_refill(mqtt_client_t *ctx)
+{
+    while (ctx->spool_len && ctx->queue_len < ctx->queue_size / 2) {
+        mqtt_msg_t *msg = mqtt_spool_read(ctx);
+        if (!msg)
+            break;
+        mqtt_queue_push(ctx, msg);
+    }
+}
+
+/// Publish all due messages as the connection and in-flight limit allows.
+static void mqtt_client_flush(mqtt_client_t *ctx)
+{
+    if (!ctx->conn || !ctx->conn->proto_handler || !ctx->connected)
+        return;
+
+    int qos    = (ctx->publish_flags >> 1) & 3;
+    double now = mg_time();
+
+    mqtt_msg_t *prev = NULL;
+    mqtt_msg_t *msg  = ctx->head;
+    for (;;) {
+        if (!ctx->head && ctx->spool_len) {
+            mqtt_spool_refill(ctx);
+            prev = NULL;
+            msg  = ctx->head;
+        }
+        if (!msg)
+            break;
+        // skip messages held back for coalescing
+        if (msg->due > now) {
+            prev = msg;
+            msg  = msg->next;
+            continue;
+        }
+        if (qos && ctx->inflight >= ctx->max_inflight)
+            break;
+        if (ctx->conn->send_mbuf.len >= MQTT_MAX_SEND_BUFFER)
+            break;
+
+        mqtt_msg_t *next = msg->next;
+        mqtt_queue_unlink(ctx, prev, msg);
+
+        if (msg->sent) {
+            // a resend keeps the message id and is flagged as duplicate
+            mg_mqtt_publish(ctx->conn, msg->topic, msg->message_id, ctx->publish_flags | MQTT_PUBLISH_DUP, msg->payload, strlen(msg->payload));
+            ctx->resent++;
+        }
+        else {
+            if (!++ctx->message_id)
+                ctx->message_id++; // 0 is not a valid message id
+            msg->message_id = ctx->message_id;
+            mg_mqtt_publish(ctx->conn, msg->topic, msg->message_id, ctx->publish_flags, msg->payload, strlen(msg->payload));
+            double latency = now - msg->queued;
+            ctx->latency_sum += latency;
+            if (latency > ctx->latency_max)
+                ctx->latency_max = latency;
+            ctx->published++;
+        }
+
+        if (qos) {
+            // keep the message until it is acknowledged
+            msg->sent = 1;
+            mqtt_inflight_push(ctx, msg);
+        }
+        else {
+            mqtt_msg_free(msg);
+        }
+        msg = next;
+    }
+}
+
+static void mqtt_client_publish(mqtt_client_t *ctx, char const *topic, char const *str, int coalesce)
 {
-    if (!ctx->conn || !ctx->conn->proto_handler)
+    double now = mg_time();
+
+    // replace a pending message to the same topic, it is always the newest queued to that topic
+    mqtt_msg_t *pending = ctx->coalesce_window > 0 ? mqtt_topic_find(ctx, topic) : NULL;
+    if (pending && !coalesce) {
+        // release the held back message now, so it is not sent after this newer one
+        mqtt_topic_remove(ctx, pending);
+        pending->coalesce = 0;
+        pending->due      = now;
+    }
+    else if (pending) {
+        char *payload = strdup(str);
+        if (!payload) {
+            WARN_STRDUP("mqtt_client_publish()");
+            return;
+        }
+        free(pending->payload);
+        pending->payload = payload;
+        ctx->coalesced++;
         return;
+    }
 
-    ctx->message_id++;
-    mg_mqtt_publish(ctx->conn, topic, ctx->message_id, ctx->publish_flags, str, strlen(str));
+    mqtt_msg_t *msg = mqtt_msg_create(topic, str);
+    if (!msg)
+        return; // NOTE: skip output on alloc failure.
+    msg->queued = now;
+    msg->due    = now;
+    if (coalesce && ctx->coalesce_window > 0) {
+        msg->coalesce = 1;
+        msg->due      = now + ctx->coalesce_window;
+    }
+
+    // keep order: once spooling all new messages go to the spool
+    if (ctx->spool && (ctx->spool_len || ctx->queue_len >= ctx->queue_size)) {
+        if (mqtt_spool_write(ctx, msg))
+            ctx->dropped++;
+        mqtt_msg_free(msg);
+    }
+    else {
+        if (ctx->queue_len >= ctx->queue_size) {
+            // drop the oldest message
+            mqtt_msg_free(mqtt_queue_unlink(ctx, NULL, ctx->head));
+            ctx->dropped++;
+        }
+        mqtt_queue_push(ctx, msg);
+    }
+
+    mqtt_client_flush(ctx);
 }
 
 static void mqtt_client_free(mqtt_client_t *ctx)
@@ -166,6 +648,14 @@ static void mqtt_client_free(mqtt_client_t *ctx)
         ctx->conn->user_data = NULL;
         ctx->conn->flags |= MG_F_CLOSE_IMMEDIATELY;
     }
+    if (ctx) {
+        mqtt_inflight_requeue(ctx);
+        while (ctx->head)
+            mqtt_msg_free(mqtt_queue_unlink(ctx, NULL, ctx->head));
+        if (ctx->spool)
+            fclose(ctx->spool);
+        free(ctx->spool_path);
+    }
     free(ctx);
 }
 
@@ -191,10 +681,21 @@ typedef struct {
     char *devices;
     char *events;
     char *states;
+    struct mqtt_topic *devices_topic;
+    struct mqtt_topic *events_topic;
+    struct mqtt_topic *states_topic;
     //char *homie;
     //char *hass;
 } data_output_mqtt_t;
 
+/// Publish a serialized message to the current topic.
+static void mqtt_publish(data_output_mqtt_t *mqtt, char const *str, int coalesce)
+{
+    data_output_mark_serialized(&mqtt->output);
+    mqtt_client_publish(mqtt->mqc, mqtt->topic, str, coalesce);
+    data_output_mark_queued(&mqtt->output);
+}
+
 static void print_mqtt_array(data_output_t *output, data_array_t *array, char const *format)
 {
     data_output_mqtt_t *mqtt = (data_output_mqtt_t *)output;
@@ -225,48 +726,113 @@ static char *append_topic(char *topic, data_t *data)
     return topic;
 }
 
-static char *expand_topic(char *topic, char const *format, data_t *data, char const *hostname)
+/* MQTT topic format */
+
+typedef enum {
+    TOPIC_LITERAL,
+    TOPIC_TYPE,
+    TOPIC_MODEL,
+    TOPIC_SUBTYPE,
+    TOPIC_CHANNEL,
+    TOPIC_ID,
+    TOPIC_PROTOCOL,
+    TOPIC_NUM_KEYS,
+} topic_token_type_t;
+
+static char const *const topic_keys[TOPIC_NUM_KEYS] = {
+        [TOPIC_TYPE]     = "type",
+        [TOPIC_MODEL]    = "model",
+        [TOPIC_SUBTYPE]  = "subtype",
+        [TOPIC_CHANNEL]  = "channel",
+        [TOPIC_ID]       = "id",
+        [TOPIC_PROTOCOL] = "protocol", // NOTE: needs "-M protocol"
+};
+
+typedef struct topic_token {
+    topic_token_type_t type;
+    char leading_slash;
+    char *text; ///< the literal, or the default for a key
+} topic_token_t;
+
+#define TOPIC_CACHE_SIZE 32
+#define TOPIC_CACHE_KEY_SIZE 128
+
+typedef struct topic_cache_entry {
+    unsigned hash;
+    unsigned key_len;
+    unsigned topic_len;
+    unsigned stamp; ///< for LRU eviction, 0 is unused
+    char key[TOPIC_CACHE_KEY_SIZE];
+    char topic[256];
+} topic_cache_entry_t;
+
+/// A topic format compiled to a token program with a cache of expanded topics.
+typedef struct mqtt_topic {
+    topic_token_t *tokens;
+    int num_tokens;
+    int uses_key[TOPIC_NUM_KEYS];
+    unsigned stamp;
+    topic_cache_entry_t cache[TOPIC_CACHE_SIZE];
+} mqtt_topic_t;
+
+static void mqtt_topic_free(mqtt_topic_t *t)
 {
-    // collect well-known top level keys
-    data_t *data_type    = NULL;
-    data_t *data_model   = NULL;
-    data_t *data_subtype = NULL;
-    data_t *data_channel = NULL;
-    data_t *data_id      = NULL;
-    data_t *data_protocol = NULL;
-    for (data_t *d = data; d; d = d->next) {
-        if (!strcmp(d->key, "type"))
-            data_type = d;
-        else if (!strcmp(d->key, "model"))
-            data_model = d;
-        else if (!strcmp(d->key, "subtype"))
-            data_subtype = d;
-        else if (!strcmp(d->key, "channel"))
-            data_channel = d;
-        else if (!strcmp(d->key, "id"))
-            data_id = d;
-        else if (!strcmp(d->key, "protocol")) // NOTE: needs "-M protocol"
-            data_protocol = d;
+    if (!t)
+        return;
+    for (int i = 0; i < t->num_tokens; ++i)
+        free(t->tokens[i].text);
+    free(t->tokens);
+    free(t);
+}
+
+static void topic_push_token(mqtt_topic_t *t, topic_token_type_t type, char leading_slash, char const *text, size_t text_len)
+{
+    topic_token_t *tokens = realloc(t->tokens, (t->num_tokens + 1) * sizeof(*tokens));
+    if (!tokens)
+        FATAL_REALLOC("topic_push_token()");
+    t->tokens = tokens;
+
+    topic_token_t *token  = &t->tokens[t->num_tokens++];
+    token->type          = type;
+    token->leading_slash = leading_slash;
+    token->text          = NULL;
+    if (text) {
+        token->text = malloc(text_len + 1);
+        if (!token->text)
+            FATAL_MALLOC("topic_push_token()");
+        memcpy(token->text, text, text_len);
+        token->text[text_len] = '\0';
     }
+    if (type != TOPIC_LITERAL)
+        t->uses_key[type] = 1;
+}
+
+/// Compile a topic format like "rtl_433/[hostname]/devices[/model][/id:0]", the hostname is resolved here.
+static mqtt_topic_t *mqtt_topic_compile(char const *format, char const *hostname)
+{
+    mqtt_topic_t *t = calloc(1, sizeof(*t));
+    if (!t)
+        FATAL_CALLOC("mqtt_topic_compile()");
 
     // consume entire format string
     while (format && *format) {
-        data_t *data_token  = NULL;
-        char const *string_token = NULL;
         int leading_slash   = 0;
         char const *t_start = NULL;
         char const *t_end   = NULL;
         char const *d_start = NULL;
         char const *d_end   = NULL;
         // copy until '['
+        char const *l_start = format;
         while (*format && *format != '[')
-            *topic++ = *format++;
+            format++;
+        if (format > l_start)
+            topic_push_token(t, TOPIC_LITERAL, 0, l_start, format - l_start);
         // skip '['
         if (!*format)
             break;
         ++format;
         // read slash
-        if (!leading_slash && (*format < 'a' || *format > 'z')) {
+        if (*format < 'a' || *format > 'z') {
             leading_slash = *format;
             format++;
         }
@@ -288,42 +854,144 @@ static char *expand_topic(char *topic, char const *format, data_t *data, char co
         ++format;
 
         // resolve token
-        if (!strncmp(t_start, "hostname", t_end - t_start))
-            string_token = hostname;
-        else if (!strncmp(t_start, "type", t_end - t_start))
-            data_token = data_type;
-        else if (!strncmp(t_start, "model", t_end - t_start))
-            data_token = data_model;
-        else if (!strncmp(t_start, "subtype", t_end - t_start))
-            data_token = data_subtype;
-        else if (!strncmp(t_start, "channel", t_end - t_start))
-            data_token = data_channel;
-        else if (!strncmp(t_start, "id", t_end - t_start))
-            data_token = data_id;
-        else if (!strncmp(t_start, "protocol", t_end - t_start))
-            data_token = data_protocol;
-        else {
+        topic_token_type_t type = TOPIC_LITERAL;
+        if (!strncmp(t_start, "hostname", t_end - t_start)) {
+            // the hostname is fixed, compile to a literal
+            if (leading_slash)
+                topic_push_token(t, TOPIC_LITERAL, 0, (char const *)&leading_slash, 1);
+            topic_push_token(t, TOPIC_LITERAL, 0, hostname, strlen(hostname));
+            continue;
+        }
+        for (int k = TOPIC_TYPE; k < TOPIC_NUM_KEYS; ++k) {
+            if (!strncmp(t_start, topic_keys[k], t_end - t_start)) {
+                type = k;
+                break;
+            }
+        }
+        if (type == TOPIC_LITERAL) {
             fprintf(stderr, "%s: unknown token \"%.*s\"\n", __func__, (int)(t_end - t_start), t_start);
             exit(1);
         }
+        topic_push_token(t, type, leading_slash, d_start, d_end - d_start);
+    }
 
+    return t;
+}
+
+// key bytes are a tag per used key and the raw value, no formatting needed
+static unsigned topic_cache_key(mqtt_topic_t *t, data_t **values, char *key)
+{
+    unsigned len = 0;
+    for (int k = TOPIC_TYPE; k < TOPIC_NUM_KEYS; ++k) {
+        if (!t->uses_key[k])
+            continue;
+        data_t *d = values[k];
+        if (!d) {
+            key[len++] = '-';
+        }
+        else if (d->type == DATA_INT) {
+            if (len + 1 + sizeof(int) > TOPIC_CACHE_KEY_SIZE)
+                return 0;
+            key[len++] = 'i';
+            memcpy(&key[len], &d->value.v_int, sizeof(int));
+            len += sizeof(int);
+        }
+        else if (d->type == DATA_STRING) {
+            size_t slen = strlen(d->value.v_ptr) + 1;
+            if (len + 1 + slen > TOPIC_CACHE_KEY_SIZE)
+                return 0;
+            key[len++] = 's';
+            memcpy(&key[len], d->value.v_ptr, slen);
+            len += slen;
+        }
+        else {
+            return 0; // not cacheable
+        }
+        if (len + 1 >= TOPIC_CACHE_KEY_SIZE)
+            return 0;
+    }
+    return len;
+}
+
+static unsigned topic_cache_hash(char const *key, unsigned len)
+{
+    unsigned h = 2166136261u; // FNV-1a
+    for (unsigned i = 0; i < len; ++i) {
+        h ^= (unsigned char)key[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static char *mqtt_topic_run(mqtt_topic_t *t, char *topic, data_t **values)
+{
+    for (int i = 0; i < t->num_tokens; ++i) {
+        topic_token_t *token = &t->tokens[i];
+        if (token->type == TOPIC_LITERAL) {
+            topic += sprintf(topic, "%s", token->text);
+            continue;
+        }
+        data_t *data_token = values[token->type];
         // append token or default
-        if (!data_token && !string_token && !d_start)
+        if (!data_token && !token->text)
             continue;
-        if (leading_slash)
-            *topic++ = leading_slash;
+        if (token->leading_slash)
+            *topic++ = token->leading_slash;
         if (data_token)
             topic = append_topic(topic, data_token);
-        else if (string_token)
-            topic += sprintf(topic, "%s", string_token);
         else
-            topic += sprintf(topic, "%.*s", (int)(d_end - d_start), d_start);
+            topic += sprintf(topic, "%s", token->text);
     }
 
     *topic = '\0';
     return topic;
 }
 
+/// Expand the topic for data, returns the end of the topic string.
+static char *mqtt_topic_expand(mqtt_topic_t *t, char *topic, data_t *data)
+{
+    // collect well-known top level keys
+    data_t *values[TOPIC_NUM_KEYS] = {0};
+    for (data_t *d = data; d; d = d->next) {
+        for (int k = TOPIC_TYPE; k < TOPIC_NUM_KEYS; ++k) {
+            if (t->uses_key[k] && !strcmp(d->key, topic_keys[k])) {
+                values[k] = d;
+                break;
+            }
+        }
+    }
+
+    char key[TOPIC_CACHE_KEY_SIZE];
+    unsigned key_len = topic_cache_key(t, values, key);
+    if (!key_len)
+        return mqtt_topic_run(t, topic, values);
+
+    unsigned hash = topic_cache_hash(key, key_len);
+    topic_cache_entry_t *lru = &t->cache[0];
+    for (int i = 0; i < TOPIC_CACHE_SIZE; ++i) {
+        topic_cache_entry_t *e = &t->cache[i];
+        if (e->stamp && e->hash == hash && e->key_len == key_len && !memcmp(e->key, key, key_len)) {
+            e->stamp = ++t->stamp;
+            memcpy(topic, e->topic, e->topic_len + 1);
+            return topic + e->topic_len;
+        }
+        if (e->stamp < lru->stamp)
+            lru = e;
+    }
+
+    char *end = mqtt_topic_run(t, topic, values);
+    unsigned topic_len = end - topic;
+    if (topic_len < sizeof(lru->topic)) {
+        lru->hash      = hash;
+        lru->key_len   = key_len;
+        lru->topic_len = topic_len;
+        lru->stamp     = ++t->stamp;
+        memcpy(lru->key, key, key_len);
+        memcpy(lru->topic, topic, topic_len + 1);
+    }
+    return end;
+}
+
 // <prefix>[/type][/model][/subtype][/channel][/id]/battery: "OK"|"LOW"
 static void print_mqtt_data(data_output_t *output, data_t *data, char const *format)
 {
@@ -352,8 +1020,8 @@ static void print_mqtt_data(data_output_t *output, data_t *data, char const *for
                     return; // NOTE: skip output on alloc failure.
                 }
                 data_print_jsons(data, message, message_size);
-                expand_topic(mqtt->topic, mqtt->states, data, mqtt->hostname);
-                mqtt_client_publish(mqtt->mqc, mqtt->topic, message);
+                mqtt_topic_expand(mqtt->states_topic, mqtt->topic, data);
+                mqtt_publish(mqtt, message, 0);
                 *mqtt->topic = '\0'; // clear topic
                 free(message);
             }
@@ -364,8 +1032,8 @@ static void print_mqtt_data(data_output_t *output, data_t *data, char const *for
         if (mqtt->events) {
             char message[2048]; // we expect the biggest strings to be around 500 bytes.
             data_print_jsons(data, message, sizeof(message));
-            expand_topic(mqtt->topic, mqtt->events, data, mqtt->hostname);
-            mqtt_client_publish(mqtt->mqc, mqtt->topic, message);
+            mqtt_topic_expand(mqtt->events_topic, mqtt->topic, data);
+            mqtt_publish(mqtt, message, 0);
             *mqtt->topic = '\0'; // clear topic
         }
 
@@ -374,7 +1042,7 @@ static void print_mqtt_data(data_output_t *output, data_t *data, char const *for
             return;
         }
 
-        end = expand_topic(mqtt->topic, mqtt->devices, data, mqtt->hostname);
+        end = mqtt_topic_expand(mqtt->devices_topic, mqtt->topic, data);
     }
 
     while (data) {
@@ -399,7 +1067,8 @@ static void print_mqtt_string(data_output_t *output, char const *str, char const
 {
     UNUSED(format);
     data_output_mqtt_t *mqtt = (data_output_mqtt_t *)output;
-    mqtt_client_publish(mqtt->mqc, mqtt->topic, str);
+    // per-field "devices" topics may be coalesced
+    mqtt_publish(mqtt, str, 1);
 }
 
 static void print_mqtt_double(data_output_t *output, double data, char const *format)
@@ -428,6 +1097,73 @@ static void print_mqtt_int(data_output_t *output, int data, char const *format)
     print_mqtt_string(output, str, format);
 }
 
+static data_t *data_output_mqtt_stats(data_output_t *output)
+{
+    data_output_mqtt_t *mqtt = (data_output_mqtt_t *)output;
+    mqtt_client_t *ctx       = mqtt->mqc;
+
+    double latency_avg = ctx->published ? ctx->latency_sum / ctx->published : 0.0;
+    return data_make(
+            "output",           "", DATA_STRING, "mqtt",
+            "connected",        "", DATA_INT, ctx->connected,
+            "queued",           "", DATA_INT, ctx->queue_len,
+            "spooled",          "", DATA_INT, ctx->spool_len,
+            "inflight",         "", DATA_INT, ctx->inflight,
+            "published",        "", DATA_INT, ctx->published,
+            "resent",           "", DATA_INT, ctx->resent,
+            "coalesced",        "", DATA_INT, ctx->coalesced,
+            "dropped",          "", DATA_INT, ctx->dropped,
+            "latency_avg_ms",   "", DATA_FORMAT, "%.1f", DATA_DOUBLE, latency_avg * 1000.0,
+            "latency_max_ms",   "", DATA_FORMAT, "%.1f", DATA_DOUBLE, ctx->latency_max * 1000.0,
+            NULL);
+}
+
+static double mqtt_connected(void *ctx)
+{
+    mqtt_client_t *mqc = ctx;
+    return mqc->connected;
+}
+
+static double mqtt_latency_sum(void *ctx)
+{
+    mqtt_client_t *mqc = ctx;
+    return mqc->latency_sum;
+}
+
+static double mqtt_latency_max(void *ctx)
+{
+    mqtt_client_t *mqc = ctx;
+    return mqc->latency_max;
+}
+
+static void data_output_mqtt_metrics(data_output_t *output, metrics_t *metrics, char const *labels)
+{
+    data_output_mqtt_t *mqtt = (data_output_mqtt_t *)output;
+    mqtt_client_t *ctx       = mqtt->mqc;
+
+    metric_family_t *family;
+    family = metrics_family(metrics, "rtl_433_output_connected", "Output connected to the server.", METRIC_GAUGE);
+    metric_add_fn(family, labels, mqtt_connected, ctx);
+    family = metrics_family(metrics, "rtl_433_output_queued", "Messages waiting to be sent by the output.", METRIC_GAUGE);
+    metric_add_unsigned(family, labels, &ctx->queue_len);
+    family = metrics_family(metrics, "rtl_433_output_spooled", "Messages spooled to disk by the output.", METRIC_GAUGE);
+    metric_add_unsigned(family, labels, &ctx->spool_len);
+    family = metrics_family(metrics, "rtl_433_output_inflight", "Messages sent but not yet acknowledged.", METRIC_GAUGE);
+    metric_add_unsigned(family, labels, &ctx->inflight);
+    family = metrics_family(metrics, "rtl_433_output_sent_total", "Messages sent by the output.", METRIC_COUNTER);
+    metric_add_unsigned(family, labels, &ctx->published);
+    family = metrics_family(metrics, "rtl_433_output_resent_total", "Messages sent again after a reconnect.", METRIC_COUNTER);
+    metric_add_unsigned(family, labels, &ctx->resent);
+    family = metrics_family(metrics, "rtl_433_output_coalesced_total", "Messages replaced by a newer one on the same topic.", METRIC_COUNTER);
+    metric_add_unsigned(family, labels, &ctx->coalesced);
+    family = metrics_family(metrics, "rtl_433_output_dropped_total", "Messages dropped by the output.", METRIC_COUNTER);
+    metric_add_unsigned(family, labels, &ctx->dropped);
+    family = metrics_family(metrics, "rtl_433_output_publish_seconds_total", "Time from queueing to sending, summed over the sent messages.", METRIC_COUNTER);
+    metric_add_fn(family, labels, mqtt_latency_sum, ctx);
+    family = metrics_family(metrics, "rtl_433_output_publish_max_seconds", "Longest time from queueing to sending.", METRIC_GAUGE);
+    metric_add_fn(family, labels, mqtt_latency_max, ctx);
+}
+
 static void data_output_mqtt_free(data_output_t *output)
 {
     data_output_mqtt_t *mqtt = (data_output_mqtt_t *)output;
@@ -438,6 +1174,9 @@ static void data_output_mqtt_free(data_output_t *output)
     free(mqtt->devices);
     free(mqtt->events);
     free(mqtt->states);
+    mqtt_topic_free(mqtt->devices_topic);
+    mqtt_topic_free(mqtt->events_topic);
+    mqtt_topic_free(mqtt->states_topic);
     //free(mqtt->homie);
     //free(mqtt->hass);
 
@@ -500,6 +1239,10 @@ struct data_output *data_output_mqtt_create(struct mg_mgr *mgr, char *param, cha
     char *pass = NULL;
     int retain = 0;
     int qos = 0;
+    mqtt_queue_opts_t queue_opts = {
+            .queue_size   = MQTT_DEFAULT_QUEUE_SIZE,
+            .max_inflight = MQTT_DEFAULT_MAX_INFLIGHT,
+    };
 
     // parse host and port
     tls_opts_t tls_opts = {0};
@@ -527,6 +1270,14 @@ struct data_output *data_output_mqtt_create(struct mg_mgr *mgr, char *param, cha
             retain = atobv(val, 1);
         else if (!strcasecmp(key, "q") || !strcasecmp(key, "qos"))
             qos = atoiv(val, 1);
+        else if (!strcasecmp(key, "queue"))
+            queue_opts.queue_size = atoiv(val, MQTT_DEFAULT_QUEUE_SIZE);
+        else if (!strcasecmp(key, "inflight"))
+            queue_opts.max_inflight = atoiv(val, MQTT_DEFAULT_MAX_INFLIGHT);
+        else if (!strcasecmp(key, "coalesce"))
+            queue_opts.coalesce_ms = atoiv(val, 100);
+        else if (!strcasecmp(key, "spool"))
+            queue_opts.spool_file = val;
         // Simple key-topic mapping
         else if (!strcasecmp(key, "d") || !strcasecmp(key, "devices"))
             mqtt->devices = mqtt_topic_default(val, base_topic, path_devices);
@@ -566,12 +1317,18 @@ struct data_output *data_output_mqtt_create(struct mg_mgr *mgr, char *param, cha
         mqtt->events  = mqtt_topic_default(NULL, base_topic, path_events);
         mqtt->states  = mqtt_topic_default(NULL, base_topic, path_states);
     }
-    if (mqtt->devices)
+    if (mqtt->devices) {
         fprintf(stderr, "Publishing device info to MQTT topic \"%s\".\n", mqtt->devices);
-    if (mqtt->events)
+        mqtt->devices_topic = mqtt_topic_compile(mqtt->devices, mqtt->hostname);
+    }
+    if (mqtt->events) {
         fprintf(stderr, "Publishing events info to MQTT topic \"%s\".\n", mqtt->events);
-    if (mqtt->states)
+        mqtt->events_topic = mqtt_topic_compile(mqtt->events, mqtt->hostname);
+    }
+    if (mqtt->states) {
         fprintf(stderr, "Publishing states info to MQTT topic \"%s\".\n", mqtt->states);
+        mqtt->states_topic = mqtt_topic_compile(mqtt->states, mqtt->hostname);
+    }
 
     mqtt->output.print_data   = print_mqtt_data;
     mqtt->output.print_array  = print_mqtt_array;
@@ -579,8 +1336,17 @@ struct data_output *data_output_mqtt_create(struct mg_mgr *mgr, char *param, cha
     mqtt->output.print_double = print_mqtt_double;
     mqtt->output.print_int    = print_mqtt_int;
     mqtt->output.output_free  = data_output_mqtt_free;
+    mqtt->output.output_stats = data_output_mqtt_stats;
+    mqtt->output.output_metrics = data_output_mqtt_metrics;
+
+    if (queue_opts.queue_size < 1)
+        queue_opts.queue_size = 1;
+    if (queue_opts.max_inflight < 1)
+        queue_opts.max_inflight = 1;
+    if (queue_opts.spool_file)
+        fprintf(stderr, "Spooling MQTT messages to \"%s\" while disconnected.\n", queue_opts.spool_file);
 
-    mqtt->mqc = mqtt_client_init(mgr, &tls_opts, host, port, user, pass, client_id, retain, qos);
+    mqtt->mqc = mqtt_client_init(mgr, &tls_opts, host, port, user, pass, client_id, retain, qos, &queue_opts);
 
     return &mqtt->output;
 }
@@ -0,0 +1,358 @@
+/** @file
+    Shared multi-pattern preamble matcher for all decoders.
+
+    Decoders declare their preamble or sync word patterns in r_device.
+    All patterns go into one Aho-Corasick automaton over bits, each row is
+    then scanned once for all patterns, with the first hit of each pattern
+    recorded. The hits of recent bitbuffers are kept by a hash of the
+    content, decoders slicing to the same bits share the scan.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "preamble_match.h"
+#include "r_device.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static inline unsigned bit_at(uint8_t const *bytes, unsigned bit)
+{
+    return bytes[bit >> 3] >> (7 - (bit & 7)) & 1;
+}
+
+static unsigned count_patterns(r_device const *r_dev)
+{
+    unsigned n = 0;
+    for (char const *const *p = r_dev->preambles; p && *p; ++p)
+        n++;
+    return n;
+}
+
+preamble_matcher_t *preamble_matcher_create(list_t *r_devs)
+{
+    unsigned num_patterns = 0;
+    unsigned max_states   = 1;
+    for (void **iter = r_devs->elems; iter && *iter; ++iter) {
+        r_device *r_dev         = *iter;
+        r_dev->preamble_matcher = NULL;
+        num_patterns += count_patterns(r_dev);
+    }
+    if (!num_patterns)
+        return NULL;
+
+    preamble_matcher_t *m = calloc(1, sizeof(*m));
+    if (!m) {
+        WARN_CALLOC("preamble_matcher_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    m->patterns = calloc(num_patterns, sizeof(*m->patterns));
+    if (!m->patterns)
+        FATAL_CALLOC("preamble_matcher_create()");
+
+    // parse the patterns, in order of the decoders
+    for (void **iter = r_devs->elems; iter && *iter; ++iter) {
+        r_device *r_dev = *iter;
+        if (!r_dev->preambles || !*r_dev->preambles)
+            continue;
+        r_dev->preamble_matcher = m;
+        r_dev->preamble_index   = m->num_patterns;
+        for (char const *const *code = r_dev->preambles; *code; ++code) {
+            bitbuffer_t bits = {0};
+            bitbuffer_parse(&bits, *code);
+            if (bits.num_rows != 1 || !bits.bits_per_row[0]) {
+                fprintf(stderr, "Bad preamble \"%s\" in \"%s\"!\n", *code, r_dev->name);
+                exit(1);
+            }
+            preamble_pattern_t *pattern = &m->patterns[m->num_patterns++];
+            pattern->r_dev = r_dev;
+            pattern->len   = bits.bits_per_row[0];
+            memcpy(pattern->bits, bits.bb[0], (pattern->len + 7) / 8);
+            max_states += pattern->len;
+        }
+    }
+
+    m->next = calloc(max_states * 2, sizeof(*m->next));
+    if (!m->next)
+        FATAL_CALLOC("preamble_matcher_create()");
+    m->dict = calloc(max_states, sizeof(*m->dict));
+    if (!m->dict)
+        FATAL_CALLOC("preamble_matcher_create()");
+    m->end_head = malloc(max_states * sizeof(*m->end_head));
+    if (!m->end_head)
+        FATAL_MALLOC("preamble_matcher_create()");
+    m->end_next = malloc(num_patterns * sizeof(*m->end_next));
+    if (!m->end_next)
+        FATAL_MALLOC("preamble_matcher_create()");
+    uint16_t *first = malloc(PREAMBLE_CACHE_SLOTS * BITBUF_ROWS * num_patterns * sizeof(*first));
+    if (!first)
+        FATAL_MALLOC("preamble_matcher_create()");
+    for (unsigned i = 0; i < PREAMBLE_CACHE_SLOTS; ++i)
+        m->cache[i].first = &first[i * BITBUF_ROWS * num_patterns];
+    for (unsigned s = 0; s < max_states; ++s)
+        m->end_head[s] = -1;
+
+    // build the trie, 0 is the root and also "no child" as no edge leads back to the root
+    m->num_states = 1;
+    for (unsigned p = 0; p < num_patterns; ++p) {
+        preamble_pattern_t *pattern = &m->patterns[p];
+        unsigned s = 0;
+        for (unsigned i = 0; i < pattern->len; ++i) {
+            unsigned b = bit_at(pattern->bits, i);
+            if (!m->next[2 * s + b])
+                m->next[2 * s + b] = m->num_states++;
+            s = m->next[2 * s + b];
+        }
+        m->end_next[p] = m->end_head[s];
+        m->end_head[s] = p;
+    }
+
+    // breadth first, complete the transitions with the failure links
+    unsigned *fail = calloc(m->num_states, sizeof(*fail));
+    if (!fail)
+        FATAL_CALLOC("preamble_matcher_create()");
+    unsigned *queue = malloc(m->num_states * sizeof(*queue));
+    if (!queue)
+        FATAL_MALLOC("preamble_matcher_create()");
+    unsigned head = 0, tail = 0;
+    for (unsigned b = 0; b < 2; ++b) {
+        if (m->next[b])
+            queue[tail++] = m->next[b];
+    }
+    while (head < tail) {
+        unsigned s = queue[head++];
+        for (unsigned b = 0; b < 2; ++b) {
+            unsigned c = m->next[2 * s + b];
+            unsigned f = m->next[2 * fail[s] + b];
+            if (c) {
+                fail[c]    = f;
+                m->dict[c] = m->end_head[f] >= 0 ? f : m->dict[f];
+                queue[tail++] = c;
+            }
+            else {
+                m->next[2 * s + b] = f;
+            }
+        }
+    }
+    free(queue);
+    free(fail);
+
+    return m;
+}
+
+void preamble_matcher_free(preamble_matcher_t *m)
+{
+    if (!m)
+        return;
+
+    free(m->cache[0].first);
+    free(m->end_next);
+    free(m->end_head);
+    free(m->dict);
+    free(m->next);
+    free(m->patterns);
+    free(m);
+}
+
+/// FNV-1a over the row lengths and the bits of the rows, bits past the row length are ignored.
+static uint64_t hash_bits(bitbuffer_t const *bitbuffer)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned row = 0; row < bitbuffer->num_rows; ++row) {
+        unsigned len = bitbuffer->bits_per_row[row];
+        hash = (hash ^ (len & 0xff)) * 0x100000001b3ULL;
+        hash = (hash ^ (len >> 8)) * 0x100000001b3ULL;
+        uint8_t const *bits = bitbuffer->bb[row];
+        for (unsigned i = 0; i < len / 8; ++i)
+            hash = (hash ^ bits[i]) * 0x100000001b3ULL;
+        if (len & 7)
+            hash = (hash ^ (bits[len / 8] & (0xff00 >> (len & 7)))) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/// Kept scans are compared by hash and row lengths only, no copy of the bits is kept.
+static preamble_scan_t *find_scan(preamble_matcher_t *m, bitbuffer_t const *bitbuffer, uint64_t hash)
+{
+    for (unsigned i = 0; i < PREAMBLE_CACHE_SLOTS; ++i) {
+        preamble_scan_t *scan = &m->cache[i];
+        if (scan->valid && scan->hash == hash && scan->num_rows == bitbuffer->num_rows
+                && !memcmp(scan->bits_per_row, bitbuffer->bits_per_row, bitbuffer->num_rows * sizeof(bitbuffer->bits_per_row[0])))
+            return scan;
+    }
+    return NULL;
+}
+
+static void scan_rows(preamble_matcher_t *m, preamble_scan_t *scan, bitbuffer_t const *bitbuffer)
+{
+    unsigned num_patterns = m->num_patterns;
+    memset(scan->first, 0xff, bitbuffer->num_rows * num_patterns * sizeof(*scan->first));
+
+    for (unsigned row = 0; row < bitbuffer->num_rows; ++row) {
+        uint8_t const *bits = bitbuffer->bb[row];
+        unsigned len        = bitbuffer->bits_per_row[row];
+        uint16_t *first     = &scan->first[row * num_patterns];
+        unsigned s          = 0;
+        for (unsigned i = 0; i < len; ++i) {
+            s = m->next[2 * s + bit_at(bits, i)];
+            unsigned t = m->end_head[s] >= 0 ? s : m->dict[s];
+            for (; t; t = m->dict[t]) {
+                for (int p = m->end_head[t]; p >= 0; p = m->end_next[p]) {
+                    if (first[p] == PREAMBLE_NONE)
+                        first[p] = i + 1 - m->patterns[p].len;
+                }
+            }
+        }
+    }
+}
+
+int preamble_matcher_scan(preamble_matcher_t *m, r_device *r_dev, bitbuffer_t const *bitbuffer)
+{
+    m->scans++;
+    uint64_t hash         = hash_bits(bitbuffer);
+    preamble_scan_t *scan = find_scan(m, bitbuffer, hash);
+    if (scan) {
+        m->scans_cached++;
+    }
+    else {
+        // keep the hits to share the scan with decoders slicing to the same bits
+        scan = &m->cache[m->cache_next];
+        m->cache_next = (m->cache_next + 1) % PREAMBLE_CACHE_SLOTS;
+        scan_rows(m, scan, bitbuffer);
+        scan->hash     = hash;
+        scan->num_rows = bitbuffer->num_rows;
+        memcpy(scan->bits_per_row, bitbuffer->bits_per_row, bitbuffer->num_rows * sizeof(bitbuffer->bits_per_row[0]));
+        scan->valid    = 1;
+    }
+    m->scanned = bitbuffer;
+    m->hits    = scan->first;
+
+    for (unsigned p = r_dev->preamble_index; p < m->num_patterns && m->patterns[p].r_dev == r_dev; ++p) {
+        for (unsigned row = 0; row < bitbuffer->num_rows; ++row) {
+            if (scan->first[row * m->num_patterns + p] != PREAMBLE_NONE)
+                return 1;
+        }
+    }
+    return 0;
+}
+
+int preamble_matcher_find(preamble_matcher_t *m, r_device *r_dev, bitbuffer_t const *bitbuffer,
+        unsigned row, uint8_t const *pattern, unsigned pattern_bits_len)
+{
+    if (m->scanned != bitbuffer || row >= bitbuffer->num_rows)
+        return -1;
+
+    for (unsigned p = r_dev->preamble_index; p < m->num_patterns && m->patterns[p].r_dev == r_dev; ++p) {
+        preamble_pattern_t const *declared = &m->patterns[p];
+        if (declared->len != pattern_bits_len)
+            continue;
+        unsigned i;
+        for (i = 0; i < pattern_bits_len && bit_at(declared->bits, i) == bit_at(pattern, i); ++i)
+            ;
+        if (i < pattern_bits_len)
+            continue;
+        unsigned pos = m->hits[row * m->num_patterns + p];
+        return pos == PREAMBLE_NONE ? (int)bitbuffer->bits_per_row[row] : (int)pos;
+    }
+    return -1;
+}
+
+#ifdef _TEST
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %s:%d: %s <> %s\n", __FILE__, __LINE__, #a, #b); \
+        } \
+    } while (0)
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+
+    fprintf(stderr, "preamble_match:: test\n");
+
+    char const *const pre_a[] = {"{24}aa2dd4", NULL};
+    char const *const pre_b[] = {"{16}2dd4", "{12}5a5", NULL};
+    char const *const pre_c[] = {"{24}aa2dd4", NULL}; // shared with a
+    r_device dev_a = {.name = "a", .preambles = pre_a};
+    r_device dev_b = {.name = "b", .preambles = pre_b};
+    r_device dev_c = {.name = "c", .preambles = pre_c};
+    r_device dev_d = {.name = "d"};
+
+    list_t r_devs = {0};
+    list_push(&r_devs, &dev_a);
+    list_push(&r_devs, &dev_d);
+    list_push(&r_devs, &dev_b);
+    list_push(&r_devs, &dev_c);
+
+    preamble_matcher_t *m = preamble_matcher_create(&r_devs);
+    ASSERT_EQUALS(m != NULL, 1);
+    ASSERT_EQUALS(m->num_patterns, 4);
+    ASSERT_EQUALS(dev_a.preamble_matcher == m, 1);
+    ASSERT_EQUALS(dev_d.preamble_matcher == NULL, 1);
+
+    // the hits agree with bitbuffer_search() on random rows
+    bitbuffer_t bits = {0};
+    bitbuffer_parse(&bits, "{40}5555aa2dd4{20}f5a5f{36}0aa2dd400{8}00");
+    uint8_t const pat_a[] = {0xaa, 0x2d, 0xd4};
+    uint8_t const pat_b[] = {0x5a, 0x50};
+    ASSERT_EQUALS(preamble_matcher_scan(m, &dev_a, &bits) != 0, 1);
+    ASSERT_EQUALS(preamble_matcher_scan(m, &dev_b, &bits) != 0, 1);
+    ASSERT_EQUALS(m->scans_cached, 1);
+    for (unsigned row = 0; row < bits.num_rows; ++row) {
+        ASSERT_EQUALS(preamble_matcher_find(m, &dev_a, &bits, row, pat_a, 24), (int)bitbuffer_search(&bits, row, 0, pat_a, 24));
+        ASSERT_EQUALS(preamble_matcher_find(m, &dev_b, &bits, row, pat_b, 12), (int)bitbuffer_search(&bits, row, 0, pat_b, 12));
+    }
+    ASSERT_EQUALS(preamble_matcher_find(m, &dev_a, &bits, 0, pat_b, 12), -1); // not declared by a
+
+    // a decoder is skipped only if none of its patterns is in any row
+    bitbuffer_t none = {0};
+    bitbuffer_parse(&none, "{32}2dd40000{16}0000");
+    ASSERT_EQUALS(preamble_matcher_scan(m, &dev_a, &none), 0);
+    ASSERT_EQUALS(preamble_matcher_scan(m, &dev_b, &none) != 0, 1);
+    ASSERT_EQUALS(preamble_matcher_scan(m, &dev_c, &none), 0);
+
+    // decoders alternating between bitbuffers share the earlier scans
+    unsigned cached = m->scans_cached;
+    ASSERT_EQUALS(preamble_matcher_scan(m, &dev_a, &bits) != 0, 1);
+    ASSERT_EQUALS(preamble_matcher_scan(m, &dev_c, &none), 0);
+    ASSERT_EQUALS(preamble_matcher_scan(m, &dev_b, &bits) != 0, 1);
+    ASSERT_EQUALS(m->scans_cached, cached + 3);
+    for (unsigned row = 0; row < bits.num_rows; ++row) {
+        ASSERT_EQUALS(preamble_matcher_find(m, &dev_b, &bits, row, pat_b, 12), (int)bitbuffer_search(&bits, row, 0, pat_b, 12));
+    }
+
+    // overlapping matches, the first is found
+    for (unsigned n = 0; n < 200; ++n) {
+        bitbuffer_t rnd = {0};
+        rnd.num_rows        = 1;
+        rnd.bits_per_row[0] = 100;
+        unsigned seed       = n * 2654435761u;
+        for (unsigned i = 0; i < 13; ++i) {
+            seed         = seed * 1103515245 + 12345;
+            rnd.bb[0][i] = (seed >> 16) & 0xff;
+        }
+        rnd.bb[0][n % 10]     = 0x5a;
+        rnd.bb[0][n % 10 + 1] = 0x5a;
+        preamble_matcher_scan(m, &dev_b, &rnd);
+        ASSERT_EQUALS(preamble_matcher_find(m, &dev_b, &rnd, 0, pat_b, 12), (int)bitbuffer_search(&rnd, 0, 0, pat_b, 12));
+    }
+
+    preamble_matcher_free(m);
+    list_free_elems(&r_devs, NULL);
+
+    fprintf(stderr, "preamble_match:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+    return failed;
+}
+#endif /* _TEST */
@@ -13,7 +13,9 @@
 
 #include "pulse_demod.h"
 #include "bitbuffer.h"
+#include "preamble_match.h"
 #include "util.h"
+#include "compat_time.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
@@ -22,20 +24,40 @@
 
 static int account_event(r_device *device, bitbuffer_t *bits, char const *demod_name)
 {
+    // skip if none of the preambles is in any row, unless verbose to keep the decoder diagnostics
+    preamble_matcher_t *matcher = device->preamble_matcher;
+    if (matcher && !preamble_matcher_scan(matcher, device, bits) && !device->verbose) {
+        matcher->scanned = NULL;
+        device->decode_skipped += 1;
+        device->total_skipped += 1;
+        return 0;
+    }
+
     // run decoder
     int ret = 0;
-    if (device->decode_fn) {
+    if (device->decode_fn && device->cpu_time) {
+        uint64_t start = monotonic_nsec();
+        ret = device->decode_fn(device, bits);
+        device->decode_nsec += monotonic_nsec() - start;
+    }
+    else if (device->decode_fn) {
         ret = device->decode_fn(device, bits);
     }
+    if (matcher)
+        matcher->scanned = NULL; // the decoder might change the bitbuffer now
 
     // statistics accounting
     device->decode_events += 1;
+    device->total_events += 1;
     if (ret > 0) {
         device->decode_ok += 1;
         device->decode_messages += ret;
+        device->total_ok += 1;
+        device->total_messages += ret;
     }
     else if (ret >= DECODE_FAIL_SANITY) {
         device->decode_fails[-ret] += 1;
+        device->total_fails[-ret] += 1;
         ret = 0;
     }
     else {
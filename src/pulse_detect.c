@@ -143,6 +143,9 @@ void pulse_data_load(FILE *file, pulse_data_t *data, uint32_t sample_rate)
                 break; // end or next header found
             }
             else {
+                if (!strncmp(s, ";fsk", 4)) {
+                    data->fsk_f2_est = 1; // mark as FSK data
+                }
                 continue; // still reading a header
             }
         }
@@ -280,6 +283,18 @@ void pulse_detect_free(pulse_detect_t *pulse_detect)
     free(pulse_detect);
 }
 
+void pulse_detect_reset(pulse_detect_t *pulse_detect)
+{
+    pulse_detect->ook_state         = PD_OOK_STATE_IDLE;
+    pulse_detect->pulse_length      = 0;
+    pulse_detect->max_pulse         = 0;
+    pulse_detect->data_counter      = 0;
+    pulse_detect->lead_in_counter   = 0;
+    pulse_detect->ook_low_estimate  = 0;
+    pulse_detect->ook_high_estimate = 0;
+    memset(&pulse_detect->FSK_state, 0, sizeof(pulse_detect->FSK_state));
+}
+
 void pulse_detect_set_levels(pulse_detect_t *pulse_detect, int use_mag_est, float fixed_high_level, float min_high_level, float high_low_ratio, int verbosity)
 {
     pulse_detect->use_mag_est = use_mag_est;
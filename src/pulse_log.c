@@ -0,0 +1,717 @@
+/** @file
+    Compact binary pulse log with a seek index.
+
+    The log is a 16 byte header followed by records of a tag byte,
+    a varint payload length, and the payload. Unknown tags are skipped.
+
+    A package record holds the package header fields as varints and float32
+    followed by the pulse and gap widths, each zigzag delta coded against
+    the previous pulse or gap. Widths are in samples, nothing is rounded.
+
+    On close an index record of every PULSE_LOG_INDEX_INTERVAL-th package
+    is appended and a fixed 16 byte trailer points to it. A log that was
+    not closed is still readable, the index is then rebuilt with a scan.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "pulse_log.h"
+#include "r_util.h"
+#include "fatal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define PULSE_LOG_MAGIC "rtl433pl"
+#define PULSE_LOG_INDEX_MAGIC "rtl433ix"
+#define PULSE_LOG_HEADER_LEN 16
+#define PULSE_LOG_TRAILER_LEN 16
+#define PULSE_LOG_TAG_PACKAGE 'P'
+#define PULSE_LOG_TAG_INDEX 'I'
+#define PULSE_LOG_FLOATS 7
+#define PULSE_LOG_MAX_RECORD (16 * 10 + PULSE_LOG_FLOATS * 4 + PD_MAX_PULSES * 2 * 10)
+
+/* varint coding */
+
+static unsigned put_varint(uint8_t *buf, uint64_t v)
+{
+    unsigned n = 0;
+    while (v >= 0x80) {
+        buf[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    buf[n++] = (uint8_t)v;
+    return n;
+}
+
+static unsigned put_zigzag(uint8_t *buf, int64_t v)
+{
+    return put_varint(buf, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+static unsigned put_float(uint8_t *buf, float f)
+{
+    uint32_t v;
+    memcpy(&v, &f, sizeof(v));
+    buf[0] = (uint8_t)(v);
+    buf[1] = (uint8_t)(v >> 8);
+    buf[2] = (uint8_t)(v >> 16);
+    buf[3] = (uint8_t)(v >> 24);
+    return 4;
+}
+
+/// @return 0 if the varint is truncated or too long
+static int get_varint(uint8_t const *data, size_t end, size_t *pos, uint64_t *val)
+{
+    uint64_t v = 0;
+    for (unsigned shift = 0; shift < 64 && *pos < end; shift += 7) {
+        uint8_t b = data[(*pos)++];
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *val = v;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int get_zigzag(uint8_t const *data, size_t end, size_t *pos, int64_t *val)
+{
+    uint64_t v;
+    if (!get_varint(data, end, pos, &v))
+        return 0;
+    *val = (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+    return 1;
+}
+
+static int get_float(uint8_t const *data, size_t end, size_t *pos, float *f)
+{
+    if (*pos + 4 > end)
+        return 0;
+    uint8_t const *p = &data[*pos];
+    uint32_t v = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+    memcpy(f, &v, sizeof(*f));
+    *pos += 4;
+    return 1;
+}
+
+/// Parse a record head at @p pos, sets the payload range.
+/// @return the tag or 0 if the record is truncated
+static int get_record(uint8_t const *data, size_t size, size_t pos, size_t *payload, size_t *next)
+{
+    if (pos >= size)
+        return 0;
+    int tag = data[pos++];
+    uint64_t len;
+    if (!get_varint(data, size, &pos, &len) || len > size - pos)
+        return 0;
+    *payload = pos;
+    *next    = pos + (size_t)len;
+    return tag;
+}
+
+/* writer */
+
+static void write_bytes(pulse_log_writer_t *w, void const *buf, size_t len)
+{
+    if (fwrite(buf, 1, len, w->file) != len) {
+        perror("Pulse log output error");
+        exit(1);
+    }
+    w->pos += len;
+}
+
+static void write_record(pulse_log_writer_t *w, int tag, uint8_t const *payload, size_t len)
+{
+    uint8_t head[11];
+    head[0] = (uint8_t)tag;
+    unsigned n = 1 + put_varint(&head[1], len);
+    write_bytes(w, head, n);
+    write_bytes(w, payload, len);
+}
+
+pulse_log_writer_t *pulse_log_writer_create(FILE *file)
+{
+    pulse_log_writer_t *w = calloc(1, sizeof(*w));
+    if (!w) {
+        WARN_CALLOC("pulse_log_writer_create()");
+        return NULL;
+    }
+    w->file = file;
+
+    uint8_t header[PULSE_LOG_HEADER_LEN] = {0};
+    memcpy(header, PULSE_LOG_MAGIC, 8);
+    header[8] = PULSE_LOG_VERSION;
+    write_bytes(w, header, sizeof(header));
+
+    return w;
+}
+
+void pulse_log_write(pulse_log_writer_t *w, pulse_data_t const *data)
+{
+    if (w->packages++ % PULSE_LOG_INDEX_INTERVAL == 0) {
+        if (w->num_index == w->max_index) {
+            unsigned max_index = w->max_index ? w->max_index * 2 : 64;
+            pulse_log_index_t *index = realloc(w->index, max_index * sizeof(*index));
+            if (!index)
+                FATAL_REALLOC("pulse_log_write()");
+            w->index     = index;
+            w->max_index = max_index;
+        }
+        struct timeval now;
+        get_time_now(&now);
+        pulse_log_index_t *entry = &w->index[w->num_index++];
+        entry->pos     = w->pos;
+        entry->offset  = data->offset;
+        entry->time_us = (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+    }
+
+    uint8_t buf[PULSE_LOG_MAX_RECORD];
+    unsigned n = 0;
+    n += put_varint(&buf[n], data->offset);
+    n += put_varint(&buf[n], data->sample_rate);
+    n += put_varint(&buf[n], data->depth_bits);
+    n += put_varint(&buf[n], data->start_ago);
+    n += put_varint(&buf[n], data->end_ago);
+    n += put_zigzag(&buf[n], data->ook_low_estimate);
+    n += put_zigzag(&buf[n], data->ook_high_estimate);
+    n += put_zigzag(&buf[n], data->fsk_f1_est);
+    n += put_zigzag(&buf[n], data->fsk_f2_est);
+    n += put_float(&buf[n], data->freq1_hz);
+    n += put_float(&buf[n], data->freq2_hz);
+    n += put_float(&buf[n], data->centerfreq_hz);
+    n += put_float(&buf[n], data->range_db);
+    n += put_float(&buf[n], data->rssi_db);
+    n += put_float(&buf[n], data->snr_db);
+    n += put_float(&buf[n], data->noise_db);
+
+    unsigned num_pulses = data->num_pulses < PD_MAX_PULSES ? data->num_pulses : PD_MAX_PULSES;
+    n += put_varint(&buf[n], num_pulses);
+    int prev_pulse = 0;
+    int prev_gap   = 0;
+    for (unsigned i = 0; i < num_pulses; ++i) {
+        n += put_zigzag(&buf[n], (int64_t)data->pulse[i] - prev_pulse);
+        n += put_zigzag(&buf[n], (int64_t)data->gap[i] - prev_gap);
+        prev_pulse = data->pulse[i];
+        prev_gap   = data->gap[i];
+    }
+
+    write_record(w, PULSE_LOG_TAG_PACKAGE, buf, n);
+}
+
+void pulse_log_writer_close(pulse_log_writer_t *w)
+{
+    if (!w)
+        return;
+
+    uint64_t index_pos = w->pos;
+    size_t max_len = 10 + (size_t)w->num_index * 30;
+    uint8_t *buf = malloc(max_len);
+    if (!buf)
+        FATAL_MALLOC("pulse_log_writer_close()");
+    size_t n = put_varint(buf, w->num_index);
+    pulse_log_index_t prev = {0};
+    for (unsigned i = 0; i < w->num_index; ++i) {
+        pulse_log_index_t const *entry = &w->index[i];
+        n += put_varint(&buf[n], entry->pos - prev.pos);
+        n += put_zigzag(&buf[n], (int64_t)(entry->offset - prev.offset));
+        n += put_zigzag(&buf[n], entry->time_us - prev.time_us);
+        prev = *entry;
+    }
+    write_record(w, PULSE_LOG_TAG_INDEX, buf, n);
+    free(buf);
+
+    uint8_t trailer[PULSE_LOG_TRAILER_LEN];
+    for (int i = 0; i < 8; ++i)
+        trailer[i] = (uint8_t)(index_pos >> (i * 8));
+    memcpy(&trailer[8], PULSE_LOG_INDEX_MAGIC, 8);
+    write_bytes(w, trailer, sizeof(trailer));
+    fflush(w->file);
+
+    free(w->index);
+    free(w);
+}
+
+/* reader */
+
+static uint8_t *read_all(FILE *file, size_t *size)
+{
+    size_t len = 0;
+    size_t cap = 1 << 16;
+    uint8_t *buf = malloc(cap);
+    if (!buf) {
+        WARN_MALLOC("pulse_log_open()");
+        return NULL;
+    }
+    size_t n;
+    while ((n = fread(buf + len, 1, cap - len, file)) > 0) {
+        len += n;
+        if (len == cap) {
+            cap *= 2;
+            uint8_t *next = realloc(buf, cap);
+            if (!next) {
+                WARN_REALLOC("pulse_log_open()");
+                free(buf);
+                return NULL;
+            }
+            buf = next;
+        }
+    }
+    *size = len;
+    return buf;
+}
+
+static int load_data(pulse_log_reader_t *r, char const *path)
+{
+    if (!strcmp(path, "-")) {
+        r->data = read_all(stdin, &r->size);
+        return r->data != NULL;
+    }
+
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+            madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+            close(fd);
+            r->data   = map;
+            r->size   = (size_t)st.st_size;
+            r->mapped = 1;
+            return 1;
+        }
+    }
+    close(fd);
+#endif
+
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        perror(path);
+        return 0;
+    }
+    r->data = read_all(file, &r->size);
+    fclose(file);
+    return r->data != NULL;
+}
+
+static int add_index(pulse_log_reader_t *r, unsigned *max_index, pulse_log_index_t const *entry)
+{
+    if (r->num_index == *max_index) {
+        *max_index = *max_index ? *max_index * 2 : 64;
+        pulse_log_index_t *index = realloc(r->index, *max_index * sizeof(*index));
+        if (!index) {
+            WARN_REALLOC("pulse_log_open()");
+            return 0;
+        }
+        r->index = index;
+    }
+    r->index[r->num_index++] = *entry;
+    return 1;
+}
+
+/// Read the index from the trailer, @return 0 if there is no valid index.
+static int read_index(pulse_log_reader_t *r)
+{
+    if (r->size < r->start + PULSE_LOG_TRAILER_LEN)
+        return 0;
+    uint8_t const *trailer = &r->data[r->size - PULSE_LOG_TRAILER_LEN];
+    if (memcmp(&trailer[8], PULSE_LOG_INDEX_MAGIC, 8))
+        return 0;
+    uint64_t index_pos = 0;
+    for (int i = 0; i < 8; ++i)
+        index_pos |= (uint64_t)trailer[i] << (i * 8);
+    if (index_pos < r->start || index_pos >= r->size - PULSE_LOG_TRAILER_LEN)
+        return 0;
+
+    size_t end = r->size - PULSE_LOG_TRAILER_LEN;
+    size_t pos, next;
+    if (get_record(r->data, end, (size_t)index_pos, &pos, &next) != PULSE_LOG_TAG_INDEX)
+        return 0;
+    uint64_t count;
+    if (!get_varint(r->data, next, &pos, &count) || count > next - pos)
+        return 0;
+
+    unsigned max_index = 0;
+    pulse_log_index_t entry = {0};
+    for (uint64_t i = 0; i < count; ++i) {
+        uint64_t pos_delta;
+        int64_t offset_delta, time_delta;
+        if (!get_varint(r->data, next, &pos, &pos_delta)
+                || !get_zigzag(r->data, next, &pos, &offset_delta)
+                || !get_zigzag(r->data, next, &pos, &time_delta))
+            return 0;
+        entry.pos += pos_delta;
+        entry.offset += (uint64_t)offset_delta;
+        entry.time_us += time_delta;
+        if (entry.pos < r->start || entry.pos >= index_pos)
+            return 0;
+        if (!add_index(r, &max_index, &entry))
+            return 0;
+    }
+    r->end = (size_t)index_pos;
+    return 1;
+}
+
+/// Rebuild the index of a log that was not closed, a truncated last record is dropped.
+static void scan_index(pulse_log_reader_t *r)
+{
+    free(r->index);
+    r->index     = NULL;
+    r->num_index = 0;
+    unsigned max_index = 0;
+    unsigned packages  = 0;
+
+    size_t pos = r->start;
+    size_t payload, next;
+    int tag;
+    while ((tag = get_record(r->data, r->size, pos, &payload, &next))) {
+        if (tag == PULSE_LOG_TAG_PACKAGE && packages++ % PULSE_LOG_INDEX_INTERVAL == 0) {
+            pulse_log_index_t entry = {0};
+            entry.pos = pos;
+            if (!get_varint(r->data, next, &payload, &entry.offset))
+                break;
+            if (!add_index(r, &max_index, &entry))
+                break;
+        }
+        pos = next;
+    }
+    r->end = pos;
+}
+
+pulse_log_reader_t *pulse_log_open(char const *path)
+{
+    pulse_log_reader_t *r = calloc(1, sizeof(*r));
+    if (!r) {
+        WARN_CALLOC("pulse_log_open()");
+        return NULL;
+    }
+    if (!load_data(r, path)) {
+        pulse_log_close(r);
+        return NULL;
+    }
+    if (r->size < PULSE_LOG_HEADER_LEN || memcmp(r->data, PULSE_LOG_MAGIC, 8)) {
+        fprintf(stderr, "Not a pulse log: %s\n", path);
+        pulse_log_close(r);
+        return NULL;
+    }
+    if (r->data[8] != PULSE_LOG_VERSION) {
+        fprintf(stderr, "Unsupported pulse log version %u: %s\n", r->data[8], path);
+        pulse_log_close(r);
+        return NULL;
+    }
+    r->start = PULSE_LOG_HEADER_LEN;
+
+    if (!read_index(r))
+        scan_index(r);
+
+    return r;
+}
+
+void pulse_log_close(pulse_log_reader_t *r)
+{
+    if (!r)
+        return;
+
+#ifndef _WIN32
+    if (r->mapped)
+        munmap((void *)r->data, r->size);
+    else
+#endif
+        free((void *)r->data);
+    free(r->index);
+    free(r);
+}
+
+static int read_package(uint8_t const *data, size_t pos, size_t end, pulse_data_t *out)
+{
+    uint64_t offset, sample_rate, depth_bits, start_ago, end_ago, num_pulses;
+    int64_t ook_low, ook_high, fsk_f1, fsk_f2;
+    float f[PULSE_LOG_FLOATS];
+
+    if (!get_varint(data, end, &pos, &offset)
+            || !get_varint(data, end, &pos, &sample_rate)
+            || !get_varint(data, end, &pos, &depth_bits)
+            || !get_varint(data, end, &pos, &start_ago)
+            || !get_varint(data, end, &pos, &end_ago)
+            || !get_zigzag(data, end, &pos, &ook_low)
+            || !get_zigzag(data, end, &pos, &ook_high)
+            || !get_zigzag(data, end, &pos, &fsk_f1)
+            || !get_zigzag(data, end, &pos, &fsk_f2))
+        return 0;
+    for (int i = 0; i < PULSE_LOG_FLOATS; ++i) {
+        if (!get_float(data, end, &pos, &f[i]))
+            return 0;
+    }
+    if (!get_varint(data, end, &pos, &num_pulses) || num_pulses > PD_MAX_PULSES)
+        return 0;
+
+    pulse_data_clear(out);
+    out->offset            = offset;
+    out->sample_rate       = (uint32_t)sample_rate;
+    out->depth_bits        = (unsigned)depth_bits;
+    out->start_ago         = (unsigned)start_ago;
+    out->end_ago           = (unsigned)end_ago;
+    out->ook_low_estimate  = (int)ook_low;
+    out->ook_high_estimate = (int)ook_high;
+    out->fsk_f1_est        = (int)fsk_f1;
+    out->fsk_f2_est        = (int)fsk_f2;
+    out->freq1_hz          = f[0];
+    out->freq2_hz          = f[1];
+    out->centerfreq_hz     = f[2];
+    out->range_db          = f[3];
+    out->rssi_db           = f[4];
+    out->snr_db            = f[5];
+    out->noise_db          = f[6];
+
+    int64_t pulse = 0;
+    int64_t gap   = 0;
+    for (unsigned i = 0; i < num_pulses; ++i) {
+        int64_t pulse_delta, gap_delta;
+        if (!get_zigzag(data, end, &pos, &pulse_delta)
+                || !get_zigzag(data, end, &pos, &gap_delta))
+            return 0;
+        pulse += pulse_delta;
+        gap += gap_delta;
+        out->pulse[i] = (int)pulse;
+        out->gap[i]   = (int)gap;
+    }
+    out->num_pulses = (unsigned)num_pulses;
+    return 1;
+}
+
+int pulse_log_read(pulse_log_reader_t const *r, size_t *pos, pulse_data_t *data)
+{
+    size_t payload, next;
+    while (*pos < r->end) {
+        int tag = get_record(r->data, r->end, *pos, &payload, &next);
+        if (!tag)
+            return -1;
+        *pos = next;
+        if (tag == PULSE_LOG_TAG_PACKAGE)
+            return read_package(r->data, payload, next, data) ? 1 : -1;
+    }
+    return 0;
+}
+
+size_t pulse_log_seek_offset(pulse_log_reader_t const *r, uint64_t offset)
+{
+    // last indexed package before the offset
+    size_t pos = r->start;
+    unsigned lo = 0;
+    unsigned hi = r->num_index;
+    while (lo < hi) {
+        unsigned mid = lo + (hi - lo) / 2;
+        if (r->index[mid].offset < offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo > 0)
+        pos = (size_t)r->index[lo - 1].pos;
+
+    // then step over the records up to the offset
+    size_t payload, next;
+    int tag;
+    while (pos < r->end && (tag = get_record(r->data, r->end, pos, &payload, &next))) {
+        uint64_t package_offset;
+        if (tag == PULSE_LOG_TAG_PACKAGE
+                && (!get_varint(r->data, next, &payload, &package_offset) || package_offset >= offset))
+            break;
+        pos = next;
+    }
+    return pos;
+}
+
+size_t pulse_log_seek_time(pulse_log_reader_t const *r, int64_t time_us)
+{
+    size_t pos = r->start;
+    for (unsigned i = 0; i < r->num_index; ++i) {
+        if (!r->index[i].time_us)
+            continue; // unknown in a rebuilt index
+        if (r->index[i].time_us > time_us)
+            break;
+        pos = (size_t)r->index[i].pos;
+    }
+    return pos;
+}
+
+unsigned pulse_log_split(pulse_log_reader_t const *r, unsigned parts, size_t *starts)
+{
+    unsigned n = 0;
+    starts[n++] = r->start;
+    unsigned i = 0;
+    for (unsigned k = 1; k < parts; ++k) {
+        size_t target = r->start + (r->end - r->start) / parts * k;
+        while (i < r->num_index && (r->index[i].pos <= starts[n - 1] || r->index[i].pos < target))
+            ++i;
+        if (i == r->num_index)
+            break;
+        starts[n++] = (size_t)r->index[i].pos;
+    }
+    starts[n] = r->end;
+    return n;
+}
+
+#ifdef _TEST
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %s:%d: %s <> %s\n", __FILE__, __LINE__, #a, #b); \
+        } \
+    } while (0)
+
+#define TEST_PACKAGES 300
+#define TEST_FILE "test_pulse_log.plog"
+
+static void make_package(pulse_data_t *data, unsigned k)
+{
+    pulse_data_clear(data);
+    data->offset            = 1000000ULL * k;
+    data->sample_rate       = 250000;
+    data->depth_bits        = 8;
+    data->start_ago         = 500 + k;
+    data->end_ago           = 20;
+    data->ook_low_estimate  = 1000;
+    data->ook_high_estimate = 9000;
+    data->fsk_f1_est        = k % 2 ? 4000 : 0;
+    data->fsk_f2_est        = k % 2 ? -4000 : 0;
+    data->freq1_hz          = 433.92e6f;
+    data->centerfreq_hz     = 433.92e6f;
+    data->rssi_db           = -0.1f * k;
+    data->snr_db            = 12.5f;
+    data->noise_db          = -20.0f;
+    data->num_pulses        = k * 7 % PD_MAX_PULSES + 1;
+    for (unsigned i = 0; i < data->num_pulses; ++i) {
+        data->pulse[i] = i % 3 ? 125 : 250;
+        data->gap[i]   = (i * 31 + k) % 500;
+    }
+    data->gap[data->num_pulses - 1] = 250000;
+}
+
+static int same_package(pulse_data_t const *a, pulse_data_t const *b)
+{
+    return a->offset == b->offset
+            && a->sample_rate == b->sample_rate
+            && a->depth_bits == b->depth_bits
+            && a->start_ago == b->start_ago
+            && a->end_ago == b->end_ago
+            && a->ook_low_estimate == b->ook_low_estimate
+            && a->ook_high_estimate == b->ook_high_estimate
+            && a->fsk_f1_est == b->fsk_f1_est
+            && a->fsk_f2_est == b->fsk_f2_est
+            && a->freq1_hz == b->freq1_hz
+            && a->rssi_db == b->rssi_db
+            && a->snr_db == b->snr_db
+            && a->noise_db == b->noise_db
+            && a->num_pulses == b->num_pulses
+            && !memcmp(a->pulse, b->pulse, a->num_pulses * sizeof(int))
+            && !memcmp(a->gap, b->gap, a->num_pulses * sizeof(int));
+}
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+
+    fprintf(stderr, "pulse_log:: test\n");
+
+    static pulse_data_t in, out;
+
+    FILE *file = fopen(TEST_FILE, "wb");
+    pulse_log_writer_t *w = pulse_log_writer_create(file);
+    for (unsigned k = 0; k < TEST_PACKAGES; ++k) {
+        make_package(&in, k);
+        pulse_log_write(w, &in);
+    }
+    uint64_t packages_end = w->pos;
+    pulse_log_writer_close(w);
+    fclose(file);
+
+    // round trip is exact
+    pulse_log_reader_t *r = pulse_log_open(TEST_FILE);
+    ASSERT_EQUALS(r != NULL, 1);
+    ASSERT_EQUALS(r->num_index, (TEST_PACKAGES + PULSE_LOG_INDEX_INTERVAL - 1) / PULSE_LOG_INDEX_INTERVAL);
+    ASSERT_EQUALS(r->end, packages_end);
+    size_t pos = r->start;
+    unsigned k = 0;
+    int ok = 1;
+    while (pulse_log_read(r, &pos, &out) == 1) {
+        make_package(&in, k++);
+        ok &= same_package(&in, &out);
+    }
+    ASSERT_EQUALS(ok != 0, 1);
+    ASSERT_EQUALS(k, TEST_PACKAGES);
+
+    // seek to an offset lands on the first package at or after it
+    pos = pulse_log_seek_offset(r, 1000000ULL * 200 - 1);
+    ASSERT_EQUALS(pulse_log_read(r, &pos, &out), 1);
+    ASSERT_EQUALS(out.offset, 1000000ULL * 200);
+    pos = pulse_log_seek_offset(r, 0);
+    ASSERT_EQUALS(pos, r->start);
+    pos = pulse_log_seek_offset(r, UINT64_MAX);
+    ASSERT_EQUALS(pos, r->end);
+    pos = pulse_log_seek_time(r, 0);
+    ASSERT_EQUALS(pos, r->start);
+
+    // split ranges cover all packages exactly once
+    size_t starts[5];
+    unsigned parts = pulse_log_split(r, 4, starts);
+    ASSERT_EQUALS(parts, 4);
+    unsigned total = 0;
+    for (unsigned p = 0; p < parts; ++p) {
+        for (pos = starts[p]; pos < starts[p + 1] && pulse_log_read(r, &pos, &out) == 1;)
+            ++total;
+    }
+    ASSERT_EQUALS(total, TEST_PACKAGES);
+    pulse_log_close(r);
+
+    // a log that was not closed is readable up to the last complete record
+    uint8_t *buf = malloc(packages_end - 3);
+    if (!buf)
+        return 1;
+    file = fopen(TEST_FILE, "rb");
+    size_t n = fread(buf, 1, packages_end - 3, file);
+    fclose(file);
+    file = fopen(TEST_FILE, "wb");
+    fwrite(buf, 1, n, file);
+    fclose(file);
+    free(buf);
+
+    r = pulse_log_open(TEST_FILE);
+    ASSERT_EQUALS(r != NULL, 1);
+    ASSERT_EQUALS(r->num_index, (TEST_PACKAGES + PULSE_LOG_INDEX_INTERVAL - 1) / PULSE_LOG_INDEX_INTERVAL);
+    pos = r->start;
+    k = 0;
+    while (pulse_log_read(r, &pos, &out) == 1)
+        ++k;
+    ASSERT_EQUALS(k, TEST_PACKAGES - 1);
+    pulse_log_close(r);
+
+    remove(TEST_FILE);
+
+    fprintf(stderr, "pulse_log:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+    return failed;
+}
+#endif /* _TEST */
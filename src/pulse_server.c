@@ -0,0 +1,996 @@
+/** @file
+    Pulse ingest server, receives pulse packets from remote receivers.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+/*
+    Receivers send packets as UDP datagrams or over a TCP connection to the
+    same port, a packet is either binary or a line of RfRaw text.
+
+    Binary packet, all values little-endian:
+
+        u8  magic 0xa5
+        u8  version 1
+        u8  flags, bit 0 set for FSK pulses
+        u8  name length N, 0 to use the sender address
+        u16 payload length L
+        i16 RSSI in 0.1 dB
+        i16 SNR in 0.1 dB
+        u32 sample rate the widths are counted in, 0 for microseconds
+        u32 frequency in Hz, 0 if unknown
+        N bytes receiver name
+        L bytes payload, pairs of pulse and gap widths as LEB128 varints
+
+    Text line: an optional receiver name as "@name" and a space, then an RfRaw
+    string, e.g. "@garage AAB1...55". Blank lines and lines starting with '#'
+    are skipped.
+
+    The packets are parsed on the server thread and queued to the decoder
+    thread (single producer, single consumer). If the decoders don't keep up
+    the queue fills and further packets are dropped and counted, the server
+    thread never waits on the decoders.
+*/
+
+#include "pulse_server.h"
+#include "spsc_queue.h"
+#include "compat_pthread.h"
+#include "optparse.h"
+#include "rfraw.h"
+#include "data.h"
+#include "list.h"
+#include "metrics.h"
+#include "fatal.h"
+#include "r_util.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "mongoose.h"
+
+#ifndef _WIN32
+#include <signal.h>
+#endif
+
+#define PULSE_SERVER_POLL_MS 100 // poll timeout, a stop request wakes us up
+#define PULSE_SERVER_MAX_DATAGRAM 65536
+
+// exported by mongoose.c but not declared in mongoose.h
+void mg_set_non_blocking_mode(sock_t sock);
+
+typedef struct pulse_client {
+    sock_t sock;
+    char addr[64];
+    size_t len;
+    uint8_t *buf;
+} pulse_client_t;
+
+/// Statistics of a receiver, counted by the server thread and read by the decoder thread, atomic.
+typedef struct pulse_source {
+    char name[PULSE_SERVER_NAME_MAX];
+    char addr[64];              ///< first sender address
+    unsigned hash;
+    unsigned packets;
+    unsigned pulses;
+    unsigned bad;
+    unsigned dropped;
+    uint64_t last_seen;         ///< time_t seconds
+} pulse_source_t;
+
+struct pulse_server {
+    sock_t udp;
+    sock_t listener;
+    sock_t wake[2];             ///< stop request, written by the decoder thread
+    sock_t ready[2];            ///< new packets, written by the server thread
+    unsigned port;
+    int verbosity;
+    unsigned stop;
+    int threaded;
+#ifdef THREADS
+    pthread_t thread;
+#endif
+
+    spsc_queue_t *queue;        ///< pulse_packet_t to decode
+    pulse_packet_t packet;      ///< parse buffer, server thread only
+    pulse_packet_t out;         ///< read buffer, decoder thread only
+    uint8_t *datagram;
+
+    unsigned max_clients;
+    pulse_client_t *clients;
+    unsigned num_sources;       ///< published after the entry is filled in
+    pulse_source_t *sources;
+
+    // stats, atomic as counted by the server thread and read by the decoder thread
+    unsigned num_clients;
+    unsigned stat_accepted;
+    unsigned stat_rejected;
+    unsigned stat_packets;
+    unsigned stat_bad;
+    unsigned stat_dropped;
+    unsigned stat_untracked;    ///< packets of receivers beyond PULSE_SERVER_MAX_SOURCES
+    unsigned max_queued;
+};
+
+static int would_block(void)
+{
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+/* packet parsing */
+
+static unsigned get_u16(uint8_t const *p)
+{
+    return (unsigned)p[0] | (unsigned)p[1] << 8;
+}
+
+static uint32_t get_u32(uint8_t const *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/// @return 0 if the varint is truncated or exceeds 31 bits
+static int get_varint(uint8_t const *data, size_t end, size_t *pos, int *val)
+{
+    uint32_t v = 0;
+    for (unsigned shift = 0; shift < 32 && *pos < end; shift += 7) {
+        uint8_t b = data[(*pos)++];
+        v |= (uint32_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            if (v > INT32_MAX)
+                return 0;
+            *val = (int)v;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/// Copy a receiver name, anything but alphanumerics and ".-_:" is replaced.
+static void set_name(char *dst, char const *src, size_t len)
+{
+    if (len > PULSE_SERVER_NAME_MAX - 1)
+        len = PULSE_SERVER_NAME_MAX - 1;
+    for (size_t i = 0; i < len; ++i) {
+        char c = src[i];
+        int ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+                || c == '.' || c == '-' || c == '_' || c == ':';
+        dst[i] = ok ? c : '_';
+    }
+    dst[len] = '\0';
+}
+
+static int parse_binary(uint8_t const *buf, size_t len, int eof, size_t *used, pulse_packet_t *packet)
+{
+    if (len < PULSE_PACKET_HEADER_LEN) {
+        *used = eof ? len : 0;
+        return eof ? -1 : 0;
+    }
+    unsigned name_len = buf[3];
+    unsigned payload  = get_u16(&buf[4]);
+    size_t total      = PULSE_PACKET_HEADER_LEN + name_len + payload;
+    if (len < total) {
+        *used = eof ? len : 0;
+        return eof ? -1 : 0;
+    }
+    *used = total;
+    if (buf[1] != PULSE_PACKET_VERSION)
+        return -1;
+
+    pulse_data_t *data = &packet->data;
+    pulse_data_clear(data);
+    uint32_t rate      = get_u32(&buf[10]);
+    data->sample_rate  = rate ? rate : 1000000;
+    data->rssi_db      = (int16_t)get_u16(&buf[6]) * 0.1f;
+    data->snr_db       = (int16_t)get_u16(&buf[8]) * 0.1f;
+    data->noise_db     = data->rssi_db - data->snr_db;
+    data->freq1_hz     = get_u32(&buf[14]);
+    data->centerfreq_hz = data->freq1_hz;
+    if (buf[2] & PULSE_PACKET_FSK)
+        data->fsk_f2_est = 1; // mark as FSK data
+
+    set_name(packet->source, (char const *)&buf[PULSE_PACKET_HEADER_LEN], name_len);
+
+    size_t pos = PULSE_PACKET_HEADER_LEN + name_len;
+    while (pos < total) {
+        if (data->num_pulses >= PD_MAX_PULSES)
+            return -1;
+        if (!get_varint(buf, total, &pos, &data->pulse[data->num_pulses])
+                || !get_varint(buf, total, &pos, &data->gap[data->num_pulses]))
+            return -1;
+        data->num_pulses++;
+    }
+    return data->num_pulses ? 1 : -1;
+}
+
+static int parse_text(uint8_t const *buf, size_t len, int eof, size_t *used, pulse_packet_t *packet)
+{
+    uint8_t const *nl = memchr(buf, '\n', len);
+    size_t line_len   = nl ? (size_t)(nl - buf) : len;
+    if (!nl && !eof && len < PULSE_SERVER_MAX_PACKET) {
+        *used = 0;
+        return 0;
+    }
+    *used = nl ? line_len + 1 : len;
+    if (line_len >= PULSE_SERVER_MAX_PACKET)
+        return -1;
+
+    char line[PULSE_SERVER_MAX_PACKET];
+    memcpy(line, buf, line_len);
+    line[line_len] = '\0';
+
+    char *p = line;
+    while (*p == ' ' || *p == '\t' || *p == '\r')
+        ++p;
+    if (!*p || *p == '#')
+        return -2;
+
+    if (*p == '@') {
+        char *name = ++p;
+        while (*p && *p != ' ' && *p != '\t')
+            ++p;
+        set_name(packet->source, name, p - name);
+    }
+
+    pulse_data_t *data = &packet->data;
+    pulse_data_clear(data);
+    if (!rfraw_check(p) || !rfraw_parse(data, p))
+        return -1;
+    return data->num_pulses ? 1 : -1;
+}
+
+int pulse_packet_parse(uint8_t const *buf, size_t len, int eof, size_t *used, pulse_packet_t *packet)
+{
+    if (!len) {
+        *used = 0;
+        return 0;
+    }
+    // the name is kept once parsed, also for a bad packet
+    packet->source[0] = '\0';
+    if (buf[0] == PULSE_PACKET_MAGIC)
+        return parse_binary(buf, len, eof, used, packet);
+    return parse_text(buf, len, eof, used, packet);
+}
+
+/* receivers and queue, server thread */
+
+static unsigned name_hash(char const *name)
+{
+    unsigned hash = 2166136261u; // FNV-1a
+    for (; *name; ++name)
+        hash = (hash ^ (unsigned char)*name) * 16777619u;
+    return hash;
+}
+
+/// Find or add the statistics entry of a receiver.
+/// @return the entry or NULL if the table is full
+static pulse_source_t *source_find(struct pulse_server *srv, char const *name, char const *addr)
+{
+    unsigned hash = name_hash(name);
+    unsigned n    = srv->num_sources;
+    for (unsigned i = 0; i < n; ++i) {
+        pulse_source_t *s = &srv->sources[i];
+        if (s->hash == hash && !strcmp(s->name, name))
+            return s;
+    }
+    if (n >= PULSE_SERVER_MAX_SOURCES)
+        return NULL;
+
+    pulse_source_t *s = &srv->sources[n];
+    snprintf(s->name, sizeof(s->name), "%s", name);
+    snprintf(s->addr, sizeof(s->addr), "%s", addr);
+    s->hash = hash;
+    atomic_store_release(&srv->num_sources, n + 1);
+    if (srv->verbosity)
+        fprintf(stderr, "Pulse receiver \"%s\" at %s\n", name, addr);
+    return s;
+}
+
+/// Account and queue a parsed packet, the source defaults to the sender address.
+/// A bad packet counts under its name if that was parsed.
+static void packet_received(struct pulse_server *srv, int ret, char const *addr)
+{
+    pulse_packet_t *packet = &srv->packet;
+    if (ret == -2)
+        return; // blank or comment line
+    if (!packet->source[0])
+        set_name(packet->source, addr, strlen(addr));
+
+    pulse_source_t *s = source_find(srv, packet->source, addr);
+    if (!s)
+        atomic_add_fetch_seq(&srv->stat_untracked, 1);
+    if (ret < 0) {
+        atomic_add_fetch_seq(&srv->stat_bad, 1);
+        if (s)
+            atomic_add_fetch_seq(&s->bad, 1);
+        if (srv->verbosity > 1)
+            fprintf(stderr, "Bad pulse packet from %s\n", addr);
+        return;
+    }
+
+    get_time_now(&packet->received);
+    packet->data.offset = 0;
+    atomic_add_fetch_seq(&srv->stat_packets, 1);
+    if (s) {
+        atomic_add_fetch_seq(&s->packets, 1);
+        atomic_add_fetch_seq(&s->pulses, (unsigned)packet->data.num_pulses);
+        atomic_store_release64(&s->last_seen, (uint64_t)packet->received.tv_sec);
+    }
+
+    unsigned queued = spsc_queue_len(srv->queue);
+    if (queued > atomic_load_acquire(&srv->max_queued))
+        atomic_store_release(&srv->max_queued, queued);
+    if (!spsc_queue_push(srv->queue, packet)) {
+        atomic_add_fetch_seq(&srv->stat_dropped, 1);
+        if (s)
+            atomic_add_fetch_seq(&s->dropped, 1);
+        return;
+    }
+    if (srv->threaded)
+        send(srv->ready[0], "", 1, 0); // a failed send means a wake up is pending anyway
+}
+
+static void udp_recv(struct pulse_server *srv)
+{
+    for (;;) {
+        struct sockaddr_storage sa;
+        socklen_t sa_len = sizeof(sa);
+        int r = recvfrom(srv->udp, (char *)srv->datagram, PULSE_SERVER_MAX_DATAGRAM, 0, (struct sockaddr *)&sa, &sa_len);
+        if (r < 0)
+            return; // would block, or an error to ignore on a datagram socket
+        char addr[64];
+        if (getnameinfo((struct sockaddr *)&sa, sa_len, addr, sizeof(addr), NULL, 0, NI_NUMERICHOST))
+            snprintf(addr, sizeof(addr), "unknown");
+
+        // a datagram may hold several packets, a truncated packet is bad
+        size_t pos = 0;
+        while (pos < (size_t)r) {
+            size_t used;
+            int ret = pulse_packet_parse(&srv->datagram[pos], r - pos, 1, &used, &srv->packet);
+            packet_received(srv, ret, addr);
+            pos += used;
+        }
+    }
+}
+
+static void client_close(struct pulse_server *srv, pulse_client_t *c)
+{
+    closesocket(c->sock);
+    c->sock = INVALID_SOCKET;
+    atomic_sub_fetch_seq(&srv->num_clients, 1);
+    if (srv->verbosity)
+        fprintf(stderr, "Pulse client %s disconnected\n", c->addr);
+}
+
+static void client_accept(struct pulse_server *srv)
+{
+    struct sockaddr_storage sa;
+    socklen_t sa_len = sizeof(sa);
+    sock_t sock = accept(srv->listener, (struct sockaddr *)&sa, &sa_len);
+    if (sock == INVALID_SOCKET)
+        return;
+
+    pulse_client_t *c = NULL;
+    for (unsigned i = 0; i < srv->max_clients; ++i) {
+        if (srv->clients[i].sock == INVALID_SOCKET) {
+            c = &srv->clients[i];
+            break;
+        }
+    }
+    if (!c) {
+        atomic_add_fetch_seq(&srv->stat_rejected, 1);
+        closesocket(sock);
+        return;
+    }
+    if (!c->buf) {
+        c->buf = malloc(PULSE_SERVER_MAX_PACKET);
+        if (!c->buf) {
+            WARN_MALLOC("client_accept()");
+            closesocket(sock);
+            return;
+        }
+    }
+
+    c->sock = sock;
+    c->len  = 0;
+    if (getnameinfo((struct sockaddr *)&sa, sa_len, c->addr, sizeof(c->addr), NULL, 0, NI_NUMERICHOST))
+        snprintf(c->addr, sizeof(c->addr), "unknown");
+    mg_set_non_blocking_mode(sock);
+    atomic_add_fetch_seq(&srv->num_clients, 1);
+    atomic_add_fetch_seq(&srv->stat_accepted, 1);
+
+    if (srv->verbosity)
+        fprintf(stderr, "Pulse client %s connected\n", c->addr);
+}
+
+/// Read and queue packets, returns -1 if the client closed.
+static int client_recv(struct pulse_server *srv, pulse_client_t *c)
+{
+    for (;;) {
+        int r = recv(c->sock, (char *)&c->buf[c->len], PULSE_SERVER_MAX_PACKET - c->len, 0);
+        if (r < 0)
+            return would_block() ? 0 : -1;
+        int eof = r == 0;
+        c->len += r;
+
+        size_t pos = 0;
+        while (pos < c->len) {
+            size_t used;
+            int ret = pulse_packet_parse(&c->buf[pos], c->len - pos, eof, &used, &srv->packet);
+            if (!used)
+                break;
+            packet_received(srv, ret, c->addr);
+            pos += used;
+        }
+        // a full buffer always parses, binary packets and lines are shorter
+        memmove(c->buf, &c->buf[pos], c->len - pos);
+        c->len -= pos;
+
+        if (eof)
+            return -1;
+    }
+}
+
+/// Accept clients and receive packets, waits up to @p timeout_ms for activity.
+static void pulse_server_poll(struct pulse_server *srv, int timeout_ms)
+{
+    fd_set read_set;
+    FD_ZERO(&read_set);
+    sock_t max_fd = srv->listener > srv->udp ? srv->listener : srv->udp;
+    FD_SET(srv->listener, &read_set);
+    FD_SET(srv->udp, &read_set);
+    if (srv->threaded) {
+        FD_SET(srv->wake[1], &read_set);
+        if (srv->wake[1] > max_fd)
+            max_fd = srv->wake[1];
+    }
+    for (unsigned i = 0; i < srv->max_clients; ++i) {
+        pulse_client_t *c = &srv->clients[i];
+        if (c->sock == INVALID_SOCKET)
+            continue;
+        FD_SET(c->sock, &read_set);
+        if (c->sock > max_fd)
+            max_fd = c->sock;
+    }
+
+    struct timeval tv = {timeout_ms / 1000, timeout_ms % 1000 * 1000};
+    int n = select((int)max_fd + 1, &read_set, NULL, NULL, &tv);
+    if (n <= 0)
+        return;
+
+    if (srv->threaded && FD_ISSET(srv->wake[1], &read_set)) {
+        char buf[64];
+        while (recv(srv->wake[1], buf, sizeof(buf), 0) > 0) {
+            // the wake up data carries no information, the stop flag is set
+        }
+    }
+
+    if (FD_ISSET(srv->udp, &read_set))
+        udp_recv(srv);
+
+    for (unsigned i = 0; i < srv->max_clients; ++i) {
+        pulse_client_t *c = &srv->clients[i];
+        if (c->sock == INVALID_SOCKET)
+            continue;
+        if (FD_ISSET(c->sock, &read_set) && client_recv(srv, c) < 0)
+            client_close(srv, c);
+    }
+
+    if (FD_ISSET(srv->listener, &read_set))
+        client_accept(srv);
+}
+
+#ifdef THREADS
+static THREAD_RETURN THREAD_CALL pulse_server_run(void *arg)
+{
+    struct pulse_server *srv = arg;
+
+#ifndef _WIN32
+    // signals are handled by the decoder thread
+    sigset_t sigset;
+    sigfillset(&sigset);
+    pthread_sigmask(SIG_BLOCK, &sigset, NULL);
+#endif
+
+    while (!atomic_load_acquire(&srv->stop)) {
+        pulse_server_poll(srv, PULSE_SERVER_POLL_MS);
+    }
+
+    return (THREAD_RETURN)0;
+}
+#endif
+
+static sock_t pulse_server_bind(char const *host, char const *port, int socktype, unsigned *bound_port)
+{
+    struct addrinfo hints, *res, *res0;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = PF_UNSPEC;
+    hints.ai_socktype = socktype;
+    hints.ai_flags    = AI_PASSIVE;
+
+    int ret = getaddrinfo(host, port, &hints, &res0);
+    if (ret) {
+        fprintf(stderr, "%s\n", gai_strerror(ret));
+        return INVALID_SOCKET;
+    }
+    sock_t sock = INVALID_SOCKET;
+    for (res = res0; res; res = res->ai_next) {
+        sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+        if (sock == INVALID_SOCKET)
+            continue;
+        int const value_one = 1;
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (char const *)&value_one, sizeof(value_one));
+        if (bind(sock, res->ai_addr, (socklen_t)res->ai_addrlen) == 0
+                && (socktype != SOCK_STREAM || listen(sock, 16) == 0))
+            break; // success
+        closesocket(sock);
+        sock = INVALID_SOCKET;
+    }
+    freeaddrinfo(res0);
+    if (sock == INVALID_SOCKET) {
+        perror("pulse server");
+        return INVALID_SOCKET;
+    }
+
+    struct sockaddr_storage sa;
+    socklen_t sa_len = sizeof(sa);
+    *bound_port = 0;
+    if (getsockname(sock, (struct sockaddr *)&sa, &sa_len) == 0) {
+        if (sa.ss_family == AF_INET)
+            *bound_port = ntohs(((struct sockaddr_in *)&sa)->sin_port);
+        else if (sa.ss_family == AF_INET6)
+            *bound_port = ntohs(((struct sockaddr_in6 *)&sa)->sin6_port);
+    }
+    mg_set_non_blocking_mode(sock);
+    return sock;
+}
+
+struct pulse_server *pulse_server_start(char const *host, char const *port, char *opts, int verbosity)
+{
+    unsigned queue       = PULSE_SERVER_QUEUE;
+    unsigned max_clients = PULSE_SERVER_MAX_CLIENTS;
+
+    char *key, *val;
+    while (getkwargs(&opts, &key, &val)) {
+        key = remove_ws(key);
+        val = trim_ws(val);
+        if (!key || !*key)
+            continue;
+        else if (!strcasecmp(key, "queue"))
+            queue = atouint32_metric(val, "queue= ");
+        else if (!strcasecmp(key, "clients"))
+            max_clients = atouint32_metric(val, "clients= ");
+        else {
+            fprintf(stderr, "Invalid key \"%s\" option.\n", key);
+            return NULL;
+        }
+    }
+    if (queue < 2 || max_clients > FD_SETSIZE - 4) {
+        fprintf(stderr, "Pulse server needs a queue of 2 or more packets and up to %d clients.\n", FD_SETSIZE - 4);
+        return NULL;
+    }
+
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        perror("WSAStartup()");
+        return NULL;
+    }
+#endif
+
+    struct pulse_server *srv = calloc(1, sizeof(*srv));
+    if (!srv) {
+        WARN_CALLOC("pulse_server_start()");
+        return NULL;
+    }
+    srv->verbosity   = verbosity;
+    srv->max_clients = max_clients;
+    srv->udp         = INVALID_SOCKET;
+    srv->listener    = INVALID_SOCKET;
+    srv->wake[0]     = INVALID_SOCKET;
+    srv->wake[1]     = INVALID_SOCKET;
+    srv->ready[0]    = INVALID_SOCKET;
+    srv->ready[1]    = INVALID_SOCKET;
+
+    srv->clients = calloc(max_clients ? max_clients : 1, sizeof(*srv->clients));
+    if (!srv->clients) {
+        WARN_CALLOC("pulse_server_start()");
+        goto fail;
+    }
+    for (unsigned i = 0; i < max_clients; ++i)
+        srv->clients[i].sock = INVALID_SOCKET;
+    srv->sources = calloc(PULSE_SERVER_MAX_SOURCES, sizeof(*srv->sources));
+    if (!srv->sources) {
+        WARN_CALLOC("pulse_server_start()");
+        goto fail;
+    }
+    srv->datagram = malloc(PULSE_SERVER_MAX_DATAGRAM);
+    if (!srv->datagram) {
+        WARN_MALLOC("pulse_server_start()");
+        goto fail;
+    }
+    srv->queue = spsc_queue_create(queue, sizeof(pulse_packet_t));
+    if (!srv->queue)
+        goto fail;
+
+    // the TCP port might be picked by the system, UDP then uses the same
+    srv->listener = pulse_server_bind(host, port, SOCK_STREAM, &srv->port);
+    if (srv->listener == INVALID_SOCKET)
+        goto fail;
+    char port_str[8];
+    snprintf(port_str, sizeof(port_str), "%u", srv->port);
+    unsigned udp_port;
+    srv->udp = pulse_server_bind(host, port_str, SOCK_DGRAM, &udp_port);
+    if (srv->udp == INVALID_SOCKET)
+        goto fail;
+
+#ifdef THREADS
+    if (!mg_socketpair(srv->wake, SOCK_DGRAM) || !mg_socketpair(srv->ready, SOCK_DGRAM)) {
+        fprintf(stderr, "Failed to create the pulse server wake up sockets.\n");
+        goto fail;
+    }
+    mg_set_non_blocking_mode(srv->wake[0]);
+    mg_set_non_blocking_mode(srv->wake[1]);
+    mg_set_non_blocking_mode(srv->ready[0]);
+    mg_set_non_blocking_mode(srv->ready[1]);
+    srv->threaded = 1;
+    if (pthread_create(&srv->thread, NULL, pulse_server_run, srv)) {
+        fprintf(stderr, "Failed to start the pulse server thread.\n");
+        srv->threaded = 0;
+        goto fail;
+    }
+#endif
+
+    return srv;
+
+fail:
+    pulse_server_stop(srv);
+    return NULL;
+}
+
+void pulse_server_stop(struct pulse_server *srv)
+{
+    if (!srv)
+        return;
+
+#ifdef THREADS
+    if (srv->threaded) {
+        atomic_store_release(&srv->stop, 1);
+        send(srv->wake[0], "", 1, 0);
+        pthread_join(srv->thread, NULL);
+    }
+#endif
+
+    for (unsigned i = 0; srv->clients && i < srv->max_clients; ++i) {
+        if (srv->clients[i].sock != INVALID_SOCKET)
+            client_close(srv, &srv->clients[i]);
+        free(srv->clients[i].buf);
+    }
+    sock_t socks[] = {srv->udp, srv->listener, srv->wake[0], srv->wake[1], srv->ready[0], srv->ready[1]};
+    for (unsigned i = 0; i < sizeof(socks) / sizeof(*socks); ++i) {
+        if (socks[i] != INVALID_SOCKET)
+            closesocket(socks[i]);
+    }
+    spsc_queue_free(srv->queue);
+    free(srv->datagram);
+    free(srv->sources);
+    free(srv->clients);
+    free(srv);
+}
+
+unsigned pulse_server_port(struct pulse_server *srv)
+{
+    return srv->port;
+}
+
+/* decoder thread */
+
+pulse_packet_t const *pulse_server_read(struct pulse_server *srv, int timeout_ms)
+{
+    if (!srv->threaded) {
+        if (!spsc_queue_len(srv->queue))
+            pulse_server_poll(srv, timeout_ms);
+        return spsc_queue_pop(srv->queue, &srv->out) ? &srv->out : NULL;
+    }
+
+    for (int wait = 0; wait < 2; ++wait) {
+        char buf[64];
+        while (recv(srv->ready[1], buf, sizeof(buf), 0) > 0) {
+            // the wake up data carries no information, packets are in the queue
+        }
+        if (spsc_queue_pop(srv->queue, &srv->out))
+            return &srv->out;
+        if (wait)
+            break;
+
+        fd_set read_set;
+        FD_ZERO(&read_set);
+        FD_SET(srv->ready[1], &read_set);
+        struct timeval tv = {timeout_ms / 1000, timeout_ms % 1000 * 1000};
+        if (select((int)srv->ready[1] + 1, &read_set, NULL, NULL, &tv) <= 0)
+            break;
+    }
+    return NULL;
+}
+
+data_t *pulse_server_stats(struct pulse_server *srv)
+{
+    list_t source_data_list = {0};
+    unsigned num_sources = atomic_load_acquire(&srv->num_sources);
+    time_t now           = time(NULL);
+    for (unsigned i = 0; i < num_sources; ++i) {
+        pulse_source_t *s = &srv->sources[i];
+        time_t last_seen  = (time_t)atomic_load_acquire64(&s->last_seen);
+        list_push(&source_data_list, data_make(
+                "name",             "", DATA_STRING, s->name,
+                "addr",             "", DATA_STRING, s->addr,
+                "packets",          "", DATA_INT, atomic_load_acquire(&s->packets),
+                "pulses",           "", DATA_INT, atomic_load_acquire(&s->pulses),
+                "bad",              "", DATA_INT, atomic_load_acquire(&s->bad),
+                "dropped",          "", DATA_INT, atomic_load_acquire(&s->dropped),
+                "last_seen_ago",    "", DATA_INT, last_seen ? (int)(now - last_seen) : -1,
+                NULL));
+    }
+
+    data_t *data = data_make(
+            "port",             "", DATA_INT, srv->port,
+            "clients",          "", DATA_INT, atomic_load_acquire(&srv->num_clients),
+            "accepted",         "", DATA_INT, atomic_load_acquire(&srv->stat_accepted),
+            "rejected",         "", DATA_INT, atomic_load_acquire(&srv->stat_rejected),
+            "packets",          "", DATA_INT, atomic_load_acquire(&srv->stat_packets),
+            "bad",              "", DATA_INT, atomic_load_acquire(&srv->stat_bad),
+            "dropped",          "", DATA_INT, atomic_load_acquire(&srv->stat_dropped),
+            "queued",           "", DATA_INT, spsc_queue_len(srv->queue),
+            "max_queued",       "", DATA_INT, atomic_load_acquire(&srv->max_queued),
+            "untracked",        "", DATA_INT, atomic_load_acquire(&srv->stat_untracked),
+            "receivers",        "", DATA_COND, source_data_list.len > 0, DATA_ARRAY, data_array(source_data_list.len, DATA_DATA, source_data_list.elems),
+            NULL);
+    list_free_elems(&source_data_list, NULL);
+    return data;
+}
+
+static double pulse_server_receivers(void *ctx)
+{
+    struct pulse_server *srv = ctx;
+    return atomic_load_acquire(&srv->num_sources);
+}
+
+static double pulse_server_queued(void *ctx)
+{
+    struct pulse_server *srv = ctx;
+    return spsc_queue_len(srv->queue);
+}
+
+void pulse_server_metrics(struct pulse_server *srv, metrics_t *metrics)
+{
+    metric_family_t *family;
+    family = metrics_family(metrics, "rtl_433_pulse_server_receivers", "Remote receivers seen by the pulse server.", METRIC_GAUGE);
+    metric_add_fn(family, NULL, pulse_server_receivers, srv);
+    family = metrics_family(metrics, "rtl_433_pulse_server_packets_total", "Pulse packets received.", METRIC_COUNTER);
+    metric_add_unsigned(family, NULL, &srv->stat_packets);
+    family = metrics_family(metrics, "rtl_433_pulse_server_bad_total", "Pulse packets that failed to parse.", METRIC_COUNTER);
+    metric_add_unsigned(family, NULL, &srv->stat_bad);
+    family = metrics_family(metrics, "rtl_433_pulse_server_dropped_total", "Pulse packets dropped with the decoder queue full.", METRIC_COUNTER);
+    metric_add_unsigned(family, NULL, &srv->stat_dropped);
+    family = metrics_family(metrics, "rtl_433_pulse_server_queued", "Pulse packets waiting for the decoders.", METRIC_GAUGE);
+    metric_add_fn(family, NULL, pulse_server_queued, srv);
+}
+
+#ifdef _TEST
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %s:%d: %s <> %s\n", __FILE__, __LINE__, #a, #b); \
+        } \
+    } while (0)
+
+static unsigned test_put_varint(uint8_t *buf, uint32_t v)
+{
+    unsigned n = 0;
+    while (v >= 0x80) {
+        buf[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    buf[n++] = (uint8_t)v;
+    return n;
+}
+
+/// Build a binary packet of @p count pulse and gap pairs.
+static unsigned test_packet(uint8_t *buf, char const *name, int const *widths, unsigned count, uint32_t rate)
+{
+    unsigned name_len = (unsigned)strlen(name);
+    unsigned n        = PULSE_PACKET_HEADER_LEN + name_len;
+    for (unsigned i = 0; i < count * 2; ++i)
+        n += test_put_varint(&buf[n], widths[i]);
+    unsigned payload = n - PULSE_PACKET_HEADER_LEN - name_len;
+    memset(buf, 0, PULSE_PACKET_HEADER_LEN);
+    buf[0]  = PULSE_PACKET_MAGIC;
+    buf[1]  = PULSE_PACKET_VERSION;
+    buf[3]  = (uint8_t)name_len;
+    buf[4]  = (uint8_t)payload;
+    buf[5]  = (uint8_t)(payload >> 8);
+    buf[6]  = (uint8_t)(uint16_t)-655; // -65.5 dB
+    buf[7]  = (uint8_t)((uint16_t)-655 >> 8);
+    buf[8]  = 123; // 12.3 dB
+    buf[10] = (uint8_t)rate;
+    buf[11] = (uint8_t)(rate >> 8);
+    buf[12] = (uint8_t)(rate >> 16);
+    buf[13] = (uint8_t)(rate >> 24);
+    memcpy(&buf[PULSE_PACKET_HEADER_LEN], name, name_len);
+    return n;
+}
+
+static sock_t test_socket(unsigned port, int socktype)
+{
+    char port_str[8];
+    snprintf(port_str, sizeof(port_str), "%u", port);
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_INET;
+    hints.ai_socktype = socktype;
+    if (getaddrinfo("127.0.0.1", port_str, &hints, &res))
+        return INVALID_SOCKET;
+    sock_t sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (sock != INVALID_SOCKET && connect(sock, res->ai_addr, (socklen_t)res->ai_addrlen)) {
+        closesocket(sock);
+        sock = INVALID_SOCKET;
+    }
+    freeaddrinfo(res);
+    return sock;
+}
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+
+    static pulse_packet_t packet;
+    static uint8_t buf[PULSE_SERVER_MAX_PACKET];
+    size_t used;
+    int const widths[] = {500, 1000, 100000, 2, 70000, 12345};
+
+    fprintf(stderr, "pulse_server::pulse_packet_parse() binary\n");
+    unsigned len = test_packet(buf, "rx 1", widths, 3, 0);
+    ASSERT_EQUALS(pulse_packet_parse(buf, len, 0, &used, &packet), 1);
+    ASSERT_EQUALS(used, len);
+    ASSERT_EQUALS(strcmp(packet.source, "rx_1"), 0);
+    ASSERT_EQUALS(packet.data.num_pulses, 3);
+    ASSERT_EQUALS(packet.data.sample_rate, 1000000);
+    ASSERT_EQUALS(packet.data.pulse[1], 100000);
+    ASSERT_EQUALS(packet.data.gap[1], 2);
+    ASSERT_EQUALS(packet.data.gap[2], 12345);
+    ASSERT_EQUALS(packet.data.rssi_db < -65.4f, 1);
+    ASSERT_EQUALS(packet.data.rssi_db > -65.6f, 1);
+    ASSERT_EQUALS(packet.data.snr_db > 12.2f, 1);
+    ASSERT_EQUALS(packet.data.snr_db < 12.4f, 1);
+    ASSERT_EQUALS(packet.data.fsk_f2_est, 0);
+
+    // a truncated packet needs more bytes, or is bad at the end
+    ASSERT_EQUALS(pulse_packet_parse(buf, len - 1, 0, &used, &packet), 0);
+    ASSERT_EQUALS(used, 0);
+    ASSERT_EQUALS(pulse_packet_parse(buf, 10, 0, &used, &packet), 0);
+    ASSERT_EQUALS(used, 0);
+    ASSERT_EQUALS(pulse_packet_parse(buf, len - 1, 1, &used, &packet), -1);
+    ASSERT_EQUALS(used, len - 1);
+
+    // an odd number of widths is bad, the packet is still skipped
+    len = test_packet(buf, "", widths, 3, 250000);
+    buf[4]--;
+    ASSERT_EQUALS(pulse_packet_parse(buf, len - 1, 0, &used, &packet), -1);
+    ASSERT_EQUALS(used, len - 1);
+    buf[4]++;
+    ASSERT_EQUALS(pulse_packet_parse(buf, len, 0, &used, &packet), 1);
+    ASSERT_EQUALS(packet.source[0], '\0');
+    ASSERT_EQUALS(packet.data.sample_rate, 250000);
+    buf[1] = 2; // unknown version
+    ASSERT_EQUALS(pulse_packet_parse(buf, len, 0, &used, &packet), -1);
+    ASSERT_EQUALS(used, len);
+    ASSERT_EQUALS(packet.source[0], '\0');
+    buf[1] = PULSE_PACKET_VERSION;
+    len = test_packet(buf, "odd", widths, 3, 0);
+    buf[4]--;
+    ASSERT_EQUALS(pulse_packet_parse(buf, len - 1, 0, &used, &packet), -1);
+    ASSERT_EQUALS(strcmp(packet.source, "odd"), 0);
+
+    fprintf(stderr, "pulse_server::pulse_packet_parse() RfRaw\n");
+    char const *text = "# comment\n@garage AAB10301D0057C36B00110011010011001010110101010010110010101010101100255\r\nAA B0 foo\nAAB1";
+    size_t text_len  = strlen(text);
+    ASSERT_EQUALS(pulse_packet_parse((uint8_t const *)text, text_len, 0, &used, &packet), -2);
+    ASSERT_EQUALS(used, 10);
+    size_t pos = used;
+    ASSERT_EQUALS(pulse_packet_parse((uint8_t const *)&text[pos], text_len - pos, 0, &used, &packet), 1);
+    ASSERT_EQUALS(strcmp(packet.source, "garage"), 0);
+    ASSERT_EQUALS(packet.data.num_pulses > 16, 1);
+    pos += used;
+    ASSERT_EQUALS(pulse_packet_parse((uint8_t const *)&text[pos], text_len - pos, 0, &used, &packet), -1);
+    ASSERT_EQUALS(packet.source[0], '\0');
+    pos += used;
+    ASSERT_EQUALS(pulse_packet_parse((uint8_t const *)&text[pos], text_len - pos, 0, &used, &packet), 0);
+    ASSERT_EQUALS(used, 0);
+    text = "@bad XYZ\n";
+    ASSERT_EQUALS(pulse_packet_parse((uint8_t const *)text, strlen(text), 0, &used, &packet), -1);
+    ASSERT_EQUALS(strcmp(packet.source, "bad"), 0);
+
+#ifdef THREADS
+    fprintf(stderr, "pulse_server:: UDP and TCP\n");
+    char opts[] = "queue=4,clients=1";
+    struct pulse_server *srv = pulse_server_start("127.0.0.1", "0", opts, 0);
+    ASSERT_EQUALS(srv != NULL, 1);
+    if (!srv)
+        return 1;
+    ASSERT_EQUALS(pulse_server_port(srv) > 0, 1);
+    ASSERT_EQUALS(pulse_server_read(srv, 10) == NULL, 1);
+
+    sock_t u = test_socket(pulse_server_port(srv), SOCK_DGRAM);
+    ASSERT_EQUALS(u != INVALID_SOCKET, 1);
+    // two packets in one datagram
+    len = test_packet(buf, "esp-1", widths, 3, 0);
+    len += test_packet(&buf[len], "esp-2", widths, 2, 0);
+    ASSERT_EQUALS(send(u, (char const *)buf, len, 0), (int)len);
+    pulse_packet_t const *p = pulse_server_read(srv, 1000);
+    ASSERT_EQUALS(p && !strcmp(p->source, "esp-1") && p->data.num_pulses == 3, 1);
+    p = pulse_server_read(srv, 1000);
+    ASSERT_EQUALS(p && !strcmp(p->source, "esp-2") && p->data.num_pulses == 2, 1);
+
+    // an unnamed packet is tagged with the sender address, a line split over two writes is joined
+    sock_t t = test_socket(pulse_server_port(srv), SOCK_STREAM);
+    ASSERT_EQUALS(t != INVALID_SOCKET, 1);
+    char const *half1 = "AAB10301D0057C36B0011001101001100";
+    char const *half2 = "1010110101010010110010101010101100255\n";
+    ASSERT_EQUALS(send(t, half1, (int)strlen(half1), 0) > 0, 1);
+    ASSERT_EQUALS(pulse_server_read(srv, 200) == NULL, 1);
+    ASSERT_EQUALS(send(t, half2, (int)strlen(half2), 0) > 0, 1);
+    p = pulse_server_read(srv, 1000);
+    ASSERT_EQUALS(p && !strcmp(p->source, "127.0.0.1") && p->data.num_pulses > 16, 1);
+
+    // a second connection is rejected with clients=1
+    sock_t t2 = test_socket(pulse_server_port(srv), SOCK_STREAM);
+    char b;
+    ASSERT_EQUALS(t2 == INVALID_SOCKET || recv(t2, &b, 1, 0) <= 0, 1);
+    if (t2 != INVALID_SOCKET)
+        closesocket(t2);
+
+    // the queue of 4 fills and further packets are dropped
+    len = test_packet(buf, "esp-1", widths, 3, 0);
+    for (unsigned k = 0; k < 8; ++k) {
+        send(u, (char const *)buf, len, 0);
+    }
+    struct timeval tv = {0, 200000};
+    select(0, NULL, NULL, NULL, &tv);
+    unsigned got = 0;
+    while (pulse_server_read(srv, 10))
+        got++;
+    ASSERT_EQUALS(got, 4);
+    ASSERT_EQUALS(srv->stat_dropped, 4);
+    ASSERT_EQUALS(srv->stat_rejected, 1);
+    ASSERT_EQUALS(srv->num_sources, 3);
+    ASSERT_EQUALS(srv->sources[0].packets, 9);
+    ASSERT_EQUALS(srv->sources[0].dropped, 4);
+
+    data_t *data = pulse_server_stats(srv);
+    ASSERT_EQUALS(data != NULL, 1);
+    data_free(data);
+
+    closesocket(t);
+    closesocket(u);
+    pulse_server_stop(srv);
+#endif
+
+    fprintf(stderr, "pulse_server:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+    return failed;
+}
+
+#endif /* _TEST */
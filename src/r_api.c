@@ -12,6 +12,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <stdbool.h>
 #include <string.h>
 #include <math.h>
@@ -23,19 +24,36 @@
 #include "rtl_433_devices.h"
 #include "r_device.h"
 #include "pulse_demod.h"
+#include "pulse_detect.h"
+#include "pulse_analyzer.h"
+#include "baseband.h"
+#include "am_analyze.h"
+#include "samp_grab.h"
+#include "iq_codec.h"
 #include "pulse_detect_fsk.h"
+#include "pulse_log.h"
+#include "recorder.h"
 #include "sdr.h"
 #include "data.h"
 #include "data_tag.h"
 #include "list.h"
 #include "optparse.h"
 #include "output_mqtt.h"
+#include "output_binary.h"
 #include "output_influx.h"
 #include "write_sigrok.h"
 #include "mongoose.h"
 #include "compat_time.h"
+#include "compat_alarm.h"
 #include "fatal.h"
 #include "http_server.h"
+#include "device_state.h"
+#include "latency.h"
+#include "metrics.h"
+#include "abuf.h"
+#include "net_thread.h"
+#include "iq_server.h"
+#include "pulse_server.h"
 
 #ifdef _WIN32
 #include <io.h>
@@ -194,6 +212,15 @@ r_cfg_t *r_create_cfg(void)
 
 void r_free_cfg(r_cfg_t *cfg)
 {
+    net_thread_stop(cfg->net_thread);
+    cfg->net_thread = NULL;
+
+    iq_server_stop(cfg->iq_server);
+    cfg->iq_server = NULL;
+
+    pulse_server_stop(cfg->pulse_server);
+    cfg->pulse_server = NULL;
+
     if (cfg->dev) {
         sdr_deactivate(cfg->dev);
         sdr_close(cfg->dev);
@@ -203,18 +230,26 @@ void r_free_cfg(r_cfg_t *cfg)
 
     for (void **iter = cfg->demod->dumper.elems; iter && *iter; ++iter) {
         file_info_t const *dumper = *iter;
+        pulse_log_writer_close(dumper->pulse_log);
+        recorder_free(dumper->recorder);
+        iq_encoder_close(dumper->iq_encoder);
         if (dumper->file && (dumper->file != stdout))
             fclose(dumper->file);
     }
     list_free_elems(&cfg->demod->dumper, free);
 
     list_free_elems(&cfg->demod->r_devs, (list_elem_free_fn)free_protocol);
+    preamble_matcher_free(cfg->demod->preamble_matcher);
 
     if (cfg->demod->am_analyze)
         am_analyze_free(cfg->demod->am_analyze);
 
+    samp_grab_free(cfg->demod->samp_grab);
+
     pulse_detect_free(cfg->demod->pulse_detect);
 
+    decimator_free(cfg->demod->decimator);
+
     free(cfg->demod);
 
     free(cfg->devices);
@@ -225,6 +260,13 @@ void r_free_cfg(r_cfg_t *cfg)
 
     list_free_elems(&cfg->in_files, NULL);
 
+    device_state_free(cfg->device_state);
+
+    latency_stats_free(cfg->latency);
+
+    metrics_free(cfg->metrics);
+    metrics_free(cfg->output_metrics);
+
     mg_mgr_free(cfg->mgr);
     free(cfg->mgr);
 
@@ -263,6 +305,7 @@ void register_protocol(r_cfg_t *cfg, r_device *r_dev, char *arg)
 
     p->verbose      = dev_verbose ? dev_verbose : (cfg->verbosity > 0 ? cfg->verbosity - 1 : 0);
     p->verbose_bits = cfg->verbose_bits;
+    p->cpu_time     = cfg->report_cpu;
 
     p->output_fn  = data_acquired_handler;
     p->output_ctx = cfg;
@@ -302,6 +345,12 @@ void register_all_protocols(r_cfg_t *cfg, unsigned disabled)
     }
 }
 
+void build_preamble_matcher(r_cfg_t *cfg)
+{
+    preamble_matcher_free(cfg->demod->preamble_matcher);
+    cfg->demod->preamble_matcher = preamble_matcher_create(&cfg->demod->r_devs);
+}
+
 /* output helper */
 
 void calc_rssi_snr(r_cfg_t *cfg, pulse_data_t *pulse_data)
@@ -309,14 +358,14 @@ void calc_rssi_snr(r_cfg_t *cfg, pulse_data_t *pulse_data)
     float ook_high_estimate = pulse_data->ook_high_estimate > 0 ? pulse_data->ook_high_estimate : 1;
     float ook_low_estimate = pulse_data->ook_low_estimate > 0 ? pulse_data->ook_low_estimate : 1;
     float asnr   = ook_high_estimate / ook_low_estimate;
-    float foffs1 = (float)pulse_data->fsk_f1_est / INT16_MAX * cfg->samp_rate / 2.0;
-    float foffs2 = (float)pulse_data->fsk_f2_est / INT16_MAX * cfg->samp_rate / 2.0;
+    float foffs1 = (float)pulse_data->fsk_f1_est / INT16_MAX * cfg->demod->sample_rate / 2.0;
+    float foffs2 = (float)pulse_data->fsk_f2_est / INT16_MAX * cfg->demod->sample_rate / 2.0;
     pulse_data->freq1_hz = (foffs1 + cfg->center_frequency);
     pulse_data->freq2_hz = (foffs2 + cfg->center_frequency);
     pulse_data->centerfreq_hz = cfg->center_frequency;
-    pulse_data->depth_bits    = cfg->demod->sample_size * 4;
+    pulse_data->depth_bits    = cfg->demod->proc_sample_size * 4;
     // NOTE: for (CU8) amplitude is 10x (because it's squares)
-    if (cfg->demod->sample_size == 2 && !cfg->demod->use_mag_est) { // amplitude (CU8)
+    if (cfg->demod->proc_sample_size == 2 && !cfg->demod->use_mag_est) { // amplitude (CU8)
         pulse_data->range_db = 42.1442f; // 10*log10f(16384.0f) == 20*log10f(128.0f)
         pulse_data->rssi_db  = 10.0f * log10f(ook_high_estimate) - 42.1442f; // 10*log10f(16384.0f)
         pulse_data->noise_db = 10.0f * log10f(ook_low_estimate) - 42.1442f; // 10*log10f(16384.0f)
@@ -335,12 +384,12 @@ void calc_rssi_snr(r_cfg_t *cfg, pulse_data_t *pulse_data)
 char *time_pos_str(r_cfg_t *cfg, unsigned samples_ago, char *buf)
 {
     if (cfg->report_time == REPORT_TIME_SAMPLES) {
-        double s_per_sample = 1.0 / cfg->samp_rate;
+        double s_per_sample = 1.0 / cfg->demod->sample_rate;
         return sample_pos_str(cfg->demod->sample_file_pos - samples_ago * s_per_sample, buf);
     }
     else {
         struct timeval ago = cfg->demod->now;
-        double us_per_sample = 1e6 / cfg->samp_rate;
+        double us_per_sample = 1e6 / cfg->demod->sample_rate;
         unsigned usecs_ago   = samples_ago * us_per_sample;
         while (ago.tv_usec < (int)usecs_ago) {
             ago.tv_sec -= 1;
@@ -402,6 +451,8 @@ char const **well_known_output_fields(r_cfg_t *cfg)
         list_push(&field_list, "snr");
         list_push(&field_list, "noise");
     }
+    if (cfg->pulse_server)
+        list_push(&field_list, "receiver");
 
     return (char const **)field_list.elems;
 }
@@ -462,12 +513,19 @@ char const **determine_csv_fields(r_cfg_t *cfg, char const *const *well_known, i
     return (char const **)field_list.elems;
 }
 
+static void account_cpu(r_device *r_dev, uint64_t start)
+{
+    r_dev->demod_calls += 1;
+    r_dev->demod_nsec += monotonic_nsec() - start;
+}
+
 int run_ook_demods(list_t *r_devs, pulse_data_t *pulse_data)
 {
     int p_events = 0;
 
     for (void **iter = r_devs->elems; iter && *iter; ++iter) {
         r_device *r_dev = *iter;
+        uint64_t start = r_dev->cpu_time ? monotonic_nsec() : 0;
         switch (r_dev->modulation) {
         case OOK_PULSE_PCM_RZ:
             p_events += pulse_demod_pcm(pulse_data, r_dev);
@@ -504,6 +562,8 @@ int run_ook_demods(list_t *r_devs, pulse_data_t *pulse_data)
         default:
             fprintf(stderr, "Unknown modulation %u in protocol!\n", r_dev->modulation);
         }
+        if (r_dev->cpu_time && r_dev->modulation < FSK_DEMOD_MIN_VAL)
+            account_cpu(r_dev, start);
     }
 
     return p_events;
@@ -515,6 +575,7 @@ int run_fsk_demods(list_t *r_devs, pulse_data_t *fsk_pulse_data)
 
     for (void **iter = r_devs->elems; iter && *iter; ++iter) {
         r_device *r_dev = *iter;
+        uint64_t start = r_dev->cpu_time ? monotonic_nsec() : 0;
         switch (r_dev->modulation) {
         // OOK decoders
         case OOK_PULSE_PCM_RZ:
@@ -539,15 +600,549 @@ int run_fsk_demods(list_t *r_devs, pulse_data_t *fsk_pulse_data)
         default:
             fprintf(stderr, "Unknown modulation %u in protocol!\n", r_dev->modulation);
         }
+        if (r_dev->cpu_time && r_dev->modulation >= FSK_DEMOD_MIN_VAL)
+            account_cpu(r_dev, start);
     }
 
     return p_events;
 }
 
+/* sample processing */
+
+static uint64_t profile_stage(struct dm_state *demod, enum profile_stage stage, uint64_t start)
+{
+    uint64_t now = monotonic_nsec();
+    demod->profile_nsec[stage] += now - start;
+    return now;
+}
+
+void sdr_callback(unsigned char *iq_buf, uint32_t len, void *ctx)
+{
+    r_cfg_t *cfg = ctx;
+    struct dm_state *demod = cfg->demod;
+    char time_str[LOCAL_TIME_BUFLEN];
+    unsigned long n_samples;
+
+    if ((cfg->bytes_to_read > 0) && (cfg->bytes_to_read <= len)) {
+        len = cfg->bytes_to_read;
+        cfg->exit_async = 1;
+    }
+
+    // save last frame time to see if a new second started
+    time_t last_frame_sec = demod->now.tv_sec;
+    get_time_now(&demod->now);
+    demod->buffer_usec = monotonic_usec();
+
+    n_samples = len / demod->sample_size;
+    if (n_samples * demod->sample_size != len) {
+        fprintf(stderr, "Sample buffer length not aligned to sample size!\n");
+    }
+    if (!n_samples) {
+        fprintf(stderr, "Sample buffer too short!\n");
+        return; // keep the watchdog timer running
+    }
+
+    // require callback to run every 3 second, abort otherwise
+    // re-arming once a second is enough and saves a syscall per transfer with small buffers
+    if (last_frame_sec != demod->now.tv_sec)
+        alarm(3);
+
+    uint64_t stage_start = demod->profile ? monotonic_nsec() : 0;
+
+    // serve the acquisition buffer as is, before any processing
+    if (cfg->iq_server && demod->load_info.format != S16_AM && demod->load_info.format != S16_FM) {
+        iq_server_push(cfg->iq_server, iq_buf, len, demod->sample_size);
+    }
+
+    // decimate right after acquisition, all later stages run on CS16 at the reduced rate
+    int decimate = demod->decimator && demod->load_info.format != S16_AM && demod->load_info.format != S16_FM;
+    unsigned decimation = decimate ? demod->decimation : 1;
+    int sample_size     = demod->sample_size;
+    uint32_t samp_rate  = cfg->samp_rate / decimation;
+    uint32_t in_len     = len;
+    if (decimate) {
+        unsigned n_out;
+        iq_buf      = (unsigned char *)decimator_process(demod->decimator, iq_buf, n_samples, sample_size, &n_out);
+        n_samples   = n_out;
+        sample_size = 2 * sizeof(int16_t);
+        len         = n_samples * sample_size;
+        if (demod->profile)
+            stage_start = profile_stage(demod, PROFILE_DECIMATE, stage_start);
+    }
+    demod->sample_rate      = samp_rate;
+    demod->proc_sample_size = sample_size;
+    if (!n_samples)
+        return; // less than one output sample
+
+    // age the frame position if there is one
+    if (demod->frame_start_ago)
+        demod->frame_start_ago += n_samples;
+    if (demod->frame_end_ago)
+        demod->frame_end_ago += n_samples;
+
+    if (demod->samp_grab) {
+        samp_grab_push(demod->samp_grab, iq_buf, len);
+    }
+
+    // AM demodulation
+    float avg_db;
+    if (sample_size == 2) { // CU8
+        if (demod->use_mag_est) {
+            //magnitude_true_cu8(iq_buf, demod->buf.temp, n_samples);
+            avg_db = magnitude_est_cu8(iq_buf, demod->buf.temp, n_samples);
+        }
+        else { // amp est
+            avg_db = envelope_detect(iq_buf, demod->buf.temp, n_samples);
+        }
+    } else { // CS16
+        //magnitude_true_cs16((int16_t *)iq_buf, demod->buf.temp, n_samples);
+        avg_db = magnitude_est_cs16((int16_t *)iq_buf, demod->buf.temp, n_samples);
+    }
+
+    //fprintf(stderr, "noise level: %.1f dB current: %.1f dB min level: %.1f dB\n", demod->noise_level, avg_db, demod->min_level_auto);
+    if (demod->min_level_auto == 0.0f) {
+        demod->min_level_auto = demod->min_level;
+    }
+    if (demod->noise_level == 0.0f) {
+        demod->noise_level = demod->min_level_auto - 3.0f;
+    }
+    int noise_only = avg_db < demod->noise_level + 3.0f; // or demod->min_level_auto?
+    int squelch_hold = 0;
+    if (cfg->low_latency) {
+        // keep processing silent short frames for a default frame length after a signal,
+        // the pulse detector needs the trailing gap to end a package
+        squelch_hold = demod->squelch_hold > 0;
+        if (!noise_only)
+            demod->squelch_hold = DEFAULT_BUF_LENGTH / demod->sample_size / decimation;
+        else
+            demod->squelch_hold = demod->squelch_hold > n_samples ? demod->squelch_hold - n_samples : 0;
+    }
+    // always process frames if loader, dumper, or analyzers are in use, otherwise skip silent frames
+    int process_frame = demod->squelch_offset <= 0 || !noise_only || squelch_hold || demod->load_info.format || demod->analyze_pulses || demod->dumper.len || demod->samp_grab;
+    // the noise estimate time constants are in frames of the default length, scale for short frames
+    float frame_weight = (float)in_len / DEFAULT_BUF_LENGTH;
+    if (noise_only) {
+        if (cfg->low_latency)
+            demod->noise_level += (avg_db - demod->noise_level) * (frame_weight < 8.0f ? frame_weight / 8 : 1.0f);
+        else
+            demod->noise_level = (demod->noise_level * 7 + avg_db) / 8; // fast fall over 8 frames
+        // If auto_level and noise level well below min_level and significant change in noise level
+        if (demod->auto_level > 0 && demod->noise_level < demod->min_level - 3.0f
+                && fabsf(demod->min_level_auto - demod->noise_level - 3.0f) > 1.0f) {
+            demod->min_level_auto = demod->noise_level + 3.0f;
+            fprintf(stderr, "Estimated noise level is %.1f dB, adjusting minimum detection level to %.1f dB\n", demod->noise_level, demod->min_level_auto);
+            pulse_detect_set_levels(demod->pulse_detect, demod->use_mag_est, demod->level_limit, demod->min_level_auto, demod->min_snr, demod->detect_verbosity);
+        }
+    } else {
+        if (cfg->low_latency)
+            demod->noise_level += (avg_db - demod->noise_level) * (frame_weight < 32.0f ? frame_weight / 32 : 1.0f);
+        else
+            demod->noise_level = (demod->noise_level * 31 + avg_db) / 32; // slow rise over 32 frames
+    }
+    // Report noise every report_noise seconds, but only for the first frame that second
+    if (cfg->report_noise && last_frame_sec != demod->now.tv_sec && demod->now.tv_sec % cfg->report_noise == 0) {
+        fprintf(stderr, "Current %s level %.1f dB, estimated noise %.1f dB\n",
+                noise_only ? "noise" : "signal", avg_db, demod->noise_level);
+    }
+    if (demod->profile)
+        stage_start = profile_stage(demod, PROFILE_ENVELOPE, stage_start);
+
+    if (process_frame)
+    baseband_low_pass_filter(demod->buf.temp, demod->am_buf, n_samples, &demod->lowpass_filter_state);
+    if (demod->profile)
+        stage_start = profile_stage(demod, PROFILE_LOWPASS, stage_start);
+
+    // FM demodulation
+    // Select the correct fsk pulse detector
+    unsigned fpdm = cfg->fsk_pulse_detect_mode;
+    if (cfg->fsk_pulse_detect_mode == FSK_PULSE_DETECT_AUTO) {
+        if (cfg->frequency[cfg->frequency_index] > FSK_PULSE_DETECTOR_LIMIT)
+            fpdm = FSK_PULSE_DETECT_NEW;
+        else
+            fpdm = FSK_PULSE_DETECT_OLD;
+    }
+
+    if (demod->enable_FM_demod && process_frame) {
+        float low_pass = demod->low_pass != 0.0f ? demod->low_pass : fpdm ? 0.2f : 0.1f;
+        if (sample_size == 2) { // CU8
+            baseband_demod_FM(iq_buf, demod->buf.fm, n_samples, samp_rate, low_pass, &demod->demod_FM_state);
+        } else { // CS16
+            baseband_demod_FM_cs16((int16_t *)iq_buf, demod->buf.fm, n_samples, samp_rate, low_pass, &demod->demod_FM_state);
+        }
+    }
+    if (demod->profile)
+        profile_stage(demod, PROFILE_FM, stage_start);
+
+    // Handle special input formats
+    if (demod->load_info.format == S16_AM) { // The IQ buffer is really AM demodulated data
+        if (len > sizeof(demod->am_buf))
+            FATAL("Buffer too small");
+        memcpy(demod->am_buf, iq_buf, len);
+    } else if (demod->load_info.format == S16_FM) { // The IQ buffer is really FM demodulated data
+        // we would need AM for the envelope too
+        if (len > sizeof(demod->buf.fm))
+            FATAL("Buffer too small");
+        memcpy(demod->buf.fm, iq_buf, len);
+    }
+
+    int d_events = 0; // Sensor events successfully detected
+    if (demod->r_devs.len || demod->analyze_pulses || demod->dumper.len || demod->samp_grab) {
+        // Detect a package and loop through demodulators with pulse data
+        int package_type = PULSE_DATA_OOK;  // Just to get us started
+        for (void **iter = demod->dumper.elems; iter && *iter; ++iter) {
+            file_info_t const *dumper = *iter;
+            if (dumper->format == U8_LOGIC) {
+                memset(demod->u8_buf, 0, n_samples);
+                break;
+            }
+        }
+        while (package_type && process_frame) {
+            int p_events = 0; // Sensor events successfully detected per package
+            if (demod->profile)
+                stage_start = monotonic_nsec();
+            package_type = pulse_detect_package(demod->pulse_detect, demod->am_buf, demod->buf.fm, n_samples, samp_rate, cfg->input_pos, &demod->pulse_data, &demod->fsk_pulse_data, fpdm);
+            if (demod->profile)
+                stage_start = profile_stage(demod, PROFILE_DETECT, stage_start);
+            if (package_type) {
+                demod->detect_usec = monotonic_usec();
+                // new package: set a first frame start if we are not tracking one already
+                if (!demod->frame_start_ago)
+                    demod->frame_start_ago = demod->pulse_data.start_ago;
+                // always update the last frame end
+                demod->frame_end_ago = demod->pulse_data.end_ago;
+            }
+            if (package_type == PULSE_DATA_OOK) {
+                calc_rssi_snr(cfg, &demod->pulse_data);
+                if (demod->analyze_pulses) fprintf(stderr, "Detected OOK package\t%s\n", time_pos_str(cfg, demod->pulse_data.start_ago, time_str));
+
+                p_events += run_ook_demods(&demod->r_devs, &demod->pulse_data);
+                if (demod->profile)
+                    profile_stage(demod, PROFILE_DEMOD, stage_start);
+                cfg->frames_count++;
+                cfg->frames_events += p_events > 0;
+                cfg->total_frames++;
+                cfg->total_frames_events += p_events > 0;
+
+                for (void **iter = demod->dumper.elems; iter && *iter; ++iter) {
+                    file_info_t const *dumper = *iter;
+                    if (dumper->format == VCD_LOGIC) pulse_data_print_vcd(dumper->file, &demod->pulse_data, '\'');
+                    if (dumper->format == U8_LOGIC) pulse_data_dump_raw(demod->u8_buf, n_samples, cfg->input_pos, &demod->pulse_data, 0x02);
+                    if (dumper->format == PULSE_OOK) pulse_data_dump(dumper->file, &demod->pulse_data);
+                    if (dumper->format == PULSE_LOG) pulse_log_write(dumper->pulse_log, &demod->pulse_data);
+                    if (dumper->format == SPAN_INDEX) recorder_add_span(dumper->recorder, &demod->pulse_data);
+                }
+
+                if (cfg->verbosity > 2) pulse_data_print(&demod->pulse_data);
+                if (cfg->raw_mode == 1 || (cfg->raw_mode == 2 && p_events == 0) || (cfg->raw_mode == 3 && p_events > 0)) {
+                    data_t *data = pulse_data_print_data(&demod->pulse_data);
+                    event_occurred_handler(cfg, data);
+                }
+                if (demod->analyze_pulses && (cfg->grab_mode <= 1 || (cfg->grab_mode == 2 && p_events == 0) || (cfg->grab_mode == 3 && p_events > 0)) ) {
+                    pulse_analyzer(&demod->pulse_data, package_type);
+                }
+
+            } else if (package_type == PULSE_DATA_FSK) {
+                calc_rssi_snr(cfg, &demod->fsk_pulse_data);
+                if (demod->analyze_pulses) fprintf(stderr, "Detected FSK package\t%s\n", time_pos_str(cfg, demod->fsk_pulse_data.start_ago, time_str));
+
+                p_events += run_fsk_demods(&demod->r_devs, &demod->fsk_pulse_data);
+                if (demod->profile)
+                    profile_stage(demod, PROFILE_DEMOD, stage_start);
+                cfg->frames_fsk++;
+                cfg->frames_events += p_events > 0;
+                cfg->total_frames_fsk++;
+                cfg->total_frames_events += p_events > 0;
+
+                for (void **iter = demod->dumper.elems; iter && *iter; ++iter) {
+                    file_info_t const *dumper = *iter;
+                    if (dumper->format == VCD_LOGIC) pulse_data_print_vcd(dumper->file, &demod->fsk_pulse_data, '"');
+                    if (dumper->format == U8_LOGIC) pulse_data_dump_raw(demod->u8_buf, n_samples, cfg->input_pos, &demod->fsk_pulse_data, 0x04);
+                    if (dumper->format == PULSE_OOK) pulse_data_dump(dumper->file, &demod->fsk_pulse_data);
+                    if (dumper->format == PULSE_LOG) pulse_log_write(dumper->pulse_log, &demod->fsk_pulse_data);
+                    if (dumper->format == SPAN_INDEX) recorder_add_span(dumper->recorder, &demod->fsk_pulse_data);
+                }
+
+                if (cfg->verbosity > 2) pulse_data_print(&demod->fsk_pulse_data);
+                if (cfg->raw_mode == 1 || (cfg->raw_mode == 2 && p_events == 0) || (cfg->raw_mode == 3 && p_events > 0)) {
+                    data_t *data = pulse_data_print_data(&demod->fsk_pulse_data);
+                    event_occurred_handler(cfg, data);
+                }
+                if (demod->analyze_pulses && (cfg->grab_mode <= 1 || (cfg->grab_mode == 2 && p_events == 0) || (cfg->grab_mode == 3 && p_events > 0))) {
+                    pulse_analyzer(&demod->fsk_pulse_data, package_type);
+                }
+            } // if (package_type == ...
+            d_events += p_events;
+
+            // in low latency mode send the output now instead of at the end of the buffer,
+            // the network thread is already woken up by the posted events
+            if (package_type && cfg->low_latency && cfg->mgr && !cfg->net_thread)
+                mg_mgr_poll(cfg->mgr, 0);
+        } // while (package_type)...
+
+        // add event counter to the frames currently tracked
+        demod->frame_event_count += d_events;
+
+        // end frame tracking if older than a whole buffer, but at least a default buffer length
+        unsigned frame_gap = DEFAULT_BUF_LENGTH / demod->sample_size / decimation;
+        if (frame_gap < n_samples)
+            frame_gap = n_samples;
+        if (demod->frame_start_ago && demod->frame_end_ago > frame_gap) {
+            if (demod->samp_grab) {
+                if (cfg->grab_mode == 1
+                        || (cfg->grab_mode == 2 && demod->frame_event_count == 0)
+                        || (cfg->grab_mode == 3 && demod->frame_event_count > 0)) {
+                    unsigned frame_pad = frame_gap / 8; // this could also be a fixed value, e.g. 10000 samples
+                    unsigned start_padded = demod->frame_start_ago + frame_pad;
+                    unsigned end_padded = demod->frame_end_ago - frame_pad;
+                    unsigned len_padded = start_padded - end_padded;
+                    samp_grab_write(demod->samp_grab, len_padded, end_padded);
+                }
+            }
+            demod->frame_start_ago = 0;
+            demod->frame_event_count = 0;
+        }
+
+        // dump partial pulse_data for this buffer
+        for (void **iter = demod->dumper.elems; iter && *iter; ++iter) {
+            file_info_t const *dumper = *iter;
+            if (dumper->format == U8_LOGIC) {
+                pulse_data_dump_raw(demod->u8_buf, n_samples, cfg->input_pos, &demod->pulse_data, 0x02);
+                pulse_data_dump_raw(demod->u8_buf, n_samples, cfg->input_pos, &demod->fsk_pulse_data, 0x04);
+                break;
+            }
+        }
+    }
+
+    if (demod->am_analyze) {
+        am_analyze(demod->am_analyze, demod->am_buf, n_samples, cfg->verbosity > 1, NULL);
+    }
+
+    for (void **iter = demod->dumper.elems; iter && *iter; ++iter) {
+        file_info_t const *dumper = *iter;
+        if (dumper->format == SPAN_INDEX) {
+            // the processed IQ stream, aligned with the pulse data offsets
+            if (recorder_write(dumper->recorder, cfg->input_pos, iq_buf, n_samples, sample_size, samp_rate, cfg->center_frequency) < 0) {
+                fprintf(stderr, "Short write, samples lost, exiting!\n");
+                cfg->exit_async = 1;
+            }
+            continue;
+        }
+        if (!dumper->file
+                || dumper->format == VCD_LOGIC
+                || dumper->format == PULSE_OOK
+                || dumper->format == PULSE_LOG)
+            continue;
+        uint8_t *out_buf = iq_buf;  // Default is to dump IQ samples
+        unsigned long out_len = n_samples * sample_size;
+
+        if (dumper->format == CU8_IQ) {
+            if (sample_size == 4) {
+                for (unsigned long n = 0; n < n_samples * 2; ++n)
+                    ((uint8_t *)demod->buf.temp)[n] = (((int16_t *)iq_buf)[n] / 256) + 128; // scale Q0.15 to Q0.7
+                out_buf = (uint8_t *)demod->buf.temp;
+                out_len = n_samples * 2 * sizeof(uint8_t);
+            }
+        }
+        else if (dumper->format == CS16_IQ) {
+            if (sample_size == 2) {
+                for (unsigned long n = 0; n < n_samples * 2; ++n)
+                    ((int16_t *)demod->buf.temp)[n] = (iq_buf[n] * 256) - 32768; // scale Q0.7 to Q0.15
+                out_buf = (uint8_t *)demod->buf.temp; // this buffer is too small if out_block_size is large
+                out_len = n_samples * 2 * sizeof(int16_t);
+            }
+        }
+        else if (dumper->format == CS8_IQ) {
+            if (sample_size == 2) {
+                for (unsigned long n = 0; n < n_samples * 2; ++n)
+                    ((int8_t *)demod->buf.temp)[n] = (iq_buf[n] - 128);
+            }
+            else if (sample_size == 4) {
+                for (unsigned long n = 0; n < n_samples * 2; ++n)
+                    ((int8_t *)demod->buf.temp)[n] = ((int16_t *)iq_buf)[n] >> 8;
+            }
+            out_buf = (uint8_t *)demod->buf.temp;
+            out_len = n_samples * 2 * sizeof(int8_t);
+        }
+        else if (dumper->format == CF32_IQ) {
+            if (sample_size == 2) {
+                for (unsigned long n = 0; n < n_samples * 2; ++n)
+                    ((float *)demod->buf.temp)[n] = (iq_buf[n] - 128) / 128.0f;
+            }
+            else if (sample_size == 4) {
+                for (unsigned long n = 0; n < n_samples * 2; ++n)
+                    ((float *)demod->buf.temp)[n] = ((int16_t *)iq_buf)[n] / 32768.0f;
+            }
+            out_buf = (uint8_t *)demod->buf.temp; // this buffer is too small if out_block_size is large
+            out_len = n_samples * 2 * sizeof(float);
+        }
+        else if (dumper->format == S16_AM) {
+            out_buf = (uint8_t *)demod->am_buf;
+            out_len = n_samples * sizeof(int16_t);
+        }
+        else if (dumper->format == S16_FM) {
+            out_buf = (uint8_t *)demod->buf.fm;
+            out_len = n_samples * sizeof(int16_t);
+        }
+        else if (dumper->format == F32_AM) {
+            for (unsigned long n = 0; n < n_samples; ++n)
+                demod->f32_buf[n] = demod->am_buf[n] * (1.0f / 0x8000); // scale from Q0.15
+            out_buf = (uint8_t *)demod->f32_buf;
+            out_len = n_samples * sizeof(float);
+        }
+        else if (dumper->format == F32_FM) {
+            for (unsigned long n = 0; n < n_samples; ++n)
+                demod->f32_buf[n] = demod->buf.fm[n] * (1.0f / 0x8000); // scale from Q0.15
+            out_buf = (uint8_t *)demod->f32_buf;
+            out_len = n_samples * sizeof(float);
+        }
+        else if (dumper->format == F32_I) {
+            if (sample_size == 2)
+                for (unsigned long n = 0; n < n_samples; ++n)
+                    demod->f32_buf[n] = (iq_buf[n * 2] - 128) * (1.0f / 0x80); // scale from Q0.7
+            else
+                for (unsigned long n = 0; n < n_samples; ++n)
+                    demod->f32_buf[n] = ((int16_t *)iq_buf)[n * 2] * (1.0f / 0x8000); // scale from Q0.15
+            out_buf = (uint8_t *)demod->f32_buf;
+            out_len = n_samples * sizeof(float);
+        }
+        else if (dumper->format == F32_Q) {
+            if (sample_size == 2)
+                for (unsigned long n = 0; n < n_samples; ++n)
+                    demod->f32_buf[n] = (iq_buf[n * 2 + 1] - 128) * (1.0f / 0x80); // scale from Q0.7
+            else
+                for (unsigned long n = 0; n < n_samples; ++n)
+                    demod->f32_buf[n] = ((int16_t *)iq_buf)[n * 2 + 1] * (1.0f / 0x8000); // scale from Q0.15
+            out_buf = (uint8_t *)demod->f32_buf;
+            out_len = n_samples * sizeof(float);
+        }
+        else if (dumper->format == U8_LOGIC) { // state data
+            out_buf = demod->u8_buf;
+            out_len = n_samples;
+        }
+
+        int short_write = dumper->iq_encoder
+                ? iq_encoder_write(dumper->iq_encoder, out_buf, out_len, samp_rate, cfg->center_frequency) < 0
+                : fwrite(out_buf, 1, out_len, dumper->file) != out_len;
+        if (short_write) {
+            fprintf(stderr, "Short write, samples lost, exiting!\n");
+            cfg->exit_async = 1;
+        }
+    }
+
+    cfg->input_pos += n_samples;
+    if (cfg->bytes_to_read > 0)
+        cfg->bytes_to_read -= in_len;
+
+    if (cfg->after_successful_events_flag && (d_events > 0)) {
+        alarm(0); // cancel the watchdog timer
+        if (cfg->after_successful_events_flag == 1) {
+            cfg->exit_async = 1;
+        }
+        else {
+            cfg->hop_now = 1;
+        }
+    }
+
+    time_t rawtime;
+    time(&rawtime);
+    // choose hop_index as frequency_index, if there are too few hop_times use the last one
+    int hop_index = cfg->hop_times > cfg->frequency_index ? cfg->frequency_index : cfg->hop_times - 1;
+    if (cfg->hop_times > 0 && cfg->frequencies > 1
+            && difftime(rawtime, cfg->hop_start_time) > cfg->hop_time[hop_index]) {
+        alarm(0); // cancel the watchdog timer
+        cfg->hop_now = 1;
+    }
+    if (cfg->duration > 0 && rawtime >= cfg->stop_time) {
+        alarm(0); // cancel the watchdog timer
+        cfg->exit_async = 1;
+        fprintf(stderr, "Time expired, exiting!\n");
+    }
+    if (cfg->stats_now || (cfg->report_stats && cfg->stats_interval && rawtime >= cfg->stats_time)) {
+        report_occurred_handler(cfg, create_report_data(cfg, cfg->stats_now ? 3 : cfg->report_stats));
+        flush_report_data(cfg);
+        if (rawtime >= cfg->stats_time)
+            cfg->stats_time += cfg->stats_interval;
+        if (cfg->stats_now)
+            cfg->stats_now--;
+    }
+
+    if (cfg->hop_now && !cfg->exit_async) {
+        cfg->hop_now = 0;
+        time(&cfg->hop_start_time);
+        cfg->frequency_index  = (cfg->frequency_index + 1) % cfg->frequencies;
+        cfg->center_frequency = cfg->frequency[cfg->frequency_index];
+        sdr_set_center_freq(cfg->dev, cfg->center_frequency, 0);
+    }
+}
+
 /* handlers */
 
 /** Pass the data structure to all output handlers. Frees data afterwards. */
-void event_occurred_handler(r_cfg_t *cfg, data_t *data)
+void output_event(r_cfg_t *cfg, r_event_t *ev)
+{
+    data_t *data = ev->data;
+
+    if (ev->kind == R_EVENT_ACQUIRED) {
+        // apply all tags
+        for (void **iter = cfg->data_tags.elems; iter && *iter; ++iter) {
+            data_tag_t *tag = *iter;
+            data            = data_tag_apply(tag, data, cfg->in_filename);
+        }
+
+        // keep the last-known state
+        if (cfg->device_state)
+            device_state_update(cfg->device_state, data, ev->now, ev->rssi, ev->snr);
+    }
+    else if (ev->kind == R_EVENT_REPORT) {
+        // output state belongs to the thread running the outputs
+        data = append_output_stats(cfg, data);
+    }
+
+    latency_stats_t *latency = cfg->latency;
+    if (latency && ev->decode_usec) {
+        uint64_t start_usec = monotonic_usec();
+        if (ev->end_usec) {
+            latency_hist_record(&latency->stage[LATENCY_BUFFER], (uint32_t)(ev->buffer_usec - ev->end_usec));
+            latency_hist_record(&latency->stage[LATENCY_DETECT], (uint32_t)(ev->detect_usec - ev->buffer_usec));
+            latency_hist_record(&latency->stage[LATENCY_DECODE], (uint32_t)(ev->decode_usec - ev->detect_usec));
+        }
+        latency_hist_record(&latency->stage[LATENCY_QUEUE], (uint32_t)(start_usec - ev->decode_usec));
+    }
+
+    for (size_t i = 0; i < cfg->output_handler.len; ++i) { // list might contain NULLs
+        data_output_t *output = cfg->output_handler.elems[i];
+        uint64_t print_usec   = 0;
+        if (output && latency && ev->decode_usec) {
+            output->serialized_usec = 0;
+            output->queued_usec     = 0;
+            print_usec              = monotonic_usec();
+        }
+        data_output_print(output, data);
+        if (print_usec && output->serialized_usec) {
+            latency_hist_record(&latency->stage[LATENCY_SERIALIZE], (uint32_t)(output->serialized_usec - print_usec));
+            if (output->queued_usec)
+                latency_hist_record(&latency->stage[LATENCY_SEND], (uint32_t)(output->queued_usec - output->serialized_usec));
+        }
+        if (latency && ev->end_usec && i < latency->num_outputs)
+            latency_hist_record(&latency->output[i], (uint32_t)(monotonic_usec() - ev->end_usec));
+    }
+    data_free(data);
+
+    if (latency && ev->end_usec)
+        latency_hist_record(&latency->stage[LATENCY_TOTAL], (uint32_t)(monotonic_usec() - ev->end_usec));
+}
+
+void dispatch_event(r_cfg_t *cfg, r_event_t *ev)
+{
+    if (!cfg->net_thread) {
+        output_event(cfg, ev);
+    }
+    else {
+        net_thread_post_event(cfg->net_thread, ev); // waits for the outputs if the queue is full
+    }
+}
+
+static data_t *prepend_event_time(r_cfg_t *cfg, data_t *data)
 {
     // prepend "time" if requested
     if (cfg->report_time != REPORT_TIME_OFF) {
@@ -557,17 +1152,26 @@ void event_occurred_handler(r_cfg_t *cfg, data_t *data)
                 "time", "", DATA_STRING, time_str,
                 NULL);
     }
+    return data;
+}
 
-    for (size_t i = 0; i < cfg->output_handler.len; ++i) { // list might contain NULLs
-        data_output_print(cfg->output_handler.elems[i], data);
-    }
-    data_free(data);
+void event_occurred_handler(r_cfg_t *cfg, data_t *data)
+{
+    r_event_t ev = {.kind = R_EVENT_DATA, .data = prepend_event_time(cfg, data)};
+    dispatch_event(cfg, &ev);
+}
+
+void report_occurred_handler(r_cfg_t *cfg, data_t *data)
+{
+    r_event_t ev = {.kind = R_EVENT_REPORT, .data = prepend_event_time(cfg, data)};
+    dispatch_event(cfg, &ev);
 }
 
 /** Pass the data structure to all output handlers. Frees data afterwards. */
 void data_acquired_handler(r_device *r_dev, data_t *data)
 {
     r_cfg_t *cfg = r_dev->output_ctx;
+    uint64_t profile_start = cfg->demod->profile ? monotonic_nsec() : 0;
 
 #ifndef NDEBUG
     // check for undeclared csv fields
@@ -771,6 +1375,13 @@ void data_acquired_handler(r_device *r_dev, data_t *data)
                 NULL);
     }
 
+    // tag pulse data from a remote receiver
+    if (cfg->pulse_source) {
+        data_append(data,
+                "receiver", "Receiver", DATA_STRING, cfg->pulse_source,
+                NULL);
+    }
+
     // prepend "time" if requested
     if (cfg->report_time != REPORT_TIME_OFF) {
         char time_str[LOCAL_TIME_BUFLEN];
@@ -780,16 +1391,53 @@ void data_acquired_handler(r_device *r_dev, data_t *data)
                 NULL);
     }
 
-    // apply all tags
-    for (void **iter = cfg->data_tags.elems; iter && *iter; ++iter) {
-        data_tag_t *tag = *iter;
-        data            = data_tag_apply(tag, data, cfg->in_filename);
+    // capture the receive info, tags and outputs might run on the network thread
+    pulse_data_t *pulse_data = cfg->demod->fsk_pulse_data.fsk_f2_est ? &cfg->demod->fsk_pulse_data : &cfg->demod->pulse_data;
+    r_event_t ev = {
+            .kind = R_EVENT_ACQUIRED,
+            .data = data,
+            .rssi = pulse_data->rssi_db,
+            .snr  = pulse_data->snr_db,
+            .now  = cfg->demod->now.tv_sec ? cfg->demod->now.tv_sec : time(NULL),
+            .decode_usec = monotonic_usec(),
+    };
+    // only packages from a sample buffer have a time on air
+    if (cfg->demod->buffer_usec && cfg->demod->detect_usec && cfg->demod->sample_rate) {
+        uint64_t end_offset = (uint64_t)pulse_data->end_ago * 1000000 / cfg->demod->sample_rate;
+        ev.buffer_usec = cfg->demod->buffer_usec;
+        ev.detect_usec = cfg->demod->detect_usec;
+        ev.end_usec    = ev.buffer_usec > end_offset ? ev.buffer_usec - end_offset : 0;
     }
+    dispatch_event(cfg, &ev);
 
-    for (size_t i = 0; i < cfg->output_handler.len; ++i) { // list might contain NULLs
-        data_output_print(cfg->output_handler.elems[i], data);
-    }
-    data_free(data);
+    if (cfg->demod->profile)
+        profile_stage(cfg->demod, PROFILE_OUTPUT, profile_start);
+}
+
+/// Samples lost upstream (estimated from the sample rate) and dropped locally.
+static double input_lost_samples(sdr_stats_t const *stats)
+{
+    int64_t missing = stats->bytes_missing > 0 ? stats->bytes_missing : 0;
+    return (double)(missing + (int64_t)stats->bytes_dropped) / stats->sample_size;
+}
+
+data_t *input_report_data(r_cfg_t *cfg)
+{
+    sdr_stats_t stats;
+    if (sdr_get_stats(cfg->dev, &stats) < 0)
+        return NULL;
+
+    return data_make(
+            "received_bytes",   "", DATA_DOUBLE, (double)stats.bytes_received,
+            "dropped_bytes",    "", DATA_DOUBLE, (double)stats.bytes_dropped,
+            "missing_bytes",    "", DATA_DOUBLE, (double)stats.bytes_missing,
+            "lost_samples",     "", DATA_DOUBLE, input_lost_samples(&stats),
+            "gaps",             "", DATA_INT, stats.gaps,
+            "buffers",          "", DATA_INT, stats.buffers,
+            "queued",           "", DATA_INT, stats.queued,
+            "max_queued",       "", DATA_INT, stats.max_queued,
+            "rcvbuf",           "", DATA_INT, stats.rcvbuf,
+            NULL);
 }
 
 // level 0: do not report (don't call this), 1: report successful devices, 2: report active devices, 3: report all
@@ -837,6 +1485,10 @@ data_t *create_report_data(r_cfg_t *cfg, int level)
             data_append(data,
                     "fail_sanity",  "", DATA_INT, r_dev->decode_fails[-DECODE_FAIL_SANITY],
                     NULL);
+        if (r_dev->decode_skipped)
+            data_append(data,
+                    "skipped",      "", DATA_INT, r_dev->decode_skipped,
+                    NULL);
 
         list_push(&dev_data_list, data);
     }
@@ -858,9 +1510,421 @@ data_t *create_report_data(r_cfg_t *cfg, int level)
             NULL);
 
     list_free_elems(&dev_data_list, NULL);
+
+    data_t *cpu_data = cpu_report_data(cfg, CPU_REPORT_TOP);
+    if (cpu_data) {
+        data_append(data,
+                "cpu",              "", DATA_DATA, cpu_data,
+                NULL);
+    }
+
+    data_t *input_data = input_report_data(cfg);
+    if (input_data) {
+        data_append(data,
+                "input",            "", DATA_DATA, input_data,
+                NULL);
+    }
+
+    return data;
+}
+
+static char const *slicer_name(unsigned modulation)
+{
+    switch (modulation) {
+    case OOK_PULSE_MANCHESTER_ZEROBIT: return "OOK_MC_ZEROBIT";
+    case OOK_PULSE_PCM_RZ: return "OOK_PCM";
+    case OOK_PULSE_PPM: return "OOK_PPM";
+    case OOK_PULSE_PWM: return "OOK_PWM";
+    case OOK_PULSE_PIWM_RAW: return "OOK_PIWM_RAW";
+    case OOK_PULSE_PIWM_DC: return "OOK_PIWM_DC";
+    case OOK_PULSE_DMC: return "OOK_DMC";
+    case OOK_PULSE_PWM_OSV1: return "OOK_MC_OSV1";
+    case OOK_PULSE_NRZS: return "OOK_NRZS";
+    case FSK_PULSE_PCM: return "FSK_PCM";
+    case FSK_PULSE_PWM: return "FSK_PWM";
+    case FSK_PULSE_MANCHESTER_ZEROBIT: return "FSK_MC_ZEROBIT";
+    default: return "";
+    }
+}
+
+static int cmp_demod_nsec(void const *a, void const *b)
+{
+    r_device const *dev_a = *(r_device *const *)a;
+    r_device const *dev_b = *(r_device *const *)b;
+    return dev_a->demod_nsec < dev_b->demod_nsec ? 1 : dev_a->demod_nsec > dev_b->demod_nsec ? -1 : 0;
+}
+
+data_t *cpu_report_data(r_cfg_t *cfg, int top)
+{
+    if (!cfg->report_cpu)
+        return NULL;
+
+    list_t *r_devs = &cfg->demod->r_devs;
+    list_t ranked  = {0};
+    list_ensure_size(&ranked, r_devs->len);
+
+    uint64_t total_nsec = 0;
+    for (void **iter = r_devs->elems; iter && *iter; ++iter) {
+        r_device *r_dev = *iter;
+        total_nsec += r_dev->demod_nsec;
+        if (r_dev->demod_calls)
+            list_push(&ranked, r_dev);
+    }
+    if (ranked.len)
+        qsort(ranked.elems, ranked.len, sizeof(*ranked.elems), cmp_demod_nsec);
+
+    list_t dev_data_list = {0};
+    for (size_t i = 0; i < ranked.len && (top <= 0 || i < (size_t)top); ++i) {
+        r_device *r_dev = ranked.elems[i];
+        list_push(&dev_data_list, data_make(
+                "device",       "", DATA_INT, r_dev->protocol_num,
+                "name",         "", DATA_STRING, r_dev->name,
+                "slicer",       "", DATA_STRING, slicer_name(r_dev->modulation),
+                "calls",        "", DATA_INT, r_dev->demod_calls,
+                "events",       "", DATA_INT, r_dev->total_events,
+                "cpu_ms",       "", DATA_FORMAT, "%.3f", DATA_DOUBLE, r_dev->demod_nsec / 1e6,
+                "decode_ms",    "", DATA_FORMAT, "%.3f", DATA_DOUBLE, r_dev->decode_nsec / 1e6,
+                "ns_per_call",  "", DATA_INT, (int)(r_dev->demod_nsec / r_dev->demod_calls),
+                "share",        "", DATA_FORMAT, "%.1f", DATA_DOUBLE, total_nsec ? r_dev->demod_nsec * 100.0 / total_nsec : 0.0,
+                NULL));
+    }
+
+    // slicer time is the time outside of decoders, summed per modulation
+    list_t slicer_data_list = {0};
+    for (unsigned modulation = 0; modulation <= FSK_PULSE_MANCHESTER_ZEROBIT; ++modulation) {
+        unsigned calls     = 0;
+        uint64_t demod_nsec = 0;
+        for (size_t i = 0; i < ranked.len; ++i) {
+            r_device *r_dev = ranked.elems[i];
+            if (r_dev->modulation != modulation)
+                continue;
+            calls += r_dev->demod_calls;
+            demod_nsec += r_dev->demod_nsec - r_dev->decode_nsec;
+        }
+        if (!calls)
+            continue;
+        list_push(&slicer_data_list, data_make(
+                "slicer",       "", DATA_STRING, slicer_name(modulation),
+                "calls",        "", DATA_INT, calls,
+                "cpu_ms",       "", DATA_FORMAT, "%.3f", DATA_DOUBLE, demod_nsec / 1e6,
+                NULL));
+    }
+
+    data_t *data = data_make(
+            "total_ms",         "", DATA_FORMAT, "%.3f", DATA_DOUBLE, total_nsec / 1e6,
+            "decoders",         "", DATA_ARRAY, data_array(dev_data_list.len, DATA_DATA, dev_data_list.elems),
+            "slicers",          "", DATA_ARRAY, data_array(slicer_data_list.len, DATA_DATA, slicer_data_list.elems),
+            NULL);
+
+    list_free_elems(&slicer_data_list, NULL);
+    list_free_elems(&dev_data_list, NULL);
+    list_free_elems(&ranked, NULL);
+
+    return data;
+}
+
+data_t *append_output_stats(r_cfg_t *cfg, data_t *data)
+{
+    if (cfg->net_thread) {
+        data_append(data,
+                "net_thread",   "", DATA_DATA, net_thread_stats(cfg->net_thread),
+                NULL);
+    }
+    if (cfg->iq_server) {
+        data_append(data,
+                "iq_server",    "", DATA_DATA, iq_server_stats(cfg->iq_server),
+                NULL);
+    }
+    if (cfg->pulse_server) {
+        data_append(data,
+                "pulse_server", "", DATA_DATA, pulse_server_stats(cfg->pulse_server),
+                NULL);
+    }
+
+    // outputs that keep queues report their depth and drops
+    list_t output_data_list = {0};
+    for (size_t i = 0; i < cfg->output_handler.len; ++i) { // list might contain NULLs
+        data_t *output_data = data_output_stats(cfg->output_handler.elems[i]);
+        if (output_data)
+            list_push(&output_data_list, output_data);
+    }
+    if (output_data_list.len) {
+        data_append(data,
+                "outputs",      "", DATA_ARRAY, data_array(output_data_list.len, DATA_DATA, output_data_list.elems),
+                NULL);
+    }
+    list_free_elems(&output_data_list, NULL);
+
+    data_t *latency_data = latency_report_data(cfg);
+    if (latency_data) {
+        data_append(data,
+                "latency",      "", DATA_DATA, latency_data,
+                NULL);
+    }
+
     return data;
 }
 
+static data_t *latency_hist_data(latency_hist_t const *hist)
+{
+    return data_make(
+            "count",        "", DATA_INT, (int)hist->count,
+            "min_us",       "", DATA_INT, (int)hist->min,
+            "mean_us",      "", DATA_INT, (int)latency_hist_mean(hist),
+            "p50_us",       "", DATA_INT, (int)latency_hist_percentile(hist, 50.0),
+            "p90_us",       "", DATA_INT, (int)latency_hist_percentile(hist, 90.0),
+            "p99_us",       "", DATA_INT, (int)latency_hist_percentile(hist, 99.0),
+            "max_us",       "", DATA_INT, (int)hist->max,
+            NULL);
+}
+
+data_t *latency_report_data(r_cfg_t *cfg)
+{
+    latency_stats_t *latency = cfg->latency;
+    if (!latency)
+        return NULL;
+
+    data_t *data = NULL;
+    for (int i = 0; i < LATENCY_STAGES; ++i) {
+        data = data_append(data,
+                latency_stage_name(i), "", DATA_DATA, latency_hist_data(&latency->stage[i]),
+                NULL);
+    }
+
+    // in the order the outputs were given
+    list_t output_data_list = {0};
+    for (unsigned i = 0; i < latency->num_outputs; ++i) {
+        list_push(&output_data_list, latency_hist_data(&latency->output[i]));
+    }
+    if (output_data_list.len) {
+        data = data_append(data,
+                "outputs",      "", DATA_ARRAY, data_array(output_data_list.len, DATA_DATA, output_data_list.elems),
+                NULL);
+    }
+    list_free_elems(&output_data_list, NULL);
+
+    return data;
+}
+
+/* metrics */
+
+static double metric_samples(void *ctx)
+{
+    r_cfg_t *cfg = ctx;
+    return (double)cfg->input_pos;
+}
+
+static double metric_center_frequency(void *ctx)
+{
+    r_cfg_t *cfg = ctx;
+    return cfg->center_frequency;
+}
+
+static double metric_sample_rate(void *ctx)
+{
+    r_cfg_t *cfg = ctx;
+    return cfg->samp_rate;
+}
+
+static double metric_input_received_bytes(void *ctx)
+{
+    sdr_stats_t stats;
+    return sdr_get_stats(ctx, &stats) < 0 ? 0.0 : stats.bytes_received;
+}
+
+static double metric_input_dropped_bytes(void *ctx)
+{
+    sdr_stats_t stats;
+    return sdr_get_stats(ctx, &stats) < 0 ? 0.0 : stats.bytes_dropped;
+}
+
+static double metric_input_lost_samples(void *ctx)
+{
+    sdr_stats_t stats;
+    return sdr_get_stats(ctx, &stats) < 0 ? 0.0 : input_lost_samples(&stats);
+}
+
+static double metric_input_queued(void *ctx)
+{
+    sdr_stats_t stats;
+    return sdr_get_stats(ctx, &stats) < 0 ? 0.0 : stats.queued;
+}
+
+static double metric_demod_seconds(void *ctx)
+{
+    r_device *r_dev = ctx;
+    return r_dev->demod_nsec / 1e9;
+}
+
+static double metric_decode_seconds(void *ctx)
+{
+    r_device *r_dev = ctx;
+    return r_dev->decode_nsec / 1e9;
+}
+
+// offsets of the per protocol counters since start
+static struct {
+    char const *name;
+    char const *help;
+    size_t offset;
+} const protocol_metrics[] = {
+        {"rtl_433_decoder_events_total", "Decoder runs.", offsetof(r_device, total_events)},
+        {"rtl_433_decoder_ok_total", "Decoder runs with at least one message.", offsetof(r_device, total_ok)},
+        {"rtl_433_decoder_messages_total", "Messages decoded.", offsetof(r_device, total_messages)},
+        {"rtl_433_decoder_skipped_total", "Decoder runs skipped, none of the preambles found.", offsetof(r_device, total_skipped)},
+};
+
+static char const *const protocol_fail_names[] = {
+        "fail_other",
+        "abort_length",
+        "abort_early",
+        "fail_mic",
+        "fail_sanity",
+};
+
+static void protocol_labels(char *labels, size_t size, r_device *r_dev, char const *extra)
+{
+    char name[256];
+    metrics_escape_label(name, sizeof(name), r_dev->name);
+    snprintf(labels, size, "protocol=\"%u\",name=\"%s\"%s", r_dev->protocol_num, name, extra);
+}
+
+static void print_latency_summary(abuf_t *buf, latency_hist_t const *hist, char const *labels)
+{
+    static double const quantiles[] = {0.5, 0.9, 0.99};
+    for (size_t i = 0; i < sizeof(quantiles) / sizeof(*quantiles); ++i) {
+        abuf_printf(buf, "rtl_433_latency_seconds{%s,quantile=\"%g\"} %.6f\n",
+                labels, quantiles[i], latency_hist_percentile(hist, quantiles[i] * 100.0) / 1e6);
+    }
+    abuf_printf(buf, "rtl_433_latency_seconds_sum{%s} %.6f\n", labels, hist->sum / 1e6);
+    abuf_printf(buf, "rtl_433_latency_seconds_count{%s} %u\n", labels, hist->count);
+}
+
+static void collect_latency_metrics(void *ctx, abuf_t *buf)
+{
+    r_cfg_t *cfg = ctx;
+    latency_stats_t *latency = cfg->latency;
+    if (!latency)
+        return;
+
+    metrics_print_header(buf, "rtl_433_latency_seconds", "Latency from the end of a package on air.", METRIC_SUMMARY);
+    char labels[64];
+    for (int i = 0; i < LATENCY_STAGES; ++i) {
+        snprintf(labels, sizeof(labels), "stage=\"%s\"", latency_stage_name(i));
+        print_latency_summary(buf, &latency->stage[i], labels);
+    }
+    for (unsigned i = 0; i < latency->num_outputs; ++i) {
+        snprintf(labels, sizeof(labels), "stage=\"output\",index=\"%u\"", i);
+        print_latency_summary(buf, &latency->output[i], labels);
+    }
+}
+
+struct metrics *create_metrics(r_cfg_t *cfg)
+{
+    metrics_t *metrics = metrics_create();
+    if (!metrics)
+        return NULL; // NOTE: skip metrics on alloc failure.
+
+    metric_family_t *family;
+    family = metrics_family(metrics, "rtl_433_frames_total", "Packages detected.", METRIC_COUNTER);
+    metric_add_unsigned(family, "modulation=\"ook\"", &cfg->total_frames);
+    metric_add_unsigned(family, "modulation=\"fsk\"", &cfg->total_frames_fsk);
+    family = metrics_family(metrics, "rtl_433_frames_events_total", "Packages with at least one decoded message.", METRIC_COUNTER);
+    metric_add_unsigned(family, NULL, &cfg->total_frames_events);
+    family = metrics_family(metrics, "rtl_433_samples_total", "Samples processed.", METRIC_COUNTER);
+    metric_add_fn(family, NULL, metric_samples, cfg);
+    family = metrics_family(metrics, "rtl_433_noise_level_db", "Estimated noise level.", METRIC_GAUGE);
+    metric_add_float(family, NULL, &cfg->demod->noise_level);
+    family = metrics_family(metrics, "rtl_433_min_level_db", "Minimum detection level.", METRIC_GAUGE);
+    metric_add_float(family, NULL, &cfg->demod->min_level_auto);
+    family = metrics_family(metrics, "rtl_433_center_frequency_hz", "Center frequency.", METRIC_GAUGE);
+    metric_add_fn(family, NULL, metric_center_frequency, cfg);
+    family = metrics_family(metrics, "rtl_433_sample_rate_hz", "Sample rate.", METRIC_GAUGE);
+    metric_add_fn(family, NULL, metric_sample_rate, cfg);
+
+    // the list of decoders is fixed once started
+    char labels[384];
+    for (size_t i = 0; i < sizeof(protocol_metrics) / sizeof(*protocol_metrics); ++i) {
+        family = metrics_family(metrics, protocol_metrics[i].name, protocol_metrics[i].help, METRIC_COUNTER);
+        for (void **iter = cfg->demod->r_devs.elems; iter && *iter; ++iter) {
+            r_device *r_dev = *iter;
+            protocol_labels(labels, sizeof(labels), r_dev, "");
+            metric_add_unsigned(family, labels, (unsigned const *)((char const *)r_dev + protocol_metrics[i].offset));
+        }
+    }
+    family = metrics_family(metrics, "rtl_433_decoder_fails_total", "Decoder runs that failed or aborted.", METRIC_COUNTER);
+    for (void **iter = cfg->demod->r_devs.elems; iter && *iter; ++iter) {
+        r_device *r_dev = *iter;
+        for (int i = 0; i < 5; ++i) {
+            char reason[32];
+            snprintf(reason, sizeof(reason), ",reason=\"%s\"", protocol_fail_names[i]);
+            protocol_labels(labels, sizeof(labels), r_dev, reason);
+            metric_add_unsigned(family, labels, &r_dev->total_fails[i]);
+        }
+    }
+
+    if (cfg->report_cpu) {
+        family = metrics_family(metrics, "rtl_433_decoder_cpu_seconds_total", "Time in the slicer and decoder.", METRIC_COUNTER);
+        for (void **iter = cfg->demod->r_devs.elems; iter && *iter; ++iter) {
+            r_device *r_dev = *iter;
+            protocol_labels(labels, sizeof(labels), r_dev, "");
+            metric_add_fn(family, labels, metric_demod_seconds, r_dev);
+        }
+        family = metrics_family(metrics, "rtl_433_decoder_decode_seconds_total", "Time in the decoder.", METRIC_COUNTER);
+        for (void **iter = cfg->demod->r_devs.elems; iter && *iter; ++iter) {
+            r_device *r_dev = *iter;
+            protocol_labels(labels, sizeof(labels), r_dev, "");
+            metric_add_fn(family, labels, metric_decode_seconds, r_dev);
+        }
+    }
+
+    sdr_stats_t input_stats;
+    if (sdr_get_stats(cfg->dev, &input_stats) == 0) {
+        family = metrics_family(metrics, "rtl_433_input_received_bytes_total", "Sample bytes received from the input.", METRIC_COUNTER);
+        metric_add_fn(family, NULL, metric_input_received_bytes, cfg->dev);
+        family = metrics_family(metrics, "rtl_433_input_dropped_bytes_total", "Sample bytes dropped with all input buffers waiting for processing.", METRIC_COUNTER);
+        metric_add_fn(family, NULL, metric_input_dropped_bytes, cfg->dev);
+        family = metrics_family(metrics, "rtl_433_input_lost_samples", "Samples lost, estimated from the sample rate, and dropped.", METRIC_GAUGE);
+        metric_add_fn(family, NULL, metric_input_lost_samples, cfg->dev);
+        family = metrics_family(metrics, "rtl_433_input_queued_buffers", "Input buffers waiting for processing.", METRIC_GAUGE);
+        metric_add_fn(family, NULL, metric_input_queued, cfg->dev);
+    }
+
+    return metrics;
+}
+
+struct metrics *create_output_metrics(r_cfg_t *cfg)
+{
+    metrics_t *metrics = metrics_create();
+    if (!metrics)
+        return NULL; // NOTE: skip metrics on alloc failure.
+
+    if (cfg->net_thread)
+        net_thread_metrics(cfg->net_thread, metrics);
+    if (cfg->iq_server)
+        iq_server_metrics(cfg->iq_server, metrics);
+    if (cfg->pulse_server)
+        pulse_server_metrics(cfg->pulse_server, metrics);
+
+    // the outputs are fixed once started, label the series by output type and index
+    for (size_t i = 0; i < cfg->output_handler.len; ++i) {
+        data_output_t *output = cfg->output_handler.elems[i];
+        char const *output_name = "";
+        data_t *stats = data_output_stats(output);
+        for (data_t *d = stats; d; d = d->next) {
+            if (!strcmp(d->key, "output") && d->type == DATA_STRING)
+                output_name = d->value.v_ptr;
+        }
+        char labels[64];
+        snprintf(labels, sizeof(labels), "output=\"%s\",index=\"%u\"", output_name, (unsigned)i);
+        data_free(stats);
+        data_output_metrics(output, metrics, labels);
+    }
+    metrics_collector(metrics, collect_latency_metrics, cfg);
+
+    return metrics;
+}
+
 void flush_report_data(r_cfg_t *cfg)
 {
     list_t *r_devs = &cfg->demod->r_devs;
@@ -881,6 +1945,7 @@ void flush_report_data(r_cfg_t *cfg)
         r_dev->decode_fails[2] = 0;
         r_dev->decode_fails[3] = 0;
         r_dev->decode_fails[4] = 0;
+        r_dev->decode_skipped = 0;
     }
 }
 
@@ -920,6 +1985,9 @@ void start_outputs(r_cfg_t *cfg, char const *const *well_known)
     }
 
     free(output_fields);
+
+    // NOTE: skip latency stats on alloc failure.
+    cfg->latency = latency_stats_create(cfg->output_handler.len);
 }
 
 void add_kv_output(r_cfg_t *cfg, char *param)
@@ -937,6 +2005,11 @@ void add_influx_output(r_cfg_t *cfg, char *param)
     list_push(&cfg->output_handler, data_output_influx_create(get_mgr(cfg), param));
 }
 
+void add_binary_output(r_cfg_t *cfg, int msgpack, char *param)
+{
+    list_push(&cfg->output_handler, data_output_binary_create(get_mgr(cfg), msgpack ? BINARY_MSGPACK : BINARY_CBOR, param));
+}
+
 void add_syslog_output(r_cfg_t *cfg, char *param)
 {
     char *host = "localhost";
@@ -951,10 +2024,45 @@ void add_http_output(r_cfg_t *cfg, char *param)
 {
     char *host = "0.0.0.0";
     char *port = "8433";
-    hostport_param(param, &host, &port);
+    char *opts = hostport_param(param, &host, &port);
     fprintf(stderr, "HTTP server at %s port %s\n", host, port);
 
-    list_push(&cfg->output_handler, data_output_http_create(get_mgr(cfg), host, port, cfg));
+    if (!cfg->device_state)
+        cfg->device_state = device_state_create(DEVICE_STATE_MAX_DEVICES);
+
+    list_push(&cfg->output_handler, data_output_http_create(get_mgr(cfg), host, port, opts, cfg));
+}
+
+void add_rtltcp_output(r_cfg_t *cfg, char *param)
+{
+    char *host = "localhost";
+    char *port = "1234";
+    char *opts = hostport_param(param, &host, &port);
+    fprintf(stderr, "rtl_tcp server at %s port %s\n", host, port);
+
+    if (cfg->iq_server) {
+        fprintf(stderr, "Only one rtl_tcp server is supported.\n");
+        exit(1);
+    }
+    cfg->iq_server = iq_server_start(host, port, opts, cfg->verbosity);
+    if (!cfg->iq_server)
+        exit(1);
+}
+
+void add_pulse_input(r_cfg_t *cfg, char *param)
+{
+    char *host = "0.0.0.0";
+    char *port = "8434";
+    char *opts = hostport_param(param, &host, &port);
+
+    if (cfg->pulse_server) {
+        fprintf(stderr, "Only one pulse server is supported.\n");
+        exit(1);
+    }
+    cfg->pulse_server = pulse_server_start(host, port, opts, cfg->verbosity);
+    if (!cfg->pulse_server)
+        exit(1);
+    fprintf(stderr, "Pulse server at %s port %u (UDP and TCP)\n", host, pulse_server_port(cfg->pulse_server));
 }
 
 void add_null_output(r_cfg_t *cfg, char *param)
@@ -979,6 +2087,13 @@ void close_dumpers(struct r_cfg *cfg)
 {
     for (void **iter = cfg->demod->dumper.elems; iter && *iter; ++iter) {
         file_info_t *dumper = *iter;
+        pulse_log_writer_close(dumper->pulse_log);
+        dumper->pulse_log = NULL;
+        recorder_free(dumper->recorder);
+        dumper->recorder = NULL;
+        if (iq_encoder_close(dumper->iq_encoder) < 0)
+            fprintf(stderr, "Short write, samples lost!\n");
+        dumper->iq_encoder = NULL;
         if (dumper->file && (dumper->file != stdout)) {
             fclose(dumper->file);
             dumper->file = NULL;
@@ -995,7 +2110,7 @@ void close_dumpers(struct r_cfg *cfg)
             "FM", // analog7
     };
     if (cfg->sr_filename) {
-        write_sigrok(cfg->sr_filename, cfg->samp_rate, 3, 4, labels);
+        write_sigrok(cfg->sr_filename, cfg->demod->sample_rate, 3, 4, labels);
     }
     if (cfg->sr_execopen) {
         open_pulseview(cfg->sr_filename);
@@ -1016,6 +2131,16 @@ void add_dumper(r_cfg_t *cfg, char const *spec, int overwrite)
     list_push(&cfg->demod->dumper, dumper);
 
     parse_file_info(spec, dumper);
+    if (dumper->format == SPAN_INDEX) {
+        dumper->recorder = recorder_create(dumper->path, overwrite);
+        if (!dumper->recorder)
+            exit(1);
+        return;
+    }
+    if (dumper->codec == CODEC_RIQ && dumper->format != CU8_IQ && dumper->format != CS16_IQ) {
+        fprintf(stderr, "Compressed output needs CU8 or CS16 IQ (%s)\n", spec);
+        exit(1);
+    }
     if (strcmp(dumper->path, "-") == 0) { /* Write samples to stdout */
         dumper->file = stdout;
 #ifdef _WIN32
@@ -1034,11 +2159,21 @@ void add_dumper(r_cfg_t *cfg, char const *spec, int overwrite)
         }
     }
     if (dumper->format == VCD_LOGIC) {
-        pulse_data_print_vcd_header(dumper->file, cfg->samp_rate);
+        pulse_data_print_vcd_header(dumper->file, cfg->samp_rate / (cfg->demod->decimation > 1 ? cfg->demod->decimation : 1));
     }
     if (dumper->format == PULSE_OOK) {
         pulse_data_print_pulse_header(dumper->file);
     }
+    if (dumper->format == PULSE_LOG) {
+        dumper->pulse_log = pulse_log_writer_create(dumper->file);
+        if (!dumper->pulse_log)
+            exit(1);
+    }
+    if (dumper->codec == CODEC_RIQ) {
+        dumper->iq_encoder = iq_encoder_create(dumper->file, dumper->format == CS16_IQ ? 4 : 2);
+        if (!dumper->iq_encoder)
+            exit(1);
+    }
 }
 
 void add_infile(r_cfg_t *cfg, char *in_file)
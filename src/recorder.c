@@ -0,0 +1,556 @@
+/** @file
+    Continuous recording to rotating segments with an index of package spans.
+
+    The recorder writes the processed IQ stream to segment files and
+    appends a line to a text index for each new segment and each detected
+    package. The index is flushed on every line and stays usable if the
+    recording is cut short:
+
+        ;spans version 1
+        segment <offset> <sample rate> <center frequency> <format> <file>
+        span <start offset> <end offset>
+
+    Offsets count samples from the start of the stream, the same as the
+    pulse data offsets. A replay seeks to the padded spans and feeds only
+    those samples to the demodulators.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+// fseeko() needs _POSIX_C_SOURCE, and a 64-bit off_t on 32-bit systems
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#ifndef _FILE_OFFSET_BITS
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include "recorder.h"
+#include "fileformat.h"
+#include "optparse.h"
+#include "r_util.h"
+#include "fatal.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <io.h>
+#ifdef _MSC_VER
+#define F_OK 0
+#endif
+#endif
+#ifndef _MSC_VER
+#include <unistd.h>
+#endif
+
+/// Seek to a byte offset from the start, also past 2 GB where long is 32 bits.
+static int seek_set(FILE *file, uint64_t offset)
+{
+#ifdef _WIN32
+    return _fseeki64(file, (__int64)offset, SEEK_SET);
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET);
+#endif
+}
+
+static char const *sample_format_ext(int sample_size)
+{
+    return sample_size == 2 ? "cu8" : "cs16";
+}
+
+/* recorder */
+
+recorder_t *recorder_create(char const *spec, int overwrite)
+{
+    recorder_t *rec = calloc(1, sizeof(*rec));
+    if (!rec) {
+        WARN_CALLOC("recorder_create()");
+        return NULL;
+    }
+    rec->segment_secs = RECORDER_DEFAULT_SEGMENT_SECS;
+
+    char *opts = strdup(spec);
+    if (!opts) {
+        WARN_STRDUP("recorder_create()");
+        free(rec);
+        return NULL;
+    }
+    char *path = asepc(&opts, ',');
+    char *key, *val;
+    while (getkwargs(&opts, &key, &val)) {
+        key = remove_ws(key);
+        val = trim_ws(val);
+        if (!key || !*key)
+            continue;
+        else if (!strcasecmp(key, "segment"))
+            rec->segment_secs = atoi_time(val, "segment= ");
+        else {
+            fprintf(stderr, "Invalid key \"%s\" option.\n", key);
+            exit(1);
+        }
+    }
+    if (rec->segment_secs < 1)
+        rec->segment_secs = 1;
+
+    rec->index_path = strdup(path);
+    if (!rec->index_path) {
+        WARN_STRDUP("recorder_create()");
+        free(path);
+        recorder_free(rec);
+        return NULL;
+    }
+    // segments are named after the index without extension
+    char *ext = strrchr(path, '.');
+    if (ext && ext > file_basename(path))
+        *ext = '\0';
+    rec->prefix = path;
+
+    if (access(rec->index_path, F_OK) == 0 && !overwrite) {
+        fprintf(stderr, "Output file %s already exists, exiting\n", rec->index_path);
+        recorder_free(rec);
+        return NULL;
+    }
+    rec->index = fopen(rec->index_path, "w");
+    if (!rec->index) {
+        fprintf(stderr, "Failed to open %s\n", rec->index_path);
+        recorder_free(rec);
+        return NULL;
+    }
+    char time_str[LOCAL_TIME_BUFLEN];
+    fprintf(rec->index, ";spans version 1\n");
+    fprintf(rec->index, ";created %s\n", format_time_str(time_str, NULL, 1, 0));
+    fflush(rec->index);
+
+    return rec;
+}
+
+static int recorder_next_segment(recorder_t *rec, uint64_t offset)
+{
+    if (rec->segment)
+        fclose(rec->segment);
+
+    char const *ext = sample_format_ext(rec->sample_size);
+    size_t len = strlen(rec->prefix) + strlen(ext) + 16;
+    char *path = malloc(len);
+    if (!path) {
+        WARN_MALLOC("recorder_next_segment()");
+        return -1;
+    }
+    snprintf(path, len, "%s-%05u.%s", rec->prefix, rec->segment_num++, ext);
+    rec->segment = fopen(path, "wb");
+    if (!rec->segment) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        free(path);
+        return -1;
+    }
+    rec->segment_start = offset;
+
+    fprintf(rec->index, "segment %llu %u %u %s %s\n", (unsigned long long)offset,
+            rec->sample_rate, rec->center_frequency, ext, file_basename(path));
+    fflush(rec->index);
+    free(path);
+    return 0;
+}
+
+int recorder_write(recorder_t *rec, uint64_t offset, uint8_t const *iq_buf, unsigned n_samples,
+        int sample_size, uint32_t sample_rate, uint32_t center_frequency)
+{
+    if (!rec->segment
+            || offset != rec->pos
+            || sample_size != rec->sample_size
+            || sample_rate != rec->sample_rate
+            || center_frequency != rec->center_frequency
+            || rec->pos - rec->segment_start >= (uint64_t)sample_rate * rec->segment_secs) {
+        rec->sample_size      = sample_size;
+        rec->sample_rate      = sample_rate;
+        rec->center_frequency = center_frequency;
+        if (recorder_next_segment(rec, offset) < 0)
+            return -1;
+    }
+
+    size_t len = (size_t)n_samples * sample_size;
+    if (fwrite(iq_buf, 1, len, rec->segment) != len)
+        return -1;
+    rec->pos = offset + n_samples;
+    return 0;
+}
+
+void recorder_add_span(recorder_t *rec, pulse_data_t const *data)
+{
+    if (!data->num_pulses)
+        return;
+
+    // the last gap is the silence that ended the package
+    uint64_t end = data->offset + data->pulse[data->num_pulses - 1];
+    for (unsigned i = 0; i < data->num_pulses - 1; ++i)
+        end += data->pulse[i] + data->gap[i];
+
+    fprintf(rec->index, "span %llu %llu\n", (unsigned long long)data->offset, (unsigned long long)end);
+    fflush(rec->index);
+    rec->spans++;
+}
+
+void recorder_free(recorder_t *rec)
+{
+    if (!rec)
+        return;
+
+    if (rec->segment)
+        fclose(rec->segment);
+    if (rec->index)
+        fclose(rec->index);
+    free(rec->index_path);
+    free(rec->prefix);
+    free(rec);
+}
+
+/* replay */
+
+static int span_cmp(void const *a, void const *b)
+{
+    span_range_t const *x = a;
+    span_range_t const *y = b;
+    return x->start < y->start ? -1 : x->start > y->start ? 1 : 0;
+}
+
+/// Find the segment holding a stream offset, @return the segment or -1.
+static int find_segment(span_index_t const *idx, uint64_t offset)
+{
+    // last segment starting at or before the offset
+    unsigned lo = 0;
+    unsigned hi = idx->num_segments;
+    while (lo < hi) {
+        unsigned mid = lo + (hi - lo) / 2;
+        if (idx->segments[mid].offset <= offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == 0)
+        return -1;
+    span_segment_t const *seg = &idx->segments[lo - 1];
+    return offset < seg->offset + seg->samples ? (int)lo - 1 : -1;
+}
+
+/// Segments continue if contiguous with the same format, rate, and frequency.
+static int segment_continues(span_segment_t const *a, span_segment_t const *b)
+{
+    return a->offset + a->samples == b->offset
+            && a->sample_size == b->sample_size
+            && a->sample_rate == b->sample_rate
+            && a->center_frequency == b->center_frequency;
+}
+
+static char *segment_path(char const *index_path, char const *name)
+{
+    size_t dir_len = file_basename(index_path) - index_path;
+    size_t len     = dir_len + strlen(name) + 1;
+    char *path     = malloc(len);
+    if (!path) {
+        WARN_MALLOC("span_index_load()");
+        return NULL;
+    }
+    memcpy(path, index_path, dir_len);
+    strcpy(path + dir_len, name);
+    return path;
+}
+
+static int add_segment(span_index_t *idx, unsigned *max_segments, span_segment_t const *seg)
+{
+    if (idx->num_segments == *max_segments) {
+        *max_segments = *max_segments ? *max_segments * 2 : 16;
+        span_segment_t *segments = realloc(idx->segments, *max_segments * sizeof(*segments));
+        if (!segments) {
+            WARN_REALLOC("span_index_load()");
+            return 0;
+        }
+        idx->segments = segments;
+    }
+    idx->segments[idx->num_segments++] = *seg;
+    return 1;
+}
+
+static int add_span(span_index_t *idx, unsigned *max_spans, span_range_t const *span)
+{
+    if (idx->num_spans == *max_spans) {
+        *max_spans = *max_spans ? *max_spans * 2 : 256;
+        span_range_t *spans = realloc(idx->spans, *max_spans * sizeof(*spans));
+        if (!spans) {
+            WARN_REALLOC("span_index_load()");
+            return 0;
+        }
+        idx->spans = spans;
+    }
+    idx->spans[idx->num_spans++] = *span;
+    return 1;
+}
+
+span_index_t *span_index_load(char const *spec)
+{
+    unsigned pad_ms = RECORDER_DEFAULT_PAD_MS;
+
+    char *opts = strdup(spec);
+    if (!opts) {
+        WARN_STRDUP("span_index_load()");
+        return NULL;
+    }
+    char *path = asepc(&opts, ',');
+    char *key, *val;
+    while (getkwargs(&opts, &key, &val)) {
+        key = remove_ws(key);
+        val = trim_ws(val);
+        if (!key || !*key)
+            continue;
+        else if (!strcasecmp(key, "pad"))
+            pad_ms = atoiv(val, RECORDER_DEFAULT_PAD_MS);
+        else {
+            fprintf(stderr, "Invalid key \"%s\" option.\n", key);
+            exit(1);
+        }
+    }
+
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Opening file: %s failed!\n", path);
+        free(path);
+        return NULL;
+    }
+
+    span_index_t *idx = calloc(1, sizeof(*idx));
+    if (!idx) {
+        WARN_CALLOC("span_index_load()");
+        fclose(file);
+        free(path);
+        return NULL;
+    }
+
+    unsigned max_segments = 0;
+    unsigned max_spans    = 0;
+    char line[1024];
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        unsigned long long a, b;
+        unsigned rate, freq;
+        char format[8];
+        int n = 0;
+        if (sscanf(line, "segment %llu %u %u %7s %n", &a, &rate, &freq, format, &n) == 4 && n > 0) {
+            span_segment_t seg = {0};
+            seg.offset           = a;
+            seg.sample_rate      = rate;
+            seg.center_frequency = freq;
+            seg.sample_size      = !strcmp(format, "cu8") ? 2 : 4;
+            seg.path             = segment_path(path, &line[n]);
+            if (!seg.path)
+                break;
+            struct stat st;
+            if (stat(seg.path, &st) == 0)
+                seg.samples = (uint64_t)st.st_size / seg.sample_size;
+            else
+                fprintf(stderr, "Segment %s missing, skipping its spans.\n", seg.path);
+            if (!add_segment(idx, &max_segments, &seg)) {
+                free(seg.path);
+                break;
+            }
+            idx->total_samples += seg.samples;
+        }
+        else if (sscanf(line, "span %llu %llu", &a, &b) == 2 && a <= b) {
+            // a span can be indexed before its segment starts, resolve later
+            span_range_t span = {a, b, 0};
+            if (!add_span(idx, &max_spans, &span))
+                break;
+        }
+    }
+    fclose(file);
+    free(path);
+
+    // contiguous segments of the same format are one run, a span can cross segments of a run
+    for (unsigned i = 0; i < idx->num_segments; ++i) {
+        span_segment_t *seg = &idx->segments[i];
+        seg->run_start = i > 0 && segment_continues(seg - 1, seg) ? seg[-1].run_start : seg->offset;
+    }
+    for (unsigned i = idx->num_segments; i > 0; --i) {
+        span_segment_t *seg = &idx->segments[i - 1];
+        seg->run_end = i < idx->num_segments && segment_continues(seg, seg + 1) ? seg[1].run_end : seg->offset + seg->samples;
+    }
+
+    // pad and clamp each span to its run, drop spans that were not recorded
+    unsigned num_spans = 0;
+    for (unsigned i = 0; i < idx->num_spans; ++i) {
+        span_range_t span = idx->spans[i];
+        int s = find_segment(idx, span.start);
+        if (s < 0)
+            continue;
+        span_segment_t const *seg = &idx->segments[s];
+        uint64_t pad = (uint64_t)seg->sample_rate * pad_ms / 1000;
+        span.start   = span.start > seg->run_start + pad ? span.start - pad : seg->run_start;
+        span.end     = span.end + pad < seg->run_end ? span.end + pad : seg->run_end;
+        span.segment = find_segment(idx, span.start);
+        idx->spans[num_spans++] = span;
+    }
+    idx->num_spans = num_spans;
+
+    // sort and merge overlapping spans of a run
+    if (idx->num_spans) {
+        qsort(idx->spans, idx->num_spans, sizeof(*idx->spans), span_cmp);
+        unsigned n = 0;
+        for (unsigned i = 1; i < idx->num_spans; ++i) {
+            span_range_t *last = &idx->spans[n];
+            span_range_t const *span = &idx->spans[i];
+            if (idx->segments[span->segment].run_start == idx->segments[last->segment].run_start
+                    && span->start <= last->end) {
+                if (span->end > last->end)
+                    last->end = span->end;
+            }
+            else {
+                idx->spans[++n] = *span;
+            }
+        }
+        idx->num_spans = n + 1;
+    }
+
+    return idx;
+}
+
+void span_index_free(span_index_t *idx)
+{
+    if (!idx)
+        return;
+
+    if (idx->file)
+        fclose(idx->file);
+    for (unsigned i = 0; i < idx->num_segments; ++i)
+        free(idx->segments[i].path);
+    free(idx->segments);
+    free(idx->spans);
+    free(idx);
+}
+
+unsigned span_index_read(span_index_t *idx, uint64_t offset, uint8_t *buf, unsigned max_samples)
+{
+    int segment = find_segment(idx, offset);
+    if (segment < 0)
+        return 0;
+    span_segment_t const *seg = &idx->segments[segment];
+
+    if (!idx->file || idx->file_segment != (unsigned)segment) {
+        if (idx->file)
+            fclose(idx->file);
+        idx->file         = fopen(seg->path, "rb");
+        idx->file_segment = segment;
+        if (!idx->file) {
+            fprintf(stderr, "Opening file: %s failed!\n", seg->path);
+            return 0;
+        }
+    }
+
+    if (max_samples > seg->offset + seg->samples - offset)
+        max_samples = (unsigned)(seg->offset + seg->samples - offset);
+    if (seek_set(idx->file, (offset - seg->offset) * seg->sample_size))
+        return 0;
+    return (unsigned)(fread(buf, seg->sample_size, max_samples, idx->file));
+}
+
+#ifdef _TEST
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %s:%d: %s <> %s\n", __FILE__, __LINE__, #a, #b); \
+        } \
+    } while (0)
+
+#define TEST_INDEX "test_recorder.spans"
+
+static void make_span(pulse_data_t *data, uint64_t offset, unsigned len)
+{
+    pulse_data_clear(data);
+    data->offset     = offset;
+    data->num_pulses = 2;
+    data->pulse[0]   = len / 4;
+    data->gap[0]     = len / 2;
+    data->pulse[1]   = len - len / 4 - len / 2;
+    data->gap[1]     = 100000; // not part of the span
+}
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+
+    fprintf(stderr, "recorder:: test\n");
+
+    static pulse_data_t data;
+    static uint8_t buf[2 * 1000];
+
+    // 1000 sps with 2 s segments, 5 s in buffers of 500 samples
+    recorder_t *rec = recorder_create(TEST_INDEX ",segment=2", 1);
+    ASSERT_EQUALS(rec != NULL, 1);
+    ASSERT_EQUALS(rec->segment_secs, 2);
+    for (uint64_t pos = 0; pos < 5000; pos += 500) {
+        for (unsigned n = 0; n < 500; ++n) {
+            buf[2 * n]     = (uint8_t)((pos + n) >> 8);
+            buf[2 * n + 1] = (uint8_t)(pos + n);
+        }
+        ASSERT_EQUALS(recorder_write(rec, pos, buf, 500, 2, 1000, 433920000), 0);
+    }
+    make_span(&data, 300, 100);
+    recorder_add_span(rec, &data);
+    make_span(&data, 420, 100);
+    recorder_add_span(rec, &data);
+    make_span(&data, 2100, 50);
+    recorder_add_span(rec, &data);
+    make_span(&data, 1000, 10);
+    recorder_add_span(rec, &data);
+    ASSERT_EQUALS(rec->segment_num, 3);
+    recorder_free(rec);
+
+    // 100 ms pad is 100 samples, clamped to the recording
+    span_index_t *idx = span_index_load(TEST_INDEX ",pad=100");
+    ASSERT_EQUALS(idx != NULL, 1);
+    ASSERT_EQUALS(idx->num_segments, 3);
+    ASSERT_EQUALS(idx->segments[1].offset, 2000);
+    ASSERT_EQUALS(idx->segments[1].samples, 2000);
+    ASSERT_EQUALS(idx->segments[2].samples, 1000);
+    ASSERT_EQUALS(idx->total_samples, 5000);
+    ASSERT_EQUALS(idx->num_spans, 3);
+    ASSERT_EQUALS(idx->spans[0].start, 200);
+    ASSERT_EQUALS(idx->spans[0].end, 620);
+    ASSERT_EQUALS(idx->spans[1].start, 900);
+    ASSERT_EQUALS(idx->spans[1].end, 1110);
+    ASSERT_EQUALS(idx->spans[2].segment, 1);
+    ASSERT_EQUALS(idx->spans[2].start, 2000);
+    ASSERT_EQUALS(idx->spans[2].end, 2250);
+    ASSERT_EQUALS(idx->segments[2].run_start, 0);
+    ASSERT_EQUALS(idx->segments[0].run_end, 5000);
+
+    // samples are read back by stream offset, up to the end of a segment
+    unsigned n = span_index_read(idx, 2100, buf, 1000);
+    ASSERT_EQUALS(n, 1000);
+    ASSERT_EQUALS(buf[0], (2100 >> 8));
+    ASSERT_EQUALS(buf[1], (2100 & 0xff));
+    n = span_index_read(idx, 3500, buf, 1000);
+    ASSERT_EQUALS(n, 500);
+    ASSERT_EQUALS(buf[2 * 499 + 1], (3999 & 0xff));
+    n = span_index_read(idx, 4000, buf, 1000);
+    ASSERT_EQUALS(n, 1000);
+    ASSERT_EQUALS(span_index_read(idx, 5000, buf, 1000), 0);
+    span_index_free(idx);
+
+    remove(TEST_INDEX);
+    remove("test_recorder-00000.cu8");
+    remove("test_recorder-00001.cu8");
+    remove("test_recorder-00002.cu8");
+
+    fprintf(stderr, "recorder:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+    return failed;
+}
+#endif /* _TEST */
@@ -38,6 +38,8 @@
 #include "pulse_detect.h"
 #include "pulse_detect_fsk.h"
 #include "pulse_demod.h"
+#include "pulse_log.h"
+#include "recorder.h"
 #include "rfraw.h"
 #include "data.h"
 #include "r_util.h"
@@ -45,6 +47,7 @@
 #include "abuf.h"
 #include "fileformat.h"
 #include "samp_grab.h"
+#include "iq_codec.h"
 #include "am_analyze.h"
 #include "confparse.h"
 #include "term_ctl.h"
@@ -52,6 +55,10 @@
 #include "compat_paths.h"
 #include "fatal.h"
 #include "write_sigrok.h"
+#include "net_thread.h"
+#include "iq_server.h"
+#include "pulse_server.h"
+#include "bulk_decode.h"
 #include "mongoose.h"
 
 #ifdef _WIN32
@@ -103,7 +110,7 @@ static void usage(int exit_code)
             "       -v : verbose, -vv : verbose decoders, -vvv : debug decoders, -vvvv : trace decoding).\n"
             "  [-c <path>] Read config options from a file\n"
             "\t\t= Tuner options =\n"
-            "  [-d <RTL-SDR USB device index> | :<RTL-SDR USB device serial> | <SoapySDR device query> | rtl_tcp | help]\n"
+            "  [-d <RTL-SDR USB device index> | :<RTL-SDR USB device serial> | <SoapySDR device query> | rtl_tcp | pulse | help]\n"
             "  [-g <gain> | help] (default: auto)\n"
             "  [-t <settings>] apply a list of keyword=value settings for SoapySDR devices\n"
             "       e.g. -t \"antenna=A,bandwidth=4.5M,rfnotch_ctrl=false\"\n"
@@ -122,20 +129,24 @@ static void usage(int exit_code)
             "  [-Y minsnr=<dB level>] Minimum SNR to determine pulses (1.0 to 99.0).\n"
             "  [-Y autolevel] Set minlevel automatically based on average estimated noise.\n"
             "  [-Y squelch] Skip frames below estimated noise level to reduce cpu load.\n"
+            "  [-Y lowlatency[=<ms>]] Use short transfers (default: %i ms) and output each package as soon as it ended.\n"
             "  [-Y ampest | magest] Choose amplitude or magnitude level estimator.\n"
+            "  [-Y decimate=<n>] Decimate the input by an integer factor (2 to 64) before any processing.\n"
             "\t\t= Analyze/Debug options =\n"
             "  [-a] Analyze mode. Print a textual description of the signal.\n"
             "  [-A] Pulse Analyzer. Enable pulse analysis and decode attempt.\n"
             "       Disable all decoders with -R 0 if you want analyzer output only.\n"
             "  [-y <code>] Verify decoding of demodulated test data (e.g. \"{25}fb2dd58\") with enabled devices\n"
+            "       Use -y @<file> or -y - to read one code per line, files are decoded on all CPUs with outputs in input order.\n"
             "\t\t= File I/O options =\n"
             "  [-S none | all | unknown | known] Signal auto save. Creates one file per signal.\n"
             "       Note: Saves raw I/Q samples (uint8 pcm, 2 channel). Preferred mode for generating test files.\n"
+            "       Append ':riq' to save lossless compressed samples, e.g. -S all:riq\n"
             "  [-r <filename> | help] Read data from input file instead of a receiver\n"
             "  [-w <filename> | help] Save data stream to output file (a '-' dumps samples to stdout)\n"
             "  [-W <filename> | help] Save data stream to output file, overwrite existing file\n"
             "\t\t= Data output options =\n"
-            "  [-F kv | json | csv | mqtt | influx | syslog | null | help] Produce decoded output in given format.\n"
+            "  [-F kv | json | csv | mqtt | influx | cbor | msgpack | syslog | null | help] Produce decoded output in given format.\n"
             "       Append output to file with :<filename> (e.g. -F csv:log.csv), defaults to stdout.\n"
             "       Specify host/port for syslog with e.g. -F syslog:127.0.0.1:1514\n"
             "  [-M time[:<options>] | protocol | level | noise[:secs] | stats | bits | help] Add various meta data to each output.\n"
@@ -146,7 +157,7 @@ static void usage(int exit_code)
             "  [-E hop | quit] Hop/Quit after outputting successful event(s)\n"
             "  [-h] Output this usage help and exit\n"
             "       Use -d, -g, -R, -X, -F, -M, -r, -w, or -W without argument for more help\n\n",
-            DEFAULT_FREQUENCY, DEFAULT_HOP_TIME, DEFAULT_SAMPLE_RATE);
+            DEFAULT_FREQUENCY, DEFAULT_HOP_TIME, DEFAULT_SAMPLE_RATE, DEFAULT_LOW_LATENCY_MS);
     exit(exit_code);
 }
 
@@ -190,7 +201,15 @@ static void help_device(void)
             "  [-d driver=rtlsdr] Open e.g. specific SoapySDR device\n"
             "\tTo set gain for SoapySDR use -g ELEM=val,ELEM=val,... e.g. -g LNA=20,TIA=8,PGA=2 (for LimeSDR).\n"
             "  [-d rtl_tcp[:[//]host[:port]] (default: localhost:1234)\n"
-            "\tSpecify host/port to connect to with e.g. -d rtl_tcp:127.0.0.1:1234\n");
+            "\tSpecify host/port to connect to with e.g. -d rtl_tcp:127.0.0.1:1234\n"
+            "\trtl_tcp options are: rcvbuf=bytes (socket receive buffer, default: system),\n"
+            "\t  buffers=N (received buffers waiting for processing, default 16), e.g. -d rtl_tcp:host:1234,rcvbuf=4M\n"
+            "\tReceived buffers are copied for the signal grabber (-S) and the rtl_tcp output (-F rtl_tcp).\n"
+            "  [-d pulse[:[//]host[:port]] (default: 0.0.0.0:8434)\n"
+            "\tReceive pulse data from remote receivers over UDP and TCP instead of samples, e.g. -d pulse::8434\n"
+            "\tEvents are tagged with the receiver name, or the sender address of unnamed receivers.\n"
+            "\tpulse options are: queue=N (packets waiting for the decoders before packets are dropped, default 64),\n"
+            "\t  clients=N (TCP connections, default 64), see docs/OPERATION.md for the packet formats\n");
     exit(0);
 }
 
@@ -211,12 +230,14 @@ static void help_output(void)
 {
     term_help_printf(
             "\t\t= Output format option =\n"
-            "  [-F kv|json|csv|mqtt|influx|syslog|null] Produce decoded output in given format.\n"
+            "  [-F kv|json|csv|mqtt|influx|cbor|msgpack|syslog|null] Produce decoded output in given format.\n"
             "\tWithout this option the default is KV output. Use \"-F null\" to remove the default.\n"
             "\tAppend output to file with :<filename> (e.g. -F csv:log.csv), defaults to stdout.\n"
             "\tSpecify MQTT server with e.g. -F mqtt://localhost:1883\n"
             "\tAdd MQTT options with e.g. -F \"mqtt://host:1883,opt=arg\"\n"
             "\tMQTT options are: user=foo, pass=bar, retain[=0|1], qos=N, <format>[=topic]\n"
+            "\tMQTT queue options are: queue=N (messages, default 1000), inflight=N (unacked QoS messages, default 20),\n"
+            "\t  coalesce[=ms] (replace pending device topics within the window), spool=FILE (overflow while disconnected)\n"
             "\tSupported MQTT formats: (default is all)\n"
             "\t  events: posts JSON event data\n"
             "\t  states: posts JSON state data\n"
@@ -228,7 +249,20 @@ static void help_output(void)
             "\tSpecify InfluxDB 2.0 server with e.g. -F \"influx://localhost:9999/api/v2/write?org=<org>&bucket=<bucket>,token=<authtoken>\"\n"
             "\tSpecify InfluxDB 1.x server with e.g. -F \"influx://localhost:8086/write?db=<db>&p=<password>&u=<user>\"\n"
             "\t  Additional parameter -M time:unix:usec:utc for correct timestamps in InfluxDB recommended\n"
-            "\tSpecify host/port for syslog with e.g. -F syslog:127.0.0.1:1514\n");
+            "\tInfluxDB options are: token=T, batch_size=N (lines, default 100), flush_interval=ms (default 0),\n"
+            "\t  max_buffer=bytes (bound for data kept on errors, default 1 MB), gzip[=0|1]\n"
+            "\tBinary event streams (cbor or msgpack) go to a file or to udp:// or tcp:// host:port,\n"
+            "\t  e.g. -F cbor:events.cbor or -F msgpack:tcp://localhost:1433\n"
+            "\t  Frames are a 4-byte big-endian length, a type byte ('S' schema, 'E' event) and the payload.\n"
+            "\t  Event keys are encoded as index into the latest schema (an array of key names) where known.\n"
+            "\tSpecify host/port for syslog with e.g. -F syslog:127.0.0.1:1514\n"
+            "\tSpecify host/port for the HTTP server with e.g. -F http:0.0.0.0:8433\n"
+            "\tHTTP options are: queue=bytes (for each streaming client, default 1M), slow=drop|close\n"
+            "\t  (drop the oldest messages or disconnect a client once the queue is full, default drop)\n"
+            "\tServe the received samples to rtl_tcp clients with e.g. -F rtl_tcp:0.0.0.0:1234 (default localhost:1234)\n"
+            "\t  Decoding continues, clients get CU8 samples and share the tuning, their commands are ignored.\n"
+            "\trtl_tcp options are: ring=N (blocks queued for each client before blocks are dropped, default 16),\n"
+            "\t  clients=N (default 8)\n");
     exit(0);
 }
 
@@ -258,7 +292,7 @@ static void help_meta(void)
 {
     term_help_printf(
             "\t\t= Meta information option =\n"
-            "  [-M time[:<options>]|protocol|level|noise[:<secs>]|stats|bits] Add various metadata to every output line.\n"
+            "  [-M time[:<options>]|protocol|level|noise[:<secs>]|stats|bits|cpu] Add various metadata to every output line.\n"
             "\tUse \"time\" to add current date and time meta data (preset for live inputs).\n"
             "\tUse \"time:rel\" to add sample position meta data (preset for read-file and stdin).\n"
             "\tUse \"time:unix\" to show the seconds since unix epoch as time meta data.\n"
@@ -274,7 +308,8 @@ static void help_meta(void)
             "\tUse \"noise[:secs]\" to report estimated noise level at intervals (default: 10 seconds).\n"
             "\tUse \"stats[:[<level>][:<interval>]]\" to report statistics (default: 600 seconds).\n"
             "\t  level 0: no report, 1: report successful devices, 2: report active devices, 3: report all\n"
-            "\tUse \"bits\" to add bit representation to code outputs (for debug).\n");
+            "\tUse \"bits\" to add bit representation to code outputs (for debug).\n"
+            "\tUse \"cpu\" to measure the time spent in each decoder, the top decoders are added to stats.\n");
     exit(0);
 }
 
@@ -290,7 +325,11 @@ static void help_read(void)
             "\tA sample rate is detected as (fractional) number suffixed with 'k',\n"
             "\t'sps', 'ksps', 'Msps', or 'Gsps'.\n\n"
             "\tFile content and format are detected as parameters, possible options are:\n"
-            "\t'cu8', 'cs16', 'cf32' ('IQ' implied), and 'am.s16'.\n\n"
+            "\t'cu8', 'cs16', 'cf32' ('IQ' implied), 'am.s16', 'ook', and 'plog'.\n\n"
+            "\tA 'spans' index replays only the package spans of a recording,\n"
+            "\tpadded by 'pad' milliseconds, e.g. path/capture.spans,pad=200\n\n"
+            "\tThe 'riq' codec reads lossless compressed 'cu8' or 'cs16', e.g. path/capture.cu8.riq\n"
+            "\tThe sample rate and center frequency are taken from the file.\n\n"
             "\tParameters must be separated by non-alphanumeric chars and are case-insensitive.\n"
             "\tOverrides can be prefixed, separated by colon (':')\n\n"
             "\tE.g. default detection by extension: path/filename.am.s16\n"
@@ -311,7 +350,11 @@ static void help_write(void)
             "\tFile content and format are detected as parameters, possible options are:\n"
             "\t'cu8', 'cs8', 'cs16', 'cf32' ('IQ' implied),\n"
             "\t'am.s16', 'am.f32', 'fm.s16', 'fm.f32',\n"
-            "\t'i.f32', 'q.f32', 'logic.u8', 'ook', and 'vcd'.\n\n"
+            "\t'i.f32', 'q.f32', 'logic.u8', 'ook', 'plog', and 'vcd'.\n\n"
+            "\tThe 'plog' pulse log is a compact binary of 'ook' with a seek index.\n\n"
+            "\tA 'spans' index records IQ to segments of 'segment' seconds,\n"
+            "\tand indexes the package spans, e.g. path/capture.spans,segment=600\n\n"
+            "\tThe 'riq' codec writes 'cu8' or 'cs16' lossless compressed, e.g. path/capture.cu8.riq\n\n"
             "\tParameters must be separated by non-alphanumeric chars and are case-insensitive.\n"
             "\tOverrides can be prefixed, separated by colon (':')\n\n"
             "\tE.g. default detection by extension: path/filename.am.s16\n"
@@ -319,373 +362,6 @@ static void help_write(void)
     exit(0);
 }
 
-static void sdr_callback(unsigned char *iq_buf, uint32_t len, void *ctx)
-{
-    r_cfg_t *cfg = ctx;
-    struct dm_state *demod = cfg->demod;
-    char time_str[LOCAL_TIME_BUFLEN];
-    unsigned long n_samples;
-
-    if ((cfg->bytes_to_read > 0) && (cfg->bytes_to_read <= len)) {
-        len = cfg->bytes_to_read;
-        cfg->exit_async = 1;
-    }
-
-    // save last frame time to see if a new second started
-    time_t last_frame_sec = demod->now.tv_sec;
-    get_time_now(&demod->now);
-
-    n_samples = len / demod->sample_size;
-    if (n_samples * demod->sample_size != len) {
-        fprintf(stderr, "Sample buffer length not aligned to sample size!\n");
-    }
-    if (!n_samples) {
-        fprintf(stderr, "Sample buffer too short!\n");
-        return; // keep the watchdog timer running
-    }
-
-    // age the frame position if there is one
-    if (demod->frame_start_ago)
-        demod->frame_start_ago += n_samples;
-    if (demod->frame_end_ago)
-        demod->frame_end_ago += n_samples;
-
-    alarm(3); // require callback to run every 3 second, abort otherwise
-
-    if (demod->samp_grab) {
-        samp_grab_push(demod->samp_grab, iq_buf, len);
-    }
-
-    // AM demodulation
-    float avg_db;
-    if (demod->sample_size == 2) { // CU8
-        if (demod->use_mag_est) {
-            //magnitude_true_cu8(iq_buf, demod->buf.temp, n_samples);
-            avg_db = magnitude_est_cu8(iq_buf, demod->buf.temp, n_samples);
-        }
-        else { // amp est
-            avg_db = envelope_detect(iq_buf, demod->buf.temp, n_samples);
-        }
-    } else { // CS16
-        //magnitude_true_cs16((int16_t *)iq_buf, demod->buf.temp, n_samples);
-        avg_db = magnitude_est_cs16((int16_t *)iq_buf, demod->buf.temp, n_samples);
-    }
-
-    //fprintf(stderr, "noise level: %.1f dB current: %.1f dB min level: %.1f dB\n", demod->noise_level, avg_db, demod->min_level_auto);
-    if (demod->min_level_auto == 0.0f) {
-        demod->min_level_auto = demod->min_level;
-    }
-    if (demod->noise_level == 0.0f) {
-        demod->noise_level = demod->min_level_auto - 3.0f;
-    }
-    int noise_only = avg_db < demod->noise_level + 3.0f; // or demod->min_level_auto?
-    // always process frames if loader, dumper, or analyzers are in use, otherwise skip silent frames
-    int process_frame = demod->squelch_offset <= 0 || !noise_only || demod->load_info.format || demod->analyze_pulses || demod->dumper.len || demod->samp_grab;
-    if (noise_only) {
-        demod->noise_level = (demod->noise_level * 7 + avg_db) / 8; // fast fall over 8 frames
-        // If auto_level and noise level well below min_level and significant change in noise level
-        if (demod->auto_level > 0 && demod->noise_level < demod->min_level - 3.0f
-                && fabsf(demod->min_level_auto - demod->noise_level - 3.0f) > 1.0f) {
-            demod->min_level_auto = demod->noise_level + 3.0f;
-            fprintf(stderr, "Estimated noise level is %.1f dB, adjusting minimum detection level to %.1f dB\n", demod->noise_level, demod->min_level_auto);
-            pulse_detect_set_levels(demod->pulse_detect, demod->use_mag_est, demod->level_limit, demod->min_level_auto, demod->min_snr, demod->detect_verbosity);
-        }
-    } else {
-        demod->noise_level = (demod->noise_level * 31 + avg_db) / 32; // slow rise over 32 frames
-    }
-    // Report noise every report_noise seconds, but only for the first frame that second
-    if (cfg->report_noise && last_frame_sec != demod->now.tv_sec && demod->now.tv_sec % cfg->report_noise == 0) {
-        fprintf(stderr, "Current %s level %.1f dB, estimated noise %.1f dB\n",
-                noise_only ? "noise" : "signal", avg_db, demod->noise_level);
-    }
-
-    if (process_frame)
-    baseband_low_pass_filter(demod->buf.temp, demod->am_buf, n_samples, &demod->lowpass_filter_state);
-
-    // FM demodulation
-    // Select the correct fsk pulse detector
-    unsigned fpdm = cfg->fsk_pulse_detect_mode;
-    if (cfg->fsk_pulse_detect_mode == FSK_PULSE_DETECT_AUTO) {
-        if (cfg->frequency[cfg->frequency_index] > FSK_PULSE_DETECTOR_LIMIT)
-            fpdm = FSK_PULSE_DETECT_NEW;
-        else
-            fpdm = FSK_PULSE_DETECT_OLD;
-    }
-
-    if (demod->enable_FM_demod && process_frame) {
-        float low_pass = demod->low_pass != 0.0f ? demod->low_pass : fpdm ? 0.2f : 0.1f;
-        if (demod->sample_size == 2) { // CU8
-            baseband_demod_FM(iq_buf, demod->buf.fm, n_samples, cfg->samp_rate, low_pass, &demod->demod_FM_state);
-        } else { // CS16
-            baseband_demod_FM_cs16((int16_t *)iq_buf, demod->buf.fm, n_samples, cfg->samp_rate, low_pass, &demod->demod_FM_state);
-        }
-    }
-
-    // Handle special input formats
-    if (demod->load_info.format == S16_AM) { // The IQ buffer is really AM demodulated data
-        if (len > sizeof(demod->am_buf))
-            FATAL("Buffer too small");
-        memcpy(demod->am_buf, iq_buf, len);
-    } else if (demod->load_info.format == S16_FM) { // The IQ buffer is really FM demodulated data
-        // we would need AM for the envelope too
-        if (len > sizeof(demod->buf.fm))
-            FATAL("Buffer too small");
-        memcpy(demod->buf.fm, iq_buf, len);
-    }
-
-    int d_events = 0; // Sensor events successfully detected
-    if (demod->r_devs.len || demod->analyze_pulses || demod->dumper.len || demod->samp_grab) {
-        // Detect a package and loop through demodulators with pulse data
-        int package_type = PULSE_DATA_OOK;  // Just to get us started
-        for (void **iter = demod->dumper.elems; iter && *iter; ++iter) {
-            file_info_t const *dumper = *iter;
-            if (dumper->format == U8_LOGIC) {
-                memset(demod->u8_buf, 0, n_samples);
-                break;
-            }
-        }
-        while (package_type && process_frame) {
-            int p_events = 0; // Sensor events successfully detected per package
-            package_type = pulse_detect_package(demod->pulse_detect, demod->am_buf, demod->buf.fm, n_samples, cfg->samp_rate, cfg->input_pos, &demod->pulse_data, &demod->fsk_pulse_data, fpdm);
-            if (package_type) {
-                // new package: set a first frame start if we are not tracking one already
-                if (!demod->frame_start_ago)
-                    demod->frame_start_ago = demod->pulse_data.start_ago;
-                // always update the last frame end
-                demod->frame_end_ago = demod->pulse_data.end_ago;
-            }
-            if (package_type == PULSE_DATA_OOK) {
-                calc_rssi_snr(cfg, &demod->pulse_data);
-                if (demod->analyze_pulses) fprintf(stderr, "Detected OOK package\t%s\n", time_pos_str(cfg, demod->pulse_data.start_ago, time_str));
-
-                p_events += run_ook_demods(&demod->r_devs, &demod->pulse_data);
-                cfg->frames_count++;
-                cfg->frames_events += p_events > 0;
-
-                for (void **iter = demod->dumper.elems; iter && *iter; ++iter) {
-                    file_info_t const *dumper = *iter;
-                    if (dumper->format == VCD_LOGIC) pulse_data_print_vcd(dumper->file, &demod->pulse_data, '\'');
-                    if (dumper->format == U8_LOGIC) pulse_data_dump_raw(demod->u8_buf, n_samples, cfg->input_pos, &demod->pulse_data, 0x02);
-                    if (dumper->format == PULSE_OOK) pulse_data_dump(dumper->file, &demod->pulse_data);
-                }
-
-                if (cfg->verbosity > 2) pulse_data_print(&demod->pulse_data);
-                if (cfg->raw_mode == 1 || (cfg->raw_mode == 2 && p_events == 0) || (cfg->raw_mode == 3 && p_events > 0)) {
-                    data_t *data = pulse_data_print_data(&demod->pulse_data);
-                    event_occurred_handler(cfg, data);
-                }
-                if (demod->analyze_pulses && (cfg->grab_mode <= 1 || (cfg->grab_mode == 2 && p_events == 0) || (cfg->grab_mode == 3 && p_events > 0)) ) {
-                    pulse_analyzer(&demod->pulse_data, package_type);
-                }
-
-            } else if (package_type == PULSE_DATA_FSK) {
-                calc_rssi_snr(cfg, &demod->fsk_pulse_data);
-                if (demod->analyze_pulses) fprintf(stderr, "Detected FSK package\t%s\n", time_pos_str(cfg, demod->fsk_pulse_data.start_ago, time_str));
-
-                p_events += run_fsk_demods(&demod->r_devs, &demod->fsk_pulse_data);
-                cfg->frames_fsk++;
-                cfg->frames_events += p_events > 0;
-
-                for (void **iter = demod->dumper.elems; iter && *iter; ++iter) {
-                    file_info_t const *dumper = *iter;
-                    if (dumper->format == VCD_LOGIC) pulse_data_print_vcd(dumper->file, &demod->fsk_pulse_data, '"');
-                    if (dumper->format == U8_LOGIC) pulse_data_dump_raw(demod->u8_buf, n_samples, cfg->input_pos, &demod->fsk_pulse_data, 0x04);
-                    if (dumper->format == PULSE_OOK) pulse_data_dump(dumper->file, &demod->fsk_pulse_data);
-                }
-
-                if (cfg->verbosity > 2) pulse_data_print(&demod->fsk_pulse_data);
-                if (cfg->raw_mode == 1 || (cfg->raw_mode == 2 && p_events == 0) || (cfg->raw_mode == 3 && p_events > 0)) {
-                    data_t *data = pulse_data_print_data(&demod->fsk_pulse_data);
-                    event_occurred_handler(cfg, data);
-                }
-                if (demod->analyze_pulses && (cfg->grab_mode <= 1 || (cfg->grab_mode == 2 && p_events == 0) || (cfg->grab_mode == 3 && p_events > 0))) {
-                    pulse_analyzer(&demod->fsk_pulse_data, package_type);
-                }
-            } // if (package_type == ...
-            d_events += p_events;
-        } // while (package_type)...
-
-        // add event counter to the frames currently tracked
-        demod->frame_event_count += d_events;
-
-        // end frame tracking if older than a whole buffer
-        if (demod->frame_start_ago && demod->frame_end_ago > n_samples) {
-            if (demod->samp_grab) {
-                if (cfg->grab_mode == 1
-                        || (cfg->grab_mode == 2 && demod->frame_event_count == 0)
-                        || (cfg->grab_mode == 3 && demod->frame_event_count > 0)) {
-                    unsigned frame_pad = n_samples / 8; // this could also be a fixed value, e.g. 10000 samples
-                    unsigned start_padded = demod->frame_start_ago + frame_pad;
-                    unsigned end_padded = demod->frame_end_ago - frame_pad;
-                    unsigned len_padded = start_padded - end_padded;
-                    samp_grab_write(demod->samp_grab, len_padded, end_padded);
-                }
-            }
-            demod->frame_start_ago = 0;
-            demod->frame_event_count = 0;
-        }
-
-        // dump partial pulse_data for this buffer
-        for (void **iter = demod->dumper.elems; iter && *iter; ++iter) {
-            file_info_t const *dumper = *iter;
-            if (dumper->format == U8_LOGIC) {
-                pulse_data_dump_raw(demod->u8_buf, n_samples, cfg->input_pos, &demod->pulse_data, 0x02);
-                pulse_data_dump_raw(demod->u8_buf, n_samples, cfg->input_pos, &demod->fsk_pulse_data, 0x04);
-                break;
-            }
-        }
-    }
-
-    if (demod->am_analyze) {
-        am_analyze(demod->am_analyze, demod->am_buf, n_samples, cfg->verbosity > 1, NULL);
-    }
-
-    for (void **iter = demod->dumper.elems; iter && *iter; ++iter) {
-        file_info_t const *dumper = *iter;
-        if (!dumper->file
-                || dumper->format == VCD_LOGIC
-                || dumper->format == PULSE_OOK)
-            continue;
-        uint8_t *out_buf = iq_buf;  // Default is to dump IQ samples
-        unsigned long out_len = n_samples * demod->sample_size;
-
-        if (dumper->format == CU8_IQ) {
-            if (demod->sample_size == 4) {
-                for (unsigned long n = 0; n < n_samples * 2; ++n)
-                    ((uint8_t *)demod->buf.temp)[n] = (((int16_t *)iq_buf)[n] / 256) + 128; // scale Q0.15 to Q0.7
-                out_buf = (uint8_t *)demod->buf.temp;
-                out_len = n_samples * 2 * sizeof(uint8_t);
-            }
-        }
-        else if (dumper->format == CS16_IQ) {
-            if (demod->sample_size == 2) {
-                for (unsigned long n = 0; n < n_samples * 2; ++n)
-                    ((int16_t *)demod->buf.temp)[n] = (iq_buf[n] * 256) - 32768; // scale Q0.7 to Q0.15
-                out_buf = (uint8_t *)demod->buf.temp; // this buffer is too small if out_block_size is large
-                out_len = n_samples * 2 * sizeof(int16_t);
-            }
-        }
-        else if (dumper->format == CS8_IQ) {
-            if (demod->sample_size == 2) {
-                for (unsigned long n = 0; n < n_samples * 2; ++n)
-                    ((int8_t *)demod->buf.temp)[n] = (iq_buf[n] - 128);
-            }
-            else if (demod->sample_size == 4) {
-                for (unsigned long n = 0; n < n_samples * 2; ++n)
-                    ((int8_t *)demod->buf.temp)[n] = ((int16_t *)iq_buf)[n] >> 8;
-            }
-            out_buf = (uint8_t *)demod->buf.temp;
-            out_len = n_samples * 2 * sizeof(int8_t);
-        }
-        else if (dumper->format == CF32_IQ) {
-            if (demod->sample_size == 2) {
-                for (unsigned long n = 0; n < n_samples * 2; ++n)
-                    ((float *)demod->buf.temp)[n] = (iq_buf[n] - 128) / 128.0f;
-            }
-            else if (demod->sample_size == 4) {
-                for (unsigned long n = 0; n < n_samples * 2; ++n)
-                    ((float *)demod->buf.temp)[n] = ((int16_t *)iq_buf)[n] / 32768.0f;
-            }
-            out_buf = (uint8_t *)demod->buf.temp; // this buffer is too small if out_block_size is large
-            out_len = n_samples * 2 * sizeof(float);
-        }
-        else if (dumper->format == S16_AM) {
-            out_buf = (uint8_t *)demod->am_buf;
-            out_len = n_samples * sizeof(int16_t);
-        }
-        else if (dumper->format == S16_FM) {
-            out_buf = (uint8_t *)demod->buf.fm;
-            out_len = n_samples * sizeof(int16_t);
-        }
-        else if (dumper->format == F32_AM) {
-            for (unsigned long n = 0; n < n_samples; ++n)
-                demod->f32_buf[n] = demod->am_buf[n] * (1.0f / 0x8000); // scale from Q0.15
-            out_buf = (uint8_t *)demod->f32_buf;
-            out_len = n_samples * sizeof(float);
-        }
-        else if (dumper->format == F32_FM) {
-            for (unsigned long n = 0; n < n_samples; ++n)
-                demod->f32_buf[n] = demod->buf.fm[n] * (1.0f / 0x8000); // scale from Q0.15
-            out_buf = (uint8_t *)demod->f32_buf;
-            out_len = n_samples * sizeof(float);
-        }
-        else if (dumper->format == F32_I) {
-            if (demod->sample_size == 2)
-                for (unsigned long n = 0; n < n_samples; ++n)
-                    demod->f32_buf[n] = (iq_buf[n * 2] - 128) * (1.0f / 0x80); // scale from Q0.7
-            else
-                for (unsigned long n = 0; n < n_samples; ++n)
-                    demod->f32_buf[n] = ((int16_t *)iq_buf)[n * 2] * (1.0f / 0x8000); // scale from Q0.15
-            out_buf = (uint8_t *)demod->f32_buf;
-            out_len = n_samples * sizeof(float);
-        }
-        else if (dumper->format == F32_Q) {
-            if (demod->sample_size == 2)
-                for (unsigned long n = 0; n < n_samples; ++n)
-                    demod->f32_buf[n] = (iq_buf[n * 2 + 1] - 128) * (1.0f / 0x80); // scale from Q0.7
-            else
-                for (unsigned long n = 0; n < n_samples; ++n)
-                    demod->f32_buf[n] = ((int16_t *)iq_buf)[n * 2 + 1] * (1.0f / 0x8000); // scale from Q0.15
-            out_buf = (uint8_t *)demod->f32_buf;
-            out_len = n_samples * sizeof(float);
-        }
-        else if (dumper->format == U8_LOGIC) { // state data
-            out_buf = demod->u8_buf;
-            out_len = n_samples;
-        }
-
-        if (fwrite(out_buf, 1, out_len, dumper->file) != out_len) {
-            fprintf(stderr, "Short write, samples lost, exiting!\n");
-            cfg->exit_async = 1;
-        }
-    }
-
-    cfg->input_pos += n_samples;
-    if (cfg->bytes_to_read > 0)
-        cfg->bytes_to_read -= len;
-
-    if (cfg->after_successful_events_flag && (d_events > 0)) {
-        alarm(0); // cancel the watchdog timer
-        if (cfg->after_successful_events_flag == 1) {
-            cfg->exit_async = 1;
-        }
-        else {
-            cfg->hop_now = 1;
-        }
-    }
-
-    time_t rawtime;
-    time(&rawtime);
-    // choose hop_index as frequency_index, if there are too few hop_times use the last one
-    int hop_index = cfg->hop_times > cfg->frequency_index ? cfg->frequency_index : cfg->hop_times - 1;
-    if (cfg->hop_times > 0 && cfg->frequencies > 1
-            && difftime(rawtime, cfg->hop_start_time) > cfg->hop_time[hop_index]) {
-        alarm(0); // cancel the watchdog timer
-        cfg->hop_now = 1;
-    }
-    if (cfg->duration > 0 && rawtime >= cfg->stop_time) {
-        alarm(0); // cancel the watchdog timer
-        cfg->exit_async = 1;
-        fprintf(stderr, "Time expired, exiting!\n");
-    }
-    if (cfg->stats_now || (cfg->report_stats && cfg->stats_interval && rawtime >= cfg->stats_time)) {
-        event_occurred_handler(cfg, create_report_data(cfg, cfg->stats_now ? 3 : cfg->report_stats));
-        flush_report_data(cfg);
-        if (rawtime >= cfg->stats_time)
-            cfg->stats_time += cfg->stats_interval;
-        if (cfg->stats_now)
-            cfg->stats_now--;
-    }
-
-    if (cfg->hop_now && !cfg->exit_async) {
-        cfg->hop_now = 0;
-        time(&cfg->hop_start_time);
-        cfg->frequency_index  = (cfg->frequency_index + 1) % cfg->frequencies;
-        cfg->center_frequency = cfg->frequency[cfg->frequency_index];
-        sdr_set_center_freq(cfg->dev, cfg->center_frequency, 0);
-    }
-}
-
 static int hasopt(int test, int argc, char *argv[], char const *optstring)
 {
     int opt;
@@ -698,6 +374,13 @@ static int hasopt(int test, int argc, char *argv[], char const *optstring)
     return 0;
 }
 
+/// Returns 1 if the arg is the keyword, optionally followed by ":" and parameters.
+static int is_keyword(char const *arg, char const *keyword)
+{
+    size_t len = strlen(keyword);
+    return !strncasecmp(arg, keyword, len) && (arg[len] == '\0' || arg[len] == ':');
+}
+
 static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg);
 
 #define OPTSTRING "hVvqDc:x:z:p:a:AI:S:m:M:r:w:W:l:d:t:f:H:g:s:b:n:R:X:F:K:C:T:UG:y:E:Y:"
@@ -923,16 +606,21 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
     case 'S':
         if (!arg)
             usage(1);
-        if (strcasecmp(arg, "all") == 0)
+        if (is_keyword(arg, "all"))
             cfg->grab_mode = 1;
-        else if (strcasecmp(arg, "unknown") == 0)
+        else if (is_keyword(arg, "unknown"))
             cfg->grab_mode = 2;
-        else if (strcasecmp(arg, "known") == 0)
+        else if (is_keyword(arg, "known"))
             cfg->grab_mode = 3;
         else
             cfg->grab_mode = atobv(arg, 1);
         if (cfg->grab_mode && !cfg->demod->samp_grab)
             cfg->demod->samp_grab = samp_grab_create(SIGNAL_GRABBER_BUFFER);
+        if (cfg->demod->samp_grab) {
+            // all:riq  saves compressed
+            char *p = arg_param(arg);
+            cfg->demod->samp_grab->compress = p && strcasecmp(p, "riq") == 0;
+        }
         break;
     case 'm':
         fprintf(stderr, "sample mode option is deprecated.\n");
@@ -1007,6 +695,14 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
             cfg->report_noise = atoiv(arg_param(arg), 10); // atoi_time_default()
         else if (!strcasecmp(arg, "bits"))
             cfg->verbose_bits = 1;
+        else if (!strcasecmp(arg, "cpu")) {
+            cfg->report_cpu = 1;
+            // also for protocols already registered
+            for (void **iter = cfg->demod->r_devs.elems; iter && *iter; ++iter) {
+                r_device *r_dev = *iter;
+                r_dev->cpu_time = 1;
+            }
+        }
         else if (!strcasecmp(arg, "description"))
             cfg->report_description = 1;
         else if (!strcasecmp(arg, "newmodel"))
@@ -1092,12 +788,21 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
         else if (strncmp(arg, "influx", 6) == 0) {
             add_influx_output(cfg, arg);
         }
+        else if (strncmp(arg, "cbor", 4) == 0) {
+            add_binary_output(cfg, 0, arg_param(arg));
+        }
+        else if (strncmp(arg, "msgpack", 7) == 0) {
+            add_binary_output(cfg, 1, arg_param(arg));
+        }
         else if (strncmp(arg, "syslog", 6) == 0) {
             add_syslog_output(cfg, arg_param(arg));
         }
         else if (strncmp(optarg, "http", 4) == 0) {
             add_http_output(cfg, arg_param(optarg));
         }
+        else if (strncmp(arg, "rtl_tcp", 7) == 0) {
+            add_rtltcp_output(cfg, arg_param(arg));
+        }
         else if (strncmp(arg, "null", 4) == 0) {
             add_null_output(cfg, arg_param(arg));
         }
@@ -1151,6 +856,8 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
                 cfg->demod->auto_level = atoiv(val, 1); // arg_float_default(p + 9, "-Y autolevel: ");
             else if (kwargs_match(p, "squelch", &val))
                 cfg->demod->squelch_offset = atoiv(val, 1); // arg_float_default(p + 7, "-Y squelch: ");
+            else if (kwargs_match(p, "lowlatency", &val))
+                cfg->low_latency = atoiv(val, DEFAULT_LOW_LATENCY_MS);
             else if (kwargs_match(p, "auto", &val))
                 cfg->fsk_pulse_detect_mode = FSK_PULSE_DETECT_AUTO;
             else if (kwargs_match(p, "classic", &val))
@@ -1171,6 +878,8 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
                 cfg->demod->min_snr = arg_float(val, "-Y minsnr: ");
             else if (kwargs_match(p, "filter", &val))
                 cfg->demod->low_pass = arg_float(val, "-Y filter: ");
+            else if (kwargs_match(p, "decimate", &val))
+                cfg->demod->decimation = atouint32_metric(val, "-Y decimate: ");
             else {
                 fprintf(stderr, "Unknown pulse detector setting: %s\n", p);
                 usage(1);
@@ -1260,6 +969,107 @@ static void sighandler(int signum)
 }
 #endif
 
+/// Dump and decode a package read from a pulse data input.
+static void replay_pulse_data(r_cfg_t *cfg)
+{
+    struct dm_state *demod = cfg->demod;
+
+    for (void **iter = demod->dumper.elems; iter && *iter; ++iter) {
+        file_info_t const *dumper = *iter;
+        if (dumper->format == VCD_LOGIC) {
+            pulse_data_print_vcd(dumper->file, &demod->pulse_data, '\'');
+        } else if (dumper->format == PULSE_OOK) {
+            pulse_data_dump(dumper->file, &demod->pulse_data);
+        } else if (dumper->format == PULSE_LOG) {
+            pulse_log_write(dumper->pulse_log, &demod->pulse_data);
+        } else {
+            fprintf(stderr, "Dumper (%s) not supported on pulse data input\n", dumper->spec);
+            exit(1);
+        }
+    }
+
+    if (demod->pulse_data.fsk_f2_est) {
+        run_fsk_demods(&demod->r_devs, &demod->pulse_data);
+    }
+    else {
+        int p_events = run_ook_demods(&demod->r_devs, &demod->pulse_data);
+        if (cfg->verbosity > 2)
+            pulse_data_print(&demod->pulse_data);
+        if (demod->analyze_pulses && (cfg->grab_mode <= 1 || (cfg->grab_mode == 2 && p_events == 0) || (cfg->grab_mode == 3 && p_events > 0))) {
+            pulse_analyzer(&demod->pulse_data, PULSE_DATA_OOK);
+        }
+    }
+}
+
+/// Clear the detector and filter state, the samples before and after a jump in the input are unrelated.
+static void reset_demod_state(struct dm_state *demod)
+{
+    pulse_detect_reset(demod->pulse_detect);
+    if (demod->decimator)
+        decimator_reset(demod->decimator);
+    memset(&demod->lowpass_filter_state, 0, sizeof(demod->lowpass_filter_state));
+    // keep the rate and filter coefficients
+    demod->demod_FM_state.xr = 0;
+    demod->demod_FM_state.xi = 0;
+    demod->demod_FM_state.xf = 0;
+    demod->demod_FM_state.yf = 0;
+    pulse_data_clear(&demod->pulse_data);
+    pulse_data_clear(&demod->fsk_pulse_data);
+    demod->squelch_hold = 0;
+}
+
+/// Feed only the padded package spans of a recording to the demodulators.
+static void replay_spans(r_cfg_t *cfg, span_index_t *spans, uint8_t *buf)
+{
+    struct dm_state *demod = cfg->demod;
+    uint64_t replayed = 0;
+
+    for (unsigned i = 0; i < spans->num_spans && !cfg->exit_async; ++i) {
+        span_range_t const *span  = &spans->spans[i];
+        span_segment_t const *seg = &spans->segments[span->segment];
+        reset_demod_state(demod);
+        demod->sample_size    = seg->sample_size;
+        cfg->samp_rate        = seg->sample_rate;
+        cfg->center_frequency = seg->center_frequency;
+        cfg->input_pos        = span->start;
+
+        unsigned max_samples = DEFAULT_BUF_LENGTH / seg->sample_size;
+        for (uint64_t pos = span->start; pos < span->end && !cfg->exit_async;) {
+            unsigned n = span->end - pos < max_samples ? (unsigned)(span->end - pos) : max_samples;
+            n = span_index_read(spans, pos, buf, n);
+            if (!n)
+                break;
+            pos += n;
+            replayed += n;
+            demod->sample_file_pos = (float)pos / seg->sample_rate;
+            sdr_callback(buf, n * seg->sample_size, cfg);
+        }
+
+        // Call with cleared samples to ensure EOP detection before the next span
+        memset(buf, demod->sample_size == 2 ? 128 : 0, DEFAULT_BUF_LENGTH);
+        sdr_callback(buf, DEFAULT_BUF_LENGTH, cfg);
+    }
+    alarm(0); // cancel the watchdog timer
+
+    if (cfg->verbosity) {
+        fprintf(stderr, "Replayed %u spans, %.1f s of %.1f s recorded samples\n", spans->num_spans,
+                cfg->samp_rate ? (double)replayed / cfg->samp_rate : 0.0,
+                cfg->samp_rate ? (double)spans->total_samples / cfg->samp_rate : 0.0);
+    }
+}
+
+/// Lend grabber blocks to the SDR so grabs retain the acquisition buffers.
+static void *grab_buffer(void *ctx, uint32_t len)
+{
+    return samp_grab_get_buffer(ctx, len);
+}
+
+/// Lend shared blocks to the SDR so the rtl_tcp server fans out the acquisition buffers without a copy.
+static void *serve_buffer(void *ctx, uint32_t len)
+{
+    return iq_server_get_buffer(ctx, len);
+}
+
 static void sdr_handler(sdr_event_t *ev, void *ctx)
 {
     r_cfg_t *cfg = ctx;
@@ -1288,14 +1098,16 @@ static void sdr_handler(sdr_event_t *ev, void *ctx)
                 NULL);
     }
     if (data) {
-        for (size_t i = 0; i < cfg->output_handler.len; ++i) { // list might contain NULLs
-            data_output_print(cfg->output_handler.elems[i], data);
-        }
-        data_free(data);
+        r_event_t out = {.kind = R_EVENT_DATA, .data = data};
+        dispatch_event(cfg, &out);
     }
 
     if (ev->ev == SDR_EV_DATA) {
-        if (cfg->mgr) {
+        if (cfg->net_thread) {
+            // apply settings received over the network
+            net_thread_run_commands(cfg->net_thread);
+        }
+        else if (cfg->mgr) {
             int max_polls = 16;
             while (max_polls-- && mg_mgr_poll(cfg->mgr, 0));
         }
@@ -1340,17 +1152,29 @@ int main(int argc, char **argv) {
 
     pulse_detect_set_levels(demod->pulse_detect, demod->use_mag_est, demod->level_limit, demod->min_level, demod->min_snr, demod->detect_verbosity);
 
+    if (demod->decimation > 1) {
+        demod->decimator = decimator_create(demod->decimation);
+        if (!demod->decimator)
+            exit(1);
+        if (cfg->samp_rate % demod->decimation) {
+            fprintf(stderr, "Sample rate %u is not a multiple of the decimation %u.\n", cfg->samp_rate, demod->decimation);
+            exit(1);
+        }
+    }
+    demod->sample_rate      = cfg->samp_rate / (demod->decimator ? demod->decimation : 1);
+    demod->proc_sample_size = demod->decimator ? 4 : demod->sample_size;
+
     if (demod->am_analyze) {
         demod->am_analyze->level_limit = DB_TO_AMP(demod->level_limit);
         demod->am_analyze->frequency   = &cfg->center_frequency;
-        demod->am_analyze->samp_rate   = &cfg->samp_rate;
-        demod->am_analyze->sample_size = &demod->sample_size;
+        demod->am_analyze->samp_rate   = &demod->sample_rate;
+        demod->am_analyze->sample_size = &demod->proc_sample_size;
     }
 
     if (demod->samp_grab) {
         demod->samp_grab->frequency   = &cfg->center_frequency;
-        demod->samp_grab->samp_rate   = &cfg->samp_rate;
-        demod->samp_grab->sample_size = &demod->sample_size;
+        demod->samp_grab->samp_rate   = &demod->sample_rate;
+        demod->samp_grab->sample_size = &demod->proc_sample_size;
     }
 
     if (cfg->report_time == REPORT_TIME_DEFAULT) {
@@ -1379,6 +1203,8 @@ int main(int argc, char **argv) {
         register_all_protocols(cfg, 0); // register all defaults
     }
 
+    build_preamble_matcher(cfg);
+
     // check if we need FM demod
     for (void **iter = demod->r_devs.elems; iter && *iter; ++iter) {
         r_device *r_dev = *iter;
@@ -1415,6 +1241,13 @@ int main(int argc, char **argv) {
                 demod->r_devs.len, cfg->num_r_devices, decoders_str);
     }
 
+    // pulse data from remote receivers replaces the SDR device
+    if (cfg->dev_query && !strncmp(cfg->dev_query, "pulse", 5)
+            && (!cfg->dev_query[5] || cfg->dev_query[5] == ':' || cfg->dev_query[5] == ',')
+            && !cfg->test_data && !cfg->in_files.len) {
+        add_pulse_input(cfg, arg_param(cfg->dev_query));
+    }
+
     char const **well_known = well_known_output_fields(cfg);
     start_outputs(cfg, well_known);
     free(well_known);
@@ -1437,6 +1270,19 @@ int main(int argc, char **argv) {
 
         if (*cfg->test_data == '@') {
             fprintf(stderr, "Reading test data from \"%s\"\n", &cfg->test_data[1]);
+            // decode files on all CPUs, unless decoder traces need the lines one by one
+            int dev_verbose = 0;
+            for (void **iter = demod->r_devs.elems; iter && *iter; ++iter) {
+                r_device *r_dev = *iter;
+                dev_verbose |= r_dev->verbose;
+            }
+            if (!cfg->verbosity && !dev_verbose) {
+                r = bulk_decode_file(cfg, &cfg->test_data[1], 0);
+                if (r >= 0) {
+                    r_free_cfg(cfg);
+                    exit(!r);
+                }
+            }
             fp = fopen(&cfg->test_data[1], "r");
         } else {
             fprintf(stderr, "Reading test data from stdin\n");
@@ -1551,6 +1397,18 @@ int main(int argc, char **argv) {
             cfg->in_filename = *iter;
 
             parse_file_info(cfg->in_filename, &demod->load_info);
+
+            // special case for span index file-inputs, only the package regions are replayed
+            if (demod->load_info.format == SPAN_INDEX) {
+                span_index_t *spans = span_index_load(demod->load_info.path);
+                if (!spans)
+                    break;
+                fprintf(stderr, "Test mode active. Replaying spans from: %s\n", cfg->in_filename);  // Essential information (not quiet)
+                replay_spans(cfg, spans, test_mode_buf);
+                span_index_free(spans);
+                continue;
+            }
+
             if (strcmp(demod->load_info.path, "-") == 0) { /* read samples from stdin */
                 in_file = stdin;
                 cfg->in_filename = "<stdin>";
@@ -1562,6 +1420,29 @@ int main(int argc, char **argv) {
                 }
             }
             fprintf(stderr, "Test mode active. Reading samples from file: %s\n", cfg->in_filename);  // Essential information (not quiet)
+            iq_decoder_t *iq_dec = NULL;
+            if (demod->load_info.codec == CODEC_RIQ) {
+                iq_dec = iq_decoder_open(in_file);
+                if (!iq_dec) {
+                    fprintf(stderr, "Compressed IQ header invalid: %s\n", cfg->in_filename);
+                    if (in_file != stdin)
+                        fclose(in_file = stdin);
+                    break;
+                }
+                demod->load_info.format = iq_dec->sample_size == 4 ? CS16_IQ : CU8_IQ;
+                if (iq_dec->sample_rate)
+                    cfg->samp_rate = iq_dec->sample_rate;
+                if (demod->decimator && cfg->samp_rate % demod->decimation) {
+                    fprintf(stderr, "Sample rate %u is not a multiple of the decimation %u: %s\n", cfg->samp_rate, demod->decimation, cfg->in_filename);
+                    iq_decoder_close(iq_dec);
+                    iq_dec = NULL;
+                    if (in_file != stdin)
+                        fclose(in_file = stdin);
+                    break;
+                }
+                if (iq_dec->center_frequency)
+                    cfg->center_frequency = iq_dec->center_frequency;
+            }
             if (demod->load_info.format == CU8_IQ
                     || demod->load_info.format == S16_AM
                     || demod->load_info.format == S16_FM) {
@@ -1569,7 +1450,8 @@ int main(int argc, char **argv) {
             } else if (demod->load_info.format == CS16_IQ
                     || demod->load_info.format == CF32_IQ) {
                 demod->sample_size = sizeof(int16_t) * 2; // CF32, CS16
-            } else if (demod->load_info.format == PULSE_OOK) {
+            } else if (demod->load_info.format == PULSE_OOK
+                    || demod->load_info.format == PULSE_LOG) {
                 // ignore
             } else {
                 fprintf(stderr, "Input format invalid: %s\n", file_info_string(&demod->load_info));
@@ -1583,33 +1465,13 @@ int main(int argc, char **argv) {
             // special case for pulse data file-inputs
             if (demod->load_info.format == PULSE_OOK) {
                 while (!cfg->exit_async) {
+                    // pulse data is not decimated
+                    demod->sample_rate = cfg->samp_rate;
                     pulse_data_load(in_file, &demod->pulse_data, cfg->samp_rate);
                     if (!demod->pulse_data.num_pulses)
                         break;
 
-                    for (void **iter2 = demod->dumper.elems; iter2 && *iter2; ++iter2) {
-                        file_info_t const *dumper = *iter2;
-                        if (dumper->format == VCD_LOGIC) {
-                            pulse_data_print_vcd(dumper->file, &demod->pulse_data, '\'');
-                        } else if (dumper->format == PULSE_OOK) {
-                            pulse_data_dump(dumper->file, &demod->pulse_data);
-                        } else {
-                            fprintf(stderr, "Dumper (%s) not supported on OOK input\n", dumper->spec);
-                            exit(1);
-                        }
-                    }
-
-                    if (demod->pulse_data.fsk_f2_est) {
-                        run_fsk_demods(&demod->r_devs, &demod->pulse_data);
-                    }
-                    else {
-                        int p_events = run_ook_demods(&demod->r_devs, &demod->pulse_data);
-                        if (cfg->verbosity > 2)
-                            pulse_data_print(&demod->pulse_data);
-                        if (demod->analyze_pulses && (cfg->grab_mode <= 1 || (cfg->grab_mode == 2 && p_events == 0) || (cfg->grab_mode == 3 && p_events > 0))) {
-                            pulse_analyzer(&demod->pulse_data, PULSE_DATA_OOK);
-                        }
-                    }
+                    replay_pulse_data(cfg);
                 }
 
                 if (in_file != stdin)
@@ -1618,11 +1480,47 @@ int main(int argc, char **argv) {
                 continue;
             }
 
+            // special case for binary pulse log file-inputs, replayed from memory
+            if (demod->load_info.format == PULSE_LOG) {
+                if (in_file != stdin)
+                    fclose(in_file = stdin);
+
+                pulse_log_reader_t *pulse_log = pulse_log_open(demod->load_info.path);
+                if (!pulse_log)
+                    break;
+                size_t pos = pulse_log->start;
+                int ret = 0;
+                while (!cfg->exit_async && (ret = pulse_log_read(pulse_log, &pos, &demod->pulse_data)) == 1) {
+                    demod->sample_rate = demod->pulse_data.sample_rate;
+                    replay_pulse_data(cfg);
+                }
+                if (ret < 0)
+                    fprintf(stderr, "Pulse log corrupt at %zu: %s\n", pos, cfg->in_filename);
+                pulse_log_close(pulse_log);
+
+                continue;
+            }
+
             // default case for file-inputs
             int n_blocks = 0;
             unsigned long n_read;
+            unsigned char *read_buf;
+            uint8_t const *dec_buf = NULL;
+            unsigned long dec_len = 0, dec_pos = 0;
             do {
-                if (demod->load_info.format == CF32_IQ) {
+                if (iq_dec) {
+                    // slice the decoded blocks to the usual buffer length
+                    if (dec_pos >= dec_len) {
+                        long r = iq_decoder_read(iq_dec, &dec_buf);
+                        if (r < 0)
+                            fprintf(stderr, "Compressed IQ corrupt or truncated: %s\n", cfg->in_filename);
+                        dec_len = r > 0 ? r : 0;
+                        dec_pos = 0;
+                    }
+                    read_buf = (unsigned char *)dec_buf + dec_pos;
+                    n_read = dec_len - dec_pos < DEFAULT_BUF_LENGTH ? dec_len - dec_pos : DEFAULT_BUF_LENGTH;
+                    dec_pos += n_read;
+                } else if (demod->load_info.format == CF32_IQ) {
                     n_read = fread(test_mode_float_buf, sizeof(float), DEFAULT_BUF_LENGTH / 2, in_file);
                     // clamp float to [-1,1] and scale to Q0.15
                     for (unsigned long n = 0; n < n_read; n++) {
@@ -1634,13 +1532,22 @@ int main(int argc, char **argv) {
                         ((int16_t *)test_mode_buf)[n] = s_tmp;
                     }
                     n_read *= 2; // convert to byte count
+                    read_buf = test_mode_buf;
                 } else {
-                    n_read = fread(test_mode_buf, 1, DEFAULT_BUF_LENGTH, in_file);
+                    // read straight into a grabber or server block if grabbing or serving
+                    read_buf = NULL;
+                    if (demod->samp_grab)
+                        read_buf = samp_grab_get_buffer(demod->samp_grab, DEFAULT_BUF_LENGTH);
+                    else if (cfg->iq_server && demod->sample_size == 2)
+                        read_buf = iq_server_get_buffer(cfg->iq_server, DEFAULT_BUF_LENGTH);
+                    if (!read_buf)
+                        read_buf = test_mode_buf;
+                    n_read = fread(read_buf, 1, DEFAULT_BUF_LENGTH, in_file);
                 }
                 if (n_read == 0) break;  // sdr_callback() will Segmentation Fault with len=0
                 demod->sample_file_pos = ((float)n_blocks * DEFAULT_BUF_LENGTH + n_read) / cfg->samp_rate / demod->sample_size;
                 n_blocks++; // this assumes n_read == DEFAULT_BUF_LENGTH
-                sdr_callback(test_mode_buf, n_read, cfg);
+                sdr_callback(read_buf, n_read, cfg);
             } while (n_read != 0 && !cfg->exit_async);
 
             // Call a last time with cleared samples to ensure EOP detection
@@ -1663,6 +1570,7 @@ int main(int argc, char **argv) {
             if (cfg->verbosity) {
                 fprintf(stderr, "Test mode file issued %d packets\n", n_blocks);
             }
+            iq_decoder_close(iq_dec);
 
             if (in_file != stdin)
                 fclose(in_file = stdin);
@@ -1680,15 +1588,6 @@ int main(int argc, char **argv) {
         exit(1);
     }
 
-    // Normal case, no test data, no in files
-    r = sdr_open(&cfg->dev, cfg->dev_query, cfg->verbosity);
-    if (r < 0) {
-        exit(2);
-    }
-    cfg->dev_info = sdr_get_dev_info(cfg->dev);
-    demod->sample_size = sdr_get_sample_size(cfg->dev);
-    //demod->sample_signed = sdr_get_sample_signed(cfg->dev);
-
 #ifndef _WIN32
     sigact.sa_handler = sighandler;
     sigemptyset(&sigact.sa_mask);
@@ -1702,6 +1601,73 @@ int main(int argc, char **argv) {
 #else
     SetConsoleCtrlHandler((PHANDLER_ROUTINE)console_handler, TRUE);
 #endif
+
+    // Pulse server case, decode the packets of remote receivers
+    if (cfg->pulse_server) {
+        if (cfg->duration > 0) {
+            time(&cfg->stop_time);
+            cfg->stop_time += cfg->duration;
+        }
+
+        // network I/O and the outputs run on their own thread if available
+        cfg->net_thread = net_thread_start(cfg);
+
+        while (!cfg->exit_async) {
+            if (cfg->net_thread) {
+                // apply settings received over the network
+                net_thread_run_commands(cfg->net_thread);
+            }
+            else if (cfg->mgr) {
+                int max_polls = 16;
+                while (max_polls-- && mg_mgr_poll(cfg->mgr, 0));
+            }
+
+            pulse_packet_t const *packet = pulse_server_read(cfg->pulse_server, 100);
+            if (packet) {
+                // pulse data is not decimated
+                demod->pulse_data  = packet->data;
+                demod->sample_rate = packet->data.sample_rate;
+                demod->now         = packet->received;
+                cfg->pulse_source  = packet->source;
+                replay_pulse_data(cfg);
+                cfg->pulse_source  = NULL;
+            }
+
+            time_t rawtime;
+            time(&rawtime);
+            if (cfg->duration > 0 && rawtime >= cfg->stop_time) {
+                cfg->exit_async = 1;
+                fprintf(stderr, "Time expired, exiting!\n");
+            }
+            if (cfg->stats_now || (cfg->report_stats && cfg->stats_interval && rawtime >= cfg->stats_time)) {
+                report_occurred_handler(cfg, create_report_data(cfg, cfg->stats_now ? 3 : cfg->report_stats));
+                flush_report_data(cfg);
+                if (rawtime >= cfg->stats_time)
+                    cfg->stats_time += cfg->stats_interval;
+                if (cfg->stats_now)
+                    cfg->stats_now--;
+            }
+        }
+
+        if (cfg->report_stats > 0) {
+            report_occurred_handler(cfg, create_report_data(cfg, cfg->report_stats));
+            flush_report_data(cfg);
+        }
+
+        r = cfg->exit_code >= 0 ? cfg->exit_code : 0;
+        r_free_cfg(cfg);
+        return r;
+    }
+
+    // Normal case, no test data, no in files
+    r = sdr_open(&cfg->dev, cfg->dev_query, cfg->verbosity);
+    if (r < 0) {
+        exit(2);
+    }
+    cfg->dev_info = sdr_get_dev_info(cfg->dev);
+    demod->sample_size = sdr_get_sample_size(cfg->dev);
+    //demod->sample_signed = sdr_get_sample_signed(cfg->dev);
+
     /* Set the sample rate */
     r = sdr_set_sample_rate(cfg->dev, cfg->samp_rate, 1); // always verbose
 
@@ -1740,12 +1706,34 @@ int main(int argc, char **argv) {
     cfg->center_frequency = cfg->frequency[cfg->frequency_index];
     r = sdr_set_center_freq(cfg->dev, cfg->center_frequency, 1); // always verbose
 
+    uint32_t buf_num = DEFAULT_ASYNC_BUF_NUMBER;
+    if (cfg->low_latency > 0) {
+        // short transfers so packages are detected soon after they ended, more of them to avoid overruns
+        uint64_t block_size = (uint64_t)cfg->samp_rate * cfg->low_latency / 1000 * demod->sample_size;
+        block_size = (block_size + MINIMAL_BUF_LENGTH - 1) / MINIMAL_BUF_LENGTH * MINIMAL_BUF_LENGTH; // librtlsdr needs multiples of 512
+        if (block_size > DEFAULT_BUF_LENGTH)
+            block_size = DEFAULT_BUF_LENGTH;
+        cfg->out_block_size = (uint32_t)block_size;
+        buf_num = LOW_LATENCY_BUF_NUMBER;
+        fprintf(stderr, "Low latency mode, using %u transfers of %u bytes (%.1f ms).\n",
+                buf_num, cfg->out_block_size, cfg->out_block_size * 1000.0 / demod->sample_size / cfg->samp_rate);
+    }
+
+        // network I/O and the outputs run on their own thread if available
+        cfg->net_thread = net_thread_start(cfg);
+
+        // only one consumer can retain the acquisition buffers, the grabber takes precedence
+        if (demod->samp_grab)
+            sdr_set_buffer_fn(cfg->dev, grab_buffer, demod->samp_grab);
+        else if (cfg->iq_server && demod->sample_size == 2)
+            sdr_set_buffer_fn(cfg->dev, serve_buffer, cfg->iq_server);
+
         time(&cfg->hop_start_time);
         signal(SIGALRM, sighandler);
         alarm(3); // require callback to run every 3 second, abort otherwise
 
         r = sdr_start(cfg->dev, sdr_handler, (void *)cfg,
-                DEFAULT_ASYNC_BUF_NUMBER, cfg->out_block_size);
+                buf_num, cfg->out_block_size);
         if (r < 0) {
             fprintf(stderr, "WARNING: async read failed (%i).\n", r);
         }
@@ -1753,7 +1741,7 @@ int main(int argc, char **argv) {
         alarm(0); // cancel the watchdog timer
 
     if (cfg->report_stats > 0) {
-        event_occurred_handler(cfg, create_report_data(cfg, cfg->report_stats));
+        report_occurred_handler(cfg, create_report_data(cfg, cfg->report_stats));
         flush_report_data(cfg);
     }
 
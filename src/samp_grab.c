@@ -25,8 +25,32 @@
 #endif
 
 #include "samp_grab.h"
+#include "iq_codec.h"
+#include "compat_pthread.h"
 #include "fatal.h"
 
+#define SAMP_GRAB_MIN_BLOCK (64 * 1024) /* bytes */
+
+typedef struct samp_grab_seg {
+    samp_block_t *block;
+    uint32_t off;
+    uint32_t len;
+} samp_grab_seg_t;
+
+/// A grab to write, holds a reference on each block.
+struct samp_grab_job {
+#ifdef THREADS
+    pthread_t thread;
+#endif
+    char f_name[64];
+    int compress;
+    int sample_size;
+    uint32_t sample_rate;
+    uint32_t center_frequency;
+    unsigned num_segs;
+    samp_grab_seg_t segs[];
+};
+
 samp_grab_t *samp_grab_create(unsigned size)
 {
     samp_grab_t *g;
@@ -39,69 +63,246 @@ samp_grab_t *samp_grab_create(unsigned size)
     g->sg_size = size;
     g->sg_counter = 1;
 
-    g->sg_buf = malloc(size);
-    if (!g->sg_buf) {
-        WARN_MALLOC("samp_grab_create()");
-        free(g);
-        return NULL; // NOTE: returns NULL on alloc failure.
+    return g;
+}
+
+/// Allocate the block pool, the block size is the first buffer length.
+static int samp_grab_init_pool(samp_grab_t *g, uint32_t len)
+{
+    uint32_t block_size = len > SAMP_GRAB_MIN_BLOCK ? len : SAMP_GRAB_MIN_BLOCK;
+    // the window, a pending write of at most the window, a lent block, and a spare
+    unsigned window_blocks = g->sg_size / block_size + 2;
+    unsigned num_blocks = 2 * window_blocks + 2;
+
+    g->blocks = calloc(num_blocks, sizeof(*g->blocks));
+    if (!g->blocks) {
+        WARN_CALLOC("samp_grab_init_pool()");
+        return -1; // NOTE: returns error on alloc failure.
+    }
+    g->window = calloc(num_blocks, sizeof(*g->window));
+    if (!g->window) {
+        WARN_CALLOC("samp_grab_init_pool()");
+        free(g->blocks);
+        g->blocks = NULL;
+        return -1; // NOTE: returns error on alloc failure.
+    }
+    g->slab = malloc((size_t)num_blocks * block_size);
+    if (!g->slab) {
+        WARN_MALLOC("samp_grab_init_pool()");
+        free(g->window);
+        g->window = NULL;
+        free(g->blocks);
+        g->blocks = NULL;
+        return -1; // NOTE: returns error on alloc failure.
     }
+    for (unsigned i = 0; i < num_blocks; ++i) {
+        g->blocks[i].data = &g->slab[(size_t)i * block_size];
+    }
+    g->block_size = block_size;
+    g->num_blocks = num_blocks;
 
-    return g;
+    return 0;
+}
+
+static void samp_block_release(samp_block_t *b)
+{
+    atomic_sub_fetch_seq(&b->refs, 1);
+}
+
+/// Take a free block, or recycle the oldest window block if no write holds it.
+static samp_block_t *samp_grab_take_block(samp_grab_t *g)
+{
+    for (unsigned i = 0; i < g->num_blocks; ++i) {
+        unsigned k = (g->next_free + i) % g->num_blocks;
+        samp_block_t *b = &g->blocks[k];
+        // only this thread takes blocks, a writer only releases them
+        if (atomic_load_acquire(&b->refs) == 0) {
+            atomic_store_release(&b->refs, 1);
+            b->len = 0;
+            g->next_free = (k + 1) % g->num_blocks;
+            return b;
+        }
+    }
+
+    if (g->window_count) {
+        samp_block_t *b = g->window[g->window_head];
+        if (atomic_load_acquire(&b->refs) == 1) {
+            g->window_head = (g->window_head + 1) % g->num_blocks;
+            g->window_count--;
+            g->sg_len -= b->len;
+            b->len = 0;
+            g->overruns++;
+            return b;
+        }
+    }
+
+    return NULL;
+}
+
+/// Drop the oldest blocks not needed to cover the window size.
+static void samp_grab_trim(samp_grab_t *g)
+{
+    while (g->window_count > 1 && g->sg_len - g->window[g->window_head]->len >= g->sg_size) {
+        samp_block_t *b = g->window[g->window_head];
+        g->window_head = (g->window_head + 1) % g->num_blocks;
+        g->window_count--;
+        g->sg_len -= b->len;
+        samp_block_release(b);
+    }
+}
+
+/// Append a block to the window, the window takes over the reference.
+static void samp_grab_append(samp_grab_t *g, samp_block_t *b)
+{
+    g->window[(g->window_head + g->window_count) % g->num_blocks] = b;
+    g->window_count++;
+    g->sg_len += b->len;
+}
+
+static void samp_grab_job_run(struct samp_grab_job *job)
+{
+    FILE *fp = fopen(job->f_name, "wb");
+    if (!fp) {
+        fprintf(stderr, "Failed to open %s\n", job->f_name);
+    }
+    iq_encoder_t *enc = fp && job->compress ? iq_encoder_create(fp, job->sample_size) : NULL;
+
+    for (unsigned i = 0; i < job->num_segs; ++i) {
+        samp_grab_seg_t *seg = &job->segs[i];
+        if (enc)
+            iq_encoder_write(enc, &seg->block->data[seg->off], seg->len, job->sample_rate, job->center_frequency);
+        else if (fp)
+            fwrite(&seg->block->data[seg->off], 1, seg->len, fp);
+        samp_block_release(seg->block);
+    }
+
+    iq_encoder_close(enc);
+    if (fp)
+        fclose(fp);
+}
+
+#ifdef THREADS
+static THREAD_RETURN THREAD_CALL samp_grab_job_thread(void *arg)
+{
+    samp_grab_job_run(arg);
+    return (THREAD_RETURN)0;
+}
+#endif
+
+/// Wait for the pending write to finish.
+static void samp_grab_wait(samp_grab_t *g)
+{
+    if (!g->job)
+        return;
+#ifdef THREADS
+    pthread_join(g->job->thread, NULL);
+#endif
+    free(g->job);
+    g->job = NULL;
 }
 
 void samp_grab_free(samp_grab_t *g)
 {
-    if (g->sg_buf)
-        free(g->sg_buf);
+    if (!g)
+        return;
+
+    samp_grab_wait(g);
+    free(g->slab);
+    free(g->window);
+    free(g->blocks);
     free(g);
 }
 
-void samp_grab_push(samp_grab_t *g, unsigned char *iq_buf, uint32_t len)
+unsigned char *samp_grab_get_buffer(samp_grab_t *g, uint32_t len)
 {
-    //fprintf(stderr, "sg_index %d + len %d (size %d ", g->sg_index, len, g->sg_len);
+    if (!g->blocks && samp_grab_init_pool(g, len))
+        return NULL;
+
+    // the previous buffer was not pushed
+    if (g->lent) {
+        samp_block_release(g->lent);
+        g->lent = NULL;
+    }
 
-    g->sg_len += len;
-    if (g->sg_len > g->sg_size)
-        g->sg_len = g->sg_size;
+    if (len > g->block_size)
+        return NULL;
 
-    //fprintf(stderr, "-> %d)\n", g->sg_len);
+    g->lent = samp_grab_take_block(g);
+    return g->lent ? g->lent->data : NULL;
+}
 
+void samp_grab_push(samp_grab_t *g, unsigned char *iq_buf, uint32_t len)
+{
+    if (!g->blocks && samp_grab_init_pool(g, len))
+        return;
+
+    samp_block_t *lent = g->lent;
+    g->lent = NULL;
+    if (lent && lent->data == iq_buf && len <= g->block_size) {
+        // retain the lent block, no copy
+        lent->len = len;
+        samp_grab_append(g, lent);
+        samp_grab_trim(g);
+        g->bytes_retained += len;
+        return;
+    }
+    if (lent)
+        samp_block_release(lent);
+
+    g->bytes_copied += len;
     while (len) {
+        samp_block_t *b = g->window_count ? g->window[(g->window_head + g->window_count - 1) % g->num_blocks] : NULL;
+        if (!b || b->len >= g->block_size) {
+            b = samp_grab_take_block(g);
+            if (!b) {
+                g->overruns++;
+                break;
+            }
+            samp_grab_append(g, b);
+        }
+        // appending past the length is safe, a pending write only reads up to it
         unsigned chunk_len = len;
-        if (g->sg_index + chunk_len > g->sg_size)
-            chunk_len = g->sg_size - g->sg_index;
+        if (chunk_len > g->block_size - b->len)
+            chunk_len = g->block_size - b->len;
 
-        memcpy(&g->sg_buf[g->sg_index], iq_buf, chunk_len);
+        memcpy(&b->data[b->len], iq_buf, chunk_len);
+        b->len += chunk_len;
+        g->sg_len += chunk_len;
         iq_buf += chunk_len;
         len -= chunk_len;
-        g->sg_index += chunk_len;
-        if (g->sg_index >= g->sg_size)
-            g->sg_index = 0;
     }
+    samp_grab_trim(g);
 }
 
 void samp_grab_reset(samp_grab_t *g)
 {
+    while (g->window_count) {
+        samp_block_release(g->window[g->window_head]);
+        g->window_head = (g->window_head + 1) % g->num_blocks;
+        g->window_count--;
+    }
+    g->window_head = 0;
     g->sg_len = 0;
-    g->sg_index = 0;
 }
 
 #define BLOCK_SIZE (128 * 1024) /* bytes */
 
 void samp_grab_write(samp_grab_t *g, unsigned grab_len, unsigned grab_end)
 {
-    if (!g->sg_buf)
+    if (!g->blocks)
         return;
 
-    unsigned end_pos, start_pos, signal_bsize, wlen, wrest;
+    // one write at a time, this also bounds the blocks held
+    samp_grab_wait(g);
+
+    unsigned end_pos, start_pos, signal_bsize;
     char f_name[64] = {0};
-    FILE *fp;
 
     char *format = *g->sample_size == 2 ? "cu8" : "cs16";
     double freq_mhz = *g->frequency / 1000000.0;
     double rate_khz = *g->samp_rate / 1000.0;
     while (1) {
-        sprintf(f_name, "g%03u_%gM_%gk.%s", g->sg_counter, freq_mhz, rate_khz, format);
+        sprintf(f_name, "g%03u_%gM_%gk.%s%s", g->sg_counter, freq_mhz, rate_khz, format, g->compress ? ".riq" : "");
         g->sg_counter++;
         if (access(f_name, F_OK) == -1) {
             break;
@@ -116,42 +317,149 @@ void samp_grab_write(samp_grab_t *g, unsigned grab_len, unsigned grab_end)
         signal_bsize = g->sg_len;
     }
 
-    // relative end in bytes from current sg_index down
+    // relative end in bytes from the newest sample down, then absolute in the window
     end_pos = *g->sample_size * grab_end;
-    if (g->sg_index >= end_pos)
-        end_pos = g->sg_index - end_pos;
-    else
-        end_pos = g->sg_size - end_pos + g->sg_index;
-    // end_pos is now absolute in sg_buf
-
-    if (end_pos >= signal_bsize)
-        start_pos = end_pos - signal_bsize;
-    else
-        start_pos = g->sg_size - signal_bsize + end_pos;
-
-    //fprintf(stderr, "signal_bsize = %d  -      sg_index = %d\n", signal_bsize, g->sg_index);
-    //fprintf(stderr, "start_pos    = %d  -   buffer_size = %d\n", start_pos, g->sg_size);
-
-    fprintf(stderr, "*** Saving signal to file %s (%u samples, %u bytes)\n", f_name, grab_len, signal_bsize);
-    fp = fopen(f_name, "wb");
-    if (!fp) {
-        fprintf(stderr, "Failed to open %s\n", f_name);
+    end_pos = end_pos < g->sg_len ? g->sg_len - end_pos : 0;
+    start_pos = end_pos > signal_bsize ? end_pos - signal_bsize : 0;
+
+    struct samp_grab_job *job = calloc(1, sizeof(*job) + g->window_count * sizeof(job->segs[0]));
+    if (!job) {
+        WARN_CALLOC("samp_grab_write()");
         return;
     }
+    memcpy(job->f_name, f_name, sizeof(job->f_name));
+    job->compress         = g->compress;
+    job->sample_size      = *g->sample_size;
+    job->sample_rate      = *g->samp_rate;
+    job->center_frequency = *g->frequency;
 
-    wlen = signal_bsize;
-    wrest = 0;
-    if (start_pos + signal_bsize > g->sg_size) {
-        wlen  = g->sg_size - start_pos;
-        wrest = signal_bsize - wlen;
+    // reference the blocks overlapping the grab
+    unsigned pos = 0;
+    for (unsigned i = 0; i < g->window_count && pos < end_pos; ++i) {
+        samp_block_t *b = g->window[(g->window_head + i) % g->num_blocks];
+        unsigned b_start = pos;
+        unsigned b_end = pos + b->len;
+        pos = b_end;
+        if (b_end <= start_pos)
+            continue;
+        unsigned s = b_start > start_pos ? b_start : start_pos;
+        unsigned e = b_end < end_pos ? b_end : end_pos;
+        atomic_add_fetch_seq(&b->refs, 1);
+        job->segs[job->num_segs].block = b;
+        job->segs[job->num_segs].off = s - b_start;
+        job->segs[job->num_segs].len = e - s;
+        job->num_segs++;
     }
-    //fprintf(stderr, "*** Writing data from %d, len %d\n", start_pos, wlen);
-    fwrite(&g->sg_buf[start_pos], 1, wlen, fp);
 
-    if (wrest) {
-        //fprintf(stderr, "*** Writing data from %d, len %d\n", 0, wrest);
-        fwrite(&g->sg_buf[0], 1, wrest, fp);
+    fprintf(stderr, "*** Saving signal to file %s (%u samples, %u bytes)\n", f_name, grab_len, end_pos - start_pos);
+
+#ifdef THREADS
+    if (!pthread_create(&job->thread, NULL, samp_grab_job_thread, job)) {
+        g->job = job;
+        return;
     }
+#endif
+    samp_grab_job_run(job);
+    free(job);
+}
 
+#ifdef _TEST
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %s:%d: %s <> %s\n", __FILE__, __LINE__, #a, #b); \
+        } \
+    } while (0)
+
+static unsigned char test_sample(unsigned i)
+{
+    return (unsigned char)(i * 7 + i / 251);
+}
+
+/// Check the grab file against the sample pattern, ending at sample @p end.
+static int check_grab(char const *f_name, unsigned end, unsigned len)
+{
+    FILE *fp = fopen(f_name, "rb");
+    if (!fp)
+        return 0;
+    unsigned n = 0;
+    int ok = 1;
+    int c;
+    while ((c = fgetc(fp)) != EOF) {
+        if ((unsigned char)c != test_sample(end - len + n))
+            ok = 0;
+        n++;
+    }
     fclose(fp);
+    remove(f_name);
+    return ok && n == len;
+}
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+
+    uint32_t frequency = 1000000;
+    uint32_t samp_rate = 1000;
+    int sample_size = 2;
+    unsigned const buf_len = 80000;
+    unsigned char *buf = malloc(buf_len);
+    if (!buf)
+        FATAL_MALLOC("main()");
+
+    fprintf(stderr, "samp_grab:: test\n");
+
+    for (int lend = 0; lend < 2; ++lend) {
+        samp_grab_t *g = samp_grab_create(6 * BLOCK_SIZE);
+        if (!g)
+            FATAL_CALLOC("main()");
+        g->frequency   = &frequency;
+        g->samp_rate   = &samp_rate;
+        g->sample_size = &sample_size;
+        g->sg_counter  = 900;
+
+        unsigned total = 0;
+        for (int k = 0; k < 20; ++k) {
+            unsigned char *iq_buf = lend ? samp_grab_get_buffer(g, buf_len) : buf;
+            ASSERT_EQUALS(iq_buf != NULL, 1);
+            if (!iq_buf)
+                break;
+            for (unsigned i = 0; i < buf_len; ++i)
+                iq_buf[i] = test_sample(total + i);
+            samp_grab_push(g, iq_buf, buf_len);
+            total += buf_len;
+        }
+        ASSERT_EQUALS(g->sg_len >= g->sg_size, 1);
+        ASSERT_EQUALS(lend ? g->bytes_copied : g->bytes_retained, 0);
+
+        // a grab across block boundaries, ending 1000 samples before the newest
+        samp_grab_write(g, 100000, 1000);
+        // keep pushing while the write is pending
+        for (int k = 0; k < 10; ++k) {
+            unsigned char *iq_buf = lend ? samp_grab_get_buffer(g, buf_len) : buf;
+            ASSERT_EQUALS(iq_buf != NULL, 1);
+            if (!iq_buf)
+                break;
+            memset(iq_buf, 0, buf_len);
+            samp_grab_push(g, iq_buf, buf_len);
+        }
+        samp_grab_wait(g);
+        ASSERT_EQUALS(check_grab("g900_1M_1k.cu8", total - 2000, 2 * BLOCK_SIZE) != 0, 1);
+
+        ASSERT_EQUALS(g->overruns, 0);
+        samp_grab_reset(g);
+        ASSERT_EQUALS(g->sg_len, 0);
+        for (unsigned i = 0; i < g->num_blocks; ++i)
+            ASSERT_EQUALS(g->blocks[i].refs, 0);
+        samp_grab_free(g);
+    }
+
+    free(buf);
+    fprintf(stderr, "samp_grab:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+    return failed;
 }
+#endif /* _TEST */
@@ -19,6 +19,7 @@
 #include "sdr.h"
 #include "r_util.h"
 #include "optparse.h"
+#include "compat_time.h"
 #include "fatal.h"
 #ifdef RTLSDR
 #include <rtl-sdr.h>
@@ -72,12 +73,38 @@ int __attribute__((weak)) rtlsdr_set_bias_tee(rtlsdr_dev_t *dev, int on);
     #define closesocket(x)  close(x)
 #endif
 
+#include "compat_pthread.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <signal.h>
+#endif
+
 #define GAIN_STR_MAX_SIZE 64
 
 struct sdr_dev {
     SOCKET rtl_tcp;
     uint32_t rtl_tcp_freq; ///< last known center frequency, rtl_tcp only.
     uint32_t rtl_tcp_rate; ///< last known sample rate, rtl_tcp only.
+    int rtl_tcp_rcvbuf; ///< requested socket receive buffer, 0 for the system default.
+    unsigned rtl_tcp_buffers; ///< requested ring size, 0 for the default.
+    sdr_stats_t rtl_tcp_stats; ///< guarded by rtl_tcp_lock with a reader thread.
+    uint64_t rtl_tcp_meas_nsec; ///< start of the missing bytes estimate.
+    uint64_t rtl_tcp_meas_bytes; ///< received since the start of the estimate.
+    uint32_t rtl_tcp_meas_rate; ///< sample rate of the estimate.
+    int64_t rtl_tcp_meas_base; ///< missing bytes before the estimate was restarted.
+    int64_t rtl_tcp_gap_mark; ///< missing bytes at the last reported gap.
+#ifdef THREADS
+    pthread_t rtl_tcp_thread;
+    pthread_mutex_t rtl_tcp_lock;
+    pthread_cond_t rtl_tcp_cond; ///< signaled on a new buffer, end of stream, and read timeouts
+    uint8_t *rtl_tcp_ring; ///< buffers of the reader thread
+    uint32_t *rtl_tcp_lens;
+    uint8_t *rtl_tcp_spare; ///< read into and dropped with all buffers waiting
+    unsigned rtl_tcp_head; ///< next buffer to process
+    unsigned rtl_tcp_stop;
+    unsigned rtl_tcp_eof;
+#endif
 
 #ifdef SOAPYSDR
     SoapySDRDevice *soapy_dev;
@@ -97,6 +124,8 @@ struct sdr_dev {
     int polling;
     void *buffer;
     size_t buffer_size;
+    sdr_buffer_fn_t buffer_fn;
+    void *buffer_ctx;
 
     int sample_size;
     int sample_signed;
@@ -169,7 +198,6 @@ struct rtl_tcp_info {
 
 static int rtltcp_open(sdr_dev_t **out_dev, char const *dev_query, int verbose)
 {
-    UNUSED(verbose);
     char *host = "localhost";
     char *port = "1234";
     char hostport[280]; // 253 chars DNS name plus extra chars
@@ -179,7 +207,25 @@ static int rtltcp_open(sdr_dev_t **out_dev, char const *dev_query, int verbose)
     if (param)
         strncpy(hostport, param, sizeof(hostport) - 1);
     hostport[sizeof(hostport) - 1] = '\0';
-    hostport_param(hostport, &host, &port);
+    char *opts = hostport_param(hostport, &host, &port);
+
+    int rcvbuf       = 0;
+    unsigned buffers = 0;
+    char *key, *val;
+    while (getkwargs(&opts, &key, &val)) {
+        key = remove_ws(key);
+        val = trim_ws(val);
+        if (!key || !*key)
+            continue;
+        else if (!strcasecmp(key, "rcvbuf"))
+            rcvbuf = (int)atouint32_metric(val, "rcvbuf= ");
+        else if (!strcasecmp(key, "buffers"))
+            buffers = atouint32_metric(val, "buffers= ");
+        else {
+            fprintf(stderr, "Invalid key \"%s\" option.\n", key);
+            return -1;
+        }
+    }
 
     fprintf(stderr, "rtl_tcp input from %s port %s\n", host, port);
 
@@ -211,6 +257,9 @@ static int rtltcp_open(sdr_dev_t **out_dev, char const *dev_query, int verbose)
     for (res = res0; res; res = res->ai_next) {
         sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
         if (sock >= 0) {
+            // the receive buffer needs to be set before connecting to get a matching TCP window
+            if (rcvbuf && setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (char const *)&rcvbuf, sizeof(rcvbuf)) < 0)
+                perror("rtl_tcp SO_RCVBUF");
             ret = connect(sock, res->ai_addr, res->ai_addrlen);
             if (ret == -1) {
                 perror("connect");
@@ -257,9 +306,23 @@ static int rtltcp_open(sdr_dev_t **out_dev, char const *dev_query, int verbose)
         return -1; // NOTE: returns error on alloc failure.
     }
 
+    int rcvbuf_effective    = 0;
+    socklen_t rcvbuf_len    = sizeof(rcvbuf_effective);
+    getsockopt(sock, SOL_SOCKET, SO_RCVBUF, (char *)&rcvbuf_effective, &rcvbuf_len);
+    if (verbose)
+        fprintf(stderr, "rtl_tcp receive buffer is %d bytes\n", rcvbuf_effective);
+
     dev->rtl_tcp = sock;
     dev->sample_size = sizeof(uint8_t) * 2; // CU8
     dev->sample_signed = 0;
+    dev->rtl_tcp_rcvbuf  = rcvbuf;
+    dev->rtl_tcp_buffers = buffers;
+    dev->rtl_tcp_stats.rcvbuf      = rcvbuf_effective;
+    dev->rtl_tcp_stats.sample_size = dev->sample_size;
+#ifdef THREADS
+    pthread_mutex_init(&dev->rtl_tcp_lock, NULL);
+    pthread_cond_init(&dev->rtl_tcp_cond, NULL);
+#endif
 
     *out_dev = dev;
     return 0;
@@ -282,9 +345,233 @@ static int rtltcp_close(SOCKET sock)
     return 0;
 }
 
+/// Account a received buffer and estimate the bytes missing at the sample rate, call with the lock held.
+static void rtltcp_account(sdr_dev_t *dev, unsigned n_read, uint32_t buf_len)
+{
+    sdr_stats_t *stats = &dev->rtl_tcp_stats;
+    stats->bytes_received += n_read;
+
+    uint64_t now  = monotonic_nsec();
+    uint32_t rate = atomic_load_acquire(&dev->rtl_tcp_rate);
+    if (!dev->rtl_tcp_meas_nsec || rate != dev->rtl_tcp_meas_rate) {
+        // (re)start after this buffer, it might have been waiting at the server
+        dev->rtl_tcp_meas_base  = stats->bytes_missing > 0 ? stats->bytes_missing : 0;
+        dev->rtl_tcp_meas_nsec  = now;
+        dev->rtl_tcp_meas_bytes = 0;
+        dev->rtl_tcp_meas_rate  = rate;
+        dev->rtl_tcp_gap_mark   = 0;
+        return;
+    }
+    dev->rtl_tcp_meas_bytes += n_read;
+    if (!rate)
+        return;
+
+    double expected = (double)(now - dev->rtl_tcp_meas_nsec) * 1e-9 * rate * stats->sample_size;
+    int64_t missing = (int64_t)expected - (int64_t)dev->rtl_tcp_meas_bytes;
+    stats->bytes_missing = dev->rtl_tcp_meas_base + missing;
+
+    // arrival jitters by about a buffer, a larger deficit means the server dropped samples
+    if (missing > dev->rtl_tcp_gap_mark + (int64_t)buf_len) {
+        stats->gaps++;
+        fprintf(stderr, "WARNING: rtl_tcp input is %.0f ms behind the sample rate, samples were likely lost.\n",
+                missing * 1e3 / stats->sample_size / rate);
+        dev->rtl_tcp_gap_mark = missing;
+    }
+    else if (missing < dev->rtl_tcp_gap_mark) {
+        dev->rtl_tcp_gap_mark = missing > 0 ? missing : 0;
+    }
+}
+
+#ifdef THREADS
+
+#define RTLTCP_RING_BUFFERS 16 // default buffers between the reader thread and the processing
+#define RTLTCP_RECV_TIMEOUT_MS 200 // the reader checks for a stop request at least this often
+
+static int rtltcp_timed_out(void)
+{
+#ifdef _WIN32
+    int err = WSAGetLastError();
+    return err == WSAETIMEDOUT || err == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+/// Read full buffers into the ring, the remote server is never stalled by the processing.
+/// The ring is not taken from dev->buffer_fn, a provider lends one buffer at a time on the processing thread.
+static THREAD_RETURN THREAD_CALL rtltcp_reader(void *arg)
+{
+    sdr_dev_t *dev   = arg;
+    sdr_stats_t *st  = &dev->rtl_tcp_stats;
+    uint32_t buf_len = (uint32_t)dev->buffer_size;
+
+#ifndef _WIN32
+    // signals are handled by the processing thread
+    sigset_t sigset;
+    sigfillset(&sigset);
+    pthread_sigmask(SIG_BLOCK, &sigset, NULL);
+#endif
+
+    while (!atomic_load_acquire(&dev->rtl_tcp_stop)) {
+        // the tail buffer is not touched by the processing until it is queued
+        pthread_mutex_lock(&dev->rtl_tcp_lock);
+        int full      = st->queued == st->buffers;
+        unsigned tail = (dev->rtl_tcp_head + st->queued) % st->buffers;
+        pthread_mutex_unlock(&dev->rtl_tcp_lock);
+        uint8_t *buffer = full ? dev->rtl_tcp_spare : &dev->rtl_tcp_ring[(size_t)tail * buf_len];
+
+        unsigned n_read = 0;
+        int r = 0;
+        while (n_read < buf_len && !atomic_load_acquire(&dev->rtl_tcp_stop)) {
+            r = recv(dev->rtl_tcp, (char *)&buffer[n_read], buf_len - n_read, 0);
+            if (r > 0) {
+                n_read += r;
+            }
+            else if (r < 0 && rtltcp_timed_out()) {
+                // let the processing check for a stop request
+                pthread_mutex_lock(&dev->rtl_tcp_lock);
+                pthread_cond_signal(&dev->rtl_tcp_cond);
+                pthread_mutex_unlock(&dev->rtl_tcp_lock);
+            }
+            else {
+                break;
+            }
+        }
+        int stopped = atomic_load_acquire(&dev->rtl_tcp_stop);
+
+        pthread_mutex_lock(&dev->rtl_tcp_lock);
+        if (n_read > 0 && !stopped) {
+            rtltcp_account(dev, n_read, buf_len);
+            if (full) {
+                st->bytes_dropped += n_read;
+            }
+            else {
+                dev->rtl_tcp_lens[tail] = n_read;
+                st->queued++;
+                if (st->queued > st->max_queued)
+                    st->max_queued = st->queued;
+            }
+        }
+        if (n_read < buf_len && !stopped) {
+            if (r < 0)
+                fprintf(stderr, "WARNING: sync read failed. %d\n", r);
+            else
+                fprintf(stderr, "rtl_tcp: connection closed\n");
+            dev->rtl_tcp_eof = 1;
+        }
+        pthread_cond_signal(&dev->rtl_tcp_cond);
+        pthread_mutex_unlock(&dev->rtl_tcp_lock);
+
+        if (dev->rtl_tcp_eof)
+            break;
+    }
+
+    return (THREAD_RETURN)0;
+}
+
+static int rtltcp_read_loop(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, uint32_t buf_num, uint32_t buf_len)
+{
+    unsigned buffers = dev->rtl_tcp_buffers ? dev->rtl_tcp_buffers : buf_num ? buf_num : RTLTCP_RING_BUFFERS;
+    if (buffers < 2)
+        buffers = 2;
+
+    dev->rtl_tcp_ring = malloc((size_t)buffers * buf_len);
+    if (!dev->rtl_tcp_ring) {
+        WARN_MALLOC("rtltcp_read_loop()");
+        return -1; // NOTE: returns error on alloc failure.
+    }
+    dev->rtl_tcp_lens = calloc(buffers, sizeof(*dev->rtl_tcp_lens));
+    if (!dev->rtl_tcp_lens) {
+        WARN_CALLOC("rtltcp_read_loop()");
+        free(dev->rtl_tcp_ring);
+        return -1; // NOTE: returns error on alloc failure.
+    }
+    dev->rtl_tcp_spare = malloc(buf_len);
+    if (!dev->rtl_tcp_spare) {
+        WARN_MALLOC("rtltcp_read_loop()");
+        free(dev->rtl_tcp_lens);
+        free(dev->rtl_tcp_ring);
+        return -1; // NOTE: returns error on alloc failure.
+    }
+    dev->buffer_size = buf_len;
+
+    pthread_mutex_lock(&dev->rtl_tcp_lock);
+    dev->rtl_tcp_stats.buffers    = buffers;
+    dev->rtl_tcp_stats.queued     = 0;
+    dev->rtl_tcp_stats.max_queued = 0;
+    dev->rtl_tcp_head             = 0;
+    dev->rtl_tcp_eof              = 0;
+    dev->rtl_tcp_stop             = 0;
+    pthread_mutex_unlock(&dev->rtl_tcp_lock);
+
+#ifdef _WIN32
+    DWORD timeout = RTLTCP_RECV_TIMEOUT_MS;
+#else
+    struct timeval timeout = {0, RTLTCP_RECV_TIMEOUT_MS * 1000};
+#endif
+    setsockopt(dev->rtl_tcp, SOL_SOCKET, SO_RCVTIMEO, (char const *)&timeout, sizeof(timeout));
+
+    if (pthread_create(&dev->rtl_tcp_thread, NULL, rtltcp_reader, dev)) {
+        fprintf(stderr, "Failed to start the rtl_tcp reader thread.\n");
+        free(dev->rtl_tcp_spare);
+        free(dev->rtl_tcp_lens);
+        free(dev->rtl_tcp_ring);
+        return -1;
+    }
+
+    dev->running = 1;
+    do {
+        pthread_mutex_lock(&dev->rtl_tcp_lock);
+        while (!dev->rtl_tcp_stats.queued && !dev->rtl_tcp_eof && dev->running)
+            pthread_cond_wait(&dev->rtl_tcp_cond, &dev->rtl_tcp_lock);
+        if (!dev->rtl_tcp_stats.queued) {
+            pthread_mutex_unlock(&dev->rtl_tcp_lock);
+            break; // end of stream or stopped
+        }
+        unsigned head = dev->rtl_tcp_head;
+        sdr_event_t ev = {
+                .ev  = SDR_EV_DATA,
+                .buf = &dev->rtl_tcp_ring[(size_t)head * buf_len],
+                .len = dev->rtl_tcp_lens[head],
+        };
+        pthread_mutex_unlock(&dev->rtl_tcp_lock);
+
+        dev->polling = 1;
+        cb(&ev, ctx);
+        dev->polling = 0;
+
+        pthread_mutex_lock(&dev->rtl_tcp_lock);
+        dev->rtl_tcp_head = (head + 1) % buffers;
+        dev->rtl_tcp_stats.queued--;
+        pthread_mutex_unlock(&dev->rtl_tcp_lock);
+
+        apply_changes(dev, cb, ctx);
+
+    } while (dev->running);
+    dev->running = 0;
+
+    atomic_store_release(&dev->rtl_tcp_stop, 1);
+    pthread_join(dev->rtl_tcp_thread, NULL);
+
+    pthread_mutex_lock(&dev->rtl_tcp_lock);
+    dev->rtl_tcp_stats.queued = 0;
+    pthread_mutex_unlock(&dev->rtl_tcp_lock);
+    free(dev->rtl_tcp_spare);
+    free(dev->rtl_tcp_lens);
+    free(dev->rtl_tcp_ring);
+    dev->rtl_tcp_spare = NULL;
+    dev->rtl_tcp_lens  = NULL;
+    dev->rtl_tcp_ring  = NULL;
+
+    return 0;
+}
+
+#else /* THREADS */
+
 static int rtltcp_read_loop(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, uint32_t buf_num, uint32_t buf_len)
 {
     UNUSED(buf_num);
+    dev->rtl_tcp_stats.buffers = 1;
     if (dev->buffer_size != buf_len) {
         free(dev->buffer);
         dev->buffer = malloc(buf_len);
@@ -294,13 +581,15 @@ static int rtltcp_read_loop(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, uint32
         }
         dev->buffer_size = buf_len;
     }
-    uint8_t *buffer = dev->buffer;
-
     dev->running = 1;
     do {
         unsigned n_read = 0;
         int r;
 
+        uint8_t *buffer = dev->buffer_fn ? dev->buffer_fn(dev->buffer_ctx, buf_len) : NULL;
+        if (!buffer)
+            buffer = dev->buffer;
+
         do {
             r = recv(dev->rtl_tcp, &buffer[n_read], buf_len - n_read, MSG_WAITALL);
             if (r <= 0)
@@ -310,6 +599,8 @@ static int rtltcp_read_loop(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, uint32
         } while (n_read < buf_len);
         //fprintf(stderr, "readStream ret=%d (read %u)\n", r, n_read);
 
+        if (n_read > 0)
+            rtltcp_account(dev, n_read, buf_len);
         if (r < 0) {
             fprintf(stderr, "WARNING: sync read failed. %d\n", r);
         }
@@ -334,6 +625,8 @@ static int rtltcp_read_loop(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, uint32
     return 0;
 }
 
+#endif /* THREADS */
+
 #pragma pack(push, 1)
 struct command {
     unsigned char cmd;
@@ -933,12 +1226,14 @@ static int soapysdr_read_loop(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, uint
         }
         dev->buffer_size = buf_len;
     }
-    int16_t *buffer = dev->buffer;
-
     size_t buf_elems = buf_len / dev->sample_size;
 
     dev->running = 1;
     do {
+        int16_t *buffer = dev->buffer_fn ? dev->buffer_fn(dev->buffer_ctx, buf_len) : NULL;
+        if (!buffer)
+            buffer = dev->buffer;
+
         void *buffs[]    = {buffer};
         int flags        = 0;
         long long timeNs = 0;
@@ -1042,8 +1337,13 @@ int sdr_close(sdr_dev_t *dev)
 
     int ret = -1;
 
-    if (dev->rtl_tcp)
+    if (dev->rtl_tcp) {
         ret = rtltcp_close(dev->rtl_tcp);
+#ifdef THREADS
+        pthread_cond_destroy(&dev->rtl_tcp_cond);
+        pthread_mutex_destroy(&dev->rtl_tcp_lock);
+#endif
+    }
 
 #ifdef SOAPYSDR
     if (dev->soapy_dev)
@@ -1351,7 +1651,7 @@ int sdr_set_sample_rate(sdr_dev_t *dev, uint32_t rate, int verbose)
     int r = -1;
 
     if (dev->rtl_tcp) {
-        dev->rtl_tcp_rate = rate;
+        atomic_store_release(&dev->rtl_tcp_rate, rate); // read by the reader thread
         r = rtltcp_command(dev, RTLTCP_SET_SAMPLE_RATE, rate);
     }
 
@@ -1562,6 +1862,30 @@ int sdr_reset(sdr_dev_t *dev, int verbose)
     return r;
 }
 
+void sdr_set_buffer_fn(sdr_dev_t *dev, sdr_buffer_fn_t fn, void *ctx)
+{
+    if (!dev)
+        return;
+
+    dev->buffer_fn  = fn;
+    dev->buffer_ctx = ctx;
+}
+
+int sdr_get_stats(sdr_dev_t *dev, sdr_stats_t *stats)
+{
+    if (!dev || !dev->rtl_tcp)
+        return -1;
+
+#ifdef THREADS
+    pthread_mutex_lock(&dev->rtl_tcp_lock);
+    *stats = dev->rtl_tcp_stats;
+    pthread_mutex_unlock(&dev->rtl_tcp_lock);
+#else
+    *stats = dev->rtl_tcp_stats;
+#endif
+    return 0;
+}
+
 int sdr_start(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, uint32_t buf_num, uint32_t buf_len)
 {
     if (!dev)
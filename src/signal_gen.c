@@ -0,0 +1,525 @@
+/** @file
+    Synthetic IQ signal generator, renders pulse data to CU8, CS16 or CF32 samples.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "signal_gen.h"
+#include "pulse_detect.h"
+#include "bitbuffer.h"
+#include "r_device.h"
+#include "optparse.h"
+#include "fatal.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+signal_gen_t *signal_gen_create(uint32_t sample_rate, float noise_dbfs, uint32_t seed)
+{
+    signal_gen_t *gen = calloc(1, sizeof(signal_gen_t));
+    if (!gen) {
+        WARN_CALLOC("signal_gen_create()");
+        return NULL;
+    }
+    gen->sample_rate = sample_rate;
+    // the noise power is split evenly on I and Q
+    gen->noise = (float)(pow(10.0, noise_dbfs / 20.0) / sqrt(2.0));
+    gen->rng   = seed ? seed : 2463534242u;
+    return gen;
+}
+
+void signal_gen_free(signal_gen_t *gen)
+{
+    if (!gen)
+        return;
+
+    list_free_elems(&gen->txs, free);
+    free(gen);
+}
+
+static uint32_t signal_gen_next(signal_gen_t *gen)
+{
+    // xorshift32
+    uint32_t x = gen->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    gen->rng = x;
+    return x;
+}
+
+double signal_gen_random(signal_gen_t *gen)
+{
+    return signal_gen_next(gen) / 4294967296.0;
+}
+
+uint64_t signal_gen_duration(signal_gen_t *gen, pulse_data_t const *pulses)
+{
+    double scale = pulses->sample_rate ? (double)gen->sample_rate / pulses->sample_rate : 1.0;
+    uint64_t len = 0;
+    for (unsigned n = 0; n < pulses->num_pulses; ++n)
+        len += (uint64_t)lrint(pulses->pulse[n] * scale) + (uint64_t)lrint(pulses->gap[n] * scale);
+    return len;
+}
+
+int signal_gen_add(signal_gen_t *gen, pulse_data_t const *pulses, uint64_t start, float level_dbfs, float offset_hz, float deviation_hz)
+{
+    if (!pulses->num_pulses)
+        return 0;
+
+    signal_gen_tx_t *tx = calloc(1, sizeof(signal_gen_tx_t));
+    if (!tx) {
+        WARN_CALLOC("signal_gen_add()");
+        return -1;
+    }
+    tx->pulses    = pulses;
+    tx->start     = start;
+    tx->scale     = pulses->sample_rate ? (double)gen->sample_rate / pulses->sample_rate : 1.0;
+    tx->amplitude = (float)pow(10.0, level_dbfs / 20.0);
+    tx->space_on  = pulses->fsk_f2_est != 0;
+
+    double mark_hz  = tx->space_on ? offset_hz + deviation_hz : offset_hz;
+    double space_hz = tx->space_on ? offset_hz - deviation_hz : offset_hz;
+    double mark_w   = 2.0 * M_PI * mark_hz / gen->sample_rate;
+    double space_w  = 2.0 * M_PI * space_hz / gen->sample_rate;
+    tx->mark_re     = cos(mark_w);
+    tx->mark_im     = sin(mark_w);
+    tx->space_re    = cos(space_w);
+    tx->space_im    = sin(space_w);
+    // random start phase, otherwise overlapping transmitters add up coherently
+    double phase    = 2.0 * M_PI * signal_gen_random(gen);
+    tx->phase_re    = cos(phase);
+    tx->phase_im    = sin(phase);
+    tx->remain      = (int)lrint(pulses->pulse[0] * tx->scale);
+
+    list_push(&gen->txs, tx);
+    return 0;
+}
+
+unsigned signal_gen_pending(signal_gen_t *gen)
+{
+    return (unsigned)gen->txs.len;
+}
+
+unsigned signal_gen_active(signal_gen_t *gen)
+{
+    unsigned active = 0;
+    for (void **iter = gen->txs.elems; iter && *iter; ++iter) {
+        signal_gen_tx_t *tx = *iter;
+        if (tx->start <= gen->pos)
+            active++;
+    }
+    return active;
+}
+
+/// Advance to the next pulse or gap, returns 0 at the end of the pulses.
+static int signal_gen_tx_step(signal_gen_tx_t *tx)
+{
+    pulse_data_t const *pulses = tx->pulses;
+    while (tx->remain <= 0) {
+        if (!tx->in_gap) {
+            tx->in_gap = 1;
+            tx->remain = (int)lrint(pulses->gap[tx->pulse] * tx->scale);
+        }
+        else {
+            tx->in_gap = 0;
+            tx->pulse++;
+            if (tx->pulse >= pulses->num_pulses)
+                return 0;
+            tx->remain = (int)lrint(pulses->pulse[tx->pulse] * tx->scale);
+        }
+    }
+    return 1;
+}
+
+/// Add a transmission to the buffer, returns 0 when it is finished.
+static int signal_gen_tx_render(signal_gen_tx_t *tx, float *iq, unsigned len)
+{
+    unsigned pos = 0;
+    while (pos < len) {
+        if (!signal_gen_tx_step(tx))
+            return 0;
+
+        unsigned chunk = (unsigned)tx->remain < len - pos ? (unsigned)tx->remain : len - pos;
+        double rot_re  = tx->in_gap ? tx->space_re : tx->mark_re;
+        double rot_im  = tx->in_gap ? tx->space_im : tx->mark_im;
+        double re      = tx->phase_re;
+        double im      = tx->phase_im;
+        if (!tx->in_gap || tx->space_on) {
+            float amp = tx->amplitude;
+            for (unsigned k = pos; k < pos + chunk; ++k) {
+                iq[2 * k] += (float)(amp * re);
+                iq[2 * k + 1] += (float)(amp * im);
+                double t = re * rot_re - im * rot_im;
+                im       = re * rot_im + im * rot_re;
+                re       = t;
+            }
+        }
+        else {
+            // keep the carrier phase going, no need to be exact while silent
+            for (unsigned k = 0; k < chunk; ++k) {
+                double t = re * rot_re - im * rot_im;
+                im       = re * rot_im + im * rot_re;
+                re       = t;
+            }
+        }
+        // keep the phasor on the unit circle
+        double mag   = sqrt(re * re + im * im);
+        tx->phase_re = re / mag;
+        tx->phase_im = im / mag;
+
+        tx->remain -= (int)chunk;
+        pos += chunk;
+    }
+    return 1;
+}
+
+void signal_gen_render(signal_gen_t *gen, float *iq, unsigned len)
+{
+    // gaussian noise, Box-Muller gives a pair for each sample
+    float sigma = gen->noise;
+    for (unsigned k = 0; k < len; ++k) {
+        double u = (signal_gen_next(gen) + 1.0) / 4294967297.0;
+        double v = signal_gen_random(gen);
+        double r = sigma * sqrt(-2.0 * log(u));
+        iq[2 * k]     = (float)(r * cos(2.0 * M_PI * v));
+        iq[2 * k + 1] = (float)(r * sin(2.0 * M_PI * v));
+    }
+
+    uint64_t end = gen->pos + len;
+    for (size_t i = 0; i < gen->txs.len;) {
+        signal_gen_tx_t *tx = gen->txs.elems[i];
+        if (tx->start >= end) {
+            ++i;
+            continue;
+        }
+        unsigned skip = tx->start > gen->pos ? (unsigned)(tx->start - gen->pos) : 0;
+        if (signal_gen_tx_render(tx, iq + 2 * skip, len - skip)) {
+            // still sending, render the rest of it with the next buffer
+            tx->start = end;
+            ++i;
+        }
+        else {
+            list_remove(&gen->txs, i, free);
+        }
+    }
+
+    gen->pos = end;
+}
+
+void signal_gen_to_cu8(float const *iq, uint8_t *out, unsigned len)
+{
+    for (unsigned k = 0; k < 2 * len; ++k) {
+        float v = 127.5f + 127.5f * iq[k];
+        out[k]  = v <= 0.0f ? 0 : v >= 255.0f ? 255 : (uint8_t)lrintf(v);
+    }
+}
+
+void signal_gen_to_cs16(float const *iq, int16_t *out, unsigned len)
+{
+    for (unsigned k = 0; k < 2 * len; ++k) {
+        float v = 32767.0f * iq[k];
+        out[k]  = v <= -32768.0f ? -32768 : v >= 32767.0f ? 32767 : (int16_t)lrintf(v);
+    }
+}
+
+/* flex-style specs */
+
+static void spec_mark(pulse_data_t *pulses, int width)
+{
+    unsigned n = pulses->num_pulses;
+    if (n && !pulses->gap[n - 1]) {
+        pulses->pulse[n - 1] += width;
+    }
+    else if (n < PD_MAX_PULSES) {
+        pulses->pulse[n] = width;
+        pulses->gap[n]   = 0;
+        pulses->num_pulses++;
+    }
+}
+
+static void spec_space(pulse_data_t *pulses, int width)
+{
+    // leading silence is dropped, pulses always start high
+    if (pulses->num_pulses)
+        pulses->gap[pulses->num_pulses - 1] += width;
+}
+
+static int spec_modulation(char const *str)
+{
+    if (!strcasecmp(str, "OOK_MC_ZEROBIT"))
+        return OOK_PULSE_MANCHESTER_ZEROBIT;
+    else if (!strcasecmp(str, "OOK_PCM"))
+        return OOK_PULSE_PCM_RZ;
+    else if (!strcasecmp(str, "OOK_PPM"))
+        return OOK_PULSE_PPM;
+    else if (!strcasecmp(str, "OOK_PWM"))
+        return OOK_PULSE_PWM;
+    else if (!strcasecmp(str, "FSK_PCM"))
+        return FSK_PULSE_PCM;
+    else if (!strcasecmp(str, "FSK_PWM"))
+        return FSK_PULSE_PWM;
+    else if (!strcasecmp(str, "FSK_MC_ZEROBIT"))
+        return FSK_PULSE_MANCHESTER_ZEROBIT;
+    return 0;
+}
+
+static int spec_width(char const *key, char const *val, int *width)
+{
+    char *end;
+    double w = strtod(val, &end);
+    if (end == val || *end || w < 0.0 || w > 10000000.0) {
+        fprintf(stderr, "Bad value for \"%s\" in signal spec: %s\n", key, val);
+        return -1;
+    }
+    *width = (int)w;
+    return 0;
+}
+
+static void spec_row(pulse_data_t *pulses, int modulation, uint8_t const *row, unsigned bits, int s, int l, int p)
+{
+    for (unsigned i = 0; i < bits; ++i) {
+        int bit = bitrow_get_bit(row, i);
+        switch (modulation) {
+        case OOK_PULSE_PCM_RZ:
+        case FSK_PULSE_PCM:
+            if (bit)
+                spec_mark(pulses, s);
+            else
+                spec_space(pulses, s);
+            break;
+        case OOK_PULSE_PPM:
+            spec_mark(pulses, p);
+            spec_space(pulses, bit ? l : s);
+            break;
+        case OOK_PULSE_PWM:
+        case FSK_PULSE_PWM:
+            // short pulse is 1, the period is constant
+            spec_mark(pulses, bit ? s : l);
+            spec_space(pulses, bit ? l : s);
+            break;
+        default: // Manchester, rising edge is 0
+            if (bit) {
+                spec_mark(pulses, s);
+                spec_space(pulses, s);
+            }
+            else {
+                spec_space(pulses, s);
+                spec_mark(pulses, s);
+            }
+            break;
+        }
+    }
+}
+
+int signal_gen_parse_spec(pulse_data_t *pulses, char const *spec)
+{
+    int modulation = 0;
+    int s = 0, l = 0, p = 0, g = 0, r = 10000, repeats = 1;
+    bitbuffer_t bits = {0};
+
+    char *buf = strdup(spec);
+    if (!buf) {
+        WARN_STRDUP("signal_gen_parse_spec()");
+        return -1;
+    }
+
+    int ret = 0;
+    char *arg = buf, *key, *val;
+    while (!ret && getkwargs(&arg, &key, &val)) {
+        key = remove_ws(key);
+        val = trim_ws(val);
+        if (!key || !*key)
+            continue;
+        else if (!val || !*val) {
+            fprintf(stderr, "Missing value for \"%s\" in signal spec\n", key);
+            ret = -1;
+        }
+        else if (!strcasecmp(key, "m") || !strcasecmp(key, "modulation")) {
+            modulation = spec_modulation(val);
+            if (!modulation) {
+                fprintf(stderr, "Unsupported modulation in signal spec: %s\n", val);
+                ret = -1;
+            }
+        }
+        else if (!strcasecmp(key, "s") || !strcasecmp(key, "short"))
+            ret = spec_width(key, val, &s);
+        else if (!strcasecmp(key, "l") || !strcasecmp(key, "long"))
+            ret = spec_width(key, val, &l);
+        else if (!strcasecmp(key, "p") || !strcasecmp(key, "pulse"))
+            ret = spec_width(key, val, &p);
+        else if (!strcasecmp(key, "g") || !strcasecmp(key, "gap"))
+            ret = spec_width(key, val, &g);
+        else if (!strcasecmp(key, "r") || !strcasecmp(key, "reset"))
+            ret = spec_width(key, val, &r);
+        else if (!strcasecmp(key, "repeats"))
+            ret = spec_width(key, val, &repeats);
+        else if (!strcasecmp(key, "c") || !strcasecmp(key, "codes"))
+            bitbuffer_parse(&bits, val);
+        else {
+            fprintf(stderr, "Unknown key \"%s\" in signal spec\n", key);
+            ret = -1;
+        }
+    }
+    free(buf);
+    if (ret)
+        return ret;
+
+    if (!modulation || !s || !bits.num_rows) {
+        fprintf(stderr, "Signal spec needs a modulation (m), a short width (s) and codes (c): %s\n", spec);
+        return -1;
+    }
+    if (!l)
+        l = s;
+    if (!p)
+        p = s;
+    if (!g)
+        g = r;
+
+    pulse_data_clear(pulses);
+    pulses->sample_rate = 1000000; // us
+    for (int rep = 0; rep < repeats; ++rep) {
+        for (unsigned row = 0; row < bits.num_rows; ++row) {
+            spec_row(pulses, modulation, bits.bb[row], bits.bits_per_row[row], s, l, p);
+            spec_space(pulses, g);
+        }
+    }
+    // replace the last row gap with the reset gap
+    if (pulses->num_pulses)
+        pulses->gap[pulses->num_pulses - 1] += r - g;
+    if (modulation >= FSK_DEMOD_MIN_VAL)
+        pulses->fsk_f2_est = 1; // mark as FSK data
+    return 0;
+}
+
+#ifdef _TEST
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d\n", (int)(a), (int)(b)); \
+        } \
+    } while (0)
+
+static double test_power(float const *iq, unsigned from, unsigned to)
+{
+    double sum = 0.0;
+    for (unsigned k = from; k < to; ++k)
+        sum += iq[2 * k] * iq[2 * k] + iq[2 * k + 1] * iq[2 * k + 1];
+    return sum / (to - from);
+}
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+
+    fprintf(stderr, "signal_gen:: test\n");
+
+    fprintf(stderr, "signal_gen::signal_gen_parse_spec()\n");
+    pulse_data_t pulses = {0};
+    ASSERT_EQUALS(signal_gen_parse_spec(&pulses, "m=OOK_PWM,s=400,l=800,r=9000,c={3}a0"), 0);
+    ASSERT_EQUALS(pulses.num_pulses, 3);
+    ASSERT_EQUALS(pulses.pulse[0], 400);
+    ASSERT_EQUALS(pulses.gap[0], 800);
+    ASSERT_EQUALS(pulses.pulse[1], 800);
+    ASSERT_EQUALS(pulses.gap[1], 400);
+    ASSERT_EQUALS(pulses.gap[2], 800 + 9000);
+    ASSERT_EQUALS(pulses.fsk_f2_est, 0);
+
+    ASSERT_EQUALS(signal_gen_parse_spec(&pulses, "m=FSK_PCM,s=100,g=500,r=2000,repeats=2,c={8}e6"), 0);
+    // 111 00 11 0, twice with a gap
+    ASSERT_EQUALS(pulses.num_pulses, 4);
+    ASSERT_EQUALS(pulses.pulse[0], 300);
+    ASSERT_EQUALS(pulses.gap[0], 200);
+    ASSERT_EQUALS(pulses.pulse[1], 200);
+    ASSERT_EQUALS(pulses.gap[1], 100 + 500);
+    ASSERT_EQUALS(pulses.gap[3], 100 + 2000);
+    ASSERT_EQUALS(pulses.fsk_f2_est, 1);
+
+    ASSERT_EQUALS(signal_gen_parse_spec(&pulses, "m=OOK_MC_ZEROBIT,s=250,c={4}40"), 0);
+    // 0 1 0 0: rise, fall, rise, fall-rise
+    ASSERT_EQUALS(pulses.num_pulses, 3);
+    ASSERT_EQUALS(pulses.pulse[0], 500);
+    ASSERT_EQUALS(pulses.gap[0], 500);
+    ASSERT_EQUALS(pulses.pulse[1], 250);
+    ASSERT_EQUALS(pulses.gap[1], 250);
+
+    ASSERT_EQUALS(signal_gen_parse_spec(&pulses, "m=OOK_FOO,s=250,c={4}40") != 0, 1);
+    ASSERT_EQUALS(signal_gen_parse_spec(&pulses, "m=OOK_PPM,c={4}40") != 0, 1);
+
+    fprintf(stderr, "signal_gen::signal_gen_render()\n");
+    signal_gen_t *gen = signal_gen_create(250000, -40.0f, 1);
+    pulse_data_t ook = {0};
+    ook.sample_rate  = 250000;
+    ook.num_pulses   = 2;
+    ook.pulse[0]     = 1000;
+    ook.gap[0]       = 1000;
+    ook.pulse[1]     = 500;
+    ook.gap[1]       = 500;
+    ASSERT_EQUALS(signal_gen_duration(gen, &ook), 3000);
+    signal_gen_add(gen, &ook, 1000, -6.0f, 10000.0f, 0.0f);
+    // two overlapping transmitters, the second one at a different rate
+    pulse_data_t fsk = ook;
+    fsk.sample_rate  = 125000;
+    fsk.fsk_f2_est   = 1;
+    signal_gen_add(gen, &fsk, 3000, -20.0f, 0.0f, 25000.0f);
+    ASSERT_EQUALS(signal_gen_pending(gen), 2);
+
+    float *iq = calloc(2 * 12000, sizeof(float));
+    if (!iq)
+        FATAL_CALLOC("main()");
+    // render in odd sized chunks to cross buffer boundaries
+    for (unsigned pos = 0; pos < 12000; pos += 777)
+        signal_gen_render(gen, iq + 2 * pos, pos + 777 < 12000 ? 777 : 12000 - pos);
+    ASSERT_EQUALS(signal_gen_pending(gen), 0);
+
+    // noise at -40 dBFS, the first pulse at -6 dBFS
+    double noise = test_power(iq, 0, 1000);
+    ASSERT_EQUALS(noise > 0.00008 && noise < 0.00012, 1);
+    double mark = test_power(iq, 1000, 2000);
+    ASSERT_EQUALS(mark > 0.24 && mark < 0.27, 1);
+    // gap of the OOK pulse with the FSK pulse overlapping from 3000
+    ASSERT_EQUALS(test_power(iq, 2000, 3000) < 0.001, 1);
+    double overlap = test_power(iq, 3000, 3500);
+    ASSERT_EQUALS(overlap > 0.2 && overlap < 0.32, 1);
+    // FSK gaps carry the carrier until 9000
+    double space = test_power(iq, 5000, 7000);
+    ASSERT_EQUALS(space > 0.008 && space < 0.012, 1);
+    ASSERT_EQUALS(test_power(iq, 9000, 12000) < 0.001, 1);
+
+    fprintf(stderr, "signal_gen::signal_gen_to_cu8()\n");
+    float clip[4] = {-2.0f, 0.0f, 1.0f, 0.5f};
+    uint8_t cu8[4];
+    signal_gen_to_cu8(clip, cu8, 2);
+    ASSERT_EQUALS(cu8[0], 0);
+    ASSERT_EQUALS(cu8[1], 128);
+    ASSERT_EQUALS(cu8[2], 255);
+    ASSERT_EQUALS(cu8[3], 191);
+    int16_t cs16[4];
+    signal_gen_to_cs16(clip, cs16, 2);
+    ASSERT_EQUALS(cs16[0], -32768);
+    ASSERT_EQUALS(cs16[1], 0);
+    ASSERT_EQUALS(cs16[2], 32767);
+    ASSERT_EQUALS(cs16[3], 16384);
+
+    free(iq);
+    signal_gen_free(gen);
+
+    fprintf(stderr, "signal_gen:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+
+    return failed;
+}
+#endif /* _TEST */
@@ -0,0 +1,134 @@
+/** @file
+    Bounded lock-free single-producer single-consumer queue.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "spsc_queue.h"
+#include "compat_pthread.h"
+#include "fatal.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+spsc_queue_t *spsc_queue_create(unsigned capacity, size_t elem_size)
+{
+    spsc_queue_t *queue = calloc(1, sizeof(spsc_queue_t));
+    if (!queue) {
+        WARN_CALLOC("spsc_queue_create()");
+        return NULL;
+    }
+
+    queue->capacity = 1;
+    while (queue->capacity < capacity)
+        queue->capacity *= 2;
+    queue->elem_size = elem_size;
+
+    queue->elems = calloc(queue->capacity, elem_size);
+    if (!queue->elems) {
+        WARN_CALLOC("spsc_queue_create()");
+        free(queue);
+        return NULL;
+    }
+
+    return queue;
+}
+
+void spsc_queue_free(spsc_queue_t *queue)
+{
+    if (!queue)
+        return;
+
+    free(queue->elems);
+    free(queue);
+}
+
+int spsc_queue_push(spsc_queue_t *queue, void const *elem)
+{
+    unsigned tail = queue->tail; // only we write this
+    unsigned head = atomic_load_acquire(&queue->head);
+    if (tail - head >= queue->capacity)
+        return 0;
+
+    memcpy(&queue->elems[(tail & (queue->capacity - 1)) * queue->elem_size], elem, queue->elem_size);
+    atomic_store_release(&queue->tail, tail + 1);
+    return 1;
+}
+
+int spsc_queue_pop(spsc_queue_t *queue, void *elem)
+{
+    unsigned head = queue->head; // only we write this
+    unsigned tail = atomic_load_acquire(&queue->tail);
+    if (head == tail)
+        return 0;
+
+    memcpy(elem, &queue->elems[(head & (queue->capacity - 1)) * queue->elem_size], queue->elem_size);
+    atomic_store_release(&queue->head, head + 1);
+    return 1;
+}
+
+unsigned spsc_queue_len(spsc_queue_t *queue)
+{
+    return atomic_load_acquire(&queue->tail) - atomic_load_acquire(&queue->head);
+}
+
+#ifdef _TEST
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d\n", (int)(a), (int)(b)); \
+        } \
+    } while (0)
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+    int val;
+
+    fprintf(stderr, "spsc_queue:: test\n");
+
+    spsc_queue_t *queue = spsc_queue_create(3, sizeof(int));
+    ASSERT_EQUALS(queue->capacity, 4);
+    ASSERT_EQUALS(spsc_queue_pop(queue, &val), 0);
+
+    fprintf(stderr, "spsc_queue::spsc_queue_push()\n");
+    for (val = 1; val <= 4; ++val)
+        ASSERT_EQUALS(spsc_queue_push(queue, &val), 1);
+    ASSERT_EQUALS(spsc_queue_push(queue, &val), 0);
+    ASSERT_EQUALS(spsc_queue_len(queue), 4);
+
+    fprintf(stderr, "spsc_queue::spsc_queue_pop()\n");
+    ASSERT_EQUALS(spsc_queue_pop(queue, &val), 1);
+    ASSERT_EQUALS(val, 1);
+    ASSERT_EQUALS(spsc_queue_pop(queue, &val), 1);
+    ASSERT_EQUALS(val, 2);
+
+    fprintf(stderr, "spsc_queue:: wrap around\n");
+    for (int i = 0; i < 1000; ++i) {
+        val = i;
+        spsc_queue_push(queue, &val);
+        spsc_queue_pop(queue, &val);
+    }
+    ASSERT_EQUALS(spsc_queue_len(queue), 2);
+    ASSERT_EQUALS(spsc_queue_pop(queue, &val), 1);
+    ASSERT_EQUALS(val, 998);
+    ASSERT_EQUALS(spsc_queue_pop(queue, &val), 1);
+    ASSERT_EQUALS(val, 999);
+    ASSERT_EQUALS(spsc_queue_pop(queue, &val), 0);
+
+    spsc_queue_free(queue);
+
+    fprintf(stderr, "spsc_queue:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+
+    return failed;
+}
+#endif /* _TEST */
@@ -0,0 +1,97 @@
+/** @file
+    Throughput of the JSON and binary (CBOR, MessagePack) data printers.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "data.h"
+#include "data_binary.h"
+
+#define BENCH_BUF_SIZE 4096
+
+typedef enum {
+    BENCH_JSON,
+    BENCH_CBOR,
+    BENCH_MSGPACK,
+} bench_format_t;
+
+static char const *bench_names[] = {"json", "cbor", "msgpack"};
+
+static void bench(char const *label, data_t *data, bench_format_t format, binary_schema_t *schema, int rounds)
+{
+    uint8_t buf[BENCH_BUF_SIZE];
+    size_t bytes = 0;
+
+    clock_t start = clock();
+    for (int i = 0; i < rounds; ++i) {
+        if (format == BENCH_JSON)
+            bytes += data_print_jsons(data, (char *)buf, sizeof(buf));
+        else
+            bytes += data_print_binary(data, format == BENCH_CBOR ? BINARY_CBOR : BINARY_MSGPACK, schema, buf, sizeof(buf));
+    }
+    double secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+    if (secs <= 0.0)
+        secs = 1e-9;
+
+    printf("%-8s %-8s %-7s %8.1f ns/event %10.0f events/s %6.1f bytes/event\n",
+            label, bench_names[format], schema ? "schema" : "",
+            secs * 1e9 / rounds, rounds / secs, (double)bytes / rounds);
+}
+
+int main(int argc, char *argv[])
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : 200000;
+    if (rounds < 1)
+        rounds = 1;
+
+    data_t *flat = data_make(
+            "time",             "",             DATA_STRING, "2019-08-29 08:38:19",
+            "model",            "",             DATA_STRING, "Nexus-TH",
+            "id",               "House Code",   DATA_INT, 42,
+            "channel",          "Channel",      DATA_INT, 2,
+            "battery_ok",       "Battery",      DATA_INT, 1,
+            "temperature_C",    "Temperature",  DATA_FORMAT, "%.1f C", DATA_DOUBLE, 20.5,
+            "humidity",         "Humidity",     DATA_FORMAT, "%u %%", DATA_INT, 83,
+            "mic",              "Integrity",    DATA_STRING, "CRC",
+            NULL);
+
+    data_t *nested = data_make(
+            "time",             "",             DATA_STRING, "2019-08-29 08:38:19",
+            "model",            "",             DATA_STRING, "Test-Nested",
+            "id",               "",             DATA_INT, 1234567,
+            "codes",            "",             DATA_ARRAY, data_array(4, DATA_INT, (int[4]){1, -2, 300, 70000}),
+            "levels",           "",             DATA_ARRAY, data_array(3, DATA_DOUBLE, (double[3]){-12.5, 0.1, 3.25}),
+            "sensor",           "",             DATA_DATA, data_make(
+                    "type",             "",             DATA_STRING, "rain",
+                    "rain_mm",          "",             DATA_DOUBLE, 123.4,
+                    NULL),
+            NULL);
+
+    char const *fields[] = {"time", "model", "id", "channel", "battery_ok", "temperature_C", "humidity", "mic", "codes", "levels", "sensor", "type", "rain_mm"};
+    binary_schema_t *schema = binary_schema_create(fields, sizeof(fields) / sizeof(*fields));
+
+    printf("Encoding %d events each:\n", rounds);
+    bench("flat", flat, BENCH_JSON, NULL, rounds);
+    bench("flat", flat, BENCH_CBOR, NULL, rounds);
+    bench("flat", flat, BENCH_CBOR, schema, rounds);
+    bench("flat", flat, BENCH_MSGPACK, schema, rounds);
+    bench("nested", nested, BENCH_JSON, NULL, rounds);
+    bench("nested", nested, BENCH_CBOR, NULL, rounds);
+    bench("nested", nested, BENCH_CBOR, schema, rounds);
+    bench("nested", nested, BENCH_MSGPACK, schema, rounds);
+
+    binary_schema_free(schema);
+    data_free(flat);
+    data_free(nested);
+    return 0;
+}
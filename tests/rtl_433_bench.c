@@ -0,0 +1,454 @@
+/** @file
+    Benchmark of the full sample processing with all default decoders.
+
+    Renders a corpus of pulse files (`.ook`) to CU8 and CS16 samples and replays
+    these through sdr_callback(), the pulses are also run through the decoders directly.
+    Reports ns/sample per stage, events/s, and the peak RSS as JSON.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+
+#include "rtl_433.h"
+#include "r_private.h"
+#include "r_device.h"
+#include "r_api.h"
+#include "pulse_detect.h"
+#include "signal_gen.h"
+#include "data.h"
+#include "list.h"
+#include "compat_time.h"
+#include "compat_alarm.h"
+#include "fatal.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#define NULL_DEVICE "NUL"
+#else
+#include <sys/resource.h>
+#define NULL_DEVICE "/dev/null"
+#endif
+
+#define BENCH_GAP_US      100000 // silence between packages
+#define BENCH_LEVEL       -6.0f  // signal level in dBFS
+#define BENCH_NOISE       -34.0f // noise level in dBFS, 28 dB SNR
+#define BENCH_OOK_OFFSET  10000  // carrier offset in Hz
+#define BENCH_FSK_DEV     25000  // FSK deviation in Hz
+
+/// Decoder, slicer, and output stages, computed from the demod and per decoder times.
+enum {
+    BENCH_DECIMATE,
+    BENCH_ENVELOPE,
+    BENCH_LOWPASS,
+    BENCH_FM,
+    BENCH_DETECT,
+    BENCH_SLICE,
+    BENCH_DECODE,
+    BENCH_OUTPUT,
+    BENCH_TOTAL,
+    BENCH_STAGES,
+};
+
+static char const *const bench_stage_names[] = {
+        "decimate",
+        "envelope",
+        "lowpass",
+        "fm",
+        "detect",
+        "slice",
+        "decode",
+        "output",
+        "total",
+};
+
+typedef struct {
+    uint64_t nsec[BENCH_STAGES];
+    uint64_t samples;
+    unsigned packages;
+    unsigned events;
+} bench_result_t;
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "rtl_433_bench, replay a corpus of pulse files through the sample processing.\n\n"
+            "Usage: rtl_433_bench [-n <repeats>] [-D <factor>] [-G] [-o <json file>] <file.ook>...\n"
+            "\t-n <repeats> replay each input this many times (default: 3)\n"
+            "\t-D <factor> render at the factor times the sample rate and decimate\n"
+            "\t-G also enable the decoders that are disabled by default\n"
+            "\t-o <file> write the JSON report to a file (default: stdout)\n\n"
+            "Each pulse file is rendered to CU8 and CS16 samples with noise, and also run directly.\n"
+            "Exits with failure if an input decodes no events.\n");
+    exit(1);
+}
+
+/* sample rendering */
+
+/// Render all packages to samples, returns the number of samples.
+static size_t render_packages(list_t *packages, int sample_size, uint32_t sample_rate, uint8_t **out)
+{
+    // the same seed for each format to get the same noise
+    signal_gen_t *gen = signal_gen_create(sample_rate, BENCH_NOISE, 1);
+    if (!gen)
+        exit(1);
+
+    uint64_t gap   = (uint64_t)BENCH_GAP_US * sample_rate / 1000000;
+    uint64_t total = gap;
+    for (void **iter = packages->elems; iter && *iter; ++iter) {
+        pulse_data_t *pulses = *iter;
+        float offset         = pulses->fsk_f2_est ? 0.0f : BENCH_OOK_OFFSET;
+        signal_gen_add(gen, pulses, total, BENCH_LEVEL, offset, BENCH_FSK_DEV);
+        total += signal_gen_duration(gen, pulses) + gap;
+    }
+
+    uint8_t *buf = malloc(total * sample_size);
+    if (!buf)
+        FATAL_MALLOC("render_packages()");
+    float *iq = malloc(DEFAULT_BUF_LENGTH * 2 * sizeof(float));
+    if (!iq)
+        FATAL_MALLOC("render_packages()");
+
+    for (uint64_t pos = 0; pos < total; pos += DEFAULT_BUF_LENGTH) {
+        unsigned len = total - pos < DEFAULT_BUF_LENGTH ? (unsigned)(total - pos) : DEFAULT_BUF_LENGTH;
+        signal_gen_render(gen, iq, len);
+        if (sample_size == 2)
+            signal_gen_to_cu8(iq, buf + pos * 2, len);
+        else
+            signal_gen_to_cs16(iq, (int16_t *)buf + pos * 2, len);
+    }
+
+    free(iq);
+    signal_gen_free(gen);
+    *out = buf;
+    return total;
+}
+
+/// Load all packages of a pulse file, returns the number of packages.
+static unsigned load_packages(char const *path, uint32_t sample_rate, list_t *packages)
+{
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return 0;
+    }
+    for (;;) {
+        pulse_data_t *pulses = calloc(1, sizeof(pulse_data_t));
+        if (!pulses)
+            FATAL_CALLOC("load_packages()");
+        pulse_data_load(file, pulses, sample_rate);
+        if (!pulses->num_pulses) {
+            free(pulses);
+            break;
+        }
+        list_push(packages, pulses);
+    }
+    fclose(file);
+    return packages->len;
+}
+
+/* measurements */
+
+static unsigned total_messages(r_cfg_t *cfg)
+{
+    unsigned messages = 0;
+    for (void **iter = cfg->demod->r_devs.elems; iter && *iter; ++iter) {
+        r_device *r_dev = *iter;
+        messages += r_dev->total_messages;
+    }
+    return messages;
+}
+
+static uint64_t total_decode_nsec(r_cfg_t *cfg)
+{
+    uint64_t nsec = 0;
+    for (void **iter = cfg->demod->r_devs.elems; iter && *iter; ++iter) {
+        r_device *r_dev = *iter;
+        nsec += r_dev->decode_nsec;
+    }
+    return nsec;
+}
+
+typedef struct {
+    uint64_t profile_nsec[PROFILE_STAGES];
+    uint64_t decode_nsec;
+    unsigned messages;
+    uint64_t start;
+} bench_mark_t;
+
+static void bench_start(r_cfg_t *cfg, bench_mark_t *mark)
+{
+    memcpy(mark->profile_nsec, cfg->demod->profile_nsec, sizeof(mark->profile_nsec));
+    mark->decode_nsec = total_decode_nsec(cfg);
+    mark->messages    = total_messages(cfg);
+    mark->start       = monotonic_nsec();
+}
+
+static void bench_stop(r_cfg_t *cfg, bench_mark_t *mark, bench_result_t *result)
+{
+    uint64_t wall = monotonic_nsec() - mark->start;
+    uint64_t *profile_nsec = cfg->demod->profile_nsec;
+    uint64_t demod  = profile_nsec[PROFILE_DEMOD] - mark->profile_nsec[PROFILE_DEMOD];
+    uint64_t decode = total_decode_nsec(cfg) - mark->decode_nsec;
+    uint64_t output = profile_nsec[PROFILE_OUTPUT] - mark->profile_nsec[PROFILE_OUTPUT];
+
+    result->nsec[BENCH_DECIMATE] += profile_nsec[PROFILE_DECIMATE] - mark->profile_nsec[PROFILE_DECIMATE];
+    result->nsec[BENCH_ENVELOPE] += profile_nsec[PROFILE_ENVELOPE] - mark->profile_nsec[PROFILE_ENVELOPE];
+    result->nsec[BENCH_LOWPASS] += profile_nsec[PROFILE_LOWPASS] - mark->profile_nsec[PROFILE_LOWPASS];
+    result->nsec[BENCH_FM] += profile_nsec[PROFILE_FM] - mark->profile_nsec[PROFILE_FM];
+    result->nsec[BENCH_DETECT] += profile_nsec[PROFILE_DETECT] - mark->profile_nsec[PROFILE_DETECT];
+    // decoders include the outputs, slicers include the decoders
+    result->nsec[BENCH_SLICE] += demod > decode ? demod - decode : 0;
+    result->nsec[BENCH_DECODE] += decode > output ? decode - output : 0;
+    result->nsec[BENCH_OUTPUT] += output;
+    result->nsec[BENCH_TOTAL] += wall;
+    result->events += total_messages(cfg) - mark->messages;
+}
+
+/// Replay samples through sdr_callback() in buffers of the default length.
+static void bench_samples(r_cfg_t *cfg, uint8_t *samples, size_t num_samples, int sample_size, bench_result_t *result)
+{
+    struct dm_state *demod = cfg->demod;
+    // the FM filter coefficients are only computed for the first sample format seen
+    if (demod->sample_size != sample_size)
+        memset(&demod->demod_FM_state, 0, sizeof(demod->demod_FM_state));
+    demod->sample_size = sample_size;
+
+    bench_mark_t mark;
+    bench_start(cfg, &mark);
+
+    size_t len = num_samples * sample_size;
+    for (size_t pos = 0; pos < len; pos += DEFAULT_BUF_LENGTH) {
+        size_t n = len - pos < DEFAULT_BUF_LENGTH ? len - pos : DEFAULT_BUF_LENGTH;
+        sdr_callback(samples + pos, (uint32_t)n, cfg);
+    }
+
+    bench_stop(cfg, &mark, result);
+    result->samples += num_samples;
+}
+
+/// Run pulses directly through the slicers and decoders.
+static void bench_pulses(r_cfg_t *cfg, list_t *packages, bench_result_t *result)
+{
+    struct dm_state *demod = cfg->demod;
+
+    bench_mark_t mark;
+    bench_start(cfg, &mark);
+
+    for (void **iter = packages->elems; iter && *iter; ++iter) {
+        pulse_data_t *pulses = *iter;
+        uint64_t start = monotonic_nsec();
+        if (pulses->fsk_f2_est)
+            run_fsk_demods(&demod->r_devs, pulses);
+        else
+            run_ook_demods(&demod->r_devs, pulses);
+        demod->profile_nsec[PROFILE_DEMOD] += monotonic_nsec() - start;
+    }
+
+    bench_stop(cfg, &mark, result);
+    result->packages += packages->len;
+}
+
+/* report */
+
+static long peak_rss_kb(void)
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return -1;
+    return (long)(pmc.PeakWorkingSetSize / 1024);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage))
+        return -1;
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024; // bytes on macOS
+#else
+    return usage.ru_maxrss; // kilobytes
+#endif
+#endif
+}
+
+static data_t *result_data(char const *input, char const *format, bench_result_t *result)
+{
+    // per sample for sample inputs, per package for pulse inputs
+    double per = result->samples ? (double)result->samples : result->packages ? (double)result->packages : 1.0;
+    data_t *stages = NULL;
+    for (int i = 0; i < BENCH_STAGES; ++i) {
+        if (!result->samples && i < BENCH_SLICE)
+            continue;
+        stages = data_append(stages,
+                bench_stage_names[i], "", DATA_DOUBLE, result->nsec[i] / per,
+                NULL);
+    }
+    double seconds = result->nsec[BENCH_TOTAL] / 1e9;
+
+    return data_make(
+            "input",            "", DATA_STRING, input,
+            "format",           "", DATA_STRING, format,
+            "samples",          "", DATA_COND, result->samples != 0, DATA_INT, (int)result->samples,
+            "packages",         "", DATA_COND, result->samples == 0, DATA_INT, (int)result->packages,
+            "events",           "", DATA_INT, (int)result->events,
+            "seconds",          "", DATA_DOUBLE, seconds,
+            "events_per_sec",   "", DATA_DOUBLE, seconds > 0.0 ? result->events / seconds : 0.0,
+            result->samples ? "ns_per_sample" : "ns_per_package", "", DATA_DATA, stages,
+            NULL);
+}
+
+static void result_add(bench_result_t *sum, bench_result_t const *result)
+{
+    for (int i = 0; i < BENCH_STAGES; ++i)
+        sum->nsec[i] += result->nsec[i];
+    sum->samples += result->samples;
+    sum->packages += result->packages;
+    sum->events += result->events;
+}
+
+int main(int argc, char **argv)
+{
+    int repeats         = 3;
+    unsigned decimation = 1;
+    unsigned disabled   = 0;
+    char const *outpath = NULL;
+    int i;
+    for (i = 1; i < argc && argv[i][0] == '-'; ++i) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            repeats = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-D") && i + 1 < argc)
+            decimation = (unsigned)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-G"))
+            disabled = 1;
+        else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+            outpath = argv[++i];
+        else
+            usage();
+    }
+    if (i >= argc || repeats < 1 || decimation < 1)
+        usage();
+
+    // sdr_callback() arms a watchdog, we do not need it
+    signal(SIGALRM, SIG_IGN);
+
+    r_cfg_t *cfg = r_create_cfg();
+    struct dm_state *demod = cfg->demod;
+    cfg->report_cpu  = 1; // time the decoders
+    cfg->report_time = REPORT_TIME_SAMPLES;
+    demod->profile   = 1;
+
+    pulse_detect_set_levels(demod->pulse_detect, demod->use_mag_est, demod->level_limit, demod->min_level, demod->min_snr, demod->detect_verbosity);
+
+    demod->sample_rate = cfg->samp_rate;
+    if (decimation > 1) {
+        demod->decimation = decimation;
+        demod->decimator  = decimator_create(decimation);
+        if (!demod->decimator)
+            exit(1);
+        cfg->samp_rate *= decimation;
+    }
+
+    char null_device[] = NULL_DEVICE;
+    add_json_output(cfg, null_device);
+
+    register_all_protocols(cfg, disabled);
+    build_preamble_matcher(cfg);
+    for (void **iter = demod->r_devs.elems; iter && *iter; ++iter) {
+        r_device *r_dev = *iter;
+        if (r_dev->modulation >= FSK_DEMOD_MIN_VAL)
+            demod->enable_FM_demod = 1;
+    }
+
+    char const **well_known = well_known_output_fields(cfg);
+    start_outputs(cfg, well_known);
+    free(well_known);
+
+    static char const *const format_names[] = {"cu8", "cs16", "ook"};
+    bench_result_t totals[3];
+    memset(totals, 0, sizeof(totals));
+    list_t results = {0};
+    int failed     = 0;
+
+    for (; i < argc; ++i) {
+        char const *path = argv[i];
+        char const *name = strrchr(path, '/');
+        name = name ? name + 1 : path;
+
+        list_t packages = {0};
+        if (!load_packages(path, cfg->samp_rate, &packages)) {
+            fprintf(stderr, "No pulse data in %s\n", path);
+            failed++;
+            continue;
+        }
+
+        for (int format = 0; format < 3; ++format) {
+            bench_result_t result = {0};
+            uint8_t *samples   = NULL;
+            size_t num_samples = 0;
+            int sample_size    = format == 0 ? 2 : 4;
+            if (format < 2)
+                num_samples = render_packages(&packages, sample_size, cfg->samp_rate, &samples);
+
+            for (int r = 0; r < repeats; ++r) {
+                if (format < 2)
+                    bench_samples(cfg, samples, num_samples, sample_size, &result);
+                else
+                    bench_pulses(cfg, &packages, &result);
+            }
+            free(samples);
+
+            if (!result.events) {
+                fprintf(stderr, "No events from %s as %s\n", name, format_names[format]);
+                failed++;
+            }
+            result_add(&totals[format], &result);
+            list_push(&results, result_data(name, format_names[format], &result));
+        }
+
+        list_free_elems(&packages, free);
+    }
+
+    list_t total_list = {0};
+    for (int format = 0; format < 3; ++format) {
+        list_push(&total_list, result_data("total", format_names[format], &totals[format]));
+    }
+
+    data_t *data = data_make(
+            "decoders",         "", DATA_INT, (int)demod->r_devs.len,
+            "sample_rate",      "", DATA_INT, (int)cfg->samp_rate,
+            "decimation",       "", DATA_INT, (int)decimation,
+            "buffer_length",    "", DATA_INT, DEFAULT_BUF_LENGTH,
+            "repeats",          "", DATA_INT, repeats,
+            "inputs",           "", DATA_ARRAY, data_array(results.len, DATA_DATA, results.elems),
+            "totals",           "", DATA_ARRAY, data_array(total_list.len, DATA_DATA, total_list.elems),
+            "peak_rss_kb",      "", DATA_INT, (int)peak_rss_kb(),
+            NULL);
+    list_free_elems(&results, NULL);
+    list_free_elems(&total_list, NULL);
+
+    FILE *out = outpath ? fopen(outpath, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "Failed to open %s\n", outpath);
+        exit(1);
+    }
+    struct data_output *output = data_output_json_create(out);
+    data_output_print(output, data);
+    data_output_free(output);
+    if (out != stdout)
+        fclose(out);
+    data_free(data);
+
+    r_free_cfg(cfg);
+    free(cfg);
+
+    return failed;
+}
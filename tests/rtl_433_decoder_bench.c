@@ -0,0 +1,361 @@
+/** @file
+    Microbenchmark of the decoders, driven by test strings as for "-y @file".
+
+    Each line is a code string or an RfRaw string, optionally prefixed by a protocol
+    number in brackets. Codes are passed to the decode_fn directly, RfRaw strings run
+    through the slicer of the decoder. Reports ns/call, allocations per call, and
+    outputs per call for each decoder as JSON, slowest first.
+
+    Allocations are counted by wrapping malloc(), calloc(), realloc(), and strdup() at
+    link time, where the linker supports it (WRAP_ALLOC), this covers data_make().
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "rtl_433.h"
+#include "r_private.h"
+#include "r_device.h"
+#include "r_api.h"
+#include "r_util.h"
+#include "pulse_demod.h"
+#include "pulse_detect.h"
+#include "bitbuffer.h"
+#include "rfraw.h"
+#include "data.h"
+#include "list.h"
+#include "compat_time.h"
+#include "fatal.h"
+
+#define DEC_BENCH_LINE_MAX 8192
+
+/* allocation counting */
+
+static uint64_t alloc_count;
+static uint64_t alloc_bytes;
+
+#ifdef WRAP_ALLOC
+#define WRAP_ALLOC_ON 1
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+char *__real_strdup(char const *s);
+
+void *__wrap_malloc(size_t size)
+{
+    alloc_count++;
+    alloc_bytes += size;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+    alloc_count++;
+    alloc_bytes += nmemb * size;
+    return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    alloc_count++;
+    alloc_bytes += size;
+    return __real_realloc(ptr, size);
+}
+
+char *__wrap_strdup(char const *s)
+{
+    alloc_count++;
+    alloc_bytes += strlen(s) + 1;
+    return __real_strdup(s);
+}
+#else
+#define WRAP_ALLOC_ON 0
+#endif
+
+/* outputs */
+
+static uint64_t output_count;
+
+static void bench_output(r_device *decoder, data_t *data)
+{
+    UNUSED(decoder);
+    output_count++;
+    data_free(data);
+}
+
+/* measurements */
+
+typedef struct {
+    r_device *r_dev;
+    unsigned lines;
+    uint64_t calls;
+    uint64_t nsec;
+    uint64_t allocs;
+    uint64_t bytes;
+    uint64_t outputs;
+} dec_stat_t;
+
+typedef struct {
+    char *text;
+    unsigned protocol; ///< 0 for all decoders
+    int is_rfraw;
+    bitbuffer_t bits;
+    pulse_data_t pulses;
+} dec_line_t;
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "rtl_433_decoder_bench, run test strings through each decoder in a tight loop.\n\n"
+            "Usage: rtl_433_decoder_bench [-n <calls>] [-a] [-G] [-o <json file>] <file>...\n"
+            "\t-n <calls> calls for each line and decoder (default: 100000)\n"
+            "\t-a run every line through all decoders, not just the one in brackets\n"
+            "\t-G also enable the decoders that are disabled by default\n"
+            "\t-o <file> write the JSON report to a file (default: stdout)\n\n"
+            "Lines are \"[<protocol>]<code>\", \"[<protocol>]<RfRaw>\", or without the protocol for all decoders.\n"
+            "Exits with failure if a line for a single decoder gives no output.\n");
+    exit(1);
+}
+
+static void load_lines(char const *path, list_t *lines)
+{
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        exit(1);
+    }
+    char buf[DEC_BENCH_LINE_MAX];
+    while (fgets(buf, sizeof(buf), file)) {
+        buf[strcspn(buf, "\r\n")] = '\0';
+        if (!*buf || *buf == '#')
+            continue;
+
+        dec_line_t *line = calloc(1, sizeof(dec_line_t));
+        if (!line)
+            FATAL_CALLOC("load_lines()");
+        line->text = strdup(buf);
+        if (!line->text)
+            FATAL_STRDUP("load_lines()");
+
+        char const *code = buf;
+        if (*code == '[') {
+            char *e;
+            line->protocol = (unsigned)strtol(code + 1, &e, 10);
+            if (*e != ']' || !line->protocol) {
+                fprintf(stderr, "Bad protocol number %.5s in %s\n", code, path);
+                exit(1);
+            }
+            code = e + 1;
+        }
+        if (rfraw_check(code)) {
+            line->is_rfraw = 1;
+            rfraw_parse(&line->pulses, code);
+        }
+        else {
+            bitbuffer_parse(&line->bits, code);
+        }
+        list_push(lines, line);
+    }
+    fclose(file);
+}
+
+static void line_free(dec_line_t *line)
+{
+    free(line->text);
+    free(line);
+}
+
+/// Run a line through a decoder, returns the number of outputs.
+static uint64_t bench_line(dec_line_t *line, dec_stat_t *stat, unsigned calls)
+{
+    r_device *r_dev = stat->r_dev;
+    list_t single   = {0};
+    list_push(&single, r_dev);
+    // decoders may change the bitbuffer, each call gets a fresh copy
+    bitbuffer_t *bits = malloc(sizeof(bitbuffer_t));
+    if (!bits)
+        FATAL_MALLOC("bench_line()");
+
+    uint64_t allocs  = alloc_count;
+    uint64_t bytes   = alloc_bytes;
+    uint64_t outputs = output_count;
+    uint64_t start   = monotonic_nsec();
+    if (line->is_rfraw) {
+        for (unsigned i = 0; i < calls; ++i) {
+            if (line->pulses.fsk_f2_est)
+                run_fsk_demods(&single, &line->pulses);
+            else
+                run_ook_demods(&single, &line->pulses);
+        }
+    }
+    else {
+        for (unsigned i = 0; i < calls; ++i) {
+            memcpy(bits, &line->bits, sizeof(*bits));
+            r_dev->decode_fn(r_dev, bits);
+        }
+    }
+    uint64_t nsec = monotonic_nsec() - start;
+    allocs        = alloc_count - allocs;
+    bytes         = alloc_bytes - bytes;
+    outputs       = output_count - outputs;
+
+    if (!line->is_rfraw) {
+        // time the copy alone to take it out
+        start = monotonic_nsec();
+        for (unsigned i = 0; i < calls; ++i) {
+            memcpy(bits, &line->bits, sizeof(*bits));
+            if (bits->num_rows > BITBUF_ROWS)
+                break; // keeps the copy from being optimized away
+        }
+        uint64_t copy = monotonic_nsec() - start;
+        nsec = nsec > copy ? nsec - copy : 0;
+    }
+
+    free(bits);
+    list_free_elems(&single, NULL);
+
+    stat->lines++;
+    stat->calls += calls;
+    stat->nsec += nsec;
+    stat->allocs += allocs;
+    stat->bytes += bytes;
+    stat->outputs += outputs;
+    return outputs;
+}
+
+static int cmp_nsec_per_call(void const *a, void const *b)
+{
+    dec_stat_t const *sa = a;
+    dec_stat_t const *sb = b;
+    double na = sa->calls ? (double)sa->nsec / sa->calls : 0.0;
+    double nb = sb->calls ? (double)sb->nsec / sb->calls : 0.0;
+    return na < nb ? 1 : na > nb ? -1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned calls      = 100000;
+    int all             = 0;
+    unsigned disabled   = 0;
+    char const *outpath = NULL;
+    int i;
+    for (i = 1; i < argc && argv[i][0] == '-'; ++i) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            calls = (unsigned)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-a"))
+            all = 1;
+        else if (!strcmp(argv[i], "-G"))
+            disabled = 1;
+        else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+            outpath = argv[++i];
+        else
+            usage();
+    }
+    if (i >= argc || calls < 1)
+        usage();
+
+    list_t lines = {0};
+    for (; i < argc; ++i)
+        load_lines(argv[i], &lines);
+
+    r_cfg_t *cfg = r_create_cfg();
+    register_all_protocols(cfg, disabled);
+    build_preamble_matcher(cfg);
+    list_t *r_devs = &cfg->demod->r_devs;
+
+    dec_stat_t *stats = calloc(r_devs->len, sizeof(dec_stat_t));
+    if (!stats)
+        FATAL_CALLOC("main()");
+    for (size_t d = 0; d < r_devs->len; ++d) {
+        r_device *r_dev = r_devs->elems[d];
+        r_dev->output_fn = bench_output;
+        stats[d].r_dev   = r_dev;
+    }
+
+    int failed = 0;
+    for (void **iter = lines.elems; iter && *iter; ++iter) {
+        dec_line_t *line = *iter;
+        int found        = 0;
+        uint64_t outputs = 0;
+        for (size_t d = 0; d < r_devs->len; ++d) {
+            r_device *r_dev = stats[d].r_dev;
+            if (line->protocol && !all && r_dev->protocol_num != line->protocol)
+                continue;
+            // slicers only run on matching pulses
+            int fsk_line = line->pulses.fsk_f2_est != 0;
+            int fsk_dev  = r_dev->modulation >= FSK_DEMOD_MIN_VAL;
+            if (line->is_rfraw && fsk_line != fsk_dev)
+                continue;
+            if (r_dev->protocol_num == line->protocol)
+                found = 1;
+            uint64_t n = bench_line(line, &stats[d], calls);
+            if (r_dev->protocol_num == line->protocol)
+                outputs = n;
+        }
+        if (line->protocol && !found) {
+            fprintf(stderr, "Protocol %u is not enabled for: %s\n", line->protocol, line->text);
+            failed++;
+        }
+        else if (line->protocol && !outputs) {
+            fprintf(stderr, "No output from protocol %u for: %s\n", line->protocol, line->text);
+            failed++;
+        }
+    }
+
+    qsort(stats, r_devs->len, sizeof(dec_stat_t), cmp_nsec_per_call);
+
+    list_t results = {0};
+    for (size_t d = 0; d < r_devs->len; ++d) {
+        dec_stat_t *stat = &stats[d];
+        if (!stat->calls)
+            continue;
+        double per = (double)stat->calls;
+        list_push(&results, data_make(
+                "protocol",         "", DATA_INT, (int)stat->r_dev->protocol_num,
+                "name",             "", DATA_STRING, stat->r_dev->name,
+                "lines",            "", DATA_INT, (int)stat->lines,
+                "calls",            "", DATA_INT, (int)stat->calls,
+                "ns_per_call",      "", DATA_DOUBLE, stat->nsec / per,
+                "allocs_per_call",  "", DATA_COND, WRAP_ALLOC_ON, DATA_DOUBLE, stat->allocs / per,
+                "bytes_per_call",   "", DATA_COND, WRAP_ALLOC_ON, DATA_DOUBLE, stat->bytes / per,
+                "outputs_per_call", "", DATA_DOUBLE, stat->outputs / per,
+                NULL));
+    }
+
+    data_t *data = data_make(
+            "lines",            "", DATA_INT, (int)lines.len,
+            "calls",            "", DATA_INT, (int)calls,
+            "alloc_counting",   "", DATA_INT, WRAP_ALLOC_ON,
+            "decoders",         "", DATA_ARRAY, data_array(results.len, DATA_DATA, results.elems),
+            NULL);
+    list_free_elems(&results, NULL);
+
+    FILE *out = outpath ? fopen(outpath, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "Failed to open %s\n", outpath);
+        exit(1);
+    }
+    struct data_output *output = data_output_json_create(out);
+    data_output_print(output, data);
+    data_output_free(output);
+    if (out != stdout)
+        fclose(out);
+    data_free(data);
+
+    free(stats);
+    list_free_elems(&lines, (list_elem_free_fn)line_free);
+    r_free_cfg(cfg);
+    free(cfg);
+
+    return failed;
+}
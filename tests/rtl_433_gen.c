@@ -0,0 +1,287 @@
+/** @file
+    Synthetic IQ signal generator for load testing.
+
+    Renders pulse files (`.ook`), RfRaw strings, or flex-style specs to CU8, CS16,
+    or CF32 samples. Messages are sent at random times with a target rate, overlap freely,
+    and get a random SNR and carrier offset from the given ranges.
+
+    E.g. `rtl_433_gen -m 20 -t 60 -f -50k:50k nexus.ook prologue.ook | rtl_433 -r cu8:-`
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "signal_gen.h"
+#include "pulse_detect.h"
+#include "rfraw.h"
+#include "fileformat.h"
+#include "optparse.h"
+#include "list.h"
+#include "fatal.h"
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+#define GEN_BLOCK 16384 // samples rendered at once
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "rtl_433_gen, render pulse data to IQ samples for load testing.\n\n"
+            "Usage: rtl_433_gen [options] <file.ook | RfRaw | spec>...\n"
+            "\t-s <rate> sample rate (default: 250k)\n"
+            "\t-w <file> output, the format is from the name or a prefix, e.g. out.cs16 (default: cu8:-)\n"
+            "\t-t <seconds> length of the output (default: 10, or until -c messages are sent)\n"
+            "\t-c <count> send this many messages at most\n"
+            "\t-m <rate> messages per second, randomly spaced (default: 1)\n"
+            "\t-n <dBFS> noise level (default: -30)\n"
+            "\t-S <dB>[:<dB>] signal to noise ratio, a range is picked from for each message (default: 24)\n"
+            "\t-f <Hz>[:<Hz>] carrier offset, a range is picked from for each message (default: 0)\n"
+            "\t-d <Hz> FSK deviation (default: 25k)\n"
+            "\t-r <seed> random seed, runs with the same seed are identical (default: 1)\n\n"
+            "Inputs are pulse files, RfRaw strings, or flex-style specs with the keys\n"
+            "m (modulation), s (short), l (long), p (PPM pulse), g (row gap), r (reset gap), repeats, codes, e.g.\n"
+            "\"m=OOK_PWM,s=464,l=1404,r=14000,repeats=3,codes={25}5a3c80\"\n"
+            "Each message is a random pick of the inputs.\n"
+            "Note that rtl_433 ignores signals below -12 dBFS unless \"-Y minlevel\" is lowered.\n");
+    exit(1);
+}
+
+/// Parse a number with an optional k or M suffix.
+static float parse_metric(char const *str, char const *error_hint)
+{
+    char *end;
+    double val = strtod(str, &end);
+    if (*end == 'k' || *end == 'K') {
+        val *= 1e3;
+        ++end;
+    }
+    else if (*end == 'M') {
+        val *= 1e6;
+        ++end;
+    }
+    if (end == str || *end) {
+        fprintf(stderr, "%sinvalid number argument (%s)\n", error_hint, str);
+        exit(1);
+    }
+    return (float)val;
+}
+
+/// Parse a single value or a range of lo:hi.
+static void parse_range(char const *arg, float *lo, float *hi, char const *error_hint)
+{
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%s", arg);
+    char *sep = strchr(buf + 1, ':'); // skip a leading sign
+    if (sep)
+        *sep = '\0';
+    *lo = parse_metric(buf, error_hint);
+    *hi = sep ? parse_metric(sep + 1, error_hint) : *lo;
+}
+
+/// Load all packages of a pulse file, an RfRaw string, or a spec.
+static void load_input(char const *arg, uint32_t sample_rate, list_t *inputs)
+{
+    if (rfraw_check(arg) || strchr(arg, '=')) {
+        pulse_data_t *pulses = calloc(1, sizeof(pulse_data_t));
+        if (!pulses)
+            FATAL_CALLOC("load_input()");
+        if (rfraw_check(arg))
+            rfraw_parse(pulses, arg);
+        else if (signal_gen_parse_spec(pulses, arg))
+            exit(1);
+        list_push(inputs, pulses);
+        return;
+    }
+
+    FILE *file = fopen(arg, "r");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s\n", arg);
+        exit(1);
+    }
+    for (;;) {
+        pulse_data_t *pulses = calloc(1, sizeof(pulse_data_t));
+        if (!pulses)
+            FATAL_CALLOC("load_input()");
+        pulse_data_load(file, pulses, sample_rate);
+        if (!pulses->num_pulses) {
+            free(pulses);
+            break;
+        }
+        list_push(inputs, pulses);
+    }
+    fclose(file);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t sample_rate = 250000;
+    char const *outspec  = "cu8:-";
+    double seconds       = 0.0;
+    unsigned count       = 0;
+    double rate          = 1.0;
+    float noise_dbfs     = -30.0f;
+    float snr_lo = 24.0f, snr_hi = 24.0f;
+    float offset_lo = 0.0f, offset_hi = 0.0f;
+    float deviation      = 25000.0f;
+    uint32_t seed        = 1;
+
+    int i;
+    for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; ++i) {
+        char const *opt = argv[i];
+        if (i + 1 >= argc || opt[2])
+            usage();
+        char const *val = argv[++i];
+        switch (opt[1]) {
+        case 's': sample_rate = atouint32_metric(val, "-s: "); break;
+        case 'w': outspec = val; break;
+        case 't': seconds = arg_float(val, "-t: "); break;
+        case 'c': count = (unsigned)atoiv(val, 0); break;
+        case 'm': rate = arg_float(val, "-m: "); break;
+        case 'n': noise_dbfs = (float)arg_float(val, "-n: "); break;
+        case 'S': parse_range(val, &snr_lo, &snr_hi, "-S: "); break;
+        case 'f': parse_range(val, &offset_lo, &offset_hi, "-f: "); break;
+        case 'd': deviation = (float)atouint32_metric(val, "-d: "); break;
+        case 'r': seed = (uint32_t)strtoul(val, NULL, 0); break;
+        default: usage();
+        }
+    }
+    if (i >= argc || !sample_rate || rate <= 0.0 || seconds < 0.0)
+        usage();
+    if (!seconds && !count)
+        seconds = 10.0;
+
+    file_info_t out = {0};
+    parse_file_info(outspec, &out);
+    if (out.format != CU8_IQ && out.format != CS16_IQ && out.format != CF32_IQ) {
+        fprintf(stderr, "Output format must be CU8, CS16, or CF32 (%s).\n", outspec);
+        exit(1);
+    }
+    if (!strcmp(out.path, "-")) {
+        out.file = stdout;
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    }
+    else {
+        out.file = fopen(out.path, "wb");
+        if (!out.file) {
+            fprintf(stderr, "Failed to open %s\n", out.path);
+            exit(1);
+        }
+    }
+
+    list_t inputs = {0};
+    for (; i < argc; ++i)
+        load_input(argv[i], sample_rate, &inputs);
+    if (!inputs.len) {
+        fprintf(stderr, "No pulse data in the inputs.\n");
+        exit(1);
+    }
+
+    signal_gen_t *gen = signal_gen_create(sample_rate, noise_dbfs, seed);
+    if (!gen)
+        exit(1);
+
+    float *iq = malloc(GEN_BLOCK * 2 * sizeof(float));
+    if (!iq)
+        FATAL_MALLOC("main()");
+    // an out buffer for CU8 or CS16, CF32 is written directly
+    void *buf = malloc(GEN_BLOCK * 2 * sizeof(int16_t));
+    if (!buf)
+        FATAL_MALLOC("main()");
+    size_t ends_size = 16;
+    uint64_t *ends   = malloc(ends_size * sizeof(uint64_t));
+    if (!ends)
+        FATAL_MALLOC("main()");
+    size_t ends_len  = 0;
+
+    uint64_t total     = seconds ? (uint64_t)(seconds * sample_rate) : UINT64_MAX;
+    double samples_per = sample_rate / rate;
+    double next        = -log(1.0 - signal_gen_random(gen)) * samples_per;
+    unsigned messages  = 0;
+    unsigned overlap   = 0;
+
+    while (gen->pos < total) {
+        int more = !count || messages < count;
+        if (!more && !signal_gen_pending(gen))
+            break;
+        unsigned len = total - gen->pos < GEN_BLOCK ? (unsigned)(total - gen->pos) : GEN_BLOCK;
+        uint64_t end = gen->pos + len;
+
+        // schedule messages with exponentially distributed spacing
+        while (more && next < end) {
+            pulse_data_t const *pulses = inputs.elems[(size_t)(signal_gen_random(gen) * inputs.len)];
+            uint64_t start = (uint64_t)next;
+            float snr      = snr_lo + (float)signal_gen_random(gen) * (snr_hi - snr_lo);
+            float offset   = offset_lo + (float)signal_gen_random(gen) * (offset_hi - offset_lo);
+            signal_gen_add(gen, pulses, start, noise_dbfs + snr, offset, deviation);
+
+            // track the most transmissions on air at once
+            size_t k = 0;
+            for (size_t j = 0; j < ends_len; ++j) {
+                if (ends[j] > start)
+                    ends[k++] = ends[j];
+            }
+            ends_len = k;
+            if (ends_len == ends_size) {
+                ends_size *= 2;
+                uint64_t *new_ends = realloc(ends, ends_size * sizeof(uint64_t));
+                if (!new_ends)
+                    FATAL_REALLOC("main()");
+                ends = new_ends;
+            }
+            ends[ends_len++] = start + signal_gen_duration(gen, pulses);
+            if (ends_len > overlap)
+                overlap = (unsigned)ends_len;
+
+            messages++;
+            more = !count || messages < count;
+            next += -log(1.0 - signal_gen_random(gen)) * samples_per;
+        }
+
+        signal_gen_render(gen, iq, len);
+
+        size_t written;
+        if (out.format == CU8_IQ) {
+            signal_gen_to_cu8(iq, buf, len);
+            written = fwrite(buf, 2 * sizeof(uint8_t), len, out.file);
+        }
+        else if (out.format == CS16_IQ) {
+            signal_gen_to_cs16(iq, buf, len);
+            written = fwrite(buf, 2 * sizeof(int16_t), len, out.file);
+        }
+        else {
+            written = fwrite(iq, 2 * sizeof(float), len, out.file);
+        }
+        if (written != len) {
+            fprintf(stderr, "Failed to write %s\n", outspec);
+            break;
+        }
+    }
+
+    fprintf(stderr, "Sent %u messages in %.3f s of %s, at most %u at once.\n",
+            messages, (double)gen->pos / sample_rate, file_info_string(&out), overlap);
+
+    if (out.file != stdout)
+        fclose(out.file);
+    free(ends);
+    free(buf);
+    free(iq);
+    signal_gen_free(gen);
+    list_free_elems(&inputs, free);
+
+    return 0;
+}
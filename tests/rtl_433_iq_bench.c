@@ -0,0 +1,306 @@
+/** @file
+    Benchmark of the lossless IQ codec, compression ratio against MB/s.
+
+    Encodes and decodes CU8 and CS16 samples in blocks, single threaded and
+    through the threaded stream decoder. Without inputs a synthetic corpus of
+    noise floor with sparse OOK bursts is used. Reports the results as JSON.
+
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "iq_codec.h"
+#include "signal_gen.h"
+#include "pulse_detect.h"
+#include "fileformat.h"
+#include "data.h"
+#include "list.h"
+#include "compat_time.h"
+#include "fatal.h"
+
+#define BENCH_SAMPLE_RATE 1000000
+#define BENCH_SECONDS     10
+#define BENCH_BURST_DBFS  -10.0f
+#define BENCH_BURST_SPEC  "m=OOK_PWM,s=464,l=1404,g=4000,r=14000,repeats=3,codes={25}5a3c80"
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "rtl_433_iq_bench, measure the lossless IQ codec.\n\n"
+            "Usage: rtl_433_iq_bench [-n <repeats>] [-o <json file>] [<file.cu8> | <file.cs16>]...\n"
+            "\t-n <repeats> run each input this many times (default: 3)\n"
+            "\t-o <file> write the JSON report to a file (default: stdout)\n\n"
+            "Without inputs %d s of synthetic noise floor at %d sps with an OOK burst each second are used.\n",
+            BENCH_SECONDS, BENCH_SAMPLE_RATE);
+    exit(1);
+}
+
+/// Render noise with a burst each second, @p low_bits are cleared to mimic a 12 bit converter.
+static size_t render_corpus(float noise_dbfs, int sample_size, unsigned low_bits, uint8_t **out)
+{
+    signal_gen_t *gen = signal_gen_create(BENCH_SAMPLE_RATE, noise_dbfs, 1);
+    if (!gen)
+        exit(1);
+    pulse_data_t *burst = calloc(1, sizeof(*burst));
+    if (!burst)
+        FATAL_CALLOC("render_corpus()");
+    if (signal_gen_parse_spec(burst, BENCH_BURST_SPEC))
+        exit(1);
+
+    size_t total = (size_t)BENCH_SECONDS * BENCH_SAMPLE_RATE;
+    for (unsigned s = 0; s < BENCH_SECONDS; ++s)
+        signal_gen_add(gen, burst, (uint64_t)s * BENCH_SAMPLE_RATE + BENCH_SAMPLE_RATE / 2, BENCH_BURST_DBFS, 50000.0f, 0.0f);
+
+    uint8_t *buf = malloc(total * sample_size);
+    if (!buf)
+        FATAL_MALLOC("render_corpus()");
+    float *iq = malloc(IQ_CODEC_BLOCK_SAMPLES * 2 * sizeof(float));
+    if (!iq)
+        FATAL_MALLOC("render_corpus()");
+
+    for (size_t pos = 0; pos < total; pos += IQ_CODEC_BLOCK_SAMPLES) {
+        unsigned len = total - pos < IQ_CODEC_BLOCK_SAMPLES ? (unsigned)(total - pos) : IQ_CODEC_BLOCK_SAMPLES;
+        signal_gen_render(gen, iq, len);
+        if (sample_size == 2)
+            signal_gen_to_cu8(iq, buf + pos * 2, len);
+        else
+            signal_gen_to_cs16(iq, (int16_t *)buf + pos * 2, len);
+    }
+    if (sample_size == 4 && low_bits) {
+        int16_t *s16 = (int16_t *)buf;
+        for (size_t i = 0; i < total * 2; ++i)
+            s16[i] = (int16_t)(s16[i] & ~((1 << low_bits) - 1));
+    }
+
+    free(iq);
+    free(burst);
+    signal_gen_free(gen);
+    *out = buf;
+    return total;
+}
+
+static size_t load_file(char const *path, int *sample_size, uint8_t **out)
+{
+    file_info_t info = {0};
+    parse_file_info(path, &info);
+    if (info.format != CU8_IQ && info.format != CS16_IQ) {
+        fprintf(stderr, "Not a CU8 or CS16 file: %s\n", path);
+        return 0;
+    }
+    *sample_size = info.format == CS16_IQ ? 4 : 2;
+
+    FILE *file = fopen(info.path, "rb");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return 0;
+    }
+    fseek(file, 0, SEEK_END);
+    long len = ftell(file);
+    rewind(file);
+    uint8_t *buf = malloc(len > 0 ? len : 1);
+    if (!buf)
+        FATAL_MALLOC("load_file()");
+    size_t n = fread(buf, 1, len > 0 ? len : 0, file);
+    fclose(file);
+    *out = buf;
+    return n / *sample_size;
+}
+
+typedef struct {
+    uint64_t raw_bytes;
+    uint64_t coded_bytes;
+    uint64_t encode_nsec;
+    uint64_t decode_nsec;
+    uint64_t stream_nsec;
+    unsigned stored_blocks;
+    unsigned blocks;
+    int mismatch;
+} bench_result_t;
+
+static void bench_codec(uint8_t const *samples, size_t num_samples, int sample_size, bench_result_t *result)
+{
+    size_t block_bytes = (size_t)IQ_CODEC_BLOCK_SAMPLES * sample_size;
+    unsigned num_blocks = (unsigned)((num_samples + IQ_CODEC_BLOCK_SAMPLES - 1) / IQ_CODEC_BLOCK_SAMPLES);
+    size_t bound        = iq_encode_bound(IQ_CODEC_BLOCK_SAMPLES, sample_size);
+    uint8_t *coded = malloc(bound * num_blocks);
+    if (!coded)
+        FATAL_MALLOC("bench_codec()");
+    size_t *lens = calloc(num_blocks, sizeof(*lens));
+    if (!lens)
+        FATAL_CALLOC("bench_codec()");
+    uint8_t *decoded = malloc(block_bytes);
+    if (!decoded)
+        FATAL_MALLOC("bench_codec()");
+
+    uint64_t start = monotonic_nsec();
+    for (unsigned b = 0; b < num_blocks; ++b) {
+        size_t pos  = (size_t)b * IQ_CODEC_BLOCK_SAMPLES;
+        unsigned n  = num_samples - pos < IQ_CODEC_BLOCK_SAMPLES ? (unsigned)(num_samples - pos) : IQ_CODEC_BLOCK_SAMPLES;
+        lens[b] = iq_encode_block(samples + pos * sample_size, n, sample_size, coded + b * bound);
+    }
+    result->encode_nsec += monotonic_nsec() - start;
+
+    start = monotonic_nsec();
+    for (unsigned b = 0; b < num_blocks; ++b) {
+        int n = iq_decode_block(coded + b * bound, lens[b], decoded, IQ_CODEC_BLOCK_SAMPLES);
+        if (n < 0 || memcmp(decoded, samples + (size_t)b * block_bytes, (size_t)n * sample_size))
+            result->mismatch = 1;
+    }
+    result->decode_nsec += monotonic_nsec() - start;
+
+    // the same blocks through a file and the threaded decoder
+    FILE *file = tmpfile();
+    if (!file)
+        exit(1);
+    iq_encoder_t *enc = iq_encoder_create(file, sample_size);
+    if (!enc)
+        exit(1);
+    iq_encoder_write(enc, samples, num_samples * sample_size, BENCH_SAMPLE_RATE, 0);
+    iq_encoder_close(enc);
+    rewind(file);
+
+    start = monotonic_nsec();
+    iq_decoder_t *dec = iq_decoder_open(file);
+    if (!dec)
+        exit(1);
+    uint8_t const *buf;
+    size_t pos = 0;
+    long r;
+    while ((r = iq_decoder_read(dec, &buf)) > 0)
+        pos += r;
+    iq_decoder_close(dec);
+    result->stream_nsec += monotonic_nsec() - start;
+    if (r < 0 || pos != num_samples * sample_size)
+        result->mismatch = 1;
+    fclose(file);
+
+    for (unsigned b = 0; b < num_blocks; ++b) {
+        result->coded_bytes += lens[b];
+        result->stored_blocks += coded[b * bound] == 0;
+    }
+    result->raw_bytes += num_samples * sample_size;
+    result->blocks += num_blocks;
+
+    free(decoded);
+    free(lens);
+    free(coded);
+}
+
+static double mb_per_sec(uint64_t bytes, uint64_t nsec)
+{
+    return nsec ? bytes * 1e3 / nsec : 0.0;
+}
+
+static data_t *result_data(char const *input, char const *format, bench_result_t *result)
+{
+    return data_make(
+            "input",            "", DATA_STRING, input,
+            "format",           "", DATA_STRING, format,
+            "raw_bytes",        "", DATA_INT, (int)(result->raw_bytes),
+            "ratio",            "", DATA_DOUBLE, result->raw_bytes ? (double)result->coded_bytes / result->raw_bytes : 0.0,
+            "stored_blocks",    "", DATA_INT, (int)result->stored_blocks,
+            "blocks",           "", DATA_INT, (int)result->blocks,
+            "encode_mb_s",      "", DATA_DOUBLE, mb_per_sec(result->raw_bytes, result->encode_nsec),
+            "decode_mb_s",      "", DATA_DOUBLE, mb_per_sec(result->raw_bytes, result->decode_nsec),
+            "stream_decode_mb_s", "", DATA_DOUBLE, mb_per_sec(result->raw_bytes, result->stream_nsec),
+            NULL);
+}
+
+int main(int argc, char **argv)
+{
+    int repeats         = 3;
+    char const *outpath = NULL;
+    int i;
+    for (i = 1; i < argc && argv[i][0] == '-'; ++i) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            repeats = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+            outpath = argv[++i];
+        else
+            usage();
+    }
+    if (repeats < 1)
+        usage();
+
+    list_t results = {0};
+    int failed     = 0;
+
+    if (i >= argc) {
+        static struct {
+            char const *name;
+            char const *format;
+            float noise_dbfs;
+            int sample_size;
+            unsigned low_bits;
+        } const corpus[] = {
+                {"noise-40dB", "cu8", -40.0f, 2, 0},
+                {"noise-30dB", "cu8", -30.0f, 2, 0},
+                {"noise-40dB", "cs16", -40.0f, 4, 0},
+                {"noise-40dB-12bit", "cs16", -40.0f, 4, 4},
+        };
+        for (unsigned c = 0; c < sizeof(corpus) / sizeof(*corpus); ++c) {
+            uint8_t *samples;
+            size_t num_samples = render_corpus(corpus[c].noise_dbfs, corpus[c].sample_size, corpus[c].low_bits, &samples);
+            bench_result_t result = {0};
+            for (int r = 0; r < repeats; ++r)
+                bench_codec(samples, num_samples, corpus[c].sample_size, &result);
+            free(samples);
+            if (result.mismatch) {
+                fprintf(stderr, "Round trip failed for %s as %s\n", corpus[c].name, corpus[c].format);
+                failed++;
+            }
+            list_push(&results, result_data(corpus[c].name, corpus[c].format, &result));
+        }
+    }
+
+    for (; i < argc; ++i) {
+        char const *path = argv[i];
+        uint8_t *samples;
+        int sample_size;
+        size_t num_samples = load_file(path, &sample_size, &samples);
+        if (!num_samples) {
+            failed++;
+            continue;
+        }
+        bench_result_t result = {0};
+        for (int r = 0; r < repeats; ++r)
+            bench_codec(samples, num_samples, sample_size, &result);
+        free(samples);
+        if (result.mismatch) {
+            fprintf(stderr, "Round trip failed for %s\n", path);
+            failed++;
+        }
+        list_push(&results, result_data(file_basename(path), sample_size == 4 ? "cs16" : "cu8", &result));
+    }
+
+    data_t *data = data_make(
+            "block_samples",    "", DATA_INT, IQ_CODEC_BLOCK_SAMPLES,
+            "decoder_threads",  "", DATA_INT, IQ_DECODER_THREADS,
+            "repeats",          "", DATA_INT, repeats,
+            "inputs",           "", DATA_ARRAY, data_array(results.len, DATA_DATA, results.elems),
+            NULL);
+    list_free_elems(&results, NULL);
+
+    FILE *out = outpath ? fopen(outpath, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "Failed to open %s\n", outpath);
+        exit(1);
+    }
+    struct data_output *output = data_output_json_create(out);
+    data_output_print(output, data);
+    data_output_free(output);
+    if (out != stdout)
+        fclose(out);
+    data_free(data);
+
+    return failed;
+}
@@ -22,6 +22,7 @@
 /// Check that there are no long lines.
 /// Check that there are no CRLF endings.
 /// Check that there are no mixed tabs/spaces.
+/// Check that decoders with mutable static data are marked stateful.
 static int style_check(char *path)
 {
     char *strict = strstr(path, "/devices/");
@@ -38,6 +39,8 @@ static int style_check(char *path)
     int trailing_errors = 0;
     int memc_errors = 0;
     int funbrace_errors = 0;
+    int static_errors = 0;
+    int stateful = 0;
 
     int leading_tabs = 0;
     int leading_spcs = 0;
@@ -74,6 +77,18 @@ static int style_check(char *path)
             funbrace_errors++;
         }
 
+        // mutable static data, i.e. not const, not a function, and not the output fields list
+        char *s = str + strspn(str, " ");
+        if (!strncmp(s, "static ", 7) && !strstr(s, "const") && !strstr(s, "output_fields")) {
+            size_t decl = strcspn(s, "=;{");
+            if (s[decl] && !memchr(s, '(', decl)) {
+                static_errors++;
+            }
+        }
+        if (strstr(str, ".stateful")) {
+            stateful++;
+        }
+
         if (strstr(str, "stdout")) {
             use_stdout++;
         }
@@ -120,9 +135,11 @@ static int style_check(char *path)
         printf("File \"%s\" has %d STDOUT lines.\n", path, use_stdout);
     if (strict && use_printf)
         printf("File \"%s\" has %d PRINTF lines.\n", path, use_printf);
+    if (strict && !stateful && static_errors)
+        printf("File \"%s\" has %d mutable STATIC lines but is not marked stateful.\n", path, static_errors);
 
     return read_errors + long_errors + crlf_errors + tabs_errors + leading_tabs + trailing_errors
-            + funbrace_errors + (strict ? use_stdout + use_printf : 0) + memc_errors;
+            + funbrace_errors + (strict ? use_stdout + use_printf + (stateful ? 0 : static_errors) : 0) + memc_errors;
 }
 
 int main(int argc, char *argv[])